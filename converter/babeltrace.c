@@ -50,6 +50,7 @@
 #include <inttypes.h>
 #include <ftw.h>
 #include <string.h>
+#include <limits.h>
 
 #include <babeltrace/ctf-ir/metadata.h>	/* for clocks */
 
@@ -61,6 +62,8 @@
 #define NET4_URL_PREFIX	"net4://"
 #define NET6_URL_PREFIX	"net6://"
 
+#define NSEC_PER_SEC	1000000000ULL
+
 static char *opt_input_format, *opt_output_format;
 
 /*
@@ -73,6 +76,10 @@ static char *opt_input_format, *opt_output_format;
 static GPtrArray *opt_input_paths;
 static char *opt_output_path;
 
+/* Events to convert, all events by default. */
+static GPtrArray *opt_event_names;	/* Array of strings */
+static uint64_t opt_begin_ns, opt_end_ns = UINT64_MAX;
+
 static struct bt_format *fmt_read;
 
 static
@@ -103,6 +110,15 @@ enum {
 	OPT_CLOCK_DATE,
 	OPT_CLOCK_GMT,
 	OPT_CLOCK_FORCE_CORRELATE,
+	OPT_MMAP_WINDOW,
+	OPT_INDEX_THREADS,
+	OPT_WRITE_INDEX_CACHE,
+	OPT_PIPELINE_DEPTH,
+	OPT_ZERO_COPY_STRINGS,
+	OPT_LIVE_BUFFER_POOL,
+	OPT_EVENT,
+	OPT_BEGIN,
+	OPT_END,
 };
 
 /*
@@ -132,6 +148,15 @@ static struct poptOption long_options[] = {
 	{ "clock-date", 0, POPT_ARG_NONE, NULL, OPT_CLOCK_DATE, NULL, NULL },
 	{ "clock-gmt", 0, POPT_ARG_NONE, NULL, OPT_CLOCK_GMT, NULL, NULL },
 	{ "clock-force-correlate", 0, POPT_ARG_NONE, NULL, OPT_CLOCK_FORCE_CORRELATE, NULL, NULL },
+	{ "mmap-window", 0, POPT_ARG_STRING, NULL, OPT_MMAP_WINDOW, NULL, NULL },
+	{ "index-threads", 0, POPT_ARG_STRING, NULL, OPT_INDEX_THREADS, NULL, NULL },
+	{ "write-index-cache", 0, POPT_ARG_NONE, NULL, OPT_WRITE_INDEX_CACHE, NULL, NULL },
+	{ "pipeline-depth", 0, POPT_ARG_STRING, NULL, OPT_PIPELINE_DEPTH, NULL, NULL },
+	{ "zero-copy-strings", 0, POPT_ARG_NONE, NULL, OPT_ZERO_COPY_STRINGS, NULL, NULL },
+	{ "live-buffer-pool", 0, POPT_ARG_STRING, NULL, OPT_LIVE_BUFFER_POOL, NULL, NULL },
+	{ "event", 'e', POPT_ARG_STRING, NULL, OPT_EVENT, NULL, NULL },
+	{ "begin", 0, POPT_ARG_STRING, NULL, OPT_BEGIN, NULL, NULL },
+	{ "end", 0, POPT_ARG_STRING, NULL, OPT_END, NULL, NULL },
 	{ NULL, 0, 0, NULL, 0, NULL, NULL },
 };
 
@@ -148,6 +173,8 @@ static void usage(FILE *fp)
 	fprintf(fp, "\n");
 	fprintf(fp, "  FILE                           Input trace file(s) and/or directory(ies)\n");
 	fprintf(fp, "                                     (space-separated)\n");
+	fprintf(fp, "                                 or lttng-live URLs, all followed at once:\n");
+	fprintf(fp, "                                     net://host[:port][/ID[,ID]...]\n");
 	fprintf(fp, "  -w, --output OUTPUT            Output trace path (default: stdout)\n");
 	fprintf(fp, "\n");
 	fprintf(fp, "  -i, --input-format FORMAT      Input trace format (default: ctf)\n");
@@ -177,10 +204,73 @@ static void usage(FILE *fp)
 	fprintf(fp, "      --clock-gmt                Print clock in GMT time zone (default: local time zone)\n");
 	fprintf(fp, "      --clock-force-correlate    Assume that clocks are inherently correlated\n");
 	fprintf(fp, "                                 across traces.\n");
+	fprintf(fp, "      --mmap-window MiB          Map input streams through a sliding window of\n");
+	fprintf(fp, "                                 MiB mebibytes spanning many packets, or \"file\"\n");
+	fprintf(fp, "                                 to map whole files (default: map each packet)\n");
+	fprintf(fp, "      --index-threads N          Number of threads indexing stream files at open\n");
+	fprintf(fp, "                                 (default: 0, one per CPU)\n");
+	fprintf(fp, "      --write-index-cache        Save the packet index of input streams without an\n");
+	fprintf(fp, "                                 up-to-date index file to the trace index directory\n");
+	fprintf(fp, "      --pipeline-depth N         Decode each input stream in its own thread, up to\n");
+	fprintf(fp, "                                 N events ahead (default: 0, decode inline)\n");
+	fprintf(fp, "      --zero-copy-strings        Reference string fields in the mapped packets\n");
+	fprintf(fp, "                                 instead of copying them\n");
+	fprintf(fp, "      --live-buffer-pool MiB     Bound on the lttng-live packet buffers, in\n");
+	fprintf(fp, "                                 mebibytes (default: 256)\n");
+	fprintf(fp, "  -e, --event name1<,name2,...>  Only convert the events with these names\n");
+	fprintf(fp, "      --begin sec[.ns]           Only convert the events at or after this time,\n");
+	fprintf(fp, "                                 as printed by --clock-seconds\n");
+	fprintf(fp, "      --end sec[.ns]             Only convert the events at or before this time,\n");
+	fprintf(fp, "                                 as printed by --clock-seconds\n");
 	list_formats(fp);
 	fprintf(fp, "\n");
 }
 
+static int get_event_args(poptContext *pc)
+{
+	char *str, *strlist, *strctx;
+
+	strlist = (char *) poptGetOptArg(*pc);
+	if (!strlist) {
+		return -EINVAL;
+	}
+	for (str = strtok_r(strlist, ",", &strctx); str;
+			str = strtok_r(NULL, ",", &strctx))
+		g_ptr_array_add(opt_event_names, g_strdup(str));
+	free(strlist);
+	return 0;
+}
+
+/*
+ * Parse a time in seconds, with up to 9 decimals: "sec[.ns]".
+ */
+static int parse_seconds(const char *str, uint64_t *ns)
+{
+	uint64_t sec, nsec = 0;
+	char *endptr;
+	int digits = 0;
+
+	if (!isdigit((int) *str))
+		return -EINVAL;
+	errno = 0;
+	sec = strtoull(str, &endptr, 10);
+	if (errno != 0 || sec >= UINT64_MAX / NSEC_PER_SEC)
+		return -EINVAL;
+	if (*endptr == '.') {
+		for (endptr++; isdigit((int) *endptr); endptr++) {
+			if (++digits > 9)
+				return -EINVAL;
+			nsec = nsec * 10 + (*endptr - '0');
+		}
+		for (; digits < 9; digits++)
+			nsec *= 10;
+	}
+	if (*endptr != '\0')
+		return -EINVAL;
+	*ns = sec * NSEC_PER_SEC + nsec;
+	return 0;
+}
+
 static int get_names_args(poptContext *pc)
 {
 	char *str, *strlist, *strctx;
@@ -396,13 +486,162 @@ static int parse_options(int argc, char **argv)
 		case OPT_CLOCK_FORCE_CORRELATE:
 			opt_clock_force_correlate = 1;
 			break;
+		case OPT_MMAP_WINDOW:
+		{
+			char *str;
+			char *endptr;
+			uint64_t len;
+
+			str = (char *) poptGetOptArg(pc);
+			if (!str) {
+				fprintf(stderr, "[error] Missing --mmap-window argument\n");
+				ret = -EINVAL;
+				goto end;
+			}
+			if (!strcmp(str, "file")) {
+				opt_mmap_window_len = UINT64_MAX;
+				free(str);
+				break;
+			}
+			errno = 0;
+			len = strtoull(str, &endptr, 0);
+			if (*endptr != '\0' || str == endptr || errno != 0
+					|| len > (UINT64_MAX >> 20)) {
+				fprintf(stderr, "[error] Incorrect --mmap-window argument: %s\n", str);
+				ret = -EINVAL;
+				free(str);
+				goto end;
+			}
+			opt_mmap_window_len = len << 20;
+			free(str);
+			break;
+		}
+		case OPT_INDEX_THREADS:
+		{
+			char *str;
+			char *endptr;
+			long nr_threads;
+
+			str = (char *) poptGetOptArg(pc);
+			if (!str) {
+				fprintf(stderr, "[error] Missing --index-threads argument\n");
+				ret = -EINVAL;
+				goto end;
+			}
+			errno = 0;
+			nr_threads = strtol(str, &endptr, 0);
+			if (*endptr != '\0' || str == endptr || errno != 0
+					|| nr_threads < 0 || nr_threads > INT_MAX) {
+				fprintf(stderr, "[error] Incorrect --index-threads argument: %s\n", str);
+				ret = -EINVAL;
+				free(str);
+				goto end;
+			}
+			opt_index_threads = nr_threads;
+			free(str);
+			break;
+		}
+		case OPT_WRITE_INDEX_CACHE:
+			opt_write_index_cache = 1;
+			break;
+		case OPT_PIPELINE_DEPTH:
+		{
+			char *str;
+			char *endptr;
+			long depth;
 
+			str = (char *) poptGetOptArg(pc);
+			if (!str) {
+				fprintf(stderr, "[error] Missing --pipeline-depth argument\n");
+				ret = -EINVAL;
+				goto end;
+			}
+			errno = 0;
+			depth = strtol(str, &endptr, 0);
+			if (*endptr != '\0' || str == endptr || errno != 0
+					|| depth < 0 || depth > 4096) {
+				fprintf(stderr, "[error] Incorrect --pipeline-depth argument: %s\n", str);
+				ret = -EINVAL;
+				free(str);
+				goto end;
+			}
+			opt_pipeline_depth = depth;
+			free(str);
+			break;
+		}
+		case OPT_ZERO_COPY_STRINGS:
+			opt_zero_copy_strings = 1;
+			break;
+		case OPT_LIVE_BUFFER_POOL:
+		{
+			char *str;
+			char *endptr;
+			uint64_t len;
+
+			str = (char *) poptGetOptArg(pc);
+			if (!str) {
+				fprintf(stderr, "[error] Missing --live-buffer-pool argument\n");
+				ret = -EINVAL;
+				goto end;
+			}
+			errno = 0;
+			len = strtoull(str, &endptr, 0);
+			if (*endptr != '\0' || str == endptr || errno != 0
+					|| len == 0 || len > (UINT64_MAX >> 20)) {
+				fprintf(stderr, "[error] Incorrect --live-buffer-pool argument: %s\n", str);
+				ret = -EINVAL;
+				free(str);
+				goto end;
+			}
+			opt_live_buffer_pool_len = len << 20;
+			free(str);
+			break;
+		}
+		case OPT_EVENT:
+			if (get_event_args(&pc)) {
+				ret = -EINVAL;
+				goto end;
+			}
+			break;
+		case OPT_BEGIN:
+		case OPT_END:
+		{
+			char *str;
+			uint64_t ns;
+
+			str = (char *) poptGetOptArg(pc);
+			if (!str) {
+				fprintf(stderr, "[error] Missing --%s argument\n",
+					opt == OPT_BEGIN ? "begin" : "end");
+				ret = -EINVAL;
+				goto end;
+			}
+			if (parse_seconds(str, &ns)) {
+				fprintf(stderr, "[error] Incorrect --%s argument: %s\n",
+					opt == OPT_BEGIN ? "begin" : "end", str);
+				ret = -EINVAL;
+				free(str);
+				goto end;
+			}
+			if (opt == OPT_BEGIN)
+				opt_begin_ns = ns;
+			else
+				opt_end_ns = ns;
+			free(str);
+			break;
+		}
 		default:
 			ret = -EINVAL;
 			goto end;
 		}
 	}
 
+	if (opt_begin_ns > opt_end_ns) {
+		fprintf(stderr, "[error] --begin time is after --end time\n");
+		ret = -EINVAL;
+		goto end;
+	}
+
 	do {
 		ipath = poptGetArg(pc);
 		if (ipath)
@@ -619,12 +858,48 @@ end:
 	return ret;
 }
 
+/*
+ * Create the reader filter selecting the events to convert, or return
+ * NULL to convert all events. The --begin and --end times include the
+ * clock offsets, as printed.
+ */
+static
+struct bt_ctf_iter_filter *create_filter(void)
+{
+	struct bt_ctf_iter_filter *filter;
+	uint64_t offset_ns, begin_ns, end_ns;
+	unsigned int i;
+
+	if (!opt_event_names->len && !opt_begin_ns && opt_end_ns == UINT64_MAX)
+		return NULL;
+
+	filter = bt_ctf_iter_filter_create();
+	for (i = 0; i < opt_event_names->len; i++)
+		bt_ctf_iter_filter_add_event_name(filter,
+			g_ptr_array_index(opt_event_names, i));
+
+	/*
+	 * Printed timestamps add the offsets modulo 2^64: remove them
+	 * the same way.
+	 */
+	offset_ns = opt_clock_offset * NSEC_PER_SEC + opt_clock_offset_ns;
+	begin_ns = opt_begin_ns;
+	if (begin_ns)
+		begin_ns -= offset_ns;
+	end_ns = opt_end_ns;
+	if (end_ns != UINT64_MAX)
+		end_ns -= offset_ns;
+	bt_ctf_iter_filter_set_time_range(filter, begin_ns, end_ns);
+	return filter;
+}
+
 static
 int convert_trace(struct bt_trace_descriptor *td_write,
 		  struct bt_context *ctx)
 {
 	struct bt_ctf_iter *iter;
 	struct ctf_text_stream_pos *sout;
+	struct bt_ctf_iter_filter *filter;
 	struct bt_iter_pos begin_pos;
 	struct bt_ctf_event *ctf_event;
 	int ret;
@@ -636,7 +911,9 @@ int convert_trace(struct bt_trace_descriptor *td_write,
 		return 0;
 
 	begin_pos.type = BT_SEEK_BEGIN;
-	iter = bt_ctf_iter_create(ctx, &begin_pos, NULL);
+	filter = create_filter();
+	iter = bt_ctf_iter_create_filtered(ctx, &begin_pos, NULL, filter);
+	bt_ctf_iter_filter_destroy(filter);
 	if (!iter) {
 		ret = -1;
 		goto error_iter;
@@ -668,15 +945,18 @@ int main(int argc, char **argv)
 	int i;
 
 	opt_input_paths = g_ptr_array_new();
+	opt_event_names = g_ptr_array_new_with_free_func(g_free);
 
 	ret = parse_options(argc, argv);
 	if (ret < 0) {
 		fprintf(stderr, "Error parsing options.\n\n");
 		usage(stderr);
 		g_ptr_array_free(opt_input_paths, TRUE);
+		g_ptr_array_free(opt_event_names, TRUE);
 		exit(EXIT_FAILURE);
 	} else if (ret > 0) {
 		g_ptr_array_free(opt_input_paths, TRUE);
+		g_ptr_array_free(opt_event_names, TRUE);
 		exit(EXIT_SUCCESS);
 	}
 	printf_verbose("Verbose mode active.\n");
@@ -733,6 +1013,24 @@ int main(int argc, char **argv)
 		goto error_td_read;
 	}
 
+	/*
+	 * The lttng-live format follows all its relay daemons from a
+	 * single reader: hand it all the URLs at once.
+	 */
+	if (!strcmp(opt_input_format, "lttng-live")
+			&& opt_input_paths->len > 1) {
+		GString *urls = g_string_new(NULL);
+
+		for (i = 0; i < opt_input_paths->len; i++) {
+			if (i)
+				g_string_append_c(urls, ' ');
+			g_string_append(urls,
+				g_ptr_array_index(opt_input_paths, i));
+		}
+		g_ptr_array_set_size(opt_input_paths, 0);
+		g_ptr_array_add(opt_input_paths, g_string_free(urls, FALSE));
+	}
+
 	for (i = 0; i < opt_input_paths->len; i++) {
 		const char *ipath = g_ptr_array_index(opt_input_paths, i);
 		ret = bt_context_add_traces_recursive(ctx, ipath,
@@ -810,6 +1108,7 @@ end:
 	free(opt_output_format);
 	free(opt_output_path);
 	g_ptr_array_free(opt_input_paths, TRUE);
+	g_ptr_array_free(opt_event_names, TRUE);
 	if (partial_error)
 		exit(EXIT_FAILURE);
 	else
@@ -41,6 +41,7 @@
 #include <glib.h>
 #include <unistd.h>
 #include <stdlib.h>
+#include <stdarg.h>
 
 #define NSEC_PER_SEC 1000000000ULL
 
@@ -156,6 +157,143 @@ int print_field(struct bt_definition *definition)
 	return 1;
 }
 
+static const char digit_pairs[201] =
+	"00010203040506070809"
+	"10111213141516171819"
+	"20212223242526272829"
+	"30313233343536373839"
+	"40414243444546474849"
+	"50515253545556575859"
+	"60616263646566676869"
+	"70717273747576777879"
+	"80818283848586878889"
+	"90919293949596979899";
+
+/*
+ * Format v in decimal, ending right before end. Returns the start of
+ * the formatted digits.
+ */
+static
+char *format_uint(char *end, uint64_t v)
+{
+	char *p = end;
+
+	while (v >= 100) {
+		unsigned int i = (v % 100) * 2;
+
+		v /= 100;
+		*--p = digit_pairs[i + 1];
+		*--p = digit_pairs[i];
+	}
+	if (v >= 10) {
+		unsigned int i = v * 2;
+
+		*--p = digit_pairs[i + 1];
+		*--p = digit_pairs[i];
+	} else {
+		*--p = '0' + v;
+	}
+	return p;
+}
+
+void ctf_text_put_uint(struct ctf_text_stream_pos *pos, uint64_t v)
+{
+	char tmp[20], *p;
+
+	p = format_uint(tmp + sizeof(tmp), v);
+	ctf_text_write(pos, p, tmp + sizeof(tmp) - p);
+}
+
+void ctf_text_put_int(struct ctf_text_stream_pos *pos, int64_t v)
+{
+	if (v < 0) {
+		ctf_text_putc(pos, '-');
+		/* Negate as unsigned: INT64_MIN has no positive counterpart. */
+		ctf_text_put_uint(pos, -(uint64_t) v);
+	} else {
+		ctf_text_put_uint(pos, v);
+	}
+}
+
+/*
+ * Print v in decimal, zero-padded to at least width digits.
+ */
+void ctf_text_put_uint_pad(struct ctf_text_stream_pos *pos, uint64_t v,
+		int width)
+{
+	char tmp[20], *p;
+	int len;
+
+	p = format_uint(tmp + sizeof(tmp), v);
+	len = tmp + sizeof(tmp) - p;
+	if (len < width) {
+		memset(ctf_text_reserve(pos, width - len), '0', width - len);
+		pos->buf_len += width - len;
+	}
+	ctf_text_write(pos, p, len);
+}
+
+void ctf_text_put_hex(struct ctf_text_stream_pos *pos, uint64_t v,
+		int upper)
+{
+	const char *digits = upper ? "0123456789ABCDEF" : "0123456789abcdef";
+	char tmp[16], *p = tmp + sizeof(tmp);
+
+	do {
+		*--p = digits[v & 0xF];
+		v >>= 4;
+	} while (v);
+	ctf_text_write(pos, p, tmp + sizeof(tmp) - p);
+}
+
+void ctf_text_put_oct(struct ctf_text_stream_pos *pos, uint64_t v)
+{
+	char tmp[22], *p = tmp + sizeof(tmp);
+
+	do {
+		*--p = '0' + (v & 07);
+		v >>= 3;
+	} while (v);
+	ctf_text_write(pos, p, tmp + sizeof(tmp) - p);
+}
+
+/*
+ * printf into the output buffer, for the less common formats.
+ */
+void ctf_text_printf(struct ctf_text_stream_pos *pos, const char *fmt, ...)
+{
+	va_list ap;
+	size_t avail = pos->buf_alloc_len - pos->buf_len;
+	int len;
+
+	va_start(ap, fmt);
+	len = vsnprintf(pos->buf + pos->buf_len, avail, fmt, ap);
+	va_end(ap);
+	if (len < 0)
+		return;
+	if (len >= avail) {
+		/* Make room for the '\0' written by vsnprintf. */
+		ctf_text_reserve(pos, len + 1);
+		va_start(ap, fmt);
+		len = vsnprintf(pos->buf + pos->buf_len, len + 1, fmt, ap);
+		va_end(ap);
+		if (len < 0)
+			return;
+	}
+	pos->buf_len += len;
+}
+
+static
+void print_timestamp(struct ctf_text_stream_pos *pos,
+		struct ctf_stream_definition *stream, uint64_t timestamp)
+{
+	char *buf;
+
+	buf = ctf_text_reserve(pos, CTF_TIMESTAMP_STR_LEN);
+	pos->buf_len += ctf_format_timestamp(buf, &pos->ts_cache,
+			stream, timestamp);
+}
+
 static
 void set_field_names_print(struct ctf_text_stream_pos *pos, enum field_item item)
 {
@@ -242,6 +380,7 @@ int ctf_text_write_event(struct bt_stream_pos *ppos, struct ctf_stream_definitio
 	struct ctf_event_declaration *event_class;
 	struct ctf_event_definition *event;
 	uint64_t id;
+	size_t event_start;
 	int ret;
 	int dom_print = 0;
 
@@ -264,54 +403,61 @@ int ctf_text_write_event(struct bt_stream_pos *ppos, struct ctf_stream_definitio
 
 	/* Print events discarded */
 	if (stream->events_discarded) {
-		fflush(pos->fp);
+		ret = ctf_text_flush(pos);
+		if (ret)
+			return ret;
 		ctf_print_discarded(stderr, stream, 0);
 		stream->events_discarded = 0;
 	}
 
+	/* Events before this one may still be buffered. */
+	event_start = pos->buf_len;
+
 	if (stream->has_timestamp) {
 		set_field_names_print(pos, ITEM_HEADER);
 		if (pos->print_names)
-			fprintf(pos->fp, "timestamp = ");
+			ctf_text_puts(pos, "timestamp = ");
 		else
-			fprintf(pos->fp, "[");
+			ctf_text_putc(pos, '[');
 		if (opt_clock_cycles) {
-			ctf_print_timestamp(pos->fp, stream, stream->cycles_timestamp);
+			print_timestamp(pos, stream, stream->cycles_timestamp);
 		} else {
-			ctf_print_timestamp(pos->fp, stream, stream->real_timestamp);
+			print_timestamp(pos, stream, stream->real_timestamp);
 		}
 		if (!pos->print_names)
-			fprintf(pos->fp, "]");
+			ctf_text_putc(pos, ']');
 
 		if (pos->print_names)
-			fprintf(pos->fp, ", ");
+			ctf_text_puts(pos, ", ");
 		else
-			fprintf(pos->fp, " ");
+			ctf_text_putc(pos, ' ');
 	}
 	if (opt_delta_field && stream->has_timestamp) {
 		uint64_t delta, delta_sec, delta_nsec;
 
 		set_field_names_print(pos, ITEM_HEADER);
 		if (pos->print_names)
-			fprintf(pos->fp, "delta = ");
+			ctf_text_puts(pos, "delta = ");
 		else
-			fprintf(pos->fp, "(");
+			ctf_text_putc(pos, '(');
 		if (pos->last_real_timestamp != -1ULL) {
 			delta = stream->real_timestamp - pos->last_real_timestamp;
 			delta_sec = delta / NSEC_PER_SEC;
 			delta_nsec = delta % NSEC_PER_SEC;
-			fprintf(pos->fp, "+%" PRIu64 ".%09" PRIu64,
-				delta_sec, delta_nsec);
+			ctf_text_putc(pos, '+');
+			ctf_text_put_uint(pos, delta_sec);
+			ctf_text_putc(pos, '.');
+			ctf_text_put_uint_pad(pos, delta_nsec, 9);
 		} else {
-			fprintf(pos->fp, "+?.?????????");
+			ctf_text_puts(pos, "+?.?????????");
 		}
 		if (!pos->print_names)
-			fprintf(pos->fp, ")");
+			ctf_text_putc(pos, ')');
 
 		if (pos->print_names)
-			fprintf(pos->fp, ", ");
+			ctf_text_puts(pos, ", ");
 		else
-			fprintf(pos->fp, " ");
+			ctf_text_putc(pos, ' ');
 		pos->last_real_timestamp = stream->real_timestamp;
 		pos->last_cycles_timestamp = stream->cycles_timestamp;
 	}
@@ -319,86 +465,88 @@ int ctf_text_write_event(struct bt_stream_pos *ppos, struct ctf_stream_definitio
 	if ((opt_trace_field || opt_all_fields) && stream_class->trace->parent.path[0] != '\0') {
 		set_field_names_print(pos, ITEM_HEADER);
 		if (pos->print_names) {
-			fprintf(pos->fp, "trace = ");
+			ctf_text_puts(pos, "trace = ");
 		}
-		fprintf(pos->fp, "%s", stream_class->trace->parent.path);
+		ctf_text_puts(pos, stream_class->trace->parent.path);
 		if (pos->print_names)
-			fprintf(pos->fp, ", ");
+			ctf_text_puts(pos, ", ");
 		else
-			fprintf(pos->fp, " ");
+			ctf_text_putc(pos, ' ');
 	}
 	if ((opt_trace_hostname_field || opt_all_fields || opt_trace_default_fields)
 			&& stream_class->trace->env.hostname[0] != '\0') {
 		set_field_names_print(pos, ITEM_HEADER);
 		if (pos->print_names) {
-			fprintf(pos->fp, "trace:hostname = ");
+			ctf_text_puts(pos, "trace:hostname = ");
 		}
-		fprintf(pos->fp, "%s", stream_class->trace->env.hostname);
+		ctf_text_puts(pos, stream_class->trace->env.hostname);
 		if (pos->print_names)
-			fprintf(pos->fp, ", ");
+			ctf_text_puts(pos, ", ");
 		dom_print = 1;
 	}
 	if ((opt_trace_domain_field || opt_all_fields) && stream_class->trace->env.domain[0] != '\0') {
 		set_field_names_print(pos, ITEM_HEADER);
 		if (pos->print_names) {
-			fprintf(pos->fp, "trace:domain = ");
+			ctf_text_puts(pos, "trace:domain = ");
 		}
-		fprintf(pos->fp, "%s", stream_class->trace->env.domain);
+		ctf_text_puts(pos, stream_class->trace->env.domain);
 		if (pos->print_names)
-			fprintf(pos->fp, ", ");
+			ctf_text_puts(pos, ", ");
 		dom_print = 1;
 	}
 	if ((opt_trace_procname_field || opt_all_fields || opt_trace_default_fields)
 			&& stream_class->trace->env.procname[0] != '\0') {
 		set_field_names_print(pos, ITEM_HEADER);
 		if (pos->print_names) {
-			fprintf(pos->fp, "trace:procname = ");
+			ctf_text_puts(pos, "trace:procname = ");
 		} else if (dom_print) {
-			fprintf(pos->fp, ":");
+			ctf_text_putc(pos, ':');
 		}
-		fprintf(pos->fp, "%s", stream_class->trace->env.procname);
+		ctf_text_puts(pos, stream_class->trace->env.procname);
 		if (pos->print_names)
-			fprintf(pos->fp, ", ");
+			ctf_text_puts(pos, ", ");
 		dom_print = 1;
 	}
 	if ((opt_trace_vpid_field || opt_all_fields || opt_trace_default_fields)
 			&& stream_class->trace->env.vpid != -1) {
 		set_field_names_print(pos, ITEM_HEADER);
 		if (pos->print_names) {
-			fprintf(pos->fp, "trace:vpid = ");
+			ctf_text_puts(pos, "trace:vpid = ");
 		} else if (dom_print) {
-			fprintf(pos->fp, ":");
+			ctf_text_putc(pos, ':');
 		}
-		fprintf(pos->fp, "%d", stream_class->trace->env.vpid);
+		ctf_text_put_int(pos, stream_class->trace->env.vpid);
 		if (pos->print_names)
-			fprintf(pos->fp, ", ");
+			ctf_text_puts(pos, ", ");
 		dom_print = 1;
 	}
 	if ((opt_loglevel_field || opt_all_fields) && event_class->loglevel != -1) {
 		set_field_names_print(pos, ITEM_HEADER);
 		if (pos->print_names) {
-			fprintf(pos->fp, "loglevel = ");
+			ctf_text_puts(pos, "loglevel = ");
 		} else if (dom_print) {
-			fprintf(pos->fp, ":");
+			ctf_text_putc(pos, ':');
 		}
-		fprintf(pos->fp, "%s (%d)",
-			print_loglevel(event_class->loglevel),
-			event_class->loglevel);
+		ctf_text_puts(pos, print_loglevel(event_class->loglevel));
+		ctf_text_puts(pos, " (");
+		ctf_text_put_int(pos, event_class->loglevel);
+		ctf_text_putc(pos, ')');
 		if (pos->print_names)
-			fprintf(pos->fp, ", ");
+			ctf_text_puts(pos, ", ");
 		dom_print = 1;
 	}
 	if ((opt_emf_field || opt_all_fields) && event_class->model_emf_uri) {
 		set_field_names_print(pos, ITEM_HEADER);
 		if (pos->print_names) {
-			fprintf(pos->fp, "model.emf.uri = ");
+			ctf_text_puts(pos, "model.emf.uri = ");
 		} else if (dom_print) {
-			fprintf(pos->fp, ":");
+			ctf_text_putc(pos, ':');
 		}
-		fprintf(pos->fp, "\"%s\"",
-			g_quark_to_string(event_class->model_emf_uri));
+		ctf_text_putc(pos, '"');
+		ctf_text_puts(pos, g_quark_to_string(event_class->model_emf_uri));
+		ctf_text_putc(pos, '"');
 		if (pos->print_names)
-			fprintf(pos->fp, ", ");
+			ctf_text_puts(pos, ", ");
 		dom_print = 1;
 	}
 	if ((opt_callsite_field || opt_all_fields)) {
@@ -412,49 +560,49 @@ int ctf_text_write_event(struct bt_stream_pos *ppos, struct ctf_stream_definitio
 
 			set_field_names_print(pos, ITEM_HEADER);
 			if (pos->print_names) {
-				fprintf(pos->fp, "callsite = ");
+				ctf_text_puts(pos, "callsite = ");
 			} else if (dom_print) {
-				fprintf(pos->fp, ":");
+				ctf_text_putc(pos, ':');
 			}
-			fprintf(pos->fp, "[");
+			ctf_text_putc(pos, '[');
 			bt_list_for_each_entry(callsite, &cs_dups->head, node) {
 				if (i != 0)
-					fprintf(pos->fp, ",");
+					ctf_text_putc(pos, ',');
 				if (CTF_CALLSITE_FIELD_IS_SET(callsite, ip)) {
-					fprintf(pos->fp, "%s@0x%" PRIx64 ":%s:%" PRIu64 "",
+					ctf_text_printf(pos, "%s@0x%" PRIx64 ":%s:%" PRIu64 "",
 						callsite->func, callsite->ip, callsite->file,
 						callsite->line);
 				} else {
-					fprintf(pos->fp, "%s:%s:%" PRIu64 "",
+					ctf_text_printf(pos, "%s:%s:%" PRIu64 "",
 						callsite->func, callsite->file,
 						callsite->line);
 				}
 				i++;
 			}
-			fprintf(pos->fp, "]");
+			ctf_text_putc(pos, ']');
 			if (pos->print_names)
-				fprintf(pos->fp, ", ");
+				ctf_text_puts(pos, ", ");
 			dom_print = 1;
 		}
 	}
 	if (dom_print && !pos->print_names)
-		fprintf(pos->fp, " ");
+		ctf_text_putc(pos, ' ');
 	set_field_names_print(pos, ITEM_HEADER);
 	if (pos->print_names)
-		fprintf(pos->fp, "name = ");
-	fprintf(pos->fp, "%s", g_quark_to_string(event_class->name));
+		ctf_text_puts(pos, "name = ");
+	ctf_text_puts(pos, g_quark_to_string(event_class->name));
 	if (pos->print_names)
 		pos->field_nr++;
 	else
-		fprintf(pos->fp, ":");
+		ctf_text_putc(pos, ':');
 
 	/* print cpuid field from packet context */
 	if (stream->stream_packet_context) {
 		if (pos->field_nr++ != 0)
-			fprintf(pos->fp, ",");
+			ctf_text_putc(pos, ',');
 		set_field_names_print(pos, ITEM_SCOPE);
 		if (pos->print_names)
-			fprintf(pos->fp, " stream.packet.context =");
+			ctf_text_puts(pos, " stream.packet.context =");
 		field_nr_saved = pos->field_nr;
 		pos->field_nr = 0;
 		set_field_names_print(pos, ITEM_CONTEXT);
@@ -467,10 +615,10 @@ int ctf_text_write_event(struct bt_stream_pos *ppos, struct ctf_stream_definitio
 	/* Only show the event header in verbose mode */
 	if (babeltrace_verbose && stream->stream_event_header) {
 		if (pos->field_nr++ != 0)
-			fprintf(pos->fp, ",");
+			ctf_text_putc(pos, ',');
 		set_field_names_print(pos, ITEM_SCOPE);
 		if (pos->print_names)
-			fprintf(pos->fp, " stream.event.header =");
+			ctf_text_puts(pos, " stream.event.header =");
 		field_nr_saved = pos->field_nr;
 		pos->field_nr = 0;
 		set_field_names_print(pos, ITEM_CONTEXT);
@@ -483,10 +631,10 @@ int ctf_text_write_event(struct bt_stream_pos *ppos, struct ctf_stream_definitio
 	/* print stream-declared event context */
 	if (stream->stream_event_context) {
 		if (pos->field_nr++ != 0)
-			fprintf(pos->fp, ",");
+			ctf_text_putc(pos, ',');
 		set_field_names_print(pos, ITEM_SCOPE);
 		if (pos->print_names)
-			fprintf(pos->fp, " stream.event.context =");
+			ctf_text_puts(pos, " stream.event.context =");
 		field_nr_saved = pos->field_nr;
 		pos->field_nr = 0;
 		set_field_names_print(pos, ITEM_CONTEXT);
@@ -499,10 +647,10 @@ int ctf_text_write_event(struct bt_stream_pos *ppos, struct ctf_stream_definitio
 	/* print event-declared event context */
 	if (event->event_context) {
 		if (pos->field_nr++ != 0)
-			fprintf(pos->fp, ",");
+			ctf_text_putc(pos, ',');
 		set_field_names_print(pos, ITEM_SCOPE);
 		if (pos->print_names)
-			fprintf(pos->fp, " event.context =");
+			ctf_text_puts(pos, " event.context =");
 		field_nr_saved = pos->field_nr;
 		pos->field_nr = 0;
 		set_field_names_print(pos, ITEM_CONTEXT);
@@ -515,10 +663,10 @@ int ctf_text_write_event(struct bt_stream_pos *ppos, struct ctf_stream_definitio
 	/* Read and print event payload */
 	if (event->event_fields) {
 		if (pos->field_nr++ != 0)
-			fprintf(pos->fp, ",");
+			ctf_text_putc(pos, ',');
 		set_field_names_print(pos, ITEM_SCOPE);
 		if (pos->print_names)
-			fprintf(pos->fp, " event.fields =");
+			ctf_text_puts(pos, " event.fields =");
 		field_nr_saved = pos->field_nr;
 		pos->field_nr = 0;
 		set_field_names_print(pos, ITEM_PAYLOAD);
@@ -528,12 +676,21 @@ int ctf_text_write_event(struct bt_stream_pos *ppos, struct ctf_stream_definitio
 		pos->field_nr = field_nr_saved;
 	}
 	/* newline */
-	fprintf(pos->fp, "\n");
+	ctf_text_putc(pos, '\n');
 	pos->field_nr = 0;
 
+	if (pos->flush_each_event || pos->buf_len >= CTF_TEXT_BUF_LEN)
+		return ctf_text_flush(pos);
 	return 0;
 
 error:
+	/*
+	 * Drop the partly printed event, and write out the events before
+	 * it so the error shows up after them.
+	 */
+	pos->buf_len = event_start;
+	pos->field_nr = 0;
+	(void) ctf_text_flush(pos);
 	fprintf(stderr, "[error] Unexpected end of stream. Either the trace data stream is corrupted or metadata description does not match data layout.\n");
 	return ret;
 }
@@ -559,6 +716,8 @@ struct bt_trace_descriptor *ctf_text_open_trace(const char *path, int flags,
 		if (!fp)
 			goto error;
 		pos->fp = fp;
+		/* Keep interactive output in step with the events read. */
+		pos->flush_each_event = isatty(fileno(fp));
 		pos->parent.rw_table = write_dispatch_table;
 		pos->parent.event_cb = ctf_text_write_event;
 		pos->parent.trace = &pos->trace_descriptor;
@@ -582,6 +741,11 @@ int ctf_text_close_trace(struct bt_trace_descriptor *td)
 	int ret;
 	struct ctf_text_stream_pos *pos =
 		container_of(td, struct ctf_text_stream_pos, trace_descriptor);
+
+	ret = ctf_text_flush(pos);
+	if (ret)
+		fprintf(stderr, "[error] Unable to write text output.\n");
+	g_free(pos->buf);
 	if (pos->fp != stdout) {
 		ret = fclose(pos->fp);
 		if (ret) {
@@ -45,11 +45,12 @@ int ctf_text_array_write(struct bt_stream_pos *ppos, struct bt_definition *defin
 
 	if (!pos->dummy) {
 		if (pos->field_nr++ != 0)
-			fprintf(pos->fp, ",");
-		fprintf(pos->fp, " ");
-		if (pos->print_names)
-			fprintf(pos->fp, "%s = ",
-				rem_(g_quark_to_string(definition->name)));
+			ctf_text_putc(pos, ',');
+		ctf_text_putc(pos, ' ');
+		if (pos->print_names) {
+			ctf_text_puts(pos, rem_(g_quark_to_string(definition->name)));
+			ctf_text_puts(pos, " = ");
+		}
 	}
 
 	if (elem->id == CTF_TYPE_INTEGER) {
@@ -66,13 +67,15 @@ int ctf_text_array_write(struct bt_stream_pos *ppos, struct bt_definition *defin
 				ret = bt_array_rw(ppos, definition);
 				pos->string = NULL;
 			}
-			fprintf(pos->fp, "\"%s\"", array_definition->string->str);
+			ctf_text_putc(pos, '"');
+			ctf_text_puts(pos, array_definition->string->str);
+			ctf_text_putc(pos, '"');
 			return ret;
 		}
 	}
 
 	if (!pos->dummy) {
-		fprintf(pos->fp, "[");
+		ctf_text_putc(pos, '[');
 		pos->depth++;
 	}
 	field_nr_saved = pos->field_nr;
@@ -80,7 +83,7 @@ int ctf_text_array_write(struct bt_stream_pos *ppos, struct bt_definition *defin
 	ret = bt_array_rw(ppos, definition);
 	if (!pos->dummy) {
 		pos->depth--;
-		fprintf(pos->fp, " ]");
+		ctf_text_puts(pos, " ]");
 	}
 	pos->field_nr = field_nr_saved;
 	return ret;
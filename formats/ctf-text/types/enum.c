@@ -48,15 +48,16 @@ int ctf_text_enum_write(struct bt_stream_pos *ppos, struct bt_definition *defini
 		return 0;
 
 	if (pos->field_nr++ != 0)
-		fprintf(pos->fp, ",");
-	fprintf(pos->fp, " ");
-	if (pos->print_names)
-		fprintf(pos->fp, "%s = ",
-			rem_(g_quark_to_string(definition->name)));
+		ctf_text_putc(pos, ',');
+	ctf_text_putc(pos, ' ');
+	if (pos->print_names) {
+		ctf_text_puts(pos, rem_(g_quark_to_string(definition->name)));
+		ctf_text_puts(pos, " = ");
+	}
 
 	field_nr_saved = pos->field_nr;
 	pos->field_nr = 0;
-	fprintf(pos->fp, "(");
+	ctf_text_putc(pos, '(');
 	pos->depth++;
 	qs = enum_definition->value;
 
@@ -69,20 +70,20 @@ int ctf_text_enum_write(struct bt_stream_pos *ppos, struct bt_definition *defini
 
 			assert(str);
 			if (pos->field_nr++ != 0)
-				fprintf(pos->fp, ",");
-			fprintf(pos->fp, " ");
-			fprintf(pos->fp, "%s", str);
+				ctf_text_putc(pos, ',');
+			ctf_text_putc(pos, ' ');
+			ctf_text_puts(pos, str);
 		}
 	} else {
-		fprintf(pos->fp, " <unknown>");
+		ctf_text_puts(pos, " <unknown>");
 	}
 
 	pos->field_nr = 0;
-	fprintf(pos->fp, " :");
+	ctf_text_puts(pos, " :");
 	ret = generic_rw(ppos, &integer_definition->p);
 
 	pos->depth--;
-	fprintf(pos->fp, " )");
+	ctf_text_puts(pos, " )");
 	pos->field_nr = field_nr_saved;
 	return ret;
 }
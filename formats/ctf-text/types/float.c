@@ -44,12 +44,13 @@ int ctf_text_float_write(struct bt_stream_pos *ppos, struct bt_definition *defin
 		return 0;
 
 	if (pos->field_nr++ != 0)
-		fprintf(pos->fp, ",");
-	fprintf(pos->fp, " ");
-	if (pos->print_names)
-		fprintf(pos->fp, "%s = ",
-			rem_(g_quark_to_string(definition->name)));
+		ctf_text_putc(pos, ',');
+	ctf_text_putc(pos, ' ');
+	if (pos->print_names) {
+		ctf_text_puts(pos, rem_(g_quark_to_string(definition->name)));
+		ctf_text_puts(pos, " = ");
+	}
 
-	fprintf(pos->fp, "%g", float_definition->value);
+	ctf_text_printf(pos, "%g", float_definition->value);
 	return 0;
 }
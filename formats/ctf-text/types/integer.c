@@ -47,11 +47,12 @@ int ctf_text_integer_write(struct bt_stream_pos *ppos, struct bt_definition *def
 		return 0;
 
 	if (pos->field_nr++ != 0)
-		fprintf(pos->fp, ",");
-	fprintf(pos->fp, " ");
-	if (pos->print_names)
-		fprintf(pos->fp, "%s = ",
-			rem_(g_quark_to_string(definition->name)));
+		ctf_text_putc(pos, ',');
+	ctf_text_putc(pos, ' ');
+	if (pos->print_names) {
+		ctf_text_puts(pos, rem_(g_quark_to_string(definition->name)));
+		ctf_text_puts(pos, " = ");
+	}
 
 	if (pos->string
 	    && (integer_declaration->encoding == CTF_STRING_ASCII
@@ -71,10 +72,10 @@ int ctf_text_integer_write(struct bt_stream_pos *ppos, struct bt_definition *def
 	case 0:	/* default */
 	case 10:
 		if (!integer_declaration->signedness) {
-			fprintf(pos->fp, "%" PRIu64,
+			ctf_text_put_uint(pos,
 				integer_definition->value._unsigned);
 		} else {
-			fprintf(pos->fp, "%" PRId64,
+			ctf_text_put_int(pos,
 				integer_definition->value._signed);
 		}
 		break;
@@ -82,18 +83,21 @@ int ctf_text_integer_write(struct bt_stream_pos *ppos, struct bt_definition *def
 	{
 		int bitnr;
 		uint64_t v;
+		char *p;
 
 		if (!integer_declaration->signedness)
 			v = integer_definition->value._unsigned;
 		else
 			v = (uint64_t) integer_definition->value._signed;
 
-		fprintf(pos->fp, "0b");
+		ctf_text_puts(pos, "0b");
 		v = _bt_piecewise_lshift(v, 64 - integer_declaration->len);
+		p = ctf_text_reserve(pos, integer_declaration->len);
 		for (bitnr = 0; bitnr < integer_declaration->len; bitnr++) {
-			fprintf(pos->fp, "%u", (v & (1ULL << 63)) ? 1 : 0);
+			p[bitnr] = (v & (1ULL << 63)) ? '1' : '0';
 			v = _bt_piecewise_lshift(v, 1);
 		}
+		pos->buf_len += integer_declaration->len;
 		break;
 	}
 	case 8:
@@ -105,7 +109,8 @@ int ctf_text_integer_write(struct bt_stream_pos *ppos, struct bt_definition *def
 		else
 			v = (uint64_t) integer_definition->value._signed;
 
-		fprintf(pos->fp, "0%" PRIo64, v);
+		ctf_text_putc(pos, '0');
+		ctf_text_put_oct(pos, v);
 		break;
 	}
 	case 16:
@@ -117,7 +122,8 @@ int ctf_text_integer_write(struct bt_stream_pos *ppos, struct bt_definition *def
 		else
 			v = (uint64_t) integer_definition->value._signed;
 
-		fprintf(pos->fp, "0x%" PRIX64, v);
+		ctf_text_puts(pos, "0x");
+		ctf_text_put_hex(pos, v, 1);
 		break;
 	}
 	default:
@@ -47,12 +47,15 @@ int ctf_text_string_write(struct bt_stream_pos *ppos,
 		return 0;
 
 	if (pos->field_nr++ != 0)
-		fprintf(pos->fp, ",");
-	fprintf(pos->fp, " ");
-	if (pos->print_names)
-		fprintf(pos->fp, "%s = ",
-			rem_(g_quark_to_string(definition->name)));
+		ctf_text_putc(pos, ',');
+	ctf_text_putc(pos, ' ');
+	if (pos->print_names) {
+		ctf_text_puts(pos, rem_(g_quark_to_string(definition->name)));
+		ctf_text_puts(pos, " = ");
+	}
 
-	fprintf(pos->fp, "\"%s\"", string_definition->value);
+	ctf_text_putc(pos, '"');
+	ctf_text_puts(pos, string_definition->value);
+	ctf_text_putc(pos, '"');
 	return 0;
 }
@@ -47,6 +47,7 @@
 #include <glib.h>
 #include <unistd.h>
 #include <stdlib.h>
+#include <pthread.h>
 
 #include "metadata/ctf-scanner.h"
 #include "metadata/ctf-parser.h"
@@ -70,9 +71,15 @@
 #define min(a, b)	(((a) < (b)) ? (a) : (b))
 #endif
 
+/*
+ * Largest read mapping window on 32-bit architectures, in bytes.
+ */
+#define MAX_MMAP_WINDOW_LEN_32	(256ULL * 1024 * 1024)
+
 #define NSEC_PER_SEC 1000000000ULL
 
-#define INDEX_PATH "./index/%s.idx"
+#define INDEX_DIR "./index"
+#define INDEX_PATH INDEX_DIR "/%s.idx"
 
 int opt_clock_cycles,
 	opt_clock_seconds,
@@ -82,6 +89,37 @@ int opt_clock_cycles,
 uint64_t opt_clock_offset;
 uint64_t opt_clock_offset_ns;
 
+/*
+ * Length of the read mapping window, in bytes. 0 maps each packet
+ * separately. UINT64_MAX maps up to the end of the file.
+ */
+uint64_t opt_mmap_window_len;
+
+/*
+ * Number of threads opening and indexing the stream files of a trace.
+ * 0 uses one thread per online CPU.
+ */
+int opt_index_threads;
+
+/*
+ * Write the packet index of stream files lacking an up-to-date index
+ * file to INDEX_PATH, for use by subsequent opens of the trace.
+ */
+int opt_write_index_cache;
+
+/*
+ * Have string definitions reference the mapped packet rather than
+ * copying each string read. Strings are only copied when their packet
+ * gets unmapped.
+ */
+int opt_zero_copy_strings;
+
+/*
+ * Bound on the packet buffers of an lttng-live connection, in bytes.
+ * 0 uses the default.
+ */
+uint64_t opt_live_buffer_pool_len;
+
 extern int yydebug;
 
 static
@@ -309,15 +347,55 @@ void ctf_update_timestamp(struct ctf_stream_definition *stream,
 }
 
 /*
- * Print timestamp, rescaling clock frequency to nanoseconds and
+ * Format v in decimal into buf, padded with pad up to width characters.
+ * Returns the number of characters written, without '\0'.
+ */
+static
+int format_dec(char *buf, uint64_t v, int width, char pad)
+{
+	char tmp[20], *p = tmp + sizeof(tmp);
+	int len, n = 0;
+
+	do {
+		*--p = '0' + v % 10;
+		v /= 10;
+	} while (v);
+	len = tmp + sizeof(tmp) - p;
+	for (; n < width - len; n++)
+		buf[n] = pad;
+	memcpy(buf + n, p, len);
+	return n + len;
+}
+
+/*
+ * Format nanoseconds (< NSEC_PER_SEC) as exactly 9 digits.
+ */
+static
+void format_nsec(char *buf, uint32_t nsec)
+{
+	int i;
+
+	for (i = 8; i >= 0; i--) {
+		buf[i] = '0' + nsec % 10;
+		nsec /= 10;
+	}
+}
+
+/*
+ * Format timestamp, rescaling clock frequency to nanoseconds and
  * applying offsets as needed (unix time).
+ *
+ * The broken-down time only changes once per second: when a cache is
+ * given, the "[date ]HH:MM:SS." prefix is formatted once per second,
+ * so that only the nanoseconds are formatted for each event.
  */
 static
-void ctf_print_timestamp_real(FILE *fp,
+int ctf_format_timestamp_real(char *buf, struct ctf_timestamp_cache *cache,
 			struct ctf_stream_definition *stream,
 			uint64_t timestamp)
 {
 	uint64_t ts_sec = 0, ts_nsec;
+	int ret = 0;
 
 	ts_nsec = timestamp;
 
@@ -334,6 +412,11 @@ void ctf_print_timestamp_real(FILE *fp,
 		struct tm tm;
 		time_t time_s = (time_t) ts_sec;
 
+		if (cache && cache->valid && cache->sec == ts_sec) {
+			memcpy(buf, cache->str, cache->len);
+			ret = cache->len;
+			goto nsec;
+		}
 		if (!opt_clock_gmt) {
 			struct tm *res;
 
@@ -352,53 +435,77 @@ void ctf_print_timestamp_real(FILE *fp,
 			}
 		}
 		if (opt_clock_date) {
-			char timestr[26];
 			size_t res;
 
 			/* Print date and time */
-			res = strftime(timestr, sizeof(timestr),
-				"%F ", &tm);
+			res = strftime(buf, CTF_TIMESTAMP_STR_LEN, "%F ", &tm);
 			if (!res) {
 				fprintf(stderr, "[warning] Unable to print ascii time.\n");
 				goto seconds;
 			}
-			fprintf(fp, "%s", timestr);
+			ret = res;
 		}
 		/* Print time in HH:MM:SS.ns */
-		fprintf(fp, "%02d:%02d:%02d.%09" PRIu64,
-			tm.tm_hour, tm.tm_min, tm.tm_sec, ts_nsec);
-		goto end;
+		ret += format_dec(buf + ret, tm.tm_hour, 2, '0');
+		buf[ret++] = ':';
+		ret += format_dec(buf + ret, tm.tm_min, 2, '0');
+		buf[ret++] = ':';
+		ret += format_dec(buf + ret, tm.tm_sec, 2, '0');
+		buf[ret++] = '.';
+		if (cache) {
+			memcpy(cache->str, buf, ret);
+			cache->len = ret;
+			cache->sec = ts_sec;
+			cache->valid = 1;
+		}
+		goto nsec;
 	}
 seconds:
-	fprintf(fp, "%3" PRIu64 ".%09" PRIu64,
-		ts_sec, ts_nsec);
-
-end:
-	return;
+	ret = format_dec(buf, ts_sec, 3, ' ');
+	buf[ret++] = '.';
+nsec:
+	format_nsec(buf + ret, ts_nsec);
+	ret += 9;
+	buf[ret] = '\0';
+	return ret;
 }
 
 /*
- * Print timestamp, in cycles
+ * Format timestamp, in cycles
  */
 static
-void ctf_print_timestamp_cycles(FILE *fp,
+int ctf_format_timestamp_cycles(char *buf,
 		struct ctf_stream_definition *stream,
 		uint64_t timestamp)
 {
-	fprintf(fp, "%020" PRIu64, timestamp);
+	int ret;
+
+	ret = format_dec(buf, timestamp, 20, '0');
+	buf[ret] = '\0';
+	return ret;
 }
 
-void ctf_print_timestamp(FILE *fp,
+int ctf_format_timestamp(char *buf, struct ctf_timestamp_cache *cache,
 		struct ctf_stream_definition *stream,
 		uint64_t timestamp)
 {
 	if (opt_clock_cycles) {
-		ctf_print_timestamp_cycles(fp, stream, timestamp);
+		return ctf_format_timestamp_cycles(buf, stream, timestamp);
 	} else {
-		ctf_print_timestamp_real(fp, stream, timestamp);
+		return ctf_format_timestamp_real(buf, cache, stream, timestamp);
 	}
 }
 
+void ctf_print_timestamp(FILE *fp,
+		struct ctf_stream_definition *stream,
+		uint64_t timestamp)
+{
+	char buf[CTF_TIMESTAMP_STR_LEN];
+
+	ctf_format_timestamp(buf, NULL, stream, timestamp);
+	fputs(buf, fp);
+}
+
 static
 void print_uuid(FILE *fp, unsigned char *uuid)
 {
@@ -442,6 +549,153 @@ void ctf_print_discarded(FILE *fp, struct ctf_stream_definition *stream,
 	fflush(fp);
 }
 
+/*
+ * When a stream reaches the end of the file, we need to show the number
+ * of events discarded ourselves, because there is no next event
+ * scheduled to be printed in the output.
+ */
+static
+void ctf_print_end_of_stream_discarded(struct ctf_stream_definition *stream)
+{
+	/*
+	 * We need to check if we are in trace read or called from
+	 * packet indexing.  In this last case, the collection is not
+	 * there, so we cannot print the timestamps.
+	 */
+	if (!stream->stream_class->trace->parent.collection)
+		return;
+	if (stream->events_discarded) {
+		fflush(stdout);
+		ctf_print_discarded(stderr, stream, 1);
+		stream->events_discarded = 0;
+	}
+}
+
+/*
+ * Find the cached header fields of the event header variant field
+ * selected by the last header read. Event header variants only have a
+ * few fields (compact and extended for LTTng), so a linear scan is
+ * cheaper than going through the variant tag lookup again.
+ */
+static inline
+const struct ctf_event_header_variant_field *
+	lookup_event_header_variant_field(struct ctf_stream_definition *stream)
+{
+	GArray *fields = stream->event_header_variant_fields;
+	struct bt_definition *current =
+		stream->event_header_variant->current_field;
+	unsigned int i;
+
+	for (i = 0; i < fields->len; i++) {
+		const struct ctf_event_header_variant_field *vfield =
+			&g_array_index(fields,
+				struct ctf_event_header_variant_field, i);
+
+		if (vfield->field == current)
+			return vfield;
+	}
+	return NULL;
+}
+
+/*
+ * Check whether the packet just entered holds events of the filter time
+ * range, using the packet index timestamps. Return 1 if the packet can
+ * be skipped, EOF if no following event of the stream can be in the
+ * range, and 0 otherwise.
+ */
+static
+int filter_packet(struct ctf_stream_pos *pos,
+		const struct ctf_stream_filter *filter)
+{
+	const struct packet_index *index;
+
+	if (!pos->packet_index || pos->cur_index >= pos->packet_index->len)
+		return 0;
+	index = &g_array_index(pos->packet_index, struct packet_index,
+			pos->cur_index);
+	if (index->ts_real.timestamp_begin > filter->end)
+		return EOF;
+	/* A zero end timestamp means the packet context has none. */
+	if (index->ts_real.timestamp_end
+			&& index->ts_real.timestamp_end < filter->begin)
+		return 1;
+	return 0;
+}
+
+/*
+ * Check whether the event whose header was just read is wanted. Return
+ * 1 if it must be skipped, EOF if no following event of the stream can
+ * be wanted, and 0 otherwise.
+ */
+static
+int filter_event(const struct ctf_stream_definition *stream, uint64_t id,
+		const struct ctf_stream_filter *filter)
+{
+	if (stream->has_timestamp) {
+		if (stream->real_timestamp > filter->end)
+			return EOF;
+		if (stream->real_timestamp < filter->begin)
+			return 1;
+	}
+	if (filter->event_ids && (id >= filter->event_ids->len
+			|| !filter->event_ids->data[id]))
+		return 1;
+	return 0;
+}
+
+/*
+ * Read the stream event context, event context and payload following
+ * the event header.
+ */
+static
+int read_event_body(struct ctf_stream_pos *pos,
+		struct ctf_stream_definition *stream,
+		struct ctf_event_definition *event)
+{
+	struct bt_stream_pos *ppos = &pos->parent;
+	int ret;
+
+	/*
+	 * Fixed-layout event body: read the contexts and payload with a
+	 * single bounds check.
+	 */
+	if (likely(event->nr_body_decoders))
+		return ctf_decoders_read(pos, event->body_decoders,
+			event->nr_body_decoders);
+
+	/* Read stream-declared event context */
+	if (stream->stream_event_context) {
+		if (stream->stream_event_context_decoder)
+			ret = ctf_decoder_read(pos,
+				stream->stream_event_context_decoder);
+		else
+			ret = generic_rw(ppos, &stream->stream_event_context->p);
+		if (ret)
+			return ret;
+	}
+
+	/* Read event-declared event context */
+	if (event->event_context) {
+		if (event->event_context_decoder)
+			ret = ctf_decoder_read(pos, event->event_context_decoder);
+		else
+			ret = generic_rw(ppos, &event->event_context->p);
+		if (ret)
+			return ret;
+	}
+
+	/* Read event payload */
+	if (likely(event->event_fields)) {
+		if (likely(event->event_fields_decoder))
+			ret = ctf_decoder_read(pos, event->event_fields_decoder);
+		else
+			ret = generic_rw(ppos, &event->event_fields->p);
+		if (ret)
+			return ret;
+	}
+	return 0;
+}
+
 static
 int ctf_read_event(struct bt_stream_pos *ppos, struct ctf_stream_definition *stream)
 {
@@ -449,13 +703,16 @@ int ctf_read_event(struct bt_stream_pos *ppos, struct ctf_stream_definition *str
 		container_of(ppos, struct ctf_stream_pos, parent);
 	struct ctf_stream_declaration *stream_class = stream->stream_class;
 	struct ctf_event_definition *event;
-	uint64_t id = 0;
-	int ret;
+	uint64_t id;
+	int ret, skip = 0;
 
 	/* We need to check for EOF here for empty files. */
 	if (unlikely(pos->offset == EOF))
 		return EOF;
+	if (unlikely(stream->filter && stream->filter->skip_stream))
+		return EOF;
 
+next_event:
 	ctf_pos_get_event(pos);
 
 	/* save the current position as a restore point */
@@ -482,60 +739,57 @@ int ctf_read_event(struct bt_stream_pos *ppos, struct ctf_stream_definition *str
 
 	assert(pos->offset < pos->content_size);
 
+	/* Skip whole packets outside of the filter time range. */
+	if (unlikely(stream->filter) && pos->offset == pos->data_offset) {
+		skip = filter_packet(pos, stream->filter);
+		if (skip == EOF)
+			return EOF;
+		if (skip) {
+			ctf_move_pos(pos, pos->content_size - pos->offset);
+			goto next_event;
+		}
+	}
+
 	/* Read event header */
+	id = 0;
 	if (likely(stream->stream_event_header)) {
-		struct definition_integer *integer_definition;
-		struct bt_definition *variant;
+		struct definition_integer *timestamp;
 
-		ret = generic_rw(ppos, &stream->stream_event_header->p);
+		if (stream->stream_event_header_decoder)
+			ret = ctf_decoder_read(pos,
+				stream->stream_event_header_decoder);
+		else
+			ret = generic_rw(ppos, &stream->stream_event_header->p);
 		if (unlikely(ret))
 			goto error;
 		/* lookup event id */
-		integer_definition = bt_lookup_integer(&stream->stream_event_header->p, "id", FALSE);
-		if (integer_definition) {
-			id = integer_definition->value._unsigned;
-		} else {
-			struct definition_enum *enum_definition;
-
-			enum_definition = bt_lookup_enum(&stream->stream_event_header->p, "id", FALSE);
-			if (enum_definition) {
-				id = enum_definition->integer->value._unsigned;
-			}
-		}
-
-		variant = bt_lookup_variant(&stream->stream_event_header->p, "v");
-		if (variant) {
-			integer_definition = bt_lookup_integer(variant, "id", FALSE);
-			if (integer_definition) {
-				id = integer_definition->value._unsigned;
+		if (stream->event_header_id)
+			id = stream->event_header_id->value._unsigned;
+		else if (stream->event_header_enum_id)
+			id = stream->event_header_enum_id->integer->value._unsigned;
+		timestamp = stream->event_header_timestamp;
+
+		if (stream->event_header_variant) {
+			const struct ctf_event_header_variant_field *vfield;
+
+			vfield = lookup_event_header_variant_field(stream);
+			if (vfield) {
+				if (vfield->id)
+					id = vfield->id->value._unsigned;
+				if (!timestamp)
+					timestamp = vfield->timestamp;
 			}
 		}
 		stream->event_id = id;
 
 		/* lookup timestamp */
 		stream->has_timestamp = 0;
-		integer_definition = bt_lookup_integer(&stream->stream_event_header->p, "timestamp", FALSE);
-		if (integer_definition) {
-			ctf_update_timestamp(stream, integer_definition);
+		if (timestamp) {
+			ctf_update_timestamp(stream, timestamp);
 			stream->has_timestamp = 1;
-		} else {
-			if (variant) {
-				integer_definition = bt_lookup_integer(variant, "timestamp", FALSE);
-				if (integer_definition) {
-					ctf_update_timestamp(stream, integer_definition);
-					stream->has_timestamp = 1;
-				}
-			}
 		}
 	}
 
-	/* Read stream-declared event context */
-	if (stream->stream_event_context) {
-		ret = generic_rw(ppos, &stream->stream_event_context->p);
-		if (ret)
-			goto error;
-	}
-
 	if (unlikely(id >= stream_class->events_by_id->len)) {
 		fprintf(stderr, "[error] Event id %" PRIu64 " is outside range.\n", id);
 		return -EINVAL;
@@ -546,24 +800,30 @@ int ctf_read_event(struct bt_stream_pos *ppos, struct ctf_stream_definition *str
 		return -EINVAL;
 	}
 
-	/* Read event-declared event context */
-	if (event->event_context) {
-		ret = generic_rw(ppos, &event->event_context->p);
-		if (ret)
-			goto error;
-	}
-
-	/* Read event payload */
-	if (likely(event->event_fields)) {
-		ret = generic_rw(ppos, &event->event_fields->p);
-		if (ret)
-			goto error;
+	if (unlikely(stream->filter)) {
+		skip = filter_event(stream, id, stream->filter);
+		if (skip == EOF)
+			return EOF;
 	}
+	/*
+	 * Move past the body of skipped events without reading it when
+	 * its layout is fixed. Otherwise, its size is only known once
+	 * read.
+	 */
+	if (unlikely(skip) && event->nr_body_decoders)
+		ret = ctf_decoders_skip(pos, event->body_decoders,
+			event->nr_body_decoders);
+	else
+		ret = read_event_body(pos, stream, event);
+	if (ret)
+		goto error;
 
 	if (pos->last_offset == pos->offset) {
 		fprintf(stderr, "[error] Invalid 0 byte event encountered.\n");
 		return -EINVAL;
 	}
+	if (unlikely(skip))
+		goto next_event;
 
 	return 0;
 
@@ -659,6 +919,7 @@ begin:
 	}
 
 	if (pos->base_mma) {
+		ctf_pos_detach_strings(pos);
 		/* unmap old base */
 		ret = munmap_align(pos->base_mma);
 		if (ret) {
@@ -672,6 +933,8 @@ begin:
 	pos->base_mma = mmap_align(packet_map_len >> LOG2_CHAR_BIT, PROT_READ,
 			MAP_PRIVATE, pos->fd, pos->mmap_offset);
 	assert(pos->base_mma != MAP_FAILED);
+	pos->mmap_window_offset = pos->mmap_offset;
+	pos->mmap_base_offset = 0;
 
 	pos->content_size = packet_map_len;
 	pos->packet_size = packet_map_len;
@@ -696,6 +959,7 @@ begin:
 	}
 	packet_index->data_offset = pos->offset;
 
+	ctf_pos_detach_strings(pos);
 	/* unmap old base */
 	ret = munmap_align(pos->base_mma);
 	if (ret) {
@@ -732,6 +996,7 @@ int ctf_init_pos(struct ctf_stream_pos *pos, struct bt_trace_descriptor *trace,
 		int fd, int open_flags)
 {
 	pos->fd = fd;
+	pos->borrowed_strings = NULL;
 	if (fd >= 0) {
 		pos->packet_index = g_array_new(FALSE, TRUE,
 				sizeof(struct packet_index));
@@ -742,6 +1007,8 @@ int ctf_init_pos(struct ctf_stream_pos *pos, struct bt_trace_descriptor *trace,
 	case O_RDONLY:
 		pos->prot = PROT_READ;
 		pos->flags = MAP_PRIVATE;
+		if (opt_zero_copy_strings && fd >= 0)
+			pos->borrowed_strings = g_ptr_array_new();
 		pos->parent.rw_table = read_dispatch_table;
 		pos->parent.event_cb = ctf_read_event;
 		pos->parent.trace = trace;
@@ -765,6 +1032,14 @@ int ctf_fini_pos(struct ctf_stream_pos *pos)
 {
 	if (pos->prot == PROT_WRITE && pos->content_size_loc)
 		*pos->content_size_loc = pos->offset;
+	/*
+	 * The string definitions of the stream are freed along with it:
+	 * no need to detach them from the mapping.
+	 */
+	if (pos->borrowed_strings) {
+		(void) g_ptr_array_free(pos->borrowed_strings, TRUE);
+		pos->borrowed_strings = NULL;
+	}
 	if (pos->base_mma) {
 		int ret;
 
@@ -778,6 +1053,8 @@ int ctf_fini_pos(struct ctf_stream_pos *pos)
 	}
 	if (pos->packet_index)
 		(void) g_array_free(pos->packet_index, TRUE);
+	if (pos->packet_event_index)
+		(void) g_ptr_array_free(pos->packet_event_index, TRUE);
 	return 0;
 }
 
@@ -817,6 +1094,72 @@ void ctf_update_current_packet_index(struct ctf_stream_definition *stream,
 	stream->events_discarded = events_discarded_diff;
 }
 
+/*
+ * Make the current packet (at mmap_offset, of length packet_size)
+ * accessible through the read mapping window. The window is only
+ * remapped when the packet is not entirely contained within it. The
+ * new window starts at the packet, spans opt_mmap_window_len bytes (or
+ * at least the packet), and is advised for sequential access. Readahead
+ * is requested for the following window.
+ *
+ * Returns 0 on success, negative error otherwise.
+ */
+static
+int ctf_pos_map_window(struct ctf_stream_pos *pos)
+{
+	uint64_t packet_len = pos->packet_size / CHAR_BIT;
+	uint64_t window_len = opt_mmap_window_len;
+	struct stat filestats;
+	int ret;
+
+	if (pos->base_mma && pos->mmap_offset >= pos->mmap_window_offset
+			&& pos->mmap_offset + packet_len
+				<= pos->mmap_window_offset
+					+ pos->base_mma->length) {
+		pos->mmap_base_offset = pos->mmap_offset
+			- pos->mmap_window_offset;
+		return 0;
+	}
+
+	if (pos->base_mma) {
+		ctf_pos_detach_strings(pos);
+		/* unmap old base */
+		ret = munmap_align(pos->base_mma);
+		pos->base_mma = NULL;
+		if (ret)
+			return -errno;
+	}
+
+	ret = fstat(pos->fd, &filestats);
+	if (ret < 0)
+		return -errno;
+
+	if (sizeof(size_t) < sizeof(uint64_t)
+			&& window_len > MAX_MMAP_WINDOW_LEN_32)
+		window_len = MAX_MMAP_WINDOW_LEN_32;
+	if (window_len > (uint64_t) filestats.st_size - pos->mmap_offset)
+		window_len = (uint64_t) filestats.st_size - pos->mmap_offset;
+	if (window_len < packet_len)
+		window_len = packet_len;
+
+	pos->base_mma = mmap_align(window_len, pos->prot, pos->flags,
+			pos->fd, pos->mmap_offset);
+	if (pos->base_mma == MAP_FAILED) {
+		pos->base_mma = NULL;
+		return -errno;
+	}
+	pos->mmap_window_offset = pos->mmap_offset;
+	pos->mmap_base_offset = 0;
+
+	(void) madvise(pos->base_mma->page_aligned_addr,
+			pos->base_mma->page_aligned_length, MADV_SEQUENTIAL);
+	if (pos->mmap_offset + window_len < (uint64_t) filestats.st_size) {
+		(void) posix_fadvise(pos->fd, pos->mmap_offset + window_len,
+				window_len, POSIX_FADV_WILLNEED);
+	}
+	return 0;
+}
+
 /*
  * for SEEK_CUR: go to next packet.
  * for SEEK_SET: go to packet numer (index).
@@ -842,7 +1185,12 @@ void ctf_packet_seek(struct bt_stream_pos *stream_pos, size_t index, int whence)
 	if (pos->prot == PROT_WRITE && pos->content_size_loc)
 		*pos->content_size_loc = pos->offset;
 
-	if (pos->base_mma) {
+	/*
+	 * With a read mapping window, the old base is only unmapped
+	 * when the next packet is not contained in the window.
+	 */
+	if (pos->base_mma && (pos->prot == PROT_WRITE || !opt_mmap_window_len)) {
+		ctf_pos_detach_strings(pos);
 		/* unmap old base */
 		ret = munmap_align(pos->base_mma);
 		if (ret) {
@@ -887,9 +1235,12 @@ void ctf_packet_seek(struct bt_stream_pos *stream_pos, size_t index, int whence)
 				return;
 			}
 			assert(pos->cur_index < pos->packet_index->len);
-			if (index > 0) {
+			/* Account for the packet we are leaving. */
+			packet_index = &g_array_index(pos->packet_index,
+					struct packet_index, pos->cur_index);
+			if (pos->cur_index > 0) {
 				prev_index = &g_array_index(pos->packet_index,
-						struct packet_index, index - 1);
+						struct packet_index, pos->cur_index - 1);
 			}
 			ctf_update_current_packet_index(&file_stream->parent,
 					prev_index, packet_index);
@@ -917,27 +1268,12 @@ void ctf_packet_seek(struct bt_stream_pos *stream_pos, size_t index, int whence)
 		}
 		if (pos->cur_index >= pos->packet_index->len) {
 			/*
-			 * We need to check if we are in trace read or
-			 * called from packet indexing.  In this last
-			 * case, the collection is not there, so we
-			 * cannot print the timestamps.
+			 * A pipeline reader decodes ahead of the output:
+			 * its consumer reports the discarded events when
+			 * it reaches the end of the stream.
 			 */
-			if ((&file_stream->parent)->stream_class->trace->parent.collection) {
-				/*
-				 * When a stream reaches the end of the
-				 * file, we need to show the number of
-				 * events discarded ourselves, because
-				 * there is no next event scheduled to
-				 * be printed in the output.
-				 */
-				if (file_stream->parent.events_discarded) {
-					fflush(stdout);
-					ctf_print_discarded(stderr,
-						&file_stream->parent,
-						1);
-					file_stream->parent.events_discarded = 0;
-				}
-			}
+			if (!file_stream->pipeline_reader)
+				ctf_print_end_of_stream_discarded(&file_stream->parent);
 			pos->offset = EOF;
 			return;
 		}
@@ -948,6 +1284,7 @@ void ctf_packet_seek(struct bt_stream_pos *stream_pos, size_t index, int whence)
 
 		file_stream->parent.real_timestamp = packet_index->ts_real.timestamp_begin;
 
+		pos->mmap_offset = packet_index->offset;
 		/* Lookup context/packet size in index */
 		if (packet_index->data_offset == -1) {
 			ret = find_data_offset(pos, file_stream, packet_index);
@@ -957,7 +1294,6 @@ void ctf_packet_seek(struct bt_stream_pos *stream_pos, size_t index, int whence)
 		}
 		pos->content_size = packet_index->content_size;
 		pos->packet_size = packet_index->packet_size;
-		pos->mmap_offset = packet_index->offset;
 		pos->data_offset = packet_index->data_offset;
 		if (pos->data_offset < packet_index->content_size) {
 			pos->offset = 0;	/* will read headers */
@@ -971,13 +1307,24 @@ void ctf_packet_seek(struct bt_stream_pos *stream_pos, size_t index, int whence)
 			return;
 		}
 	}
-	/* map new base. Need mapping length from header. */
-	pos->base_mma = mmap_align(pos->packet_size / CHAR_BIT, pos->prot,
-			pos->flags, pos->fd, pos->mmap_offset);
-	if (pos->base_mma == MAP_FAILED) {
-		fprintf(stderr, "[error] mmap error %s.\n",
-			strerror(errno));
-		assert(0);
+	if (pos->prot == PROT_READ && opt_mmap_window_len) {
+		ret = ctf_pos_map_window(pos);
+		if (ret) {
+			fprintf(stderr, "[error] mmap error %s.\n",
+				strerror(-ret));
+			assert(0);
+		}
+	} else {
+		/* map new base. Need mapping length from header. */
+		pos->base_mma = mmap_align(pos->packet_size / CHAR_BIT, pos->prot,
+				pos->flags, pos->fd, pos->mmap_offset);
+		if (pos->base_mma == MAP_FAILED) {
+			fprintf(stderr, "[error] mmap error %s.\n",
+				strerror(errno));
+			assert(0);
+		}
+		pos->mmap_window_offset = pos->mmap_offset;
+		pos->mmap_base_offset = 0;
 	}
 
 	/* update trace_packet_header and stream_packet_context */
@@ -1322,6 +1669,39 @@ end_free:
 	return ret;
 }
 
+/*
+ * Gather the decoders of the structures following the event header, if
+ * they all have a fixed layout.
+ */
+static
+void init_body_decoders(struct ctf_stream_definition *stream,
+		struct ctf_event_definition *stream_event)
+{
+	struct {
+		struct definition_struct *definition;
+		struct ctf_decoder *decoder;
+	} body[] = {
+		{ stream->stream_event_context,
+			stream->stream_event_context_decoder },
+		{ stream_event->event_context,
+			stream_event->event_context_decoder },
+		{ stream_event->event_fields,
+			stream_event->event_fields_decoder },
+	};
+	unsigned int i, nr = 0;
+
+	for (i = 0; i < sizeof(body) / sizeof(body[0]); i++) {
+		if (!body[i].definition)
+			continue;
+		if (!body[i].decoder) {
+			nr = 0;
+			break;
+		}
+		stream_event->body_decoders[nr++] = body[i].decoder;
+	}
+	stream_event->nr_body_decoders = nr;
+}
+
 static
 struct ctf_event_definition *create_event_definitions(struct ctf_trace *td,
 						  struct ctf_stream_definition *stream,
@@ -1338,6 +1718,8 @@ struct ctf_event_definition *create_event_definitions(struct ctf_trace *td,
 		}
 		stream_event->event_context = container_of(definition,
 					struct definition_struct, p);
+		stream_event->event_context_decoder =
+			ctf_decoder_create(stream_event->event_context);
 		stream->parent_def_scope = stream_event->event_context->p.scope;
 	}
 	if (event->fields_decl) {
@@ -1349,21 +1731,67 @@ struct ctf_event_definition *create_event_definitions(struct ctf_trace *td,
 		}
 		stream_event->event_fields = container_of(definition,
 					struct definition_struct, p);
+		stream_event->event_fields_decoder =
+			ctf_decoder_create(stream_event->event_fields);
 		stream->parent_def_scope = stream_event->event_fields->p.scope;
 	}
 	stream_event->stream = stream;
+	init_body_decoders(stream, stream_event);
 	return stream_event;
 
 error:
+	ctf_decoder_destroy(stream_event->event_fields_decoder);
+	ctf_decoder_destroy(stream_event->event_context_decoder);
 	if (stream_event->event_fields)
 		bt_definition_unref(&stream_event->event_fields->p);
 	if (stream_event->event_context)
 		bt_definition_unref(&stream_event->event_context->p);
+	g_free(stream_event);
 	fprintf(stderr, "[error] Unable to create event definition for event \"%s\".\n",
 		g_quark_to_string(event->name));
 	return NULL;
 }
 
+/*
+ * Resolve the event header "id" and "timestamp" fields once, rather
+ * than looking them up by name for each event.
+ */
+static
+void resolve_event_header_fields(struct ctf_stream_definition *stream)
+{
+	struct bt_definition *header = &stream->stream_event_header->p;
+	struct bt_definition *variant;
+
+	stream->event_header_id = bt_lookup_integer(header, "id", FALSE);
+	if (!stream->event_header_id)
+		stream->event_header_enum_id =
+			bt_lookup_enum(header, "id", FALSE);
+	stream->event_header_timestamp =
+		bt_lookup_integer(header, "timestamp", FALSE);
+
+	variant = bt_lookup_definition(header, "v");
+	if (variant && variant->declaration->id == CTF_TYPE_VARIANT) {
+		struct definition_variant *variant_definition =
+			container_of(variant, struct definition_variant, p);
+		unsigned int i;
+
+		stream->event_header_variant = variant_definition;
+		stream->event_header_variant_fields = g_array_sized_new(FALSE,
+			TRUE, sizeof(struct ctf_event_header_variant_field),
+			variant_definition->fields->len);
+		for (i = 0; i < variant_definition->fields->len; i++) {
+			struct ctf_event_header_variant_field vfield;
+
+			vfield.field = g_ptr_array_index(variant_definition->fields, i);
+			vfield.id = bt_lookup_integer(vfield.field, "id", FALSE);
+			vfield.timestamp = bt_lookup_integer(vfield.field,
+				"timestamp", FALSE);
+			g_array_append_val(stream->event_header_variant_fields,
+				vfield);
+		}
+	}
+}
+
 static
 int create_stream_definitions(struct ctf_trace *td, struct ctf_stream_definition *stream)
 {
@@ -1398,6 +1826,9 @@ int create_stream_definitions(struct ctf_trace *td, struct ctf_stream_definition
 		}
 		stream->stream_event_header =
 			container_of(definition, struct definition_struct, p);
+		stream->stream_event_header_decoder =
+			ctf_decoder_create(stream->stream_event_header);
+		resolve_event_header_fields(stream);
 		stream->parent_def_scope = stream->stream_event_header->p.scope;
 	}
 	if (stream_class->event_context_decl) {
@@ -1410,6 +1841,8 @@ int create_stream_definitions(struct ctf_trace *td, struct ctf_stream_definition
 		}
 		stream->stream_event_context =
 			container_of(definition, struct definition_struct, p);
+		stream->stream_event_context_decoder =
+			ctf_decoder_create(stream->stream_event_context);
 		stream->parent_def_scope = stream->stream_event_context->p.scope;
 	}
 	stream->events_by_id = g_ptr_array_new();
@@ -1432,11 +1865,22 @@ int create_stream_definitions(struct ctf_trace *td, struct ctf_stream_definition
 error_event:
 	for (i = 0; i < stream->events_by_id->len; i++) {
 		struct ctf_event_definition *stream_event = g_ptr_array_index(stream->events_by_id, i);
-		if (stream_event)
+		if (stream_event) {
+			ctf_decoder_destroy(stream_event->event_fields_decoder);
+			ctf_decoder_destroy(stream_event->event_context_decoder);
 			g_free(stream_event);
+		}
 	}
 	g_ptr_array_free(stream->events_by_id, TRUE);
 error:
+	ctf_decoder_destroy(stream->stream_event_context_decoder);
+	stream->stream_event_context_decoder = NULL;
+	ctf_decoder_destroy(stream->stream_event_header_decoder);
+	stream->stream_event_header_decoder = NULL;
+	if (stream->event_header_variant_fields) {
+		g_array_free(stream->event_header_variant_fields, TRUE);
+		stream->event_header_variant_fields = NULL;
+	}
 	if (stream->stream_event_context)
 		bt_definition_unref(&stream->stream_event_context->p);
 	if (stream->stream_event_header)
@@ -1496,6 +1940,7 @@ begin:
 	}
 
 	if (pos->base_mma) {
+		ctf_pos_detach_strings(pos);
 		/* unmap old base */
 		ret = munmap_align(pos->base_mma);
 		if (ret) {
@@ -1509,6 +1954,8 @@ begin:
 	pos->base_mma = mmap_align(packet_map_len >> LOG2_CHAR_BIT, PROT_READ,
 			 MAP_PRIVATE, pos->fd, pos->mmap_offset);
 	assert(pos->base_mma != MAP_FAILED);
+	pos->mmap_window_offset = pos->mmap_offset;
+	pos->mmap_base_offset = 0;
 	/*
 	 * Use current mapping size as temporary content and packet
 	 * size.
@@ -1804,6 +2251,43 @@ error:
 	return ret;
 }
 
+/*
+ * Read the header extension following the index file header hdr, if
+ * its version has one. Returns 1 if present, leaving the index file
+ * position after it, 0 if absent, leaving the position at the first
+ * packet index entry, or a negative value on error.
+ */
+static
+int read_index_hdr_ext(FILE *index_fp,
+		const struct ctf_packet_index_file_hdr *hdr,
+		struct ctf_packet_index_file_hdr_ext *ext)
+{
+	long start;
+	uint32_t len;
+
+	if (be32toh(hdr->index_minor) < CTF_INDEX_EXT_MINOR)
+		return 0;
+	start = ftell(index_fp);
+	if (start < 0)
+		return -1;
+	if (fread(ext, sizeof(*ext), 1, index_fp) != 1
+			|| be32toh(ext->magic) != CTF_INDEX_EXT_MAGIC) {
+		if (fseek(index_fp, start, SEEK_SET))
+			return -1;
+		return 0;
+	}
+	len = be32toh(ext->len);
+	if (be32toh(ext->version) < CTF_INDEX_EXT_VERSION
+			|| len < sizeof(*ext)) {
+		fprintf(stderr, "[error] Malformed index header extension.\n");
+		return -1;
+	}
+	/* Skip fields added by later extension versions. */
+	if (fseek(index_fp, start + len, SEEK_SET))
+		return -1;
+	return 1;
+}
+
 static
 int import_stream_packet_index(struct ctf_trace *td,
 		struct ctf_file_stream *file_stream)
@@ -1812,7 +2296,9 @@ int import_stream_packet_index(struct ctf_trace *td,
 	struct ctf_stream_pos *pos;
 	struct ctf_packet_index ctf_index;
 	struct ctf_packet_index_file_hdr index_hdr;
+	struct ctf_packet_index_file_hdr_ext index_hdr_ext;
 	struct packet_index index;
+	uint32_t packet_index_len;
 	int ret = 0;
 	int first_packet = 1;
 	size_t len;
@@ -1840,16 +2326,32 @@ int import_stream_packet_index(struct ctf_trace *td,
 		ret = -1;
 		goto error;
 	}
-	if (index_hdr.packet_index_len == 0) {
-		fprintf(stderr, "[error] Packet index length cannot be 0.\n");
+	packet_index_len = be32toh(index_hdr.packet_index_len);
+	if (packet_index_len < sizeof(ctf_index)) {
+		fprintf(stderr, "[error] Packet index length %" PRIu32
+				" is too small.\n", packet_index_len);
+		ret = -1;
+		goto error;
+	}
+	if (read_index_hdr_ext(pos->index_fp, &index_hdr,
+			&index_hdr_ext) < 0) {
 		ret = -1;
 		goto error;
 	}
 
-	while (fread(&ctf_index, index_hdr.packet_index_len, 1,
-			pos->index_fp) == 1) {
+	while (fread(&ctf_index, sizeof(ctf_index), 1, pos->index_fp) == 1) {
 		uint64_t stream_id;
 
+		/* Skip fields added by later index minor versions. */
+		if (packet_index_len > sizeof(ctf_index)
+				&& fseek(pos->index_fp,
+					packet_index_len - sizeof(ctf_index),
+					SEEK_CUR)) {
+			perror("seek index file");
+			ret = -1;
+			goto error;
+		}
+
 		memset(&index, 0, sizeof(index));
 		index.offset = be64toh(ctf_index.offset);
 		index.packet_size = be64toh(ctf_index.packet_size);
@@ -1892,19 +2394,833 @@ error:
 }
 
 /*
- * Note: many file streams can inherit from the same stream class
- * description (metadata).
+ * An index file written by babeltrace is out of date if the size or the
+ * modification time of its stream file differ from the ones recorded in
+ * its header extension. Index files written by the tracer have no
+ * extension: they are out of date if their stream file was modified
+ * after them, or if their packets do not end exactly at the end of the
+ * stream file (e.g. the stream was appended to or truncated).
+ * Malformed index headers are reported by import_stream_packet_index().
+ * Leaves the index file position at its beginning.
  */
 static
-int ctf_open_file_stream_read(struct ctf_trace *td, const char *path, int flags,
-		void (*packet_seek)(struct bt_stream_pos *pos, size_t index,
-			int whence))
+int stream_packet_index_is_stale(struct ctf_file_stream *file_stream)
 {
-	int ret, fd, closeret;
-	struct ctf_file_stream *file_stream;
-	struct stat statbuf;
-	char *index_name;
-
+	struct ctf_stream_pos *pos = &file_stream->pos;
+	struct ctf_packet_index_file_hdr index_hdr;
+	struct ctf_packet_index_file_hdr_ext index_hdr_ext;
+	struct ctf_packet_index ctf_index;
+	struct stat stream_stat, index_stat;
+	uint32_t packet_index_len;
+	off_t entries_start, nr_entries;
+	int stale = 1, ret;
+
+	if (fstat(pos->fd, &stream_stat) < 0
+			|| fstat(fileno(pos->index_fp), &index_stat) < 0)
+		goto end;
+	if (fread(&index_hdr, sizeof(index_hdr), 1, pos->index_fp) != 1) {
+		stale = 0;
+		goto end;
+	}
+	packet_index_len = be32toh(index_hdr.packet_index_len);
+	if (be32toh(index_hdr.magic) != CTF_INDEX_MAGIC
+			|| packet_index_len < sizeof(ctf_index)) {
+		stale = 0;
+		goto end;
+	}
+	ret = read_index_hdr_ext(pos->index_fp, &index_hdr, &index_hdr_ext);
+	if (ret < 0) {
+		stale = 0;
+		goto end;
+	}
+	if (ret) {
+		stale = be64toh(index_hdr_ext.stream_size)
+				!= (uint64_t) stream_stat.st_size
+			|| be64toh(index_hdr_ext.stream_mtime_sec)
+				!= (uint64_t) stream_stat.st_mtim.tv_sec
+			|| be64toh(index_hdr_ext.stream_mtime_nsec)
+				!= (uint64_t) stream_stat.st_mtim.tv_nsec;
+		goto end;
+	}
+
+	if (stream_stat.st_mtime > index_stat.st_mtime)
+		goto end;
+	entries_start = ftell(pos->index_fp);
+	nr_entries = (index_stat.st_size - entries_start) / packet_index_len;
+	if (!nr_entries) {
+		stale = stream_stat.st_size != 0;
+		goto end;
+	}
+	if (fseek(pos->index_fp, entries_start
+			+ (nr_entries - 1) * packet_index_len, SEEK_SET))
+		goto end;
+	if (fread(&ctf_index, sizeof(ctf_index), 1, pos->index_fp) != 1)
+		goto end;
+	stale = be64toh(ctf_index.offset)
+		+ (be64toh(ctf_index.packet_size) >> LOG2_CHAR_BIT)
+			!= stream_stat.st_size;
+end:
+	rewind(pos->index_fp);
+	return stale;
+}
+
+/*
+ * Create a temporary file next to index file index_name, under a name
+ * no other writer of the same index uses. Returns its file descriptor
+ * and sets tmp_name, to be freed by the caller, or returns -1 with
+ * errno set.
+ */
+static
+int create_tmp_index_file(struct ctf_trace *td, const char *index_name,
+		char **tmp_name)
+{
+	unsigned int attempt;
+	int fd;
+
+	for (attempt = 0; attempt < 16; attempt++) {
+		*tmp_name = g_strdup_printf("%s.%08" PRIx32 ".tmp", index_name,
+			g_random_int());
+		fd = openat(td->dirfd, *tmp_name,
+			O_WRONLY | O_CREAT | O_EXCL, 0644);
+		if (fd >= 0 || errno != EEXIST)
+			return fd;
+		g_free(*tmp_name);
+	}
+	*tmp_name = NULL;
+	return -1;
+}
+
+/*
+ * Write the packet index built from the stream data to its index file.
+ * The index is written to a temporary file of its own which is then
+ * renamed, so concurrent readers never see a partial index, and
+ * concurrent writers never write to the same file. Failing to write the
+ * index cache is not fatal.
+ */
+static
+void write_stream_packet_index(struct ctf_trace *td,
+		struct ctf_file_stream *file_stream, const char *index_name)
+{
+	struct ctf_packet_index_file_hdr index_hdr;
+	struct ctf_packet_index_file_hdr_ext index_hdr_ext;
+	struct ctf_packet_index ctf_index;
+	struct stat stream_stat;
+	char *tmp_name;
+	unsigned int i;
+	FILE *fp;
+	int fd, ret;
+
+	if (fstat(file_stream->pos.fd, &stream_stat) < 0) {
+		perror("File stream fstat()");
+		return;
+	}
+
+	ret = mkdirat(td->dirfd, INDEX_DIR, 0755);
+	if (ret < 0 && errno != EEXIST) {
+		fprintf(stderr, "[warning] Unable to create index directory: %s\n",
+			strerror(errno));
+		return;
+	}
+	fd = create_tmp_index_file(td, index_name, &tmp_name);
+	if (fd < 0) {
+		fprintf(stderr, "[warning] Unable to create index file \"%s\": %s\n",
+			index_name, strerror(errno));
+		goto end;
+	}
+	fp = fdopen(fd, "w");
+	if (!fp) {
+		perror("fdopen() error");
+		close(fd);
+		goto error_unlink;
+	}
+
+	index_hdr.magic = htobe32(CTF_INDEX_MAGIC);
+	index_hdr.index_major = htobe32(CTF_INDEX_MAJOR);
+	index_hdr.index_minor = htobe32(CTF_INDEX_MINOR);
+	index_hdr.packet_index_len = htobe32(sizeof(ctf_index));
+	if (fwrite(&index_hdr, sizeof(index_hdr), 1, fp) != 1)
+		goto error_close;
+	memset(&index_hdr_ext, 0, sizeof(index_hdr_ext));
+	index_hdr_ext.magic = htobe32(CTF_INDEX_EXT_MAGIC);
+	index_hdr_ext.version = htobe32(CTF_INDEX_EXT_VERSION);
+	index_hdr_ext.len = htobe32(sizeof(index_hdr_ext));
+	index_hdr_ext.stream_size = htobe64(stream_stat.st_size);
+	index_hdr_ext.stream_mtime_sec = htobe64(stream_stat.st_mtim.tv_sec);
+	index_hdr_ext.stream_mtime_nsec = htobe64(stream_stat.st_mtim.tv_nsec);
+	if (fwrite(&index_hdr_ext, sizeof(index_hdr_ext), 1, fp) != 1)
+		goto error_close;
+
+	for (i = 0; i < file_stream->pos.packet_index->len; i++) {
+		struct packet_index *index =
+			&g_array_index(file_stream->pos.packet_index,
+				struct packet_index, i);
+
+		ctf_index.offset = htobe64(index->offset);
+		ctf_index.packet_size = htobe64(index->packet_size);
+		ctf_index.content_size = htobe64(index->content_size);
+		ctf_index.timestamp_begin = htobe64(index->ts_cycles.timestamp_begin);
+		ctf_index.timestamp_end = htobe64(index->ts_cycles.timestamp_end);
+		ctf_index.events_discarded = htobe64(index->events_discarded);
+		ctf_index.stream_id = htobe64(file_stream->parent.stream_id);
+		if (fwrite(&ctf_index, sizeof(ctf_index), 1, fp) != 1)
+			goto error_close;
+	}
+	if (fclose(fp)) {
+		perror("close index");
+		goto error_unlink;
+	}
+	if (renameat(td->dirfd, tmp_name, td->dirfd, index_name) < 0) {
+		perror("rename index");
+		goto error_unlink;
+	}
+	goto end;
+
+error_close:
+	fprintf(stderr, "[warning] Unable to write index file \"%s\"\n",
+		tmp_name);
+	fclose(fp);
+error_unlink:
+	(void) unlinkat(td->dirfd, tmp_name, 0);
+end:
+	g_free(tmp_name);
+}
+
+/*
+ * Pipelined stream decoding.
+ *
+ * With opt_pipeline_depth >= 2, file streams are decoded up to
+ * opt_pipeline_depth events ahead of the iterator by a pool of worker
+ * threads, at most one per CPU. Each worker serves a group of streams,
+ * filling the free slots of their rings in turn. Each ring slot owns a
+ * complete set of stream definitions
+ * (packet header/context, event header/context and event payloads)
+ * into which the worker decodes one event. Handing an event to the
+ * iterator amounts to installing the slot definitions in the file
+ * stream, so the iterator merge and the event API are unchanged: they
+ * keep seeing one decoded event per stream, in stream order.
+ *
+ * The slot the iterator currently looks at is only recycled by the
+ * next read, which keeps the current event definitions valid. Seeking
+ * a stream stops its decoding run, which is restarted from the new
+ * position by the next read.
+ */
+int opt_pipeline_depth;
+
+/*
+ * Worker thread and the pipelines it serves. The group lock protects
+ * the slot states, head, tail, running, ended and busy fields of the
+ * pipelines of the group.
+ */
+struct pipeline_group {
+	pthread_t thread;
+	int running;		/* Thread started */
+	int exit;		/* Thread exit request */
+	pthread_mutex_t lock;
+	pthread_cond_t cond;	/* Slot state changes, runs started and stopped */
+	GPtrArray *pipelines;	/* struct ctf_stream_pipeline */
+	unsigned int next;	/* Next pipeline served */
+};
+
+/*
+ * Worker groups shared by all the traces of the process, created with
+ * the first pipeline and freed with the last one. Protected by
+ * pipeline_pool_lock, along with the pipeline lists of the groups.
+ */
+static pthread_mutex_t pipeline_pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct pipeline_group *pipeline_groups;
+static unsigned int nr_pipeline_groups, nr_pool_pipelines;
+
+enum pipeline_slot_state {
+	PIPELINE_SLOT_FREE,
+	PIPELINE_SLOT_FILLED,		/* Decoded, waiting for the iterator */
+	PIPELINE_SLOT_CURRENT,		/* Event seen by the iterator */
+};
+
+struct pipeline_slot {
+	enum pipeline_slot_state state;
+	struct ctf_stream_definition stream;	/* Owns a definition set */
+	int64_t packet_index;	/* Packet read in the packet definitions, -1 if none */
+	int ret;		/* ctf_read_event() return value */
+	/* Stream position after the event. */
+	off_t mmap_offset;
+	uint64_t packet_size;
+	uint64_t content_size;
+	int64_t offset;
+	int64_t last_offset;
+	int64_t data_offset;
+	uint64_t cur_index;
+};
+
+struct ctf_stream_pipeline {
+	struct ctf_file_stream reader;	/* Worker position in the stream */
+	struct pipeline_group *group;
+	int running;		/* Decoding run started by the iterator */
+	int ended;		/* Last slot of the run filled */
+	int busy;		/* Worker decoding into the tail slot */
+	unsigned int head;	/* Next slot handed to the iterator */
+	unsigned int tail;	/* Next slot filled by the worker */
+	int current;		/* Slot seen by the iterator, -1 if none */
+	unsigned int nr_slots;
+	struct pipeline_slot slots[];
+};
+
+/*
+ * Install the definition set of "from" into "stream", leaving the
+ * stream state (timestamps, discarded events, ...) untouched.
+ */
+static
+void stream_install_definitions(struct ctf_stream_definition *stream,
+		const struct ctf_stream_definition *from)
+{
+	stream->trace_packet_header = from->trace_packet_header;
+	stream->stream_packet_context = from->stream_packet_context;
+	stream->stream_event_header = from->stream_event_header;
+	stream->stream_event_context = from->stream_event_context;
+	stream->stream_event_header_decoder = from->stream_event_header_decoder;
+	stream->stream_event_context_decoder = from->stream_event_context_decoder;
+	stream->event_header_id = from->event_header_id;
+	stream->event_header_enum_id = from->event_header_enum_id;
+	stream->event_header_timestamp = from->event_header_timestamp;
+	stream->event_header_variant = from->event_header_variant;
+	stream->event_header_variant_fields = from->event_header_variant_fields;
+	stream->events_by_id = from->events_by_id;
+	stream->parent_def_scope = from->parent_def_scope;
+}
+
+static
+void free_stream_definitions(struct ctf_stream_definition *stream)
+{
+	unsigned int i;
+
+	for (i = 0; i < stream->events_by_id->len; i++) {
+		struct ctf_event_definition *event;
+
+		event = g_ptr_array_index(stream->events_by_id, i);
+		if (!event)
+			continue;
+		if (event->event_fields)
+			bt_definition_unref(&event->event_fields->p);
+		if (event->event_context)
+			bt_definition_unref(&event->event_context->p);
+		ctf_decoder_destroy(event->event_fields_decoder);
+		ctf_decoder_destroy(event->event_context_decoder);
+		g_free(event);
+	}
+	if (stream->trace_packet_header)
+		bt_definition_unref(&stream->trace_packet_header->p);
+	if (stream->stream_event_header)
+		bt_definition_unref(&stream->stream_event_header->p);
+	if (stream->stream_packet_context)
+		bt_definition_unref(&stream->stream_packet_context->p);
+	if (stream->stream_event_context)
+		bt_definition_unref(&stream->stream_event_context->p);
+	ctf_decoder_destroy(stream->stream_event_context_decoder);
+	ctf_decoder_destroy(stream->stream_event_header_decoder);
+	if (stream->event_header_variant_fields)
+		g_array_free(stream->event_header_variant_fields, TRUE);
+	g_ptr_array_free(stream->events_by_id, TRUE);
+}
+
+/*
+ * Create a new definition set for a pipeline slot, carrying the
+ * stream state of "file_stream".
+ */
+static
+int create_slot_definitions(struct ctf_file_stream *file_stream,
+		struct ctf_stream_definition *stream)
+{
+	struct ctf_trace *td = file_stream->parent.stream_class->trace;
+	int ret;
+
+	*stream = file_stream->parent;
+	stream->trace_packet_header = NULL;
+	stream->stream_packet_context = NULL;
+	stream->stream_event_header = NULL;
+	stream->stream_event_context = NULL;
+	stream->stream_event_header_decoder = NULL;
+	stream->stream_event_context_decoder = NULL;
+	stream->event_header_id = NULL;
+	stream->event_header_enum_id = NULL;
+	stream->event_header_timestamp = NULL;
+	stream->event_header_variant = NULL;
+	stream->event_header_variant_fields = NULL;
+	stream->events_by_id = NULL;
+	stream->parent_def_scope = NULL;
+	stream->stream_definitions_created = 0;
+
+	ret = create_trace_definitions(td, stream);
+	if (ret)
+		return ret;
+	ret = create_stream_definitions(td, stream);
+	if (ret) {
+		if (stream->trace_packet_header)
+			bt_definition_unref(&stream->trace_packet_header->p);
+		return ret;
+	}
+	return 0;
+}
+
+/*
+ * Re-read the packet header and context of the current packet into the
+ * definitions installed in the reader.
+ */
+static
+void pipeline_read_packet_definitions(struct ctf_file_stream *reader)
+{
+	struct ctf_stream_pos *pos = &reader->pos;
+	int64_t offset = pos->offset;
+	int ret;
+
+	pos->offset = 0;
+	if (reader->parent.trace_packet_header) {
+		ret = generic_rw(&pos->parent, &reader->parent.trace_packet_header->p);
+		assert(!ret);
+	}
+	if (reader->parent.stream_packet_context) {
+		ret = generic_rw(&pos->parent, &reader->parent.stream_packet_context->p);
+		assert(!ret);
+	}
+	pos->offset = offset;
+}
+
+/*
+ * Find a pipeline of the group with a slot to fill, starting after the
+ * last one served. Called with the group lock held.
+ */
+static
+struct ctf_stream_pipeline *pipeline_group_next(struct pipeline_group *group)
+{
+	unsigned int i;
+
+	for (i = 0; i < group->pipelines->len; i++) {
+		struct ctf_stream_pipeline *pipeline;
+
+		pipeline = g_ptr_array_index(group->pipelines,
+				(group->next + i) % group->pipelines->len);
+		if (pipeline->running && !pipeline->ended
+				&& pipeline->slots[pipeline->tail].state
+					== PIPELINE_SLOT_FREE) {
+			group->next = (group->next + i + 1)
+				% group->pipelines->len;
+			return pipeline;
+		}
+	}
+	return NULL;
+}
+
+/*
+ * Decode the next event of a pipeline into its tail slot.
+ */
+static
+void pipeline_fill_slot(struct ctf_stream_pipeline *pipeline,
+		struct pipeline_slot *slot)
+{
+	struct ctf_file_stream *reader = &pipeline->reader;
+	int ret;
+
+	stream_install_definitions(&reader->parent, &slot->stream);
+	if (reader->pos.offset != EOF
+			&& slot->packet_index != reader->pos.cur_index)
+		pipeline_read_packet_definitions(reader);
+	ret = ctf_read_event(&reader->pos.parent, &reader->parent);
+
+	slot->stream = reader->parent;
+	slot->packet_index = reader->pos.cur_index;
+	slot->ret = ret;
+	slot->mmap_offset = reader->pos.mmap_offset;
+	slot->packet_size = reader->pos.packet_size;
+	slot->content_size = reader->pos.content_size;
+	slot->offset = reader->pos.offset;
+	slot->last_offset = reader->pos.last_offset;
+	slot->data_offset = reader->pos.data_offset;
+	slot->cur_index = reader->pos.cur_index;
+	/*
+	 * Discarded events are reported along with the first event
+	 * following the packet switch only, or by the consumer when
+	 * it reaches the end of the stream.
+	 */
+	reader->parent.events_discarded = 0;
+}
+
+static
+void *pipeline_worker(void *arg)
+{
+	struct pipeline_group *group = arg;
+
+	pthread_mutex_lock(&group->lock);
+	for (;;) {
+		struct ctf_stream_pipeline *pipeline;
+		struct pipeline_slot *slot;
+
+		if (group->exit)
+			break;
+		pipeline = pipeline_group_next(group);
+		if (!pipeline) {
+			pthread_cond_wait(&group->cond, &group->lock);
+			continue;
+		}
+		slot = &pipeline->slots[pipeline->tail];
+		pipeline->busy = 1;
+		pthread_mutex_unlock(&group->lock);
+
+		pipeline_fill_slot(pipeline, slot);
+
+		pthread_mutex_lock(&group->lock);
+		slot->state = PIPELINE_SLOT_FILLED;
+		pipeline->tail = (pipeline->tail + 1) % pipeline->nr_slots;
+		/* EOF, EAGAIN and errors end the run. */
+		if (slot->ret)
+			pipeline->ended = 1;
+		pipeline->busy = 0;
+		pthread_cond_broadcast(&group->cond);
+	}
+	pthread_mutex_unlock(&group->lock);
+	return NULL;
+}
+
+/*
+ * Stop the worker threads and free the groups, once the last pipeline
+ * has left. Called with pipeline_pool_lock held.
+ */
+static
+void pipeline_pool_free(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < nr_pipeline_groups; i++) {
+		struct pipeline_group *group = &pipeline_groups[i];
+
+		if (group->running) {
+			pthread_mutex_lock(&group->lock);
+			group->exit = 1;
+			pthread_cond_broadcast(&group->cond);
+			pthread_mutex_unlock(&group->lock);
+			pthread_join(group->thread, NULL);
+		}
+		g_ptr_array_free(group->pipelines, TRUE);
+		pthread_cond_destroy(&group->cond);
+		pthread_mutex_destroy(&group->lock);
+	}
+	g_free(pipeline_groups);
+	pipeline_groups = NULL;
+	nr_pipeline_groups = 0;
+}
+
+/*
+ * Add a pipeline to the group serving the fewest pipelines, starting
+ * its worker thread if needed.
+ */
+static
+int pipeline_join_group(struct ctf_stream_pipeline *pipeline)
+{
+	struct pipeline_group *group;
+	unsigned int i;
+	int ret = 0;
+
+	pthread_mutex_lock(&pipeline_pool_lock);
+	if (!pipeline_groups) {
+		long nr_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+		nr_pipeline_groups = nr_cpus > 0 ? nr_cpus : 1;
+		pipeline_groups = g_new0(struct pipeline_group,
+				nr_pipeline_groups);
+		for (i = 0; i < nr_pipeline_groups; i++) {
+			pthread_mutex_init(&pipeline_groups[i].lock, NULL);
+			pthread_cond_init(&pipeline_groups[i].cond, NULL);
+			pipeline_groups[i].pipelines = g_ptr_array_new();
+		}
+	}
+	group = &pipeline_groups[0];
+	for (i = 1; i < nr_pipeline_groups; i++) {
+		if (pipeline_groups[i].pipelines->len < group->pipelines->len)
+			group = &pipeline_groups[i];
+	}
+	if (!group->running) {
+		ret = pthread_create(&group->thread, NULL, pipeline_worker,
+				group);
+		if (ret) {
+			ret = -ret;
+			goto end;
+		}
+		group->running = 1;
+	}
+	pipeline->group = group;
+	pthread_mutex_lock(&group->lock);
+	g_ptr_array_add(group->pipelines, pipeline);
+	pthread_mutex_unlock(&group->lock);
+	nr_pool_pipelines++;
+end:
+	if (!nr_pool_pipelines)
+		pipeline_pool_free();
+	pthread_mutex_unlock(&pipeline_pool_lock);
+	return ret;
+}
+
+/*
+ * Remove a stopped pipeline from its group.
+ */
+static
+void pipeline_leave_group(struct ctf_stream_pipeline *pipeline)
+{
+	struct pipeline_group *group = pipeline->group;
+
+	pthread_mutex_lock(&pipeline_pool_lock);
+	pthread_mutex_lock(&group->lock);
+	g_ptr_array_remove(group->pipelines, pipeline);
+	group->next = 0;
+	pthread_mutex_unlock(&group->lock);
+	if (!--nr_pool_pipelines)
+		pipeline_pool_free();
+	pthread_mutex_unlock(&pipeline_pool_lock);
+}
+
+static
+struct ctf_stream_pipeline *pipeline_create(struct ctf_file_stream *file_stream)
+{
+	struct ctf_stream_pipeline *pipeline;
+	struct ctf_file_stream *reader;
+	unsigned int i;
+	int ret;
+
+	pipeline = g_malloc0(sizeof(*pipeline)
+		+ opt_pipeline_depth * sizeof(struct pipeline_slot));
+	pipeline->nr_slots = opt_pipeline_depth;
+	/* The first slot uses the definitions of the file stream. */
+	pipeline->slots[0].stream = file_stream->parent;
+	for (i = 1; i < pipeline->nr_slots; i++) {
+		ret = create_slot_definitions(file_stream,
+				&pipeline->slots[i].stream);
+		if (ret)
+			goto error;
+	}
+
+	reader = &pipeline->reader;
+	reader->parent = file_stream->parent;
+	reader->pos.fd = file_stream->pos.fd;
+	reader->pos.packet_index = file_stream->pos.packet_index;
+	reader->pos.prot = PROT_READ;
+	reader->pos.flags = MAP_PRIVATE;
+	reader->pos.offset = EOF;
+	reader->pos.last_offset = LAST_OFFSET_POISON;
+	reader->pos.parent.rw_table = read_dispatch_table;
+	reader->pos.parent.event_cb = ctf_read_event;
+	reader->pos.parent.trace = file_stream->pos.parent.trace;
+	reader->pos.packet_seek = ctf_packet_seek;
+	reader->pipeline_reader = 1;
+
+	if (pipeline_join_group(pipeline)) {
+		i = pipeline->nr_slots;
+		goto error;
+	}
+	return pipeline;
+
+error:
+	while (--i > 0)
+		free_stream_definitions(&pipeline->slots[i].stream);
+	g_free(pipeline);
+	return NULL;
+}
+
+/*
+ * Start decoding from the current position of the file stream.
+ */
+static
+void pipeline_start(struct ctf_file_stream *file_stream)
+{
+	struct ctf_stream_pipeline *pipeline = file_stream->pipeline;
+	struct pipeline_group *group = pipeline->group;
+	struct ctf_file_stream *reader = &pipeline->reader;
+	unsigned int i;
+
+	/* Stopped: the worker leaves the pipeline alone. */
+	for (i = 0; i < pipeline->nr_slots; i++) {
+		pipeline->slots[i].state = PIPELINE_SLOT_FREE;
+		pipeline->slots[i].packet_index = -1;
+	}
+	pipeline->head = pipeline->tail = 0;
+	pipeline->current = -1;
+	pipeline->ended = 0;
+
+	/*
+	 * Map the current packet of the file stream, reading its
+	 * headers in the first slot, then restore the file stream state
+	 * which was altered by the packet switch.
+	 */
+	reader->parent = file_stream->parent;
+	stream_install_definitions(&reader->parent, &pipeline->slots[0].stream);
+	ctf_packet_seek(&reader->pos.parent, file_stream->pos.cur_index,
+			SEEK_SET);
+	reader->parent = file_stream->parent;
+	stream_install_definitions(&reader->parent, &pipeline->slots[0].stream);
+	pipeline->slots[0].packet_index = reader->pos.cur_index;
+	reader->pos.offset = file_stream->pos.offset;
+	reader->pos.last_offset = file_stream->pos.last_offset;
+
+	pthread_mutex_lock(&group->lock);
+	pipeline->running = 1;
+	pthread_cond_broadcast(&group->cond);
+	pthread_mutex_unlock(&group->lock);
+}
+
+/*
+ * Stop the decoding run of a pipeline, waiting for the worker to be
+ * done with the slot it may be filling.
+ */
+static
+void pipeline_stop(struct ctf_stream_pipeline *pipeline)
+{
+	struct pipeline_group *group = pipeline->group;
+
+	if (!pipeline->running)
+		return;
+	pthread_mutex_lock(&group->lock);
+	pipeline->running = 0;
+	while (pipeline->busy)
+		pthread_cond_wait(&group->cond, &group->lock);
+	pthread_mutex_unlock(&group->lock);
+}
+
+static
+void pipeline_destroy(struct ctf_file_stream *file_stream)
+{
+	struct ctf_stream_pipeline *pipeline = file_stream->pipeline;
+	unsigned int i;
+	int ret;
+
+	pipeline_stop(pipeline);
+	pipeline_leave_group(pipeline);
+	/*
+	 * Give the file stream its own definitions back: they are freed
+	 * along with the metadata.
+	 */
+	stream_install_definitions(&file_stream->parent,
+			&pipeline->slots[0].stream);
+	for (i = 1; i < pipeline->nr_slots; i++)
+		free_stream_definitions(&pipeline->slots[i].stream);
+	if (pipeline->reader.pos.base_mma) {
+		ret = munmap_align(pipeline->reader.pos.base_mma);
+		if (ret) {
+			fprintf(stderr, "[error] Unable to unmap old base: %s.\n",
+				strerror(errno));
+		}
+	}
+	g_free(pipeline);
+	file_stream->pipeline = NULL;
+}
+
+static
+int ctf_pipeline_read_event(struct bt_stream_pos *ppos,
+		struct ctf_stream_definition *stream)
+{
+	struct ctf_stream_pos *pos =
+		container_of(ppos, struct ctf_stream_pos, parent);
+	struct ctf_file_stream *file_stream =
+		container_of(pos, struct ctf_file_stream, pos);
+	struct ctf_stream_pipeline *pipeline = file_stream->pipeline;
+	struct pipeline_group *group;
+	struct pipeline_slot *slot;
+
+	if (unlikely(!pipeline)) {
+		pipeline = pipeline_create(file_stream);
+		if (!pipeline)
+			goto fallback;
+		file_stream->pipeline = pipeline;
+	}
+	if (unlikely(!pipeline->running)) {
+		if (pos->offset == EOF)
+			return EOF;
+		pipeline_start(file_stream);
+	}
+
+	group = pipeline->group;
+	pthread_mutex_lock(&group->lock);
+	if (pipeline->current >= 0) {
+		slot = &pipeline->slots[pipeline->current];
+		if (unlikely(slot->ret)) {
+			/* The worker has ended this run. */
+			pthread_mutex_unlock(&group->lock);
+			return slot->ret;
+		}
+		slot->state = PIPELINE_SLOT_FREE;
+		pthread_cond_broadcast(&group->cond);
+	}
+	slot = &pipeline->slots[pipeline->head];
+	while (slot->state != PIPELINE_SLOT_FILLED)
+		pthread_cond_wait(&group->cond, &group->lock);
+	slot->state = PIPELINE_SLOT_CURRENT;
+	pipeline->current = pipeline->head;
+	pipeline->head = (pipeline->head + 1) % pipeline->nr_slots;
+	pthread_mutex_unlock(&group->lock);
+
+	*stream = slot->stream;
+	pos->mmap_offset = slot->mmap_offset;
+	pos->packet_size = slot->packet_size;
+	pos->content_size = slot->content_size;
+	pos->offset = slot->offset;
+	pos->last_offset = slot->last_offset;
+	pos->data_offset = slot->data_offset;
+	pos->cur_index = slot->cur_index;
+	if (slot->ret == EOF)
+		ctf_print_end_of_stream_discarded(stream);
+	return slot->ret;
+
+fallback:
+	fprintf(stderr, "[warning] Unable to start decoding pipeline of stream \"%s\", decoding inline.\n",
+		file_stream->parent.path);
+	pos->parent.event_cb = ctf_read_event;
+	pos->packet_seek = ctf_packet_seek;
+	return ctf_read_event(ppos, stream);
+}
+
+/*
+ * Packet switches requested by the iterator (seeks) stop the worker and
+ * are applied to the file stream position. The next read restarts the
+ * worker from there.
+ */
+static
+void ctf_pipeline_packet_seek(struct bt_stream_pos *stream_pos, size_t index,
+		int whence)
+{
+	struct ctf_stream_pos *pos =
+		container_of(stream_pos, struct ctf_stream_pos, parent);
+	struct ctf_file_stream *file_stream =
+		container_of(pos, struct ctf_file_stream, pos);
+
+	if (file_stream->pipeline)
+		pipeline_stop(file_stream->pipeline);
+	ctf_packet_seek(stream_pos, index, whence);
+}
+
+/*
+ * Set the events read from a file stream. Its decoding worker, which may
+ * be reading ahead with the previous filter, is stopped: it restarts
+ * with the new one at the next read.
+ */
+void ctf_file_stream_set_filter(struct ctf_file_stream *file_stream,
+		struct ctf_stream_filter *filter)
+{
+	if (file_stream->pipeline)
+		pipeline_stop(file_stream->pipeline);
+	file_stream->parent.filter = filter;
+}
+
+/*
+ * Note: many file streams can inherit from the same stream class
+ * description (metadata).
+ */
+static
+int ctf_open_file_stream_read(struct ctf_trace *td, const char *path, int flags,
+		void (*packet_seek)(struct bt_stream_pos *pos, size_t index,
+			int whence),
+		struct ctf_file_stream **file_stream_ret)
+{
+	int ret, fd, closeret;
+	struct ctf_file_stream *file_stream;
+	struct stat statbuf;
+	char *index_name;
+	int index_imported = 0;
+
+	*file_stream_ret = NULL;
 	fd = openat(td->dirfd, path, flags);
 	if (fd < 0) {
 		perror("File stream openat()");
@@ -1965,13 +3281,7 @@ int ctf_open_file_stream_read(struct ctf_trace *td, const char *path, int flags,
 	snprintf(index_name, strlen(path) + sizeof(INDEX_PATH),
 			INDEX_PATH, path);
 
-	if (faccessat(td->dirfd, index_name, O_RDONLY, flags) < 0) {
-		ret = create_stream_packet_index(td, file_stream);
-		if (ret) {
-			fprintf(stderr, "[error] Stream index creation error.\n");
-			goto error_index;
-		}
-	} else {
+	if (!faccessat(td->dirfd, index_name, O_RDONLY, flags)) {
 		ret = openat(td->dirfd, index_name, flags);
 		if (ret < 0) {
 			perror("Index file openat()");
@@ -1983,22 +3293,42 @@ int ctf_open_file_stream_read(struct ctf_trace *td, const char *path, int flags,
 			perror("fdopen() error");
 			goto error_free;
 		}
-		ret = import_stream_packet_index(td, file_stream);
-		if (ret) {
-			ret = -1;
-			goto error_index;
+		if (!stream_packet_index_is_stale(file_stream)) {
+			ret = import_stream_packet_index(td, file_stream);
+			if (ret) {
+				ret = -1;
+				goto error_index;
+			}
+			index_imported = 1;
+		} else {
+			printf_verbose("Index file \"%s\" is out of date, rebuilding index.\n",
+				index_name);
 		}
 		ret = fclose(file_stream->pos.index_fp);
+		file_stream->pos.index_fp = NULL;
 		if (ret < 0) {
 			perror("close index");
 			goto error_free;
 		}
 	}
+	if (!index_imported) {
+		ret = create_stream_packet_index(td, file_stream);
+		if (ret) {
+			fprintf(stderr, "[error] Stream index creation error.\n");
+			goto error_index;
+		}
+		if (opt_write_index_cache)
+			write_stream_packet_index(td, file_stream, index_name);
+	}
 	free(index_name);
 
-	/* Add stream file to stream class */
-	g_ptr_array_add(file_stream->parent.stream_class->streams,
-			&file_stream->parent);
+	if (opt_pipeline_depth > 1 && packet_seek == ctf_packet_seek) {
+		file_stream->pos.parent.event_cb = ctf_pipeline_read_event;
+		file_stream->pos.packet_seek = ctf_pipeline_packet_seek;
+	}
+
+	/* Added to its stream class by the caller. */
+	*file_stream_ret = file_stream;
 	return 0;
 
 error_index:
@@ -2028,6 +3358,120 @@ error:
 	return ret;
 }
 
+struct file_streams_open_work {
+	struct ctf_trace *td;
+	int flags;
+	void (*packet_seek)(struct bt_stream_pos *pos, size_t index,
+		int whence);
+	GPtrArray *paths;	/* Stream file names */
+	struct ctf_file_stream **file_streams;	/* Opened streams, by path index */
+	pthread_mutex_t lock;	/* Protects next and ret */
+	unsigned int next;	/* Next path to open */
+	int ret;		/* First error encountered */
+};
+
+static
+void *file_streams_open_worker(void *arg)
+{
+	struct file_streams_open_work *work = arg;
+
+	for (;;) {
+		unsigned int i;
+		int ret;
+
+		pthread_mutex_lock(&work->lock);
+		if (work->ret || work->next >= work->paths->len) {
+			pthread_mutex_unlock(&work->lock);
+			break;
+		}
+		i = work->next++;
+		pthread_mutex_unlock(&work->lock);
+
+		ret = ctf_open_file_stream_read(work->td,
+				g_ptr_array_index(work->paths, i),
+				work->flags, work->packet_seek,
+				&work->file_streams[i]);
+		if (ret) {
+			pthread_mutex_lock(&work->lock);
+			if (!work->ret)
+				work->ret = ret;
+			pthread_mutex_unlock(&work->lock);
+		}
+	}
+	return NULL;
+}
+
+/*
+ * Open and index stream files with a pool of opt_index_threads worker
+ * threads. Indexing a stream file maps and parses each of its packet
+ * headers, which dominates the trace open time when there is no index
+ * on disk. Stream files are then added to their stream class in
+ * directory order, so the resulting trace does not depend on thread
+ * scheduling.
+ */
+static
+int ctf_open_file_streams_read(struct ctf_trace *td, GPtrArray *paths,
+		int flags,
+		void (*packet_seek)(struct bt_stream_pos *pos, size_t index,
+			int whence))
+{
+	struct file_streams_open_work work;
+	pthread_t *threads;
+	long nr_threads = opt_index_threads, nr_started = 0;
+	unsigned int i;
+	int ret;
+
+	memset(&work, 0, sizeof(work));
+	work.td = td;
+	work.flags = flags;
+	work.packet_seek = packet_seek;
+	work.paths = paths;
+	work.file_streams = g_new0(struct ctf_file_stream *, paths->len);
+	pthread_mutex_init(&work.lock, NULL);
+
+	if (nr_threads <= 0) {
+		nr_threads = sysconf(_SC_NPROCESSORS_ONLN);
+		if (nr_threads <= 0)
+			nr_threads = 1;
+	}
+	if (nr_threads > paths->len)
+		nr_threads = paths->len;
+
+	if (nr_threads > 1) {
+		threads = g_new0(pthread_t, nr_threads);
+		for (i = 0; i < nr_threads; i++) {
+			ret = pthread_create(&threads[i], NULL,
+					file_streams_open_worker, &work);
+			if (ret) {
+				fprintf(stderr, "[warning] Unable to create indexing thread: %s\n",
+					strerror(ret));
+				break;
+			}
+			nr_started++;
+		}
+		for (i = 0; i < nr_started; i++)
+			pthread_join(threads[i], NULL);
+		g_free(threads);
+	}
+	/* Single thread, or completes the work if threads failed to start. */
+	if (!nr_started)
+		file_streams_open_worker(&work);
+
+	/* Add stream files to their stream class */
+	for (i = 0; i < paths->len; i++) {
+		struct ctf_file_stream *file_stream = work.file_streams[i];
+
+		if (!file_stream)
+			continue;
+		g_ptr_array_add(file_stream->parent.stream_class->streams,
+				&file_stream->parent);
+	}
+	ret = work.ret;
+	pthread_mutex_destroy(&work.lock);
+	g_free(work.file_streams);
+	return ret;
+}
+
 static
 int ctf_open_trace_read(struct ctf_trace *td,
 		const char *path, int flags,
@@ -2038,6 +3482,7 @@ int ctf_open_trace_read(struct ctf_trace *td,
 	struct dirent *dirent;
 	struct dirent *diriter;
 	size_t dirent_len;
+	GPtrArray *paths;
 	char *ext;
 
 	td->flags = flags;
@@ -2080,6 +3525,7 @@ int ctf_open_trace_read(struct ctf_trace *td,
 			fpathconf(td->dirfd, _PC_NAME_MAX) + 1;
 
 	dirent = malloc(dirent_len);
+	paths = g_ptr_array_new_with_free_func(g_free);
 
 	for (;;) {
 		ret = readdir_r(td->dir, dirent, &diriter);
@@ -2101,18 +3547,21 @@ int ctf_open_trace_read(struct ctf_trace *td,
 			continue;
 		}
 
-		ret = ctf_open_file_stream_read(td, diriter->d_name,
-					flags, packet_seek);
-		if (ret) {
-			fprintf(stderr, "[error] Open file stream error.\n");
-			goto readdir_error;
-		}
+		g_ptr_array_add(paths, g_strdup(diriter->d_name));
+	}
+
+	ret = ctf_open_file_streams_read(td, paths, flags, packet_seek);
+	if (ret) {
+		fprintf(stderr, "[error] Open file stream error.\n");
+		goto readdir_error;
 	}
 
+	g_ptr_array_free(paths, TRUE);
 	free(dirent);
 	return 0;
 
 readdir_error:
+	g_ptr_array_free(paths, TRUE);
 	free(dirent);
 error_metadata:
 	closeret = close(td->dirfd);
@@ -2380,6 +3829,8 @@ int ctf_close_file_stream(struct ctf_file_stream *file_stream)
 {
 	int ret;
 
+	if (file_stream->pipeline)
+		pipeline_destroy(file_stream);
 	ret = ctf_fini_pos(&file_stream->pos);
 	if (ret) {
 		fprintf(stderr, "Error on ctf_fini_pos\n");
@@ -96,16 +96,18 @@ error:
 	return NULL;
 }
 
-const struct bt_definition *bt_ctf_get_field(const struct bt_ctf_event *ctf_event,
-		const struct bt_definition *scope,
+/*
+ * Lookup a field directly within scope, falling back on its underscore
+ * prefixed name. Returns the definition as found in the scope, before
+ * variant selection.
+ */
+static
+const struct bt_definition *lookup_scope_field(const struct bt_definition *scope,
 		const char *field)
 {
 	const struct bt_definition *def;
 	char *field_underscore;
 
-	if (!ctf_event || !scope || !field)
-		return NULL;
-
 	def = bt_lookup_definition(scope, field);
 	/*
 	 * optionally a field can have an underscore prefix, try
@@ -118,6 +120,12 @@ const struct bt_definition *bt_ctf_get_field(const struct bt_ctf_event *ctf_even
 		def = bt_lookup_definition(scope, field_underscore);
 		g_free(field_underscore);
 	}
+	return def;
+}
+
+static
+const struct bt_definition *select_variant_field(const struct bt_definition *def)
+{
 	if (bt_ctf_field_type(bt_ctf_get_decl_from_def(def)) == CTF_TYPE_VARIANT) {
 		const struct definition_variant *variant_definition;
 		variant_definition = container_of(def,
@@ -127,6 +135,85 @@ const struct bt_definition *bt_ctf_get_field(const struct bt_ctf_event *ctf_even
 	return def;
 }
 
+const struct bt_definition *bt_ctf_get_field(const struct bt_ctf_event *ctf_event,
+		const struct bt_definition *scope,
+		const char *field)
+{
+	if (!ctf_event || !scope || !field)
+		return NULL;
+
+	return select_variant_field(lookup_scope_field(scope, field));
+}
+
+/*
+ * A field handle records the position of a field within the structure
+ * declaration of a top-level scope. All events sharing that declaration
+ * (the events of an event class, or the events of a stream class for
+ * the stream scopes) lay out the field at the same position.
+ */
+struct bt_ctf_field_handle {
+	enum bt_ctf_scope scope;
+	struct declaration_struct *declaration;
+	unsigned long index;
+};
+
+struct bt_ctf_field_handle *bt_ctf_field_handle_create(
+		const struct bt_ctf_event *ctf_event,
+		enum bt_ctf_scope scope,
+		const char *field)
+{
+	const struct bt_definition *scope_def, *def;
+	const struct definition_struct *struct_def;
+	struct bt_ctf_field_handle *handle;
+
+	if (!ctf_event || !field)
+		return NULL;
+
+	scope_def = bt_ctf_get_top_level_scope(ctf_event, scope);
+	if (!scope_def)
+		return NULL;
+	def = lookup_scope_field(scope_def, field);
+	if (!def)
+		return NULL;
+	struct_def = container_of(scope_def, const struct definition_struct, p);
+
+	handle = g_new(struct bt_ctf_field_handle, 1);
+	handle->scope = scope;
+	handle->declaration = struct_def->declaration;
+	bt_declaration_ref(&handle->declaration->p);
+	handle->index = def->index;
+	return handle;
+}
+
+void bt_ctf_field_handle_destroy(struct bt_ctf_field_handle *handle)
+{
+	if (!handle)
+		return;
+	bt_declaration_unref(&handle->declaration->p);
+	g_free(handle);
+}
+
+const struct bt_definition *bt_ctf_get_field_from_handle(
+		const struct bt_ctf_event *ctf_event,
+		const struct bt_ctf_field_handle *handle)
+{
+	const struct bt_definition *scope_def;
+	const struct definition_struct *struct_def;
+
+	if (!ctf_event || !handle)
+		return NULL;
+
+	scope_def = bt_ctf_get_top_level_scope(ctf_event, handle->scope);
+	if (!scope_def)
+		return NULL;
+	struct_def = container_of(scope_def, const struct definition_struct, p);
+	/* The handle was resolved against another layout. */
+	if (struct_def->declaration != handle->declaration)
+		return NULL;
+	return select_variant_field(g_ptr_array_index(struct_def->fields,
+				handle->index));
+}
+
 const struct bt_definition *bt_ctf_get_index(const struct bt_ctf_event *ctf_event,
 		const struct bt_definition *field,
 		unsigned int index)
@@ -253,6 +340,9 @@ int bt_ctf_get_field_list(const struct bt_ctf_event *ctf_event,
 		def_sequence = container_of(scope, const struct definition_sequence, p);
 		if (!def_sequence)
 			goto error;
+		/* Create the element definitions of bulk-decoded sequences. */
+		if (bt_sequence_load_elems((struct definition_sequence *) def_sequence))
+			goto error;
 		if (def_sequence->elems->pdata) {
 			*list = (struct bt_definition const* const*) def_sequence->elems->pdata;
 			*count = def_sequence->elems->len;
@@ -30,6 +30,7 @@
 #include <babeltrace/babeltrace.h>
 #include <babeltrace/format.h>
 #include <babeltrace/ctf/events.h>
+#include <babeltrace/ctf/iterator.h>
 #include <babeltrace/ctf-ir/metadata.h>
 #include <babeltrace/prio_heap.h>
 #include <babeltrace/iterator-internal.h>
@@ -39,19 +40,217 @@
 
 #include "events-private.h"
 
-struct bt_ctf_iter *bt_ctf_iter_create(struct bt_context *ctx,
+/*
+ * Events to read, as specified by the user. It is resolved into a
+ * struct ctf_stream_filter for each stream when creating the iterator.
+ */
+struct bt_ctf_iter_filter {
+	GArray *event_names;	/* Array of GQuark, empty for all events */
+	GArray *stream_ids;	/* Array of uint64_t, empty for all streams */
+	uint64_t begin, end;	/* Real timestamp range, in ns, inclusive */
+};
+
+struct bt_ctf_iter_filter *bt_ctf_iter_filter_create(void)
+{
+	struct bt_ctf_iter_filter *filter;
+
+	filter = g_new0(struct bt_ctf_iter_filter, 1);
+	filter->event_names = g_array_new(FALSE, FALSE, sizeof(GQuark));
+	filter->stream_ids = g_array_new(FALSE, FALSE, sizeof(uint64_t));
+	filter->begin = 0;
+	filter->end = UINT64_MAX;
+	return filter;
+}
+
+void bt_ctf_iter_filter_destroy(struct bt_ctf_iter_filter *filter)
+{
+	if (!filter)
+		return;
+	g_array_free(filter->event_names, TRUE);
+	g_array_free(filter->stream_ids, TRUE);
+	g_free(filter);
+}
+
+int bt_ctf_iter_filter_add_event_name(struct bt_ctf_iter_filter *filter,
+		const char *name)
+{
+	GQuark q;
+
+	if (!filter || !name)
+		return -EINVAL;
+	q = g_quark_from_string(name);
+	g_array_append_val(filter->event_names, q);
+	return 0;
+}
+
+int bt_ctf_iter_filter_add_stream_id(struct bt_ctf_iter_filter *filter,
+		uint64_t stream_id)
+{
+	if (!filter)
+		return -EINVAL;
+	g_array_append_val(filter->stream_ids, stream_id);
+	return 0;
+}
+
+int bt_ctf_iter_filter_set_time_range(struct bt_ctf_iter_filter *filter,
+		uint64_t begin, uint64_t end)
+{
+	if (!filter || begin > end)
+		return -EINVAL;
+	filter->begin = begin;
+	filter->end = end;
+	return 0;
+}
+
+static
+int filter_has_stream_id(const struct bt_ctf_iter_filter *filter,
+		uint64_t stream_id)
+{
+	unsigned int i;
+
+	if (!filter->stream_ids->len)
+		return 1;
+	for (i = 0; i < filter->stream_ids->len; i++) {
+		if (g_array_index(filter->stream_ids, uint64_t, i) == stream_id)
+			return 1;
+	}
+	return 0;
+}
+
+static
+int filter_has_event_name(const struct bt_ctf_iter_filter *filter,
+		GQuark name)
+{
+	unsigned int i;
+
+	for (i = 0; i < filter->event_names->len; i++) {
+		if (g_array_index(filter->event_names, GQuark, i) == name)
+			return 1;
+	}
+	return 0;
+}
+
+/*
+ * Resolve the filter for the events of a stream class: the event names
+ * are turned into a table indexed by event ID.
+ */
+static
+struct ctf_stream_filter *create_stream_filter(
+		const struct bt_ctf_iter_filter *filter,
+		struct ctf_stream_declaration *stream_class)
+{
+	struct ctf_stream_filter *stream_filter;
+	unsigned int i;
+
+	stream_filter = g_new0(struct ctf_stream_filter, 1);
+	stream_filter->skip_stream =
+		!filter_has_stream_id(filter, stream_class->stream_id);
+	stream_filter->begin = filter->begin;
+	stream_filter->end = filter->end;
+	if (!filter->event_names->len)
+		return stream_filter;
+
+	stream_filter->event_ids = g_byte_array_sized_new(
+			stream_class->events_by_id->len);
+	g_byte_array_set_size(stream_filter->event_ids,
+			stream_class->events_by_id->len);
+	for (i = 0; i < stream_class->events_by_id->len; i++) {
+		struct ctf_event_declaration *event_class =
+			g_ptr_array_index(stream_class->events_by_id, i);
+
+		stream_filter->event_ids->data[i] = event_class &&
+			filter_has_event_name(filter, event_class->name);
+	}
+	return stream_filter;
+}
+
+static
+void destroy_stream_filter(struct ctf_stream_filter *stream_filter)
+{
+	if (stream_filter->event_ids)
+		g_byte_array_free(stream_filter->event_ids, TRUE);
+	g_free(stream_filter);
+}
+
+/*
+ * Install the filter on each stream of the context, before the
+ * iterator initialization reads their first event.
+ */
+static
+void install_stream_filters(struct bt_ctf_iter *iter, struct bt_context *ctx,
+		const struct bt_ctf_iter_filter *filter)
+{
+	int i, j, k;
+
+	iter->filtered_streams = g_ptr_array_new();
+	for (i = 0; i < ctx->tc->array->len; i++) {
+		struct bt_trace_descriptor *td_read;
+		struct ctf_trace *tin;
+
+		td_read = g_ptr_array_index(ctx->tc->array, i);
+		if (!td_read)
+			continue;
+		tin = container_of(td_read, struct ctf_trace, parent);
+		for (j = 0; j < tin->streams->len; j++) {
+			struct ctf_stream_declaration *stream_class;
+
+			stream_class = g_ptr_array_index(tin->streams, j);
+			if (!stream_class)
+				continue;
+			for (k = 0; k < stream_class->streams->len; k++) {
+				struct ctf_file_stream *file_stream;
+
+				file_stream = g_ptr_array_index(stream_class->streams, k);
+				if (!file_stream)
+					continue;
+				ctf_file_stream_set_filter(file_stream,
+					create_stream_filter(filter, stream_class));
+				g_ptr_array_add(iter->filtered_streams, file_stream);
+			}
+		}
+	}
+}
+
+static
+void remove_stream_filters(struct bt_ctf_iter *iter)
+{
+	unsigned int i;
+
+	if (!iter->filtered_streams)
+		return;
+	for (i = 0; i < iter->filtered_streams->len; i++) {
+		struct ctf_file_stream *file_stream =
+			g_ptr_array_index(iter->filtered_streams, i);
+		struct ctf_stream_filter *stream_filter =
+			file_stream->parent.filter;
+
+		ctf_file_stream_set_filter(file_stream, NULL);
+		destroy_stream_filter(stream_filter);
+	}
+	g_ptr_array_free(iter->filtered_streams, TRUE);
+	iter->filtered_streams = NULL;
+}
+
+struct bt_ctf_iter *bt_ctf_iter_create_filtered(struct bt_context *ctx,
 		const struct bt_iter_pos *begin_pos,
-		const struct bt_iter_pos *end_pos)
+		const struct bt_iter_pos *end_pos,
+		const struct bt_ctf_iter_filter *filter)
 {
 	struct bt_ctf_iter *iter;
 	int ret;
 
 	if (!ctx)
 		return NULL;
+	/* Do not touch the streams of the context's current iterator. */
+	if (filter && ctx->current_iterator)
+		return NULL;
 
 	iter = g_new0(struct bt_ctf_iter, 1);
+	if (filter)
+		install_stream_filters(iter, ctx, filter);
 	ret = bt_iter_init(&iter->parent, ctx, begin_pos, end_pos);
 	if (ret) {
+		remove_stream_filters(iter);
 		g_free(iter);
 		return NULL;
 	}
@@ -63,6 +262,13 @@ struct bt_ctf_iter *bt_ctf_iter_create(struct bt_context *ctx,
 	return iter;
 }
 
+struct bt_ctf_iter *bt_ctf_iter_create(struct bt_context *ctx,
+		const struct bt_iter_pos *begin_pos,
+		const struct bt_iter_pos *end_pos)
+{
+	return bt_ctf_iter_create_filtered(ctx, begin_pos, end_pos, NULL);
+}
+
 void bt_ctf_iter_destroy(struct bt_ctf_iter *iter)
 {
 	struct bt_stream_callbacks *bt_stream_cb;
@@ -92,6 +298,7 @@ void bt_ctf_iter_destroy(struct bt_ctf_iter *iter)
 	}
 	g_array_free(iter->callbacks, TRUE);
 	g_ptr_array_free(iter->dep_gc, TRUE);
+	remove_stream_filters(iter);
 
 	bt_iter_fini(&iter->parent);
 	g_free(iter);
@@ -184,6 +391,79 @@ struct bt_ctf_event *bt_ctf_iter_read_event(struct bt_ctf_iter *iter)
 	return bt_ctf_iter_read_event_flags(iter, NULL);
 }
 
+int bt_ctf_iter_read_events(struct bt_ctf_iter *iter,
+		struct bt_ctf_event_batch *batch, unsigned int n)
+{
+	struct ctf_file_stream *file_stream;
+	struct ctf_stream_definition *stream;
+	struct packet_index *packet_index;
+	unsigned int i;
+	int ret;
+
+	if (!iter || !batch)
+		return -EINVAL;
+
+	iter->events_lost = 0;
+	for (i = 0; i < n; i++) {
+		file_stream = bt_heap_maximum(iter->parent.stream_heap);
+		if (!file_stream) {
+			/* end of file for all streams */
+			break;
+		}
+		if (file_stream->pos.data_offset == file_stream->pos.content_size
+				|| file_stream->pos.content_size == 0) {
+			/* Let the caller move to the next packet first. */
+			if (!i)
+				return -EAGAIN;
+			break;
+		}
+		stream = &file_stream->parent;
+		if (iter->parent.end_pos &&
+			iter->parent.end_pos->type == BT_SEEK_TIME &&
+			stream->real_timestamp > iter->parent.end_pos->u.seek_time)
+			break;
+
+		if (file_stream->pos.packet_index) {
+			packet_index = &g_array_index(file_stream->pos.packet_index,
+					struct packet_index, file_stream->pos.cur_index);
+			if (packet_index->events_discarded >
+					file_stream->pos.last_events_discarded) {
+				iter->events_lost += packet_index->events_discarded -
+					file_stream->pos.last_events_discarded;
+				file_stream->pos.last_events_discarded =
+					packet_index->events_discarded;
+			}
+		}
+
+		if (batch->timestamp)
+			batch->timestamp[i] = stream->has_timestamp ?
+				stream->real_timestamp : -1ULL;
+		if (batch->cycles)
+			batch->cycles[i] = stream->has_timestamp ?
+				stream->cycles_timestamp : -1ULL;
+		if (batch->event_id)
+			batch->event_id[i] = stream->event_id;
+		if (batch->stream_id)
+			batch->stream_id[i] = stream->stream_id;
+		if (batch->stream)
+			batch->stream[i] = stream;
+		if (batch->handle_id) {
+			struct ctf_trace *trace = stream->stream_class->trace;
+
+			batch->handle_id[i] = trace->parent.handle ?
+				trace->parent.handle->id : -1;
+		}
+
+		if (stream->stream_id <= iter->callbacks->len)
+			process_callbacks(iter, stream);
+
+		ret = bt_iter_next(&iter->parent);
+		if (ret < 0)
+			return ret;
+	}
+	return i;
+}
+
 uint64_t bt_ctf_get_lost_events_count(struct bt_ctf_iter *iter)
 {
 	if (!iter)
@@ -1152,6 +1152,7 @@ struct bt_declaration *ctf_declaration_enum_visit(FILE *fd, int depth,
 			if (ret)
 				goto error;
 		}
+		bt_enum_declaration_freeze(enum_declaration);
 		if (name) {
 			int ret;
 
@@ -3074,6 +3075,8 @@ int ctf_destroy_metadata(struct ctf_trace *trace)
 						bt_definition_unref(&event->event_fields->p);
 					if (&event->event_context->p)
 						bt_definition_unref(&event->event_context->p);
+					ctf_decoder_destroy(event->event_fields_decoder);
+					ctf_decoder_destroy(event->event_context_decoder);
 					g_free(event);
 				}
 				if (&stream_def->trace_packet_header->p)
@@ -3084,6 +3087,10 @@ int ctf_destroy_metadata(struct ctf_trace *trace)
 					bt_definition_unref(&stream_def->stream_packet_context->p);
 				if (&stream_def->stream_event_context->p)
 					bt_definition_unref(&stream_def->stream_event_context->p);
+				ctf_decoder_destroy(stream_def->stream_event_context_decoder);
+				ctf_decoder_destroy(stream_def->stream_event_header_decoder);
+				if (stream_def->event_header_variant_fields)
+					g_array_free(stream_def->event_header_variant_fields, TRUE);
 				g_ptr_array_free(stream_def->events_by_id, TRUE);
 				g_free(stream_def);
 			}
@@ -0,0 +1,553 @@
+/*
+ * Common Trace Format
+ *
+ * Compiled decoders for fixed-layout structures.
+ *
+ * Copyright 2010-2011 EfficiOS Inc. and Linux Foundation
+ *
+ * Author: Mathieu Desnoyers <mathieu.desnoyers@efficios.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <babeltrace/ctf/types.h>
+#include <babeltrace/bitfield.h>
+#include <babeltrace/endian.h>
+#include <stdint.h>
+#include <string.h>
+#include <float.h>
+#include <glib.h>
+
+/*
+ * A decoder is a flat program of field reads compiled from a structure
+ * definition whose layout does not depend on the data: integers,
+ * enumerations, floats, and nested structures and arrays thereof. All
+ * field offsets are therefore known relative to the start of the
+ * structure, which lets the decoder perform a single alignment and
+ * bounds check per structure instead of walking the type tree through
+ * generic_rw() for each field.
+ *
+ * Structures holding strings, sequences or variants are not compiled,
+ * and keep using generic_rw().
+ */
+
+enum ctf_decode_op_type {
+	CTF_DECODE_INTEGER,
+	CTF_DECODE_ENUM,
+	CTF_DECODE_FLOAT,
+	CTF_DECODE_TEXT,	/* String view of an 8-bit encoded array */
+};
+
+struct ctf_decode_op {
+	enum ctf_decode_op_type type;
+	uint64_t offset;	/* offset from start of structure, in bits */
+	unsigned int len;	/* field length, in bits */
+	int byte_order;
+	int signedness;
+	int aligned;		/* byte-aligned 8/16/32/64-bit access */
+	struct bt_definition *definition;	/* destination */
+};
+
+struct ctf_decoder {
+	uint64_t alignment;	/* structure alignment, in bits */
+	uint64_t len;		/* structure length, in bits */
+	size_t nr_ops;
+	struct ctf_decode_op ops[];
+};
+
+static
+int compile_field(GArray *ops, uint64_t *offset,
+		struct bt_definition *definition);
+
+static
+void push_op(GArray *ops, enum ctf_decode_op_type type, uint64_t offset,
+		unsigned int len, int byte_order, int signedness,
+		struct bt_definition *definition)
+{
+	struct ctf_decode_op op;
+
+	memset(&op, 0, sizeof(op));
+	op.type = type;
+	op.offset = offset;
+	op.len = len;
+	op.byte_order = byte_order;
+	op.signedness = signedness;
+	op.definition = definition;
+	g_array_append_val(ops, op);
+}
+
+static
+int compile_integer(GArray *ops, uint64_t *offset,
+		enum ctf_decode_op_type type,
+		struct definition_integer *integer_definition,
+		struct bt_definition *definition)
+{
+	const struct declaration_integer *integer_declaration =
+		integer_definition->declaration;
+
+	if (!integer_declaration->len || integer_declaration->len > 64)
+		return -EINVAL;
+	*offset += offset_align(*offset, integer_declaration->p.alignment);
+	push_op(ops, type, *offset, integer_declaration->len,
+		integer_declaration->byte_order,
+		integer_declaration->signedness, definition);
+	*offset += integer_declaration->len;
+	return 0;
+}
+
+static
+int compile_float(GArray *ops, uint64_t *offset,
+		struct definition_float *float_definition)
+{
+	const struct declaration_float *float_declaration =
+		float_definition->declaration;
+	unsigned int len;
+
+	/* Only IEEE 754 binary32 and binary64 are supported. */
+	if (float_declaration->sign->len != 1)
+		return -EINVAL;
+	switch (float_declaration->mantissa->len + 1) {
+	case FLT_MANT_DIG:
+		if (float_declaration->exp->len != sizeof(float) * CHAR_BIT
+				- FLT_MANT_DIG)
+			return -EINVAL;
+		len = sizeof(float) * CHAR_BIT;
+		break;
+	case DBL_MANT_DIG:
+		if (float_declaration->exp->len != sizeof(double) * CHAR_BIT
+				- DBL_MANT_DIG)
+			return -EINVAL;
+		len = sizeof(double) * CHAR_BIT;
+		break;
+	default:
+		return -EINVAL;
+	}
+	*offset += offset_align(*offset, float_declaration->p.alignment);
+	push_op(ops, CTF_DECODE_FLOAT, *offset, len,
+		float_declaration->byte_order, 0, &float_definition->p);
+	*offset += len;
+	return 0;
+}
+
+static
+int compile_struct(GArray *ops, uint64_t *offset,
+		struct definition_struct *struct_definition)
+{
+	unsigned long i;
+	int ret;
+
+	*offset += offset_align(*offset,
+			struct_definition->declaration->p.alignment);
+	for (i = 0; i < struct_definition->fields->len; i++) {
+		struct bt_definition *field =
+			g_ptr_array_index(struct_definition->fields, i);
+
+		ret = compile_field(ops, offset, field);
+		if (ret)
+			return ret;
+	}
+	return 0;
+}
+
+static
+int compile_array(GArray *ops, uint64_t *offset,
+		struct definition_array *array_definition)
+{
+	const struct declaration_array *array_declaration =
+		array_definition->declaration;
+	struct bt_declaration *elem = array_declaration->elem;
+	uint64_t i;
+	int ret;
+
+	*offset += offset_align(*offset, array_declaration->p.alignment);
+	if (array_definition->string) {
+		struct declaration_integer *integer_declaration =
+			container_of(elem, struct declaration_integer, p);
+
+		/* Same condition as ctf_array_read(). */
+		if (integer_declaration->len == CHAR_BIT
+		    && integer_declaration->p.alignment == CHAR_BIT) {
+			push_op(ops, CTF_DECODE_TEXT, *offset,
+				array_declaration->len * CHAR_BIT,
+				0, 0, &array_definition->p);
+		}
+	}
+	for (i = 0; i < array_declaration->len; i++) {
+		struct bt_definition *field =
+			g_ptr_array_index(array_definition->elems, i);
+
+		ret = compile_field(ops, offset, field);
+		if (ret)
+			return ret;
+	}
+	return 0;
+}
+
+static
+int compile_field(GArray *ops, uint64_t *offset,
+		struct bt_definition *definition)
+{
+	switch (definition->declaration->id) {
+	case CTF_TYPE_INTEGER:
+		return compile_integer(ops, offset, CTF_DECODE_INTEGER,
+			container_of(definition, struct definition_integer, p),
+			definition);
+	case CTF_TYPE_ENUM:
+	{
+		struct definition_enum *enum_definition =
+			container_of(definition, struct definition_enum, p);
+
+		return compile_integer(ops, offset, CTF_DECODE_ENUM,
+			enum_definition->integer, definition);
+	}
+	case CTF_TYPE_FLOAT:
+		return compile_float(ops, offset,
+			container_of(definition, struct definition_float, p));
+	case CTF_TYPE_STRUCT:
+		return compile_struct(ops, offset,
+			container_of(definition, struct definition_struct, p));
+	case CTF_TYPE_ARRAY:
+		return compile_array(ops, offset,
+			container_of(definition, struct definition_array, p));
+	default:
+		/* Data-dependent layout. */
+		return -EINVAL;
+	}
+}
+
+/*
+ * ctf_decoder_create - compile a decoder for a structure definition.
+ *
+ * Returns NULL if the structure layout depends on its content, in which
+ * case the caller should use generic_rw().
+ */
+struct ctf_decoder *ctf_decoder_create(struct definition_struct *definition)
+{
+	struct ctf_decoder *decoder;
+	GArray *ops;
+	uint64_t offset = 0;
+	size_t i;
+	int ret;
+
+	ops = g_array_new(FALSE, TRUE, sizeof(struct ctf_decode_op));
+	ret = compile_struct(ops, &offset, definition);
+	if (ret) {
+		g_array_free(ops, TRUE);
+		return NULL;
+	}
+	decoder = g_malloc0(sizeof(*decoder)
+			+ ops->len * sizeof(struct ctf_decode_op));
+	decoder->alignment = definition->declaration->p.alignment;
+	decoder->len = offset;
+	decoder->nr_ops = ops->len;
+	memcpy(decoder->ops, ops->data, ops->len * sizeof(struct ctf_decode_op));
+	g_array_free(ops, TRUE);
+
+	/*
+	 * The structure start is aligned on its own alignment, so a field
+	 * at a byte-aligned relative offset is byte-aligned in the stream
+	 * only if the structure itself is.
+	 */
+	for (i = 0; i < decoder->nr_ops; i++) {
+		struct ctf_decode_op *op = &decoder->ops[i];
+
+		if (decoder->alignment % CHAR_BIT || op->offset % CHAR_BIT)
+			continue;
+		switch (op->len) {
+		case 8:
+		case 16:
+		case 32:
+		case 64:
+			op->aligned = 1;
+			break;
+		default:
+			break;
+		}
+	}
+	return decoder;
+}
+
+void ctf_decoder_destroy(struct ctf_decoder *decoder)
+{
+	g_free(decoder);
+}
+
+static inline
+uint64_t decode_unsigned(const char *base, uint64_t avail,
+		uint64_t bit_offset, const struct ctf_decode_op *op)
+{
+	int rbo = (op->byte_order != BYTE_ORDER);	/* reverse byte order */
+	const char *addr = base + (bit_offset / CHAR_BIT);
+	uint64_t v;
+
+	if (likely(op->aligned)) {
+		switch (op->len) {
+		case 8:
+			return *(const uint8_t *) addr;
+		case 16:
+		{
+			uint16_t v16;
+
+			memcpy(&v16, addr, sizeof(v16));
+			return rbo ? GUINT16_SWAP_LE_BE(v16) : v16;
+		}
+		case 32:
+		{
+			uint32_t v32;
+
+			memcpy(&v32, addr, sizeof(v32));
+			return rbo ? GUINT32_SWAP_LE_BE(v32) : v32;
+		}
+		case 64:
+			memcpy(&v, addr, sizeof(v));
+			return rbo ? GUINT64_SWAP_LE_BE(v) : v;
+		default:
+			assert(0);
+		}
+	}
+	if (likely(bt_bitfield_word_ok(bit_offset, op->len, avail))) {
+		if (op->byte_order == LITTLE_ENDIAN)
+			return bt_bitfield_read_word_le(base, bit_offset,
+				op->len);
+		else
+			return bt_bitfield_read_word_be(base, bit_offset,
+				op->len);
+	}
+	if (op->byte_order == LITTLE_ENDIAN)
+		bt_bitfield_read_le(base, unsigned long, bit_offset,
+				op->len, &v);
+	else
+		bt_bitfield_read_be(base, unsigned long, bit_offset,
+				op->len, &v);
+	return v;
+}
+
+static inline
+int64_t decode_signed(const char *base, uint64_t avail,
+		uint64_t bit_offset, const struct ctf_decode_op *op)
+{
+	int64_t v;
+
+	if (likely(op->aligned)) {
+		uint64_t u = decode_unsigned(base, avail, bit_offset, op);
+
+		switch (op->len) {
+		case 8:
+			return (int8_t) u;
+		case 16:
+			return (int16_t) u;
+		case 32:
+			return (int32_t) u;
+		case 64:
+			return (int64_t) u;
+		default:
+			assert(0);
+		}
+	}
+	if (likely(bt_bitfield_word_ok(bit_offset, op->len, avail)))
+		return bt_bitfield_sign_extend(decode_unsigned(base, avail,
+				bit_offset, op), op->len);
+	if (op->byte_order == LITTLE_ENDIAN)
+		bt_bitfield_read_le(base, unsigned long, bit_offset,
+				op->len, &v);
+	else
+		bt_bitfield_read_be(base, unsigned long, bit_offset,
+				op->len, &v);
+	return v;
+}
+
+static inline
+void decode_integer(const char *base, uint64_t avail,
+		uint64_t bit_offset, const struct ctf_decode_op *op,
+		struct definition_integer *integer_definition)
+{
+	if (!op->signedness)
+		integer_definition->value._unsigned =
+			decode_unsigned(base, avail, bit_offset, op);
+	else
+		integer_definition->value._signed =
+			decode_signed(base, avail, bit_offset, op);
+}
+
+/*
+ * The float is read as a single unsigned word, which gives the same bit
+ * layout as reading mantissa, exponent and sign in stream order. The
+ * native representation is assumed to be IEEE 754.
+ */
+static inline
+void decode_float(const char *base, uint64_t avail,
+		uint64_t bit_offset, const struct ctf_decode_op *op,
+		struct definition_float *float_definition)
+{
+	ctf_float_set_bits(float_definition,
+		decode_unsigned(base, avail, bit_offset, op), op->len);
+}
+
+/*
+ * Read all the fields of a structure starting at bit offset start of
+ * base, without any check: the caller validated the whole range.
+ */
+static
+void decode_struct(const char *base, uint64_t avail, uint64_t start,
+		const struct ctf_decoder *decoder)
+{
+	size_t i;
+
+	for (i = 0; i < decoder->nr_ops; i++) {
+		const struct ctf_decode_op *op = &decoder->ops[i];
+		uint64_t bit_offset = start + op->offset;
+
+		switch (op->type) {
+		case CTF_DECODE_INTEGER:
+			decode_integer(base, avail, bit_offset, op,
+				container_of(op->definition,
+					struct definition_integer, p));
+			break;
+		case CTF_DECODE_ENUM:
+		{
+			struct definition_enum *enum_definition =
+				container_of(op->definition,
+					struct definition_enum, p);
+
+			decode_integer(base, avail, bit_offset, op,
+				enum_definition->integer);
+			ctf_enum_update_quark_set(enum_definition);
+			break;
+		}
+		case CTF_DECODE_FLOAT:
+			decode_float(base, avail, bit_offset, op,
+				container_of(op->definition,
+					struct definition_float, p));
+			break;
+		case CTF_DECODE_TEXT:
+		{
+			struct definition_array *array_definition =
+				container_of(op->definition,
+					struct definition_array, p);
+
+			g_string_assign(array_definition->string, "");
+			g_string_insert_len(array_definition->string, 0,
+				base + (bit_offset / CHAR_BIT),
+				op->len / CHAR_BIT);
+			break;
+		}
+		}
+	}
+}
+
+/*
+ * ctf_decoder_read - read a whole structure with a compiled decoder.
+ *
+ * Equivalent to generic_rw() on the definition the decoder was compiled
+ * from, with a single alignment and bounds check.
+ */
+int ctf_decoder_read(struct ctf_stream_pos *pos,
+		const struct ctf_decoder *decoder)
+{
+	const char *base;
+
+	if (!ctf_align_pos(pos, decoder->alignment))
+		return -EFAULT;
+	if (!ctf_pos_access_ok(pos, decoder->len))
+		return -EFAULT;
+
+	base = mmap_align_addr(pos->base_mma) + pos->mmap_base_offset;
+	/* The whole packet is mapped: word loads may extend up to its end */
+	decode_struct(base, pos->packet_size / CHAR_BIT, pos->offset, decoder);
+	if (!ctf_move_pos(pos, decoder->len))
+		return -EFAULT;
+	return 0;
+}
+
+/*
+ * Compute the end offset of consecutive structures starting at the
+ * current position, and check that they fit in the packet. The padding
+ * between structures only depends on the offset of the first one, so
+ * the end offset of the last one is known before any field is read.
+ */
+static
+int decoders_end(struct ctf_stream_pos *pos,
+		const struct ctf_decoder * const *decoders, size_t nr,
+		uint64_t *end)
+{
+	uint64_t offset;
+	size_t i;
+
+	if (unlikely(pos->offset == EOF))
+		return -EFAULT;
+	offset = pos->offset;
+	for (i = 0; i < nr; i++) {
+		/* Keep the sum from wrapping around */
+		if (unlikely(decoders[i]->len > pos->packet_size))
+			return -EFAULT;
+		offset += offset_align(offset, decoders[i]->alignment);
+		offset += decoders[i]->len;
+	}
+	if (!ctf_pos_access_ok(pos, offset - pos->offset))
+		return -EFAULT;
+	*end = offset;
+	return 0;
+}
+
+/*
+ * ctf_decoders_read - read consecutive structures with compiled decoders.
+ *
+ * Equivalent to ctf_decoder_read() on each decoder in turn, with a
+ * single bounds check for all of them.
+ */
+int ctf_decoders_read(struct ctf_stream_pos *pos,
+		const struct ctf_decoder * const *decoders, size_t nr)
+{
+	const char *base;
+	uint64_t start, end, avail;
+	size_t i;
+	int ret;
+
+	ret = decoders_end(pos, decoders, nr, &end);
+	if (ret)
+		return ret;
+
+	base = mmap_align_addr(pos->base_mma) + pos->mmap_base_offset;
+	avail = pos->packet_size / CHAR_BIT;
+	start = pos->offset;
+	for (i = 0; i < nr; i++) {
+		start += offset_align(start, decoders[i]->alignment);
+		decode_struct(base, avail, start, decoders[i]);
+		start += decoders[i]->len;
+	}
+	pos->offset = end;
+	return 0;
+}
+
+/*
+ * ctf_decoders_skip - move past consecutive structures without reading
+ * them. Their definitions are left untouched.
+ */
+int ctf_decoders_skip(struct ctf_stream_pos *pos,
+		const struct ctf_decoder * const *decoders, size_t nr)
+{
+	uint64_t end;
+	int ret;
+
+	ret = decoders_end(pos, decoders, nr, &end);
+	if (ret)
+		return ret;
+	pos->offset = end;
+	return 0;
+}
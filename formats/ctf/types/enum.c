@@ -31,41 +31,58 @@
 #include <stdint.h>
 #include <glib.h>
 
-int ctf_enum_read(struct bt_stream_pos *ppos, struct bt_definition *definition)
+void ctf_enum_update_quark_set(struct definition_enum *enum_definition)
 {
-	struct definition_enum *enum_definition =
-		container_of(definition, struct definition_enum, p);
 	const struct declaration_enum *enum_declaration =
 		enum_definition->declaration;
 	struct definition_integer *integer_definition =
 		enum_definition->integer;
 	const struct declaration_integer *integer_declaration =
 		integer_definition->declaration;
+	int frozen = !!enum_declaration->table.index;
 	GArray *qs;
-	int ret;
 
-	ret = ctf_integer_read(ppos, &integer_definition->p);
-	if (ret)
-		return ret;
+	/* unref previous quark set */
+	if (enum_definition->value_owned)
+		g_array_unref(enum_definition->value);
 	if (!integer_declaration->signedness) {
-		qs = bt_enum_uint_to_quark_set(enum_declaration,
-			integer_definition->value._unsigned);
+		if (frozen)
+			qs = bt_enum_uint_lookup_quark_set(enum_declaration,
+				integer_definition->value._unsigned);
+		else
+			qs = bt_enum_uint_to_quark_set(enum_declaration,
+				integer_definition->value._unsigned);
 		if (!qs) {
 			fprintf(stderr, "[warning] Unknown value %" PRIu64 " in enum.\n",
 				integer_definition->value._unsigned);
 		}
 	} else {
-		qs = bt_enum_int_to_quark_set(enum_declaration,
-			integer_definition->value._signed);
+		if (frozen)
+			qs = bt_enum_int_lookup_quark_set(enum_declaration,
+				integer_definition->value._signed);
+		else
+			qs = bt_enum_int_to_quark_set(enum_declaration,
+				integer_definition->value._signed);
 		if (!qs) {
 			fprintf(stderr, "[warning] Unknown value %" PRId64 " in enum.\n",
 				integer_definition->value._signed);
 		}
 	}
-	/* unref previous quark set */
-	if (enum_definition->value)
-		g_array_unref(enum_definition->value);
 	enum_definition->value = qs;
+	/* Sets of an enumeration not frozen are not kept by it. */
+	enum_definition->value_owned = !frozen && qs;
+}
+
+int ctf_enum_read(struct bt_stream_pos *ppos, struct bt_definition *definition)
+{
+	struct definition_enum *enum_definition =
+		container_of(definition, struct definition_enum, p);
+	int ret;
+
+	ret = ctf_integer_read(ppos, &enum_definition->integer->p);
+	if (ret)
+		return ret;
+	ctf_enum_update_quark_set(enum_definition);
 	return 0;
 }
 
@@ -29,140 +29,52 @@
  */
 
 #include <babeltrace/ctf/types.h>
+#include <babeltrace/bitfield.h>
 #include <glib.h>
 #include <float.h>	/* C99 floating point definitions */
 #include <limits.h>	/* C99 limits */
+#include <string.h>
 #include <babeltrace/endian.h>
-#include <pthread.h>
 
 /*
  * This library is limited to binary representation of floating point values.
  * We use hardware support for conversion between 32 and 64-bit floating
  * point values.
+ *
+ * A float is serialized as a single integer made of its sign, exponent
+ * and mantissa bits, in the declared byte order. It is read and written
+ * as such, directly for byte-aligned positions, and through the
+ * bitfield accessors otherwise. No shared state is involved, so floats
+ * can be decoded concurrently.
  */
 
-/*
- * Aliasing float/double and unsigned long is not strictly permitted by strict
- * aliasing, but in practice declaration prunning is well supported, and this permits
- * us to use per-word read/writes rather than per-byte.
- */
-
-#if defined(__GNUC__) || defined(__MINGW32__) || defined(_MSC_VER)
-#define HAS_TYPE_PRUNING
-#endif
-
 #if (FLT_RADIX != 2)
 
 #error "Unsupported floating point radix"
 
 #endif
 
-union doubleIEEE754 {
-	double vd;
-	float vf;
-#ifdef HAS_TYPE_PRUNING
-	unsigned long bits[(sizeof(double) + sizeof(unsigned long) - 1) / sizeof(unsigned long)];
-#else
-	unsigned char bits[sizeof(double)];
-#endif
-};
-
 /*
- * This mutex protects the static temporary float and double
- * declarations (static_float_declaration and static_double_declaration).
+ * Return the size of the binary representation of a float declaration,
+ * in bits, or 0 if it does not match a native float or double.
  */
-static pthread_mutex_t float_mutex = PTHREAD_MUTEX_INITIALIZER;
-
-static struct declaration_float *static_float_declaration,
-		*static_double_declaration;
-
-struct pos_len {
-	size_t len;
-};
-
-static void float_lock(void)
-{
-	int ret;
-
-	ret = pthread_mutex_lock(&float_mutex);
-	assert(!ret);
-}
-
-static void float_unlock(void)
-{
-	int ret;
-
-	ret = pthread_mutex_unlock(&float_mutex);
-	assert(!ret);
-}
-
-static int _ctf_float_copy(struct bt_stream_pos *destp,
-		    struct definition_float *dest_definition,
-		    struct bt_stream_pos *srcp,
-		    const struct definition_float *src_definition)
+static
+size_t float_len(const struct declaration_float *float_declaration)
 {
-	int ret;
-
-	/* We only support copy of same-size floats for now */
-	assert(src_definition->declaration->sign->len ==
-		dest_definition->declaration->sign->len);
-	assert(src_definition->declaration->exp->len ==
-		dest_definition->declaration->exp->len);
-	assert(src_definition->declaration->mantissa->len ==
-		dest_definition->declaration->mantissa->len);
-	/* Read */
-	if (src_definition->declaration->byte_order == LITTLE_ENDIAN) {
-		ret = ctf_integer_read(srcp, &src_definition->mantissa->p);
-		if (ret)
-			return ret;
-		ret = ctf_integer_read(srcp, &src_definition->exp->p);
-		if (ret)
-			return ret;
-		ret = ctf_integer_read(srcp, &src_definition->sign->p);
-		if (ret)
-			return ret;
-	} else {
-		ret = ctf_integer_read(srcp, &src_definition->sign->p);
-		if (ret)
-			return ret;
-		ret = ctf_integer_read(srcp, &src_definition->exp->p);
-		if (ret)
-			return ret;
-		ret = ctf_integer_read(srcp, &src_definition->mantissa->p);
-		if (ret)
-			return ret;
-	}
+	size_t exp_len = float_declaration->exp->len;
 
-	dest_definition->mantissa->value._unsigned =
-		src_definition->mantissa->value._unsigned;
-	dest_definition->exp->value._signed =
-		src_definition->exp->value._signed;
-	dest_definition->sign->value._unsigned =
-		src_definition->sign->value._unsigned;
-
-	/* Write */
-	if (dest_definition->declaration->byte_order == LITTLE_ENDIAN) {
-		ret = ctf_integer_write(destp, &dest_definition->mantissa->p);
-		if (ret)
-			return ret;
-		ret = ctf_integer_write(destp, &dest_definition->exp->p);
-		if (ret)
-			return ret;
-		ret = ctf_integer_write(destp, &dest_definition->sign->p);
-		if (ret)
-			return ret;
-	} else {
-		ret = ctf_integer_write(destp, &dest_definition->sign->p);
-		if (ret)
-			return ret;
-		ret = ctf_integer_write(destp, &dest_definition->exp->p);
-		if (ret)
-			return ret;
-		ret = ctf_integer_write(destp, &dest_definition->mantissa->p);
-		if (ret)
-			return ret;
+	switch (float_declaration->mantissa->len + 1) {
+	case FLT_MANT_DIG:
+		if (exp_len != sizeof(float) * CHAR_BIT - FLT_MANT_DIG)
+			return 0;
+		return sizeof(float) * CHAR_BIT;
+	case DBL_MANT_DIG:
+		if (exp_len != sizeof(double) * CHAR_BIT - DBL_MANT_DIG)
+			return 0;
+		return sizeof(double) * CHAR_BIT;
+	default:
+		return 0;
 	}
-	return 0;
 }
 
 int ctf_float_read(struct bt_stream_pos *ppos, struct bt_definition *definition)
@@ -172,57 +84,43 @@ int ctf_float_read(struct bt_stream_pos *ppos, struct bt_definition *definition)
 	const struct declaration_float *float_declaration =
 		float_definition->declaration;
 	struct ctf_stream_pos *pos = ctf_pos(ppos);
-	union doubleIEEE754 u;
-	struct bt_definition *tmpdef;
-	struct definition_float *tmpfloat;
-	struct ctf_stream_pos destp;
-	struct mmap_align mma;
-	int ret;
-
-	float_lock();
-	switch (float_declaration->mantissa->len + 1) {
-	case FLT_MANT_DIG:
-		tmpdef = static_float_declaration->p.definition_new(
-				&static_float_declaration->p,
-				NULL, 0, 0, "__tmpfloat");
-		break;
-	case DBL_MANT_DIG:
-		tmpdef = static_double_declaration->p.definition_new(
-				&static_double_declaration->p,
-				NULL, 0, 0, "__tmpfloat");
-		break;
-	default:
-		ret = -EINVAL;
-		goto end;
-	}
-	tmpfloat = container_of(tmpdef, struct definition_float, p);
-	memset(&destp, 0, sizeof(destp));
-	ctf_init_pos(&destp, NULL, -1, O_RDWR);
-	mmap_align_set_addr(&mma, (char *) u.bits);
-	destp.base_mma = &mma;
-	destp.content_size = destp.packet_size = sizeof(u) * CHAR_BIT;
-	if (!ctf_align_pos(pos, float_declaration->p.alignment)) {
-		ret = -EFAULT;
-		goto end_unref;
-	}
-	ret = _ctf_float_copy(&destp.parent, tmpfloat, ppos, float_definition);
-	switch (float_declaration->mantissa->len + 1) {
-	case FLT_MANT_DIG:
-		float_definition->value = u.vf;
-		break;
-	case DBL_MANT_DIG:
-		float_definition->value = u.vd;
-		break;
-	default:
-		ret = -EINVAL;
-		goto end_unref;
+	int rbo = (float_declaration->byte_order != BYTE_ORDER);	/* reverse byte order */
+	size_t len;
+	uint64_t v;
+
+	len = float_len(float_declaration);
+	if (!len)
+		return -EINVAL;
+	if (!ctf_align_pos(pos, float_declaration->p.alignment))
+		return -EFAULT;
+	if (!ctf_pos_access_ok(pos, len))
+		return -EFAULT;
+
+	if (likely(!(pos->offset % CHAR_BIT))) {
+		if (len == sizeof(float) * CHAR_BIT) {
+			uint32_t v32;
+
+			memcpy(&v32, ctf_get_pos_addr(pos), sizeof(v32));
+			v = rbo ? GUINT32_SWAP_LE_BE(v32) : v32;
+		} else {
+			memcpy(&v, ctf_get_pos_addr(pos), sizeof(v));
+			if (rbo)
+				v = GUINT64_SWAP_LE_BE(v);
+		}
+	} else {
+		if (float_declaration->byte_order == LITTLE_ENDIAN)
+			bt_bitfield_read_le(mmap_align_addr(pos->base_mma) +
+					pos->mmap_base_offset, unsigned char,
+				pos->offset, len, &v);
+		else
+			bt_bitfield_read_be(mmap_align_addr(pos->base_mma) +
+					pos->mmap_base_offset, unsigned char,
+				pos->offset, len, &v);
 	}
-
-end_unref:
-	bt_definition_unref(tmpdef);
-end:
-	float_unlock();
-	return ret;
+	ctf_float_set_bits(float_definition, v, len);
+	if (!ctf_move_pos(pos, len))
+		return -EFAULT;
+	return 0;
 }
 
 int ctf_float_write(struct bt_stream_pos *ppos, struct bt_definition *definition)
@@ -232,56 +130,60 @@ int ctf_float_write(struct bt_stream_pos *ppos, struct bt_definition *definition
 	const struct declaration_float *float_declaration =
 		float_definition->declaration;
 	struct ctf_stream_pos *pos = ctf_pos(ppos);
-	union doubleIEEE754 u;
-	struct bt_definition *tmpdef;
-	struct definition_float *tmpfloat;
-	struct ctf_stream_pos srcp = { { 0 } };
-	struct mmap_align mma;
-	int ret;
+	int rbo = (float_declaration->byte_order != BYTE_ORDER);	/* reverse byte order */
+	size_t len;
+	uint64_t v;
 
-	float_lock();
-	switch (float_declaration->mantissa->len + 1) {
-	case FLT_MANT_DIG:
-		tmpdef = static_float_declaration->p.definition_new(
-				&static_float_declaration->p,
-				NULL, 0, 0, "__tmpfloat");
-		break;
-	case DBL_MANT_DIG:
-		tmpdef = static_double_declaration->p.definition_new(
-				&static_double_declaration->p,
-				NULL, 0, 0, "__tmpfloat");
-		break;
-	default:
-		ret = -EINVAL;
-		goto end;
-	}
-	tmpfloat = container_of(tmpdef, struct definition_float, p);
-	ctf_init_pos(&srcp, NULL, -1, O_RDONLY);
-	mmap_align_set_addr(&mma, (char *) u.bits);
-	srcp.base_mma = &mma;
-	srcp.content_size = srcp.packet_size = sizeof(u) * CHAR_BIT;
-	switch (float_declaration->mantissa->len + 1) {
-	case FLT_MANT_DIG:
-		u.vf = float_definition->value;
-		break;
-	case DBL_MANT_DIG:
-		u.vd = float_definition->value;
-		break;
-	default:
-		ret = -EINVAL;
-		goto end_unref;
-	}
-	if (!ctf_align_pos(pos, float_declaration->p.alignment)) {
-		ret = -EFAULT;
-		goto end_unref;
+	len = float_len(float_declaration);
+	if (!len)
+		return -EINVAL;
+	if (len == sizeof(float) * CHAR_BIT) {
+		float f = float_definition->value;
+		uint32_t v32;
+
+		memcpy(&v32, &f, sizeof(v32));
+		v = v32;
+	} else {
+		double d = float_definition->value;
+
+		memcpy(&v, &d, sizeof(v));
 	}
-	ret = _ctf_float_copy(ppos, float_definition, &srcp.parent, tmpfloat);
+	/* Keep the sign, exponent and mantissa fields consistent. */
+	ctf_float_set_bits(float_definition, v, len);
+
+	if (!ctf_align_pos(pos, float_declaration->p.alignment))
+		return -EFAULT;
+	if (!ctf_pos_access_ok(pos, len))
+		return -EFAULT;
+	if (pos->dummy)
+		goto end;
 
-end_unref:
-	bt_definition_unref(tmpdef);
+	if (likely(!(pos->offset % CHAR_BIT))) {
+		if (len == sizeof(float) * CHAR_BIT) {
+			uint32_t v32 = (uint32_t) v;
+
+			if (rbo)
+				v32 = GUINT32_SWAP_LE_BE(v32);
+			memcpy(ctf_get_pos_addr(pos), &v32, sizeof(v32));
+		} else {
+			if (rbo)
+				v = GUINT64_SWAP_LE_BE(v);
+			memcpy(ctf_get_pos_addr(pos), &v, sizeof(v));
+		}
+	} else {
+		if (float_declaration->byte_order == LITTLE_ENDIAN)
+			bt_bitfield_write_le(mmap_align_addr(pos->base_mma) +
+					pos->mmap_base_offset, unsigned char,
+				pos->offset, len, v);
+		else
+			bt_bitfield_write_be(mmap_align_addr(pos->base_mma) +
+					pos->mmap_base_offset, unsigned char,
+				pos->offset, len, v);
+	}
 end:
-	float_unlock();
-	return ret;
+	if (!ctf_move_pos(pos, len))
+		return -EFAULT;
+	return 0;
 }
 
 double bt_get_float(const struct bt_definition *field)
@@ -291,25 +193,3 @@ double bt_get_float(const struct bt_definition *field)
 
 	return definition->value;
 }
-
-static
-void __attribute__((constructor)) ctf_float_init(void)
-{
-	static_float_declaration =
-		bt_float_declaration_new(FLT_MANT_DIG,
-				sizeof(float) * CHAR_BIT - FLT_MANT_DIG,
-				BYTE_ORDER,
-				__alignof__(float));
-	static_double_declaration =
-		bt_float_declaration_new(DBL_MANT_DIG,
-				sizeof(double) * CHAR_BIT - DBL_MANT_DIG,
-				BYTE_ORDER,
-				__alignof__(double));
-}
-
-static
-void __attribute__((destructor)) ctf_float_fini(void)
-{
-	bt_declaration_unref(&static_float_declaration->p);
-	bt_declaration_unref(&static_double_declaration->p);
-}
@@ -234,7 +234,26 @@ int ctf_integer_read(struct bt_stream_pos *ppos, struct bt_definition *definitio
 	if (!ctf_pos_access_ok(pos, integer_declaration->len))
 		return -EFAULT;
 
-	if (!integer_declaration->signedness) {
+	/* The whole packet is mapped: a word load may extend up to its end */
+	if (likely(bt_bitfield_word_ok(pos->offset, integer_declaration->len,
+			pos->packet_size / CHAR_BIT))) {
+		const char *base = mmap_align_addr(pos->base_mma) +
+				pos->mmap_base_offset;
+		uint64_t v;
+
+		if (integer_declaration->byte_order == LITTLE_ENDIAN)
+			v = bt_bitfield_read_word_le(base, pos->offset,
+				integer_declaration->len);
+		else
+			v = bt_bitfield_read_word_be(base, pos->offset,
+				integer_declaration->len);
+		if (!integer_declaration->signedness)
+			integer_definition->value._unsigned = v;
+		else
+			integer_definition->value._signed =
+				bt_bitfield_sign_extend(v,
+					integer_declaration->len);
+	} else if (!integer_declaration->signedness) {
 		if (integer_declaration->byte_order == LITTLE_ENDIAN)
 			bt_bitfield_read_le(mmap_align_addr(pos->base_mma) +
 					pos->mmap_base_offset, unsigned long,
@@ -27,6 +27,147 @@
  */
 
 #include <babeltrace/ctf/types.h>
+#include <babeltrace/bitfield.h>
+#include <babeltrace/endian.h>
+#include <stdint.h>
+#include <glib.h>
+
+static
+void sequence_store_value(GArray *values, uint64_t i, uint64_t v)
+{
+	switch (g_array_get_element_size(values)) {
+	case 1:
+		g_array_index(values, uint8_t, i) = (uint8_t) v;
+		break;
+	case 2:
+		g_array_index(values, uint16_t, i) = (uint16_t) v;
+		break;
+	case 4:
+		g_array_index(values, uint32_t, i) = (uint32_t) v;
+		break;
+	default:
+		g_array_index(values, uint64_t, i) = v;
+		break;
+	}
+}
+
+/*
+ * Decode all the elements of an integer sequence into its flat value
+ * buffer, without going through per-element definitions. Elements
+ * whose size matches the buffer element size and which are packed
+ * without padding are copied with a single memcpy, then byte-swapped
+ * in place if needed.
+ * Enumeration and floating point elements still go through their
+ * definitions: each one needs its label set looked up or its value
+ * converted from the declared mantissa and exponent sizes.
+ */
+static
+int ctf_sequence_read_values(struct ctf_stream_pos *pos,
+		struct definition_sequence *sequence_definition,
+		const struct declaration_integer *integer_declaration)
+{
+	GArray *values = sequence_definition->values;
+	guint size = g_array_get_element_size(values);
+	uint64_t len = bt_sequence_len(sequence_definition), i;
+	size_t elem_len = integer_declaration->len;
+	size_t alignment = integer_declaration->p.alignment;
+	int rbo = (integer_declaration->byte_order != BYTE_ORDER);	/* reverse byte order */
+
+	if (!len) {
+		g_array_set_size(values, 0);
+		return 0;
+	}
+	if (!ctf_align_pos(pos, alignment))
+		return -EFAULT;
+	/*
+	 * Padding aside, the elements take len * elem_len bits: check
+	 * that the packet holds them before sizing the value buffer, so
+	 * that a corrupt length cannot allocate more than that.
+	 */
+	if (len > UINT64_MAX / elem_len
+	    || !ctf_pos_access_ok(pos, len * elem_len))
+		return -EFAULT;
+	g_array_set_size(values, len);
+
+	if (elem_len == size * CHAR_BIT && !(alignment % CHAR_BIT)
+	    && alignment <= elem_len) {
+		memcpy(values->data, ctf_get_pos_addr(pos), len * size);
+		if (rbo) {
+			switch (size) {
+			case 2:
+				for (i = 0; i < len; i++)
+					g_array_index(values, uint16_t, i) =
+						GUINT16_SWAP_LE_BE(g_array_index(values, uint16_t, i));
+				break;
+			case 4:
+				for (i = 0; i < len; i++)
+					g_array_index(values, uint32_t, i) =
+						GUINT32_SWAP_LE_BE(g_array_index(values, uint32_t, i));
+				break;
+			case 8:
+				for (i = 0; i < len; i++)
+					g_array_index(values, uint64_t, i) =
+						GUINT64_SWAP_LE_BE(g_array_index(values, uint64_t, i));
+				break;
+			}
+		}
+		if (!ctf_move_pos(pos, len * elem_len))
+			return -EFAULT;
+		return 0;
+	}
+
+	for (i = 0; i < len; i++) {
+		uint64_t v;
+		int64_t sv;
+
+		if (!ctf_align_pos(pos, alignment))
+			return -EFAULT;
+		if (!ctf_pos_access_ok(pos, elem_len))
+			return -EFAULT;
+		/*
+		 * Signed values are sign-extended to 64 bits, and thus
+		 * remain correct once truncated to the element size.
+		 */
+		if (likely(bt_bitfield_word_ok(pos->offset, elem_len,
+				pos->packet_size / CHAR_BIT))) {
+			const char *base = mmap_align_addr(pos->base_mma) +
+					pos->mmap_base_offset;
+
+			if (integer_declaration->byte_order == LITTLE_ENDIAN)
+				v = bt_bitfield_read_word_le(base, pos->offset,
+					elem_len);
+			else
+				v = bt_bitfield_read_word_be(base, pos->offset,
+					elem_len);
+			if (integer_declaration->signedness)
+				v = (uint64_t) bt_bitfield_sign_extend(v,
+					elem_len);
+		} else if (!integer_declaration->signedness) {
+			if (integer_declaration->byte_order == LITTLE_ENDIAN)
+				bt_bitfield_read_le(mmap_align_addr(pos->base_mma) +
+						pos->mmap_base_offset, unsigned long,
+					pos->offset, elem_len, &v);
+			else
+				bt_bitfield_read_be(mmap_align_addr(pos->base_mma) +
+						pos->mmap_base_offset, unsigned long,
+					pos->offset, elem_len, &v);
+		} else {
+			if (integer_declaration->byte_order == LITTLE_ENDIAN)
+				bt_bitfield_read_le(mmap_align_addr(pos->base_mma) +
+						pos->mmap_base_offset, unsigned long,
+					pos->offset, elem_len, &sv);
+			else
+				bt_bitfield_read_be(mmap_align_addr(pos->base_mma) +
+						pos->mmap_base_offset, unsigned long,
+					pos->offset, elem_len, &sv);
+			v = (uint64_t) sv;
+		}
+		sequence_store_value(values, i, v);
+		if (!ctf_move_pos(pos, elem_len))
+			return -EFAULT;
+	}
+	return 0;
+}
 
 int ctf_sequence_read(struct bt_stream_pos *ppos, struct bt_definition *definition)
 {
@@ -60,6 +201,9 @@ int ctf_sequence_read(struct bt_stream_pos *ppos, struct bt_definition *definiti
 					return -EFAULT;
 				return 0;
 			}
+		} else if (sequence_definition->values) {
+			return ctf_sequence_read_values(pos, sequence_definition,
+					integer_declaration);
 		}
 	}
 	return bt_sequence_rw(ppos, definition);
@@ -58,13 +58,23 @@ int ctf_string_read(struct bt_stream_pos *ppos, struct bt_definition *definition
 	if (srcaddr[len - 1] != '\0')
 		return -EFAULT;
 
-	if (string_definition->alloc_len < len) {
-		string_definition->value =
-			g_realloc(string_definition->value, len);
-		string_definition->alloc_len = len;
-	}
 	printf_debug("CTF string read %s\n", srcaddr);
-	memcpy(string_definition->value, srcaddr, len);
+	if (pos->borrowed_strings) {
+		/* Reference the mapping until it is unmapped. */
+		string_definition->value = srcaddr;
+		if (!string_definition->borrowed) {
+			g_ptr_array_add(pos->borrowed_strings, string_definition);
+			string_definition->borrowed = 1;
+		}
+	} else {
+		if (string_definition->alloc_len < len) {
+			string_definition->buf =
+				g_realloc(string_definition->buf, len);
+			string_definition->alloc_len = len;
+		}
+		memcpy(string_definition->buf, srcaddr, len);
+		string_definition->value = string_definition->buf;
+	}
 	string_definition->len = len;
 	if (!ctf_move_pos(pos, len * CHAR_BIT))
 		return -EFAULT;
@@ -99,3 +109,34 @@ end:
 		return -EFAULT;
 	return 0;
 }
+
+/*
+ * Give the string definitions referencing the current mapping of pos
+ * their own copy of the string. Must be called before unmapping it.
+ */
+void ctf_pos_detach_strings(struct ctf_stream_pos *pos)
+{
+	unsigned int i;
+
+	if (!pos->borrowed_strings)
+		return;
+	for (i = 0; i < pos->borrowed_strings->len; i++) {
+		struct definition_string *string_definition =
+			g_ptr_array_index(pos->borrowed_strings, i);
+
+		string_definition->borrowed = 0;
+		if (!string_definition->value
+		    || string_definition->value == string_definition->buf)
+			continue;
+		if (string_definition->alloc_len < string_definition->len) {
+			string_definition->buf =
+				g_realloc(string_definition->buf,
+					string_definition->len);
+			string_definition->alloc_len = string_definition->len;
+		}
+		memcpy(string_definition->buf, string_definition->value,
+			string_definition->len);
+		string_definition->value = string_definition->buf;
+	}
+	g_ptr_array_set_size(pos->borrowed_strings, 0);
+}
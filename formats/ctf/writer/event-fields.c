@@ -88,6 +88,19 @@ int bt_ctf_field_array_validate(struct bt_ctf_field *field);
 static
 int bt_ctf_field_sequence_validate(struct bt_ctf_field *field);
 
+static
+void bt_ctf_field_generic_reset(struct bt_ctf_field *field);
+static
+void bt_ctf_field_enumeration_reset(struct bt_ctf_field *field);
+static
+void bt_ctf_field_structure_reset(struct bt_ctf_field *field);
+static
+void bt_ctf_field_variant_reset(struct bt_ctf_field *field);
+static
+void bt_ctf_field_array_reset(struct bt_ctf_field *field);
+static
+void bt_ctf_field_sequence_reset(struct bt_ctf_field *field);
+
 static
 int bt_ctf_field_integer_serialize(struct bt_ctf_field *,
 		struct ctf_stream_pos *);
@@ -113,9 +126,6 @@ static
 int bt_ctf_field_string_serialize(struct bt_ctf_field *,
 		struct ctf_stream_pos *);
 
-static
-int increase_packet_size(struct ctf_stream_pos *pos);
-
 static
 struct bt_ctf_field *(*field_create_funcs[])(
 		struct bt_ctf_field_type *) = {
@@ -155,6 +165,18 @@ int (*field_validate_funcs[])(struct bt_ctf_field *) = {
 	[CTF_TYPE_STRING] = bt_ctf_field_generic_validate,
 };
 
+static
+void (*field_reset_funcs[])(struct bt_ctf_field *) = {
+	[CTF_TYPE_INTEGER] = bt_ctf_field_generic_reset,
+	[CTF_TYPE_ENUM] = bt_ctf_field_enumeration_reset,
+	[CTF_TYPE_FLOAT] = bt_ctf_field_generic_reset,
+	[CTF_TYPE_STRUCT] = bt_ctf_field_structure_reset,
+	[CTF_TYPE_VARIANT] = bt_ctf_field_variant_reset,
+	[CTF_TYPE_ARRAY] = bt_ctf_field_array_reset,
+	[CTF_TYPE_SEQUENCE] = bt_ctf_field_sequence_reset,
+	[CTF_TYPE_STRING] = bt_ctf_field_generic_reset,
+};
+
 static
 int (*field_serialize_funcs[])(struct bt_ctf_field *,
 		struct ctf_stream_pos *) = {
@@ -242,21 +264,25 @@ int bt_ctf_field_sequence_set_length(struct bt_ctf_field *field,
 		parent);
 	sequence_length = length->definition.value._unsigned;
 	sequence = container_of(field, struct bt_ctf_field_sequence, parent);
-	if (sequence->elements) {
-		g_ptr_array_free(sequence->elements, TRUE);
-		bt_ctf_field_put(sequence->length);
-	}
-
-	sequence->elements = g_ptr_array_sized_new((size_t)sequence_length);
 	if (!sequence->elements) {
-		ret = -1;
-		goto end;
+		sequence->elements = g_ptr_array_sized_new(
+			(size_t)sequence_length);
+		if (!sequence->elements) {
+			ret = -1;
+			goto end;
+		}
+
+		g_ptr_array_set_free_func(sequence->elements,
+			(GDestroyNotify)bt_ctf_field_put);
 	}
 
-	g_ptr_array_set_free_func(sequence->elements,
-		(GDestroyNotify)bt_ctf_field_put);
+	/*
+	 * Elements kept from a previous length (e.g. after a reset) are
+	 * reused; the ones past the new length are released.
+	 */
 	g_ptr_array_set_size(sequence->elements, (size_t)sequence_length);
 	bt_ctf_field_get(length_field);
+	bt_ctf_field_put(sequence->length);
 	sequence->length = length_field;
 end:
 	return ret;
@@ -376,9 +402,9 @@ struct bt_ctf_field *bt_ctf_field_array_get_field(struct bt_ctf_field *field,
 	}
 
 	new_field = bt_ctf_field_create(field_type);
-	bt_ctf_field_get(new_field);
 	array->elements->pdata[(size_t)index] = new_field;
 end:
+	bt_ctf_field_get(new_field);
 	return new_field;
 }
 
@@ -409,9 +435,9 @@ struct bt_ctf_field *bt_ctf_field_sequence_get_field(struct bt_ctf_field *field,
 	}
 
 	new_field = bt_ctf_field_create(field_type);
-	bt_ctf_field_get(new_field);
 	sequence->elements->pdata[(size_t)index] = new_field;
 end:
+	bt_ctf_field_get(new_field);
 	return new_field;
 }
 
@@ -456,7 +482,15 @@ struct bt_ctf_field *bt_ctf_field_variant_get_field(struct bt_ctf_field *field,
 		goto end;
 	}
 
-	new_field = bt_ctf_field_create(field_type);
+	/* Reuse the payload left by a reset if the selected type matches */
+	if (!variant->tag && variant->payload &&
+		variant->payload->type == field_type) {
+		new_field = variant->payload;
+		bt_ctf_field_get(new_field);
+	} else {
+		new_field = bt_ctf_field_create(field_type);
+	}
+
 	if (!new_field) {
 		goto end;
 	}
@@ -608,10 +642,11 @@ int bt_ctf_field_string_set_value(struct bt_ctf_field *field,
 
 	string = container_of(field, struct bt_ctf_field_string, parent);
 	if (string->payload) {
-		g_string_free(string->payload, TRUE);
+		g_string_assign(string->payload, value);
+	} else {
+		string->payload = g_string_new(value);
 	}
 
-	string->payload = g_string_new(value);
 	string->parent.payload_set = 1;
 end:
 	return ret;
@@ -639,6 +674,23 @@ end:
 	return ret;
 }
 
+BT_HIDDEN
+void bt_ctf_field_reset(struct bt_ctf_field *field)
+{
+	enum ctf_type_id type_id;
+
+	if (!field) {
+		return;
+	}
+
+	type_id = bt_ctf_field_type_get_type_id(field->type);
+	if (type_id <= CTF_TYPE_UNKNOWN || type_id >= NR_CTF_TYPES) {
+		return;
+	}
+
+	field_reset_funcs[type_id](field);
+}
+
 BT_HIDDEN
 int bt_ctf_field_serialize(struct bt_ctf_field *field,
 		struct ctf_stream_pos *pos)
@@ -1002,6 +1054,11 @@ int bt_ctf_field_variant_validate(struct bt_ctf_field *field)
 	}
 
 	variant = container_of(field, struct bt_ctf_field_variant, parent);
+	if (!variant->tag) {
+		ret = -1;
+		goto end;
+	}
+
 	ret = bt_ctf_field_validate(variant->payload);
 end:
 	return ret;
@@ -1043,6 +1100,11 @@ int bt_ctf_field_sequence_validate(struct bt_ctf_field *field)
 	}
 
 	sequence = container_of(field, struct bt_ctf_field_sequence, parent);
+	if (!sequence->length) {
+		ret = -1;
+		goto end;
+	}
+
 	for (i = 0; i < sequence->elements->len; i++) {
 		ret = bt_ctf_field_validate(sequence->elements->pdata[i]);
 		if (ret) {
@@ -1053,6 +1115,106 @@ end:
 	return ret;
 }
 
+/*
+ * Reset a field tree owned by an event. Sub-fields which are also
+ * referenced from elsewhere are detached rather than cleared, so that
+ * fields shared by the user keep their value.
+ */
+static
+void reset_or_detach_field(struct bt_ctf_field **field)
+{
+	if (!*field) {
+		return;
+	}
+
+	if ((*field)->ref_count.refcount > 1) {
+		bt_ctf_field_put(*field);
+		*field = NULL;
+		return;
+	}
+
+	bt_ctf_field_reset(*field);
+}
+
+static
+void bt_ctf_field_generic_reset(struct bt_ctf_field *field)
+{
+	field->payload_set = 0;
+}
+
+static
+void bt_ctf_field_enumeration_reset(struct bt_ctf_field *field)
+{
+	struct bt_ctf_field_enumeration *enumeration = container_of(
+		field, struct bt_ctf_field_enumeration, parent);
+
+	reset_or_detach_field(&enumeration->payload);
+}
+
+static
+void bt_ctf_field_structure_reset(struct bt_ctf_field *field)
+{
+	size_t i;
+	struct bt_ctf_field_structure *structure = container_of(
+		field, struct bt_ctf_field_structure, parent);
+
+	/*
+	 * Sequence lengths and variant tags are declared before the fields
+	 * referring to them: going backwards releases those references
+	 * before the length and tag fields are reached, so they are reset
+	 * rather than detached.
+	 */
+	for (i = structure->fields->len; i > 0; i--) {
+		reset_or_detach_field((struct bt_ctf_field **)
+			&structure->fields->pdata[i - 1]);
+	}
+}
+
+static
+void bt_ctf_field_variant_reset(struct bt_ctf_field *field)
+{
+	struct bt_ctf_field_variant *variant = container_of(
+		field, struct bt_ctf_field_variant, parent);
+
+	/* The payload is kept for reuse by bt_ctf_field_variant_get_field */
+	bt_ctf_field_put(variant->tag);
+	variant->tag = NULL;
+	reset_or_detach_field(&variant->payload);
+}
+
+static
+void bt_ctf_field_array_reset(struct bt_ctf_field *field)
+{
+	size_t i;
+	struct bt_ctf_field_array *array = container_of(
+		field, struct bt_ctf_field_array, parent);
+
+	for (i = 0; i < array->elements->len; i++) {
+		reset_or_detach_field((struct bt_ctf_field **)
+			&array->elements->pdata[i]);
+	}
+}
+
+static
+void bt_ctf_field_sequence_reset(struct bt_ctf_field *field)
+{
+	size_t i;
+	struct bt_ctf_field_sequence *sequence = container_of(
+		field, struct bt_ctf_field_sequence, parent);
+
+	/* Elements are kept for reuse by bt_ctf_field_sequence_set_length */
+	bt_ctf_field_put(sequence->length);
+	sequence->length = NULL;
+	if (!sequence->elements) {
+		return;
+	}
+
+	for (i = 0; i < sequence->elements->len; i++) {
+		reset_or_detach_field((struct bt_ctf_field **)
+			&sequence->elements->pdata[i]);
+	}
+}
+
 static
 int bt_ctf_field_integer_serialize(struct bt_ctf_field *field,
 		struct ctf_stream_pos *pos)
@@ -1203,38 +1365,77 @@ static
 int bt_ctf_field_string_serialize(struct bt_ctf_field *field,
 		struct ctf_stream_pos *pos)
 {
-	size_t i;
 	int ret = 0;
 	struct bt_ctf_field_string *string = container_of(field,
 		struct bt_ctf_field_string, parent);
-	struct bt_ctf_field_type *character_type =
-		get_field_type(FIELD_TYPE_ALIAS_UINT8_T);
-	struct bt_ctf_field *character = bt_ctf_field_create(character_type);
+	/* Including the terminating null character */
+	uint64_t len = (string->payload->len + 1) * CHAR_BIT;
 
-	for (i = 0; i < string->payload->len + 1; i++) {
-		ret = bt_ctf_field_unsigned_integer_set_value(character,
-			(uint64_t) string->payload->str[i]);
+	while (!ctf_pos_access_ok(pos,
+		offset_align(pos->offset, CHAR_BIT) + len)) {
+		ret = increase_packet_size(pos);
 		if (ret) {
 			goto end;
 		}
+	}
 
-		ret = bt_ctf_field_integer_serialize(character, pos);
-		if (ret) {
-			goto end;
-		}
+	if (!ctf_align_pos(pos, CHAR_BIT)) {
+		ret = -1;
+		goto end;
+	}
+
+	memcpy(ctf_get_pos_addr(pos), string->payload->str,
+		string->payload->len + 1);
+	if (!ctf_move_pos(pos, len)) {
+		ret = -1;
 	}
 end:
-	bt_ctf_field_put(character);
-	bt_ctf_field_type_put(character_type);
 	return ret;
 }
 
+/*
+ * Packets of asynchronous streams live in anonymous memory which is not
+ * backed by the stream file: move the packet to a larger mapping, unless
+ * its buffer was already grown by a previous packet.
+ */
 static
+int increase_buffer_size(struct ctf_stream_pos *pos)
+{
+	int ret = 0;
+	struct mmap_align *mma;
+	size_t len = pos->packet_size / CHAR_BIT;
+
+	if (pos->base_mma->length >= len + PACKET_LEN_INCREMENT / CHAR_BIT) {
+		pos->packet_size += PACKET_LEN_INCREMENT;
+		goto end;
+	}
+
+	mma = mmap_align(len + PACKET_LEN_INCREMENT / CHAR_BIT,
+		PROT_READ | PROT_WRITE, pos->flags, -1, 0);
+	if (mma == MAP_FAILED) {
+		ret = -1;
+		goto end;
+	}
+
+	memcpy(mmap_align_addr(mma), mmap_align_addr(pos->base_mma), len);
+	ret = munmap_align(pos->base_mma);
+	pos->base_mma = mma;
+	pos->packet_size += PACKET_LEN_INCREMENT;
+end:
+	return ret;
+}
+
+BT_HIDDEN
 int increase_packet_size(struct ctf_stream_pos *pos)
 {
 	int ret;
 
 	assert(pos);
+	if (pos->flags & MAP_ANONYMOUS) {
+		ret = increase_buffer_size(pos);
+		goto end;
+	}
+
 	ret = munmap_align(pos->base_mma);
 	if (ret) {
 		goto end;
@@ -39,6 +39,10 @@ static
 void bt_ctf_event_class_destroy(struct bt_ctf_ref *ref);
 static
 void bt_ctf_event_destroy(struct bt_ctf_ref *ref);
+static
+void bt_ctf_event_free(struct bt_ctf_event *event);
+static
+void event_reset(struct bt_ctf_event *event);
 
 struct bt_ctf_event_class *bt_ctf_event_class_create(const char *name)
 {
@@ -53,6 +57,13 @@ struct bt_ctf_event_class *bt_ctf_event_class_create(const char *name)
 		goto end;
 	}
 
+	event_class->event_cache = g_ptr_array_sized_new(EVENT_CACHE_MAX_LEN);
+	if (!event_class->event_cache) {
+		g_free(event_class);
+		event_class = NULL;
+		goto end;
+	}
+
 	bt_ctf_ref_init(&event_class->ref_count);
 	event_class->name = g_quark_from_string(name);
 end:
@@ -111,6 +122,16 @@ struct bt_ctf_event *bt_ctf_event_create(struct bt_ctf_event_class *event_class)
 		goto end;
 	}
 
+	if (event_class->event_cache->len) {
+		/* No free function is set: removing does not release it */
+		event = g_ptr_array_remove_index_fast(event_class->event_cache,
+			event_class->event_cache->len - 1);
+		bt_ctf_ref_init(&event->ref_count);
+		bt_ctf_event_class_get(event_class);
+		event->event_class = event_class;
+		goto end;
+	}
+
 	event = g_new0(struct bt_ctf_event, 1);
 	if (!event) {
 		goto end;
@@ -126,6 +147,20 @@ end:
 	return event;
 }
 
+int bt_ctf_event_reset(struct bt_ctf_event *event)
+{
+	int ret = 0;
+
+	if (!event) {
+		ret = -1;
+		goto end;
+	}
+
+	event_reset(event);
+end:
+	return ret;
+}
+
 int bt_ctf_event_set_payload(struct bt_ctf_event *event,
 		const char *name,
 		struct bt_ctf_field *value)
@@ -179,6 +214,7 @@ void bt_ctf_event_put(struct bt_ctf_event *event)
 static
 void bt_ctf_event_class_destroy(struct bt_ctf_ref *ref)
 {
+	size_t i;
 	struct bt_ctf_event_class *event_class;
 
 	if (!ref) {
@@ -186,6 +222,11 @@ void bt_ctf_event_class_destroy(struct bt_ctf_ref *ref)
 	}
 
 	event_class = container_of(ref, struct bt_ctf_event_class, ref_count);
+	for (i = 0; i < event_class->event_cache->len; i++) {
+		bt_ctf_event_free(g_ptr_array_index(event_class->event_cache, i));
+	}
+
+	g_ptr_array_free(event_class->event_cache, TRUE);
 	bt_ctf_field_type_put(event_class->context);
 	bt_ctf_field_type_put(event_class->fields);
 	g_free(event_class);
@@ -195,6 +236,7 @@ static
 void bt_ctf_event_destroy(struct bt_ctf_ref *ref)
 {
 	struct bt_ctf_event *event;
+	struct bt_ctf_event_class *event_class;
 
 	if (!ref) {
 		return;
@@ -202,12 +244,36 @@ void bt_ctf_event_destroy(struct bt_ctf_ref *ref)
 
 	event = container_of(ref, struct bt_ctf_event,
 		ref_count);
-	bt_ctf_event_class_put(event->event_class);
+	event_class = event->event_class;
+	event->event_class = NULL;
+	if (event_class->event_cache->len < EVENT_CACHE_MAX_LEN) {
+		/* Keep the event's field tree around for the next one */
+		event_reset(event);
+		g_ptr_array_add(event_class->event_cache, event);
+	} else {
+		bt_ctf_event_free(event);
+	}
+
+	bt_ctf_event_class_put(event_class);
+}
+
+static
+void bt_ctf_event_free(struct bt_ctf_event *event)
+{
 	bt_ctf_field_put(event->context_payload);
 	bt_ctf_field_put(event->fields_payload);
 	g_free(event);
 }
 
+static
+void event_reset(struct bt_ctf_event *event)
+{
+	event->timestamp = 0;
+	/* The payload may refer to context fields (see structure reset) */
+	bt_ctf_field_reset(event->fields_payload);
+	bt_ctf_field_reset(event->context_payload);
+}
+
 BT_HIDDEN
 void bt_ctf_event_class_freeze(struct bt_ctf_event_class *event_class)
 {
@@ -0,0 +1,209 @@
+/*
+ * packet-writer.c
+ *
+ * Babeltrace CTF Writer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <babeltrace/ctf-writer/packet-writer-internal.h>
+#include <babeltrace/compiler.h>
+#include <glib.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+static
+void packet_writer_destroy(struct bt_ctf_ref *ref);
+
+/*
+ * Only the packet content is written out: extending the file over the
+ * padding reads back as zeros, as a fresh file-backed packet would.
+ */
+static
+int write_packet(struct packet_buffer *buffer)
+{
+	int ret = 0;
+	char *addr = mmap_align_addr(buffer->mma);
+	size_t written = 0;
+
+	while (written < buffer->content_len) {
+		ssize_t len = pwrite(buffer->fd, addr + written,
+			buffer->content_len - written,
+			buffer->offset + written);
+
+		if (len < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+
+			perror("pwrite");
+			ret = -errno;
+			goto end;
+		}
+
+		written += len;
+	}
+
+	if (buffer->content_len < buffer->len &&
+		ftruncate(buffer->fd, buffer->offset + buffer->len)) {
+		perror("ftruncate");
+		ret = -errno;
+	}
+end:
+	/* Hand the buffer back zeroed, padding is never written explicitly */
+	memset(addr, 0, buffer->content_len);
+	return ret;
+}
+
+static
+void *packet_writer_thread(void *data)
+{
+	struct packet_writer *writer = data;
+
+	pthread_mutex_lock(&writer->lock);
+	for (;;) {
+		struct packet_buffer *buffer;
+		int ret;
+
+		while (bt_list_empty(&writer->queue) && !writer->quit) {
+			pthread_cond_wait(&writer->queue_cond, &writer->lock);
+		}
+
+		if (bt_list_empty(&writer->queue)) {
+			break;
+		}
+
+		buffer = bt_list_entry(writer->queue.next,
+			struct packet_buffer, node);
+		bt_list_del(&buffer->node);
+		pthread_mutex_unlock(&writer->lock);
+
+		ret = write_packet(buffer);
+
+		pthread_mutex_lock(&writer->lock);
+		buffer->error = ret;
+		buffer->busy = 0;
+		pthread_cond_broadcast(&writer->done_cond);
+	}
+	pthread_mutex_unlock(&writer->lock);
+	return NULL;
+}
+
+BT_HIDDEN
+struct packet_writer *packet_writer_create(void)
+{
+	struct packet_writer *writer = g_new0(struct packet_writer, 1);
+
+	if (!writer) {
+		goto end;
+	}
+
+	bt_ctf_ref_init(&writer->ref_count);
+	BT_INIT_LIST_HEAD(&writer->queue);
+	pthread_mutex_init(&writer->lock, NULL);
+	pthread_cond_init(&writer->queue_cond, NULL);
+	pthread_cond_init(&writer->done_cond, NULL);
+	if (pthread_create(&writer->thread, NULL, packet_writer_thread,
+		writer)) {
+		perror("pthread_create");
+		pthread_mutex_destroy(&writer->lock);
+		pthread_cond_destroy(&writer->queue_cond);
+		pthread_cond_destroy(&writer->done_cond);
+		g_free(writer);
+		writer = NULL;
+	}
+end:
+	return writer;
+}
+
+BT_HIDDEN
+void packet_writer_get(struct packet_writer *writer)
+{
+	if (!writer) {
+		return;
+	}
+
+	bt_ctf_ref_get(&writer->ref_count);
+}
+
+BT_HIDDEN
+void packet_writer_put(struct packet_writer *writer)
+{
+	if (!writer) {
+		return;
+	}
+
+	bt_ctf_ref_put(&writer->ref_count, packet_writer_destroy);
+}
+
+BT_HIDDEN
+void packet_writer_submit(struct packet_writer *writer,
+		struct packet_buffer *buffer)
+{
+	pthread_mutex_lock(&writer->lock);
+	buffer->busy = 1;
+	bt_list_add_tail(&buffer->node, &writer->queue);
+	pthread_cond_signal(&writer->queue_cond);
+	pthread_mutex_unlock(&writer->lock);
+}
+
+BT_HIDDEN
+int packet_writer_wait(struct packet_writer *writer,
+		struct packet_buffer *buffer)
+{
+	int ret;
+
+	pthread_mutex_lock(&writer->lock);
+	while (buffer->busy) {
+		pthread_cond_wait(&writer->done_cond, &writer->lock);
+	}
+
+	ret = buffer->error;
+	buffer->error = 0;
+	pthread_mutex_unlock(&writer->lock);
+	return ret;
+}
+
+static
+void packet_writer_destroy(struct bt_ctf_ref *ref)
+{
+	struct packet_writer *writer;
+
+	if (!ref) {
+		return;
+	}
+
+	writer = container_of(ref, struct packet_writer, ref_count);
+
+	/* Streams wait for their buffers to be written before releasing us */
+	pthread_mutex_lock(&writer->lock);
+	writer->quit = 1;
+	pthread_cond_signal(&writer->queue_cond);
+	pthread_mutex_unlock(&writer->lock);
+	if (pthread_join(writer->thread, NULL)) {
+		perror("pthread_join");
+	}
+
+	pthread_mutex_destroy(&writer->lock);
+	pthread_cond_destroy(&writer->queue_cond);
+	pthread_cond_destroy(&writer->done_cond);
+	g_free(writer);
+}
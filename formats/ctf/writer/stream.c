@@ -37,6 +37,10 @@
 #include <babeltrace/ctf-writer/functor-internal.h>
 #include <babeltrace/compiler.h>
 #include <babeltrace/align.h>
+#include <babeltrace/bitfield.h>
+#include <babeltrace/mmap-align.h>
+#include <sys/mman.h>
+#include <unistd.h>
 
 static
 void bt_ctf_stream_destroy(struct bt_ctf_ref *ref);
@@ -46,10 +50,21 @@ static
 int init_event_header(struct bt_ctf_stream_class *stream_class,
 		enum bt_ctf_byte_order byte_order);
 static
+int init_event_header_layout(struct bt_ctf_stream_class *stream_class);
+static
 int init_packet_context(struct bt_ctf_stream_class *stream_class,
 		enum bt_ctf_byte_order byte_order);
 static
 int set_structure_field_integer(struct bt_ctf_field *, char *, uint64_t);
+static
+int map_packet(struct bt_ctf_stream *stream);
+static
+int release_packet(struct bt_ctf_stream *stream);
+static
+int open_packet(struct bt_ctf_stream *stream, uint64_t timestamp);
+static
+int write_event_header(struct bt_ctf_stream *stream, uint32_t id,
+		uint64_t timestamp);
 
 struct bt_ctf_stream_class *bt_ctf_stream_class_create(const char *name)
 {
@@ -283,12 +298,11 @@ struct bt_ctf_stream *bt_ctf_stream_create(
 
 	bt_ctf_ref_init(&stream->ref_count);
 	stream->pos.fd = -1;
+	stream->packet_size = DEFAULT_PACKET_SIZE;
 	stream->id = stream_class->next_stream_id++;
 	stream->stream_class = stream_class;
 	bt_ctf_stream_class_get(stream_class);
 	bt_ctf_stream_class_freeze(stream_class);
-	stream->events = g_ptr_array_new_with_free_func(
-		(GDestroyNotify)bt_ctf_event_put);
 end:
 	return stream;
 }
@@ -319,12 +333,50 @@ int bt_ctf_stream_set_fd(struct bt_ctf_stream *stream, int fd)
 		goto end;
 	}
 
-	ctf_init_pos(&stream->pos, NULL, fd, O_RDWR);
+	/* Packets are mapped as they are opened, see map_packet() */
+	ctf_init_pos(&stream->pos, NULL, -1, O_RDWR);
 	stream->pos.fd = fd;
 end:
 	return ret;
 }
 
+BT_HIDDEN
+int bt_ctf_stream_set_packet_size(struct bt_ctf_stream *stream,
+		uint64_t packet_size)
+{
+	int ret = 0;
+
+	if (!stream || !packet_size || packet_size % getpagesize() ||
+		stream->packet_open) {
+		ret = -1;
+		goto end;
+	}
+
+	stream->packet_size = packet_size * CHAR_BIT;
+end:
+	return ret;
+}
+
+BT_HIDDEN
+int bt_ctf_stream_set_packet_writer(struct bt_ctf_stream *stream,
+		struct packet_writer *writer)
+{
+	int ret = 0;
+
+	if (!stream || !writer || stream->packet_writer ||
+		stream->packet_open) {
+		ret = -1;
+		goto end;
+	}
+
+	packet_writer_get(writer);
+	stream->packet_writer = writer;
+	/* Tells increase_packet_size() not to remap the stream file */
+	stream->pos.flags = MAP_PRIVATE | MAP_ANONYMOUS;
+end:
+	return ret;
+}
+
 void bt_ctf_stream_append_discarded_events(struct bt_ctf_stream *stream,
 		uint64_t event_count)
 {
@@ -339,7 +391,7 @@ int bt_ctf_stream_append_event(struct bt_ctf_stream *stream,
 		struct bt_ctf_event *event)
 {
 	int ret = 0;
-	uint64_t timestamp;
+	uint64_t timestamp, event_offset;
 
 	if (!stream || !event) {
 		ret = -1;
@@ -357,47 +409,61 @@ int bt_ctf_stream_append_event(struct bt_ctf_stream *stream,
 		goto end;
 	}
 
-	bt_ctf_event_get(event);
-	g_ptr_array_add(stream->events, event);
+	if (!stream->packet_open) {
+		ret = open_packet(stream, timestamp);
+		if (ret) {
+			goto end;
+		}
+	}
+
+	/*
+	 * Serialize the event right away; on error, rewind to its start so
+	 * that the packet only contains whole events.
+	 */
+	event_offset = stream->pos.offset;
+	ret = write_event_header(stream,
+		bt_ctf_event_class_get_id(event->event_class), timestamp);
+	if (ret) {
+		goto error;
+	}
+
+	ret = bt_ctf_event_serialize(event, &stream->pos);
+	if (ret) {
+		goto error;
+	}
+
+	stream->timestamp_end = timestamp;
+	stream->packet_event_count++;
 end:
 	return ret;
+error:
+	stream->pos.offset = event_offset;
+	return ret;
 }
 
 int bt_ctf_stream_flush(struct bt_ctf_stream *stream)
 {
 	int ret = 0;
-	size_t i;
-	uint64_t timestamp_begin, timestamp_end;
 	struct bt_ctf_stream_class *stream_class;
-	struct bt_ctf_field *integer = NULL;
-	struct ctf_stream_pos packet_context_pos;
 
 	if (!stream) {
 		ret = -1;
 		goto end;
 	}
 
-	if (!stream->events->len) {
+	if (!stream->packet_event_count) {
 		goto end;
 	}
 
-	if (stream->flush.func) {
-		stream->flush.func(stream, stream->flush.data);
-	}
-
 	stream_class = stream->stream_class;
-	timestamp_begin = ((struct bt_ctf_event *) g_ptr_array_index(
-		stream->events, 0))->timestamp;
-	timestamp_end = ((struct bt_ctf_event *) g_ptr_array_index(
-		stream->events, stream->events->len - 1))->timestamp;
 	ret = set_structure_field_integer(stream_class->packet_context,
-		"timestamp_begin", timestamp_begin);
+		"timestamp_begin", stream->timestamp_begin);
 	if (ret) {
 		goto end;
 	}
 
 	ret = set_structure_field_integer(stream_class->packet_context,
-		"timestamp_end", timestamp_end);
+		"timestamp_end", stream->timestamp_end);
 	if (ret) {
 		goto end;
 	}
@@ -408,66 +474,14 @@ int bt_ctf_stream_flush(struct bt_ctf_stream *stream)
 		goto end;
 	}
 
-	ret = set_structure_field_integer(stream_class->packet_context,
-		"content_size", UINT64_MAX);
-	if (ret) {
-		goto end;
-	}
-
-	ret = set_structure_field_integer(stream_class->packet_context,
-		"packet_size", UINT64_MAX);
-	if (ret) {
-		goto end;
-	}
-
-	/* Write packet context */
-	memcpy(&packet_context_pos, &stream->pos,
-	       sizeof(struct ctf_stream_pos));
-	ret = bt_ctf_field_serialize(stream_class->packet_context,
-		&stream->pos);
-	if (ret) {
-		goto end;
-	}
-
-	for (i = 0; i < stream->events->len; i++) {
-		struct bt_ctf_event *event = g_ptr_array_index(
-			stream->events, i);
-		uint32_t event_id = bt_ctf_event_class_get_id(
-			event->event_class);
-		uint64_t timestamp = bt_ctf_event_get_timestamp(event);
-
-		ret = set_structure_field_integer(stream_class->event_header,
-			"id", event_id);
-		if (ret) {
-			goto end;
-		}
-		ret = set_structure_field_integer(stream_class->event_header,
-			"timestamp", timestamp);
-		if (ret) {
-			goto end;
-		}
-
-		/* Write event header */
-		ret = bt_ctf_field_serialize(stream_class->event_header,
-			&stream->pos);
-		if (ret) {
-			goto end;
-		}
-
-		/* Write event content */
-		ret = bt_ctf_event_serialize(event, &stream->pos);
-		if (ret) {
-			goto end;
-		}
-	}
-
 	/*
 	 * Update the packet total size and content size and overwrite the
 	 * packet context.
 	 * Copy base_mma as the packet may have been remapped (e.g. when a
 	 * packet is resized).
 	 */
-	packet_context_pos.base_mma = stream->pos.base_mma;
+	stream->packet_context_pos.base_mma = stream->pos.base_mma;
+	stream->packet_context_pos.packet_size = stream->pos.packet_size;
 	ret = set_structure_field_integer(stream_class->packet_context,
 		"content_size", stream->pos.offset);
 	if (ret) {
@@ -481,15 +495,20 @@ int bt_ctf_stream_flush(struct bt_ctf_stream *stream)
 	}
 
 	ret = bt_ctf_field_serialize(stream_class->packet_context,
-		&packet_context_pos);
+		&stream->packet_context_pos);
+	if (ret) {
+		goto end;
+	}
+
+	ret = release_packet(stream);
 	if (ret) {
 		goto end;
 	}
 
-	g_ptr_array_set_size(stream->events, 0);
+	stream->packet_open = 0;
+	stream->packet_event_count = 0;
 	stream->flushed_packet_count++;
 end:
-	bt_ctf_field_put(integer);
 	return ret;
 }
 
@@ -514,6 +533,7 @@ void bt_ctf_stream_put(struct bt_ctf_stream *stream)
 static
 void bt_ctf_stream_destroy(struct bt_ctf_ref *ref)
 {
+	size_t i;
 	struct bt_ctf_stream *stream;
 
 	if (!ref) {
@@ -521,12 +541,41 @@ void bt_ctf_stream_destroy(struct bt_ctf_ref *ref)
 	}
 
 	stream = container_of(ref, struct bt_ctf_stream, ref_count);
+	/* Close the current packet rather than leave it half-written */
+	if (bt_ctf_stream_flush(stream)) {
+		fprintf(stderr, "[error] Unable to flush stream %" PRIu32 ".\n",
+			stream->id);
+	}
+
+	if (stream->packet_writer) {
+		/* A packet left open without events is not written out */
+		if (stream->pos.base_mma) {
+			stream->buffers[stream->current_buffer].mma =
+				stream->pos.base_mma;
+			stream->pos.base_mma = NULL;
+		}
+
+		for (i = 0; i < 2; i++) {
+			struct packet_buffer *buffer = &stream->buffers[i];
+
+			if (packet_writer_wait(stream->packet_writer, buffer)) {
+				fprintf(stderr, "[error] Unable to write packet of stream %" PRIu32 ".\n",
+					stream->id);
+			}
+
+			if (buffer->mma) {
+				munmap_align(buffer->mma);
+			}
+		}
+
+		packet_writer_put(stream->packet_writer);
+	}
+
 	ctf_fini_pos(&stream->pos);
 	if (close(stream->pos.fd)) {
 		perror("close");
 	}
 	bt_ctf_stream_class_put(stream->stream_class);
-	g_ptr_array_free(stream->events, TRUE);
 	g_free(stream);
 }
 
@@ -551,7 +600,6 @@ void bt_ctf_stream_class_destroy(struct bt_ctf_ref *ref)
 	}
 
 	bt_ctf_field_type_put(stream_class->event_header_type);
-	bt_ctf_field_put(stream_class->event_header);
 	bt_ctf_field_type_put(stream_class->packet_context_type);
 	bt_ctf_field_put(stream_class->packet_context);
 	bt_ctf_field_type_put(stream_class->event_context_type);
@@ -599,11 +647,7 @@ int init_event_header(struct bt_ctf_stream_class *stream_class,
 	}
 
 	stream_class->event_header_type = event_header_type;
-	stream_class->event_header = bt_ctf_field_create(
-		stream_class->event_header_type);
-	if (!stream_class->event_header) {
-		ret = -1;
-	}
+	ret = init_event_header_layout(stream_class);
 end:
 	if (ret) {
 		bt_ctf_field_type_put(event_header_type);
@@ -614,6 +658,68 @@ end:
 	return ret;
 }
 
+static
+int init_event_header_layout(struct bt_ctf_stream_class *stream_class)
+{
+	int ret = 0;
+	size_t i;
+	uint64_t offset = 0;
+	struct event_header_layout *layout =
+		&stream_class->event_header_layout;
+	struct bt_ctf_field_type_structure *structure = container_of(
+		stream_class->event_header_type,
+		struct bt_ctf_field_type_structure, parent);
+	GQuark id_quark = g_quark_from_static_string("id");
+	GQuark timestamp_quark = g_quark_from_static_string("timestamp");
+
+	/*
+	 * Field offsets are relative to the (aligned) start of the header,
+	 * which is valid since the structure's alignment is the largest of
+	 * its fields'.
+	 */
+	memset(layout, 0, sizeof(*layout));
+	layout->alignment = structure->parent.declaration->alignment;
+	for (i = 0; i < structure->fields->len; i++) {
+		struct structure_field *field =
+			g_ptr_array_index(structure->fields, i);
+		struct bt_ctf_field_type_integer *integer;
+		struct header_field_layout *field_layout;
+
+		if (bt_ctf_field_type_get_type_id(field->type) !=
+			CTF_TYPE_INTEGER) {
+			ret = -1;
+			goto end;
+		}
+
+		if (field->name == id_quark) {
+			field_layout = &layout->id;
+		} else if (field->name == timestamp_quark) {
+			field_layout = &layout->timestamp;
+		} else {
+			ret = -1;
+			goto end;
+		}
+
+		integer = container_of(field->type,
+			struct bt_ctf_field_type_integer, parent);
+		offset += offset_align(offset,
+			integer->declaration.p.alignment);
+		field_layout->offset = offset;
+		field_layout->len = integer->declaration.len;
+		field_layout->byte_order = integer->declaration.byte_order;
+		offset += integer->declaration.len;
+	}
+
+	if (!layout->id.len || !layout->timestamp.len) {
+		ret = -1;
+		goto end;
+	}
+
+	layout->len = offset;
+end:
+	return ret;
+}
+
 static
 int init_packet_context(struct bt_ctf_stream_class *stream_class,
 		enum bt_ctf_byte_order byte_order)
@@ -701,3 +807,215 @@ end:
 	bt_ctf_field_put(integer);
 	return ret;
 }
+
+/*
+ * Map the memory of a new packet: the stream file itself in synchronous
+ * mode, or the next packet buffer once the packet writer is done with it.
+ */
+static
+int map_packet(struct bt_ctf_stream *stream)
+{
+	int ret = 0;
+	struct ctf_stream_pos *pos = &stream->pos;
+	size_t len = stream->packet_size / CHAR_BIT;
+
+	pos->mmap_offset = stream->next_packet_offset;
+	pos->mmap_base_offset = 0;
+	pos->packet_size = stream->packet_size;
+	pos->content_size = -1U;	/* Unknown at this point */
+	pos->offset = 0;
+	if (stream->packet_writer) {
+		struct packet_buffer *buffer =
+			&stream->buffers[stream->current_buffer];
+
+		ret = packet_writer_wait(stream->packet_writer, buffer);
+		if (ret) {
+			goto end;
+		}
+
+		/*
+		 * A buffer grown by a large packet is kept, see
+		 * increase_packet_size(): it only grows the packet within
+		 * the mapping from then on.
+		 */
+		if (buffer->mma && buffer->mma->length < len) {
+			munmap_align(buffer->mma);
+			buffer->mma = NULL;
+		}
+
+		if (!buffer->mma) {
+			buffer->mma = mmap_align(len, PROT_READ | PROT_WRITE,
+				pos->flags, -1, 0);
+			if (buffer->mma == MAP_FAILED) {
+				buffer->mma = NULL;
+				ret = -1;
+				goto end;
+			}
+		}
+
+		pos->base_mma = buffer->mma;
+	} else {
+		ret = posix_fallocate(pos->fd, pos->mmap_offset, len);
+		if (ret) {
+			ret = -ret;
+			goto end;
+		}
+
+		pos->base_mma = mmap_align(len, pos->prot, pos->flags, pos->fd,
+			pos->mmap_offset);
+		if (pos->base_mma == MAP_FAILED) {
+			pos->base_mma = NULL;
+			ret = -1;
+		}
+	}
+end:
+	return ret;
+}
+
+/*
+ * Hand a complete packet over to the packet writer, or unmap it from the
+ * stream file.
+ */
+static
+int release_packet(struct bt_ctf_stream *stream)
+{
+	int ret = 0;
+	struct ctf_stream_pos *pos = &stream->pos;
+
+	stream->next_packet_offset = pos->mmap_offset +
+		pos->packet_size / CHAR_BIT;
+	if (stream->packet_writer) {
+		struct packet_buffer *buffer =
+			&stream->buffers[stream->current_buffer];
+
+		/* The packet may have been moved to a larger mapping */
+		buffer->mma = pos->base_mma;
+		buffer->fd = pos->fd;
+		buffer->offset = pos->mmap_offset;
+		buffer->len = pos->packet_size / CHAR_BIT;
+		buffer->content_len = (pos->offset + CHAR_BIT - 1) / CHAR_BIT;
+		packet_writer_submit(stream->packet_writer, buffer);
+		stream->current_buffer ^= 1;
+	} else {
+		ret = munmap_align(pos->base_mma);
+	}
+
+	pos->base_mma = NULL;
+	return ret;
+}
+
+/*
+ * Start a new packet: write its header and a placeholder packet context
+ * which is overwritten once the packet is flushed.
+ */
+static
+int open_packet(struct bt_ctf_stream *stream, uint64_t timestamp)
+{
+	int ret = 0;
+	struct bt_ctf_stream_class *stream_class = stream->stream_class;
+
+	ret = map_packet(stream);
+	if (ret) {
+		goto end;
+	}
+
+	if (stream->flush.func) {
+		stream->flush.func(stream, stream->flush.data);
+	}
+
+	ret = set_structure_field_integer(stream_class->packet_context,
+		"timestamp_begin", timestamp);
+	if (ret) {
+		goto end;
+	}
+
+	ret = set_structure_field_integer(stream_class->packet_context,
+		"timestamp_end", timestamp);
+	if (ret) {
+		goto end;
+	}
+
+	ret = set_structure_field_integer(stream_class->packet_context,
+		"events_discarded", stream->events_discarded);
+	if (ret) {
+		goto end;
+	}
+
+	ret = set_structure_field_integer(stream_class->packet_context,
+		"content_size", UINT64_MAX);
+	if (ret) {
+		goto end;
+	}
+
+	ret = set_structure_field_integer(stream_class->packet_context,
+		"packet_size", UINT64_MAX);
+	if (ret) {
+		goto end;
+	}
+
+	memcpy(&stream->packet_context_pos, &stream->pos,
+	       sizeof(struct ctf_stream_pos));
+	ret = bt_ctf_field_serialize(stream_class->packet_context,
+		&stream->pos);
+	if (ret) {
+		goto end;
+	}
+
+	stream->timestamp_begin = timestamp;
+	stream->timestamp_end = timestamp;
+	stream->packet_event_count = 0;
+	stream->packet_open = 1;
+end:
+	return ret;
+}
+
+static inline
+void write_header_field(char *base, uint64_t offset,
+		struct header_field_layout *field, uint64_t value)
+{
+	if (field->byte_order == LITTLE_ENDIAN) {
+		bt_bitfield_write_le(base, unsigned long,
+			offset + field->offset, field->len, value);
+	} else {
+		bt_bitfield_write_be(base, unsigned long,
+			offset + field->offset, field->len, value);
+	}
+}
+
+/*
+ * Write the event header directly in the packet mapping using the
+ * stream class' precomputed layout.
+ */
+static
+int write_event_header(struct bt_ctf_stream *stream, uint32_t id,
+		uint64_t timestamp)
+{
+	int ret = 0;
+	struct ctf_stream_pos *pos = &stream->pos;
+	struct event_header_layout *layout =
+		&stream->stream_class->event_header_layout;
+	char *base;
+
+	while (!ctf_pos_access_ok(pos,
+		offset_align(pos->offset, layout->alignment) +
+			layout->len)) {
+		ret = increase_packet_size(pos);
+		if (ret) {
+			goto end;
+		}
+	}
+
+	if (!ctf_align_pos(pos, layout->alignment)) {
+		ret = -1;
+		goto end;
+	}
+
+	base = mmap_align_addr(pos->base_mma) + pos->mmap_base_offset;
+	write_header_field(base, pos->offset, &layout->id, id);
+	write_header_field(base, pos->offset, &layout->timestamp, timestamp);
+	if (!ctf_move_pos(pos, layout->len)) {
+		ret = -1;
+	}
+end:
+	return ret;
+}
@@ -198,6 +198,7 @@ void bt_ctf_writer_destroy(struct bt_ctf_ref *ref)
 
 	bt_ctf_field_type_put(writer->trace_packet_header_type);
 	bt_ctf_field_put(writer->trace_packet_header);
+	packet_writer_put(writer->packet_writer);
 	g_free(writer);
 }
 
@@ -224,6 +225,25 @@ struct bt_ctf_stream *bt_ctf_writer_create_stream(struct bt_ctf_writer *writer,
 		goto error;
 	}
 
+	if (writer->packet_size &&
+		bt_ctf_stream_set_packet_size(stream, writer->packet_size)) {
+		goto error;
+	}
+
+	if (writer->async_flush) {
+		if (!writer->packet_writer) {
+			writer->packet_writer = packet_writer_create();
+			if (!writer->packet_writer) {
+				goto error;
+			}
+		}
+
+		if (bt_ctf_stream_set_packet_writer(stream,
+			writer->packet_writer)) {
+			goto error;
+		}
+	}
+
 	bt_ctf_stream_set_flush_callback(stream, (flush_func)stream_flush_cb,
 		writer);
 	ret = bt_ctf_stream_class_set_byte_order(stream->stream_class,
@@ -522,6 +542,37 @@ end:
 	return ret;
 }
 
+int bt_ctf_writer_set_packet_size(struct bt_ctf_writer *writer,
+		uint64_t packet_size)
+{
+	int ret = 0;
+
+	if (!writer || writer->frozen || !packet_size ||
+		packet_size % getpagesize()) {
+		ret = -1;
+		goto end;
+	}
+
+	writer->packet_size = packet_size;
+end:
+	return ret;
+}
+
+int bt_ctf_writer_set_async_flush(struct bt_ctf_writer *writer,
+		int async_flush)
+{
+	int ret = 0;
+
+	if (!writer || writer->frozen) {
+		ret = -1;
+		goto end;
+	}
+
+	writer->async_flush = !!async_flush;
+end:
+	return ret;
+}
+
 void bt_ctf_writer_get(struct bt_ctf_writer *writer)
 {
 	if (!writer) {
@@ -709,12 +760,7 @@ void stream_flush_cb(struct bt_ctf_stream *stream, struct bt_ctf_writer *writer)
 {
 	struct bt_ctf_field *stream_id;
 
-	/* Start a new packet in the stream */
-	if (stream->flushed_packet_count) {
-		/* ctf_init_pos has already initialized the first packet */
-		ctf_packet_seek(&stream->pos.parent, 0, SEEK_CUR);
-	}
-
+	/* A new packet was just mapped by the stream */
 	stream_id = bt_ctf_field_structure_get_field(
 		writer->trace_packet_header, "stream_id");
 	bt_ctf_field_unsigned_integer_set_value(stream_id, stream->id);
@@ -32,6 +32,8 @@
 #include <errno.h>
 #include <inttypes.h>
 #include <fcntl.h>
+#include <poll.h>
+#include <time.h>
 #include <sys/mman.h>
 
 #include <babeltrace/ctf/ctf-index.h>
@@ -57,10 +59,7 @@
  */
 #define zmalloc(x) calloc(1, x)
 
-#ifndef max_t
-#define max_t(type, a, b)	\
-	((type) (a) > (type) (b) ? (type) (a) : (type) (b))
-#endif
+#define NSEC_PER_SEC 1000000000ULL
 
 int lttng_live_connect_viewer(struct lttng_live_ctx *ctx, char *hostname,
 		int port)
@@ -156,7 +155,13 @@ error:
 	return ret;
 }
 
-int lttng_live_list_sessions(struct lttng_live_ctx *ctx, const char *path)
+/*
+ * Receive the list of sessions from the relay daemon, printing it if
+ * path is not NULL. The live timer of the sessions we follow is updated
+ * from it.
+ */
+static
+int get_session_list(struct lttng_live_ctx *ctx, const char *path)
 {
 	struct lttng_viewer_cmd cmd;
 	struct lttng_viewer_list_sessions list;
@@ -190,9 +195,13 @@ int lttng_live_list_sessions(struct lttng_live_ctx *ctx, const char *path)
 	assert(ret_len == sizeof(list));
 
 	sessions_count = be32toh(list.sessions_count);
-	fprintf(stdout, "%u active session(s)%c\n", sessions_count,
-			sessions_count > 0 ? ':' : ' ');
+	if (path) {
+		fprintf(stdout, "%u active session(s)%c\n", sessions_count,
+				sessions_count > 0 ? ':' : ' ');
+	}
 	for (i = 0; i < sessions_count; i++) {
+		int j;
+
 		do {
 			ret_len = recv(ctx->control_sock, &lsession, sizeof(lsession), 0);
 		} while (ret_len < 0 && errno == EINTR);
@@ -205,6 +214,16 @@ int lttng_live_list_sessions(struct lttng_live_ctx *ctx, const char *path)
 		lsession.hostname[LTTNG_VIEWER_HOST_NAME_MAX - 1] = '\0';
 		lsession.session_name[LTTNG_VIEWER_NAME_MAX - 1] = '\0';
 
+		for (j = 0; j < ctx->sessions->len; j++) {
+			struct lttng_live_session *session =
+				g_ptr_array_index(ctx->sessions, j);
+
+			if (session->id == be64toh(lsession.id))
+				session->live_timer_interval =
+					be32toh(lsession.live_timer);
+		}
+		if (!path)
+			continue;
 		fprintf(stdout, "%s/%" PRIu64 " : %s on host %s (timer = %u, "
 				"%u stream(s), %u client(s) connected)\n",
 				path, be64toh(lsession.id),
@@ -220,6 +239,11 @@ error:
 	return ret;
 }
 
+int lttng_live_list_sessions(struct lttng_live_ctx *ctx, const char *path)
+{
+	return get_session_list(ctx, path);
+}
+
 int lttng_live_ctf_trace_assign(struct lttng_live_viewer_stream *stream,
 		uint64_t ctf_trace_id)
 {
@@ -245,7 +269,8 @@ int lttng_live_ctf_trace_assign(struct lttng_live_viewer_stream *stream,
 	return ret;
 }
 
-int lttng_live_attach_session(struct lttng_live_ctx *ctx, uint64_t id)
+int lttng_live_attach_session(struct lttng_live_ctx *ctx,
+		struct lttng_live_session *session)
 {
 	struct lttng_viewer_cmd cmd;
 	struct lttng_viewer_attach_session_request rq;
@@ -259,7 +284,7 @@ int lttng_live_attach_session(struct lttng_live_ctx *ctx, uint64_t id)
 	cmd.cmd_version = 0;
 
 	memset(&rq, 0, sizeof(rq));
-	rq.session_id = htobe64(id);
+	rq.session_id = htobe64(session->id);
 	// TODO: add cmd line parameter to select seek beginning
 	// rq.seek = htobe32(LTTNG_VIEWER_SEEK_BEGINNING);
 	rq.seek = htobe32(LTTNG_VIEWER_SEEK_LAST);
@@ -323,20 +348,23 @@ int lttng_live_attach_session(struct lttng_live_ctx *ctx, uint64_t id)
 		goto end;
 	}
 
-	ctx->session->stream_count = be32toh(rp.streams_count);
+	/* Streams of a previous attach are not referenced anymore. */
+	g_free(session->streams);
+	session->streams = NULL;
+	session->stream_count = be32toh(rp.streams_count);
 	/*
 	 * When the session is created but not started, we do an active wait
 	 * until it starts. It allows the viewer to start processing the trace
 	 * as soon as the session starts.
 	 */
-	if (ctx->session->stream_count == 0) {
+	if (session->stream_count == 0) {
 		ret = 0;
 		goto end;
 	}
 	printf_verbose("Waiting for %" PRIu64 " streams:\n",
-		ctx->session->stream_count);
-	ctx->session->streams = g_new0(struct lttng_live_viewer_stream,
-			ctx->session->stream_count);
+		session->stream_count);
+	session->streams = g_new0(struct lttng_live_viewer_stream,
+			session->stream_count);
 	for (i = 0; i < be32toh(rp.streams_count); i++) {
 		do {
 			ret_len = recv(ctx->control_sock, &stream, sizeof(stream), 0);
@@ -353,11 +381,11 @@ int lttng_live_attach_session(struct lttng_live_ctx *ctx, uint64_t id)
 		printf_verbose("    stream %" PRIu64 " : %s/%s\n",
 				be64toh(stream.id), stream.path_name,
 				stream.channel_name);
-		ctx->session->streams[i].id = be64toh(stream.id);
-		ctx->session->streams[i].session = ctx->session;
+		session->streams[i].id = be64toh(stream.id);
+		session->streams[i].session = session;
 
-		ctx->session->streams[i].first_read = 1;
-		ctx->session->streams[i].mmap_size = 0;
+		session->streams[i].first_read = 1;
+		BT_INIT_LIST_HEAD(&session->streams[i].packets);
 
 		if (be32toh(stream.metadata_flag)) {
 			char *path;
@@ -374,12 +402,12 @@ int lttng_live_attach_session(struct lttng_live_ctx *ctx, uint64_t id)
 				ret = -1;
 				goto error;
 			}
-			ctx->session->streams[i].metadata_flag = 1;
-			snprintf(ctx->session->streams[i].path,
-					sizeof(ctx->session->streams[i].path),
+			session->streams[i].metadata_flag = 1;
+			snprintf(session->streams[i].path,
+					sizeof(session->streams[i].path),
 					"%s/%s", path,
 					stream.channel_name);
-			ret = open(ctx->session->streams[i].path,
+			ret = open(session->streams[i].path,
 					O_WRONLY | O_CREAT | O_TRUNC,
 					S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP);
 			if (ret < 0) {
@@ -387,10 +415,10 @@ int lttng_live_attach_session(struct lttng_live_ctx *ctx, uint64_t id)
 				free(path);
 				goto error;
 			}
-			ctx->session->streams[i].fd = ret;
+			session->streams[i].fd = ret;
 			free(path);
 		}
-		ret = lttng_live_ctf_trace_assign(&ctx->session->streams[i],
+		ret = lttng_live_ctf_trace_assign(&session->streams[i],
 				be64toh(stream.ctf_trace_id));
 		if (ret < 0) {
 			goto error;
@@ -404,148 +432,6 @@ error:
 	return ret;
 }
 
-static
-int get_data_packet(struct lttng_live_ctx *ctx,
-		struct ctf_stream_pos *pos,
-		struct lttng_live_viewer_stream *stream, uint64_t offset,
-		uint64_t len)
-{
-	struct lttng_viewer_cmd cmd;
-	struct lttng_viewer_get_packet rq;
-	struct lttng_viewer_trace_packet rp;
-	ssize_t ret_len;
-	int ret;
-
-	cmd.cmd = htobe32(LTTNG_VIEWER_GET_PACKET);
-	cmd.data_size = sizeof(rq);
-	cmd.cmd_version = 0;
-
-	memset(&rq, 0, sizeof(rq));
-	rq.stream_id = htobe64(stream->id);
-	/* Already in big endian. */
-	rq.offset = offset;
-	rq.len = htobe32(len);
-
-	do {
-		ret_len = send(ctx->control_sock, &cmd, sizeof(cmd), 0);
-	} while (ret_len < 0 && errno == EINTR);
-	if (ret_len < 0) {
-		fprintf(stderr, "[error] Error sending cmd\n");
-		ret = ret_len;
-		goto error;
-	}
-	assert(ret_len == sizeof(cmd));
-
-	do {
-		ret_len = send(ctx->control_sock, &rq, sizeof(rq), 0);
-	} while (ret_len < 0 && errno == EINTR);
-	if (ret_len < 0) {
-		fprintf(stderr, "[error] Error sending get_data_packet request\n");
-		ret = ret_len;
-		goto error;
-	}
-	assert(ret_len == sizeof(rq));
-
-	do {
-		ret_len = recv(ctx->control_sock, &rp, sizeof(rp), 0);
-	} while (ret_len < 0 && errno == EINTR);
-	if (ret_len < 0) {
-		fprintf(stderr, "[error] Error receiving data response\n");
-		ret = ret_len;
-		goto error;
-	}
-	if (ret_len != sizeof(rp)) {
-		fprintf(stderr, "[error] get_data_packet: expected %" PRId64
-				", received %" PRId64 "\n", ret_len,
-				sizeof(rp));
-		ret = -1;
-		goto error;
-	}
-
-	rp.flags = be32toh(rp.flags);
-
-	switch (be32toh(rp.status)) {
-	case LTTNG_VIEWER_GET_PACKET_OK:
-		len = be32toh(rp.len);
-		printf_verbose("get_data_packet: Ok, packet size : %" PRIu64
-				"\n", len);
-		break;
-	case LTTNG_VIEWER_GET_PACKET_RETRY:
-		printf_verbose("get_data_packet: retry\n");
-		ret = -1;
-		goto end;
-	case LTTNG_VIEWER_GET_PACKET_ERR:
-		if (rp.flags & LTTNG_VIEWER_FLAG_NEW_METADATA) {
-			printf_verbose("get_data_packet: new metadata needed\n");
-			ret = 0;
-			goto end;
-		}
-		fprintf(stderr, "[error] get_data_packet: error\n");
-		ret = -1;
-		goto end;
-	case LTTNG_VIEWER_GET_PACKET_EOF:
-		ret = -2;
-		goto error;
-	default:
-		printf_verbose("get_data_packet: unknown\n");
-		assert(0);
-		ret = -1;
-		goto end;
-	}
-
-	if (len <= 0) {
-		ret = -1;
-		goto end;
-	}
-
-	if (len > stream->mmap_size) {
-		uint64_t new_size;
-
-		new_size = max_t(uint64_t, len, stream->mmap_size << 1);
-		if (pos->base_mma) {
-			/* unmap old base */
-			ret = munmap_align(pos->base_mma);
-			if (ret) {
-				fprintf(stderr, "[error] Unable to unmap old base: %s.\n",
-					strerror(errno));
-				ret = -1;
-				goto error;
-			}
-			pos->base_mma = NULL;
-		}
-		pos->base_mma = mmap_align(new_size,
-				PROT_READ | PROT_WRITE,
-				MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
-		if (pos->base_mma == MAP_FAILED) {
-			fprintf(stderr, "[error] mmap error %s.\n",
-				strerror(errno));
-			pos->base_mma = NULL;
-			ret = -1;
-			goto error;
-		}
-
-		stream->mmap_size = new_size;
-		printf_verbose("Expanding stream mmap size to %" PRIu64 " bytes\n",
-				stream->mmap_size);
-	}
-
-	do {
-		ret_len = recv(ctx->control_sock,
-			mmap_align_addr(pos->base_mma), len,
-			MSG_WAITALL);
-	} while (ret_len < 0 && errno == EINTR);
-	if (ret_len < 0) {
-		fprintf(stderr, "[error] Error receiving trace packet\n");
-		ret = ret_len;
-		goto error;
-	}
-	assert(ret_len == len);
-
-end:
-error:
-	return ret;
-}
-
 /*
  * Return number of metadata bytes written or a negative value on error.
  */
@@ -662,135 +548,872 @@ error:
 }
 
 /*
- * Get one index for a stream.
+ * Packet requests are pipelined on the control connection: the relay
+ * daemon answers commands in the order it receives them, so several
+ * GET_NEXT_INDEX and GET_PACKET requests can be outstanding at once,
+ * across streams. Replies are matched with the inflight list, in order,
+ * and stored in per-stream packet queues until the iterator needs them.
  *
- * Returns 0 on success or a negative value on error.
+ * The total number of outstanding requests is bounded so the requests
+ * waiting to be read by the relay daemon always fit in the socket
+ * buffers: sending them never blocks while the relay daemon waits for
+ * us to read its replies.
  */
+#define LTTNG_LIVE_PREFETCH_DEPTH	4
+#define LTTNG_LIVE_MAX_INFLIGHT		64
+
 static
-int get_next_index(struct lttng_live_ctx *ctx,
-		struct lttng_live_viewer_stream *viewer_stream,
-		struct packet_index *index)
+int recv_reply(struct lttng_live_ctx *ctx);
+
+static
+uint64_t get_time_ns(clockid_t clk_id)
+{
+	struct timespec ts;
+
+	clock_gettime(clk_id, &ts);
+	return (uint64_t) ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+/*
+ * The relay daemon had no new packet for the stream: it is not asked
+ * again before one live timer period.
+ */
+static
+void stall_stream(struct lttng_live_viewer_stream *viewer_stream)
+{
+	viewer_stream->stalled = 1;
+	viewer_stream->stall_time = get_time_ns(CLOCK_MONOTONIC);
+}
+
+static
+void queue_request(struct lttng_live_ctx *ctx, uint32_t cmd_id,
+		const void *rq, size_t rq_len,
+		struct lttng_live_packet *packet)
 {
 	struct lttng_viewer_cmd cmd;
-	struct lttng_viewer_get_next_index rq;
-	struct lttng_viewer_index rp;
-	int ret;
-	uint64_t metadata_len;
-	ssize_t ret_len;
 
-	cmd.cmd = htobe32(LTTNG_VIEWER_GET_NEXT_INDEX);
-	cmd.data_size = sizeof(rq);
+	cmd.cmd = htobe32(cmd_id);
+	cmd.data_size = rq_len;
 	cmd.cmd_version = 0;
 
-	memset(&rq, 0, sizeof(rq));
-	rq.stream_id = htobe64(viewer_stream->id);
+	g_byte_array_append(ctx->send_buf, (const guint8 *) &cmd, sizeof(cmd));
+	g_byte_array_append(ctx->send_buf, rq, rq_len);
+	bt_list_add_tail(&packet->inflight_node, &ctx->inflight);
+	ctx->inflight_count++;
+}
 
-retry:
-	do {
-		ret_len = send(ctx->control_sock, &cmd, sizeof(cmd), 0);
-	} while (ret_len < 0 && errno == EINTR);
-	if (ret_len < 0) {
-		fprintf(stderr, "[error] Error sending cmd\n");
-		ret = ret_len;
-		goto error;
-	}
-	assert(ret_len == sizeof(cmd));
+/*
+ * Send all queued requests at once.
+ */
+static
+int flush_requests(struct lttng_live_ctx *ctx)
+{
+	ssize_t ret_len;
+	size_t sent = 0;
 
-	do {
-		ret_len = send(ctx->control_sock, &rq, sizeof(rq), 0);
-	} while (ret_len < 0 && errno == EINTR);
-	if (ret_len < 0) {
-		fprintf(stderr, "[error] Error sending get_next_index request\n");
-		ret = ret_len;
-		goto error;
+	while (sent < ctx->send_buf->len) {
+		do {
+			ret_len = send(ctx->control_sock,
+				ctx->send_buf->data + sent,
+				ctx->send_buf->len - sent, 0);
+		} while (ret_len < 0 && errno == EINTR);
+		if (ret_len < 0) {
+			fprintf(stderr, "[error] Error sending requests\n");
+			return -1;
+		}
+		sent += ret_len;
 	}
-	assert(ret_len == sizeof(rq));
+	g_byte_array_set_size(ctx->send_buf, 0);
+	return 0;
+}
 
-	do {
-		ret_len = recv(ctx->control_sock, &rp, sizeof(rp), 0);
-	} while (ret_len < 0 && errno == EINTR);
-	if (ret_len < 0) {
-		fprintf(stderr, "[error] Error receiving index response\n");
-		ret = ret_len;
-		goto error;
-	}
-	assert(ret_len == sizeof(rp));
+static
+void request_index(struct lttng_live_ctx *ctx,
+		struct lttng_live_packet *packet)
+{
+	struct lttng_viewer_get_next_index rq;
 
-	rp.flags = be32toh(rp.flags);
+	memset(&rq, 0, sizeof(rq));
+	rq.stream_id = htobe64(packet->stream->id);
+	packet->state = LTTNG_LIVE_PACKET_GET_INDEX;
+	queue_request(ctx, LTTNG_VIEWER_GET_NEXT_INDEX, &rq, sizeof(rq),
+			packet);
+}
 
-	switch (be32toh(rp.status)) {
-	case LTTNG_VIEWER_INDEX_INACTIVE:
-		printf_verbose("get_next_index: inactive\n");
-		memset(index, 0, sizeof(struct packet_index));
-		index->ts_cycles.timestamp_end = be64toh(rp.timestamp_end);
-		break;
-	case LTTNG_VIEWER_INDEX_OK:
-		printf_verbose("get_next_index: Ok, need metadata update : %u\n",
-				rp.flags & LTTNG_VIEWER_FLAG_NEW_METADATA);
-		index->offset = be64toh(rp.offset);
-		index->packet_size = be64toh(rp.packet_size);
-		index->content_size = be64toh(rp.content_size);
-		index->ts_cycles.timestamp_begin = be64toh(rp.timestamp_begin);
-		index->ts_cycles.timestamp_end = be64toh(rp.timestamp_end);
-		index->events_discarded = be64toh(rp.events_discarded);
+void lttng_live_pool_init(struct lttng_live_buffer_pool *pool,
+		uint64_t max_len)
+{
+	int i;
 
-		if (rp.flags & LTTNG_VIEWER_FLAG_NEW_METADATA) {
-			printf_verbose("get_next_index: new metadata needed\n");
-			ret = get_new_metadata(ctx, viewer_stream,
-					&metadata_len);
-			if (ret < 0) {
-				goto error;
-			}
-		}
-		break;
-	case LTTNG_VIEWER_INDEX_RETRY:
-		printf_verbose("get_next_index: retry\n");
-		sleep(1);
-		goto retry;
-	case LTTNG_VIEWER_INDEX_HUP:
-		printf_verbose("get_next_index: stream hung up\n");
-		viewer_stream->id = -1ULL;
-		viewer_stream->fd = -1;
-		index->offset = EOF;
-		break;
-	case LTTNG_VIEWER_INDEX_ERR:
-		fprintf(stderr, "[error] get_next_index: error\n");
-		ret = -1;
-		goto error;
-	default:
-		fprintf(stderr, "[error] get_next_index: unkwown value\n");
-		ret = -1;
-		goto error;
-	}
+	memset(pool, 0, sizeof(*pool));
+	pool->max_len = max_len ? max_len : LTTNG_LIVE_DEFAULT_POOL_LEN;
+	for (i = 0; i < LTTNG_LIVE_POOL_NR_CLASSES; i++)
+		pool->free[i] = g_ptr_array_new();
+}
 
-	ret = 0;
+static
+void print_pool_stats(struct lttng_live_buffer_pool *pool)
+{
+	printf_verbose("Packet buffers : %" PRIu64 " KiB mapped (peak %" PRIu64
+			" KiB, max %" PRIu64 " KiB), %" PRIu64 " KiB in use, "
+			"%" PRIu64 " mapped, %" PRIu64 " reused, %" PRIu64
+			" deferred\n",
+			pool->mapped_len >> 10, pool->peak_len >> 10,
+			pool->max_len >> 10, pool->used_len >> 10,
+			pool->nr_maps, pool->nr_reuses, pool->nr_deferred);
+}
 
-error:
-	return ret;
+/*
+ * Size class of a buffer of len bytes, or -1 if it is too large to be
+ * pooled.
+ */
+static
+int pool_class(uint64_t len)
+{
+	int order = LTTNG_LIVE_POOL_MIN_ORDER;
+
+	while ((1ULL << order) < len)
+		order++;
+	order -= LTTNG_LIVE_POOL_MIN_ORDER;
+	if (order >= LTTNG_LIVE_POOL_NR_CLASSES)
+		return -1;
+	return order;
 }
 
-void ctf_live_packet_seek(struct bt_stream_pos *stream_pos, size_t index,
-		int whence)
+static
+void pool_unmap(struct lttng_live_buffer_pool *pool, struct mmap_align *mma)
 {
-	struct ctf_stream_pos *pos;
-	struct ctf_file_stream *file_stream;
-	struct packet_index *prev_index = NULL, *cur_index;
-	struct lttng_live_viewer_stream *viewer_stream;
-	struct lttng_live_session *session;
 	int ret;
 
-retry:
-	pos = ctf_pos(stream_pos);
-	file_stream = container_of(pos, struct ctf_file_stream, pos);
-	viewer_stream = (struct lttng_live_viewer_stream *) pos->priv;
-	session = viewer_stream->session;
+	pool->mapped_len -= mma->length;
+	ret = munmap_align(mma);
+	if (ret) {
+		fprintf(stderr, "[error] Unable to unmap packet buffer: %s.\n",
+			strerror(errno));
+	}
+}
 
-	switch (pos->packet_index->len) {
-	case 0:
-		g_array_set_size(pos->packet_index, 1);
-		cur_index = &g_array_index(pos->packet_index,
-				struct packet_index, 0);
-		break;
+/*
+ * Unmap free buffers, largest first, until len more bytes fit within
+ * the pool bound. Returns 0 if they fit.
+ */
+static
+int pool_make_room(struct lttng_live_buffer_pool *pool, uint64_t len)
+{
+	int i;
+
+	for (i = LTTNG_LIVE_POOL_NR_CLASSES - 1; i >= 0; i--) {
+		GPtrArray *free_list = pool->free[i];
+
+		while (free_list->len
+				&& pool->mapped_len + len > pool->max_len) {
+			pool_unmap(pool, g_ptr_array_remove_index(free_list,
+					free_list->len - 1));
+		}
+	}
+	return pool->mapped_len + len > pool->max_len ? -1 : 0;
+}
+
+/*
+ * Get a buffer of at least len bytes. Unless force is set, return NULL
+ * instead of going over the pool bound.
+ */
+static
+struct mmap_align *pool_get(struct lttng_live_buffer_pool *pool,
+		uint64_t len, int force)
+{
+	struct mmap_align *mma;
+	uint64_t size;
+	int class;
+
+	class = pool_class(len);
+	if (class >= 0) {
+		GPtrArray *free_list = pool->free[class];
+
+		if (free_list->len) {
+			mma = g_ptr_array_remove_index(free_list,
+					free_list->len - 1);
+			pool->nr_reuses++;
+			goto end;
+		}
+		size = 1ULL << (class + LTTNG_LIVE_POOL_MIN_ORDER);
+	} else {
+		size = len;
+	}
+	if (pool_make_room(pool, size) < 0 && !force)
+		return NULL;
+	mma = mmap_align(size, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (mma == MAP_FAILED) {
+		fprintf(stderr, "[error] mmap error %s.\n", strerror(errno));
+		return NULL;
+	}
+	pool->mapped_len += size;
+	if (pool->mapped_len > pool->peak_len)
+		pool->peak_len = pool->mapped_len;
+	pool->nr_maps++;
+end:
+	pool->used_len += mma->length;
+	return mma;
+}
+
+static
+void pool_put(struct lttng_live_buffer_pool *pool, struct mmap_align *mma)
+{
+	int class;
+
+	if (!mma)
+		return;
+	pool->used_len -= mma->length;
+	class = pool_class(mma->length);
+	if (class < 0 || pool->mapped_len > pool->max_len) {
+		pool_unmap(pool, mma);
+		return;
+	}
+	g_ptr_array_add(pool->free[class], mma);
+}
+
+void lttng_live_pool_fini(struct lttng_live_buffer_pool *pool)
+{
+	int i;
+
+	print_pool_stats(pool);
+	for (i = 0; i < LTTNG_LIVE_POOL_NR_CLASSES; i++) {
+		GPtrArray *free_list = pool->free[i];
+
+		while (free_list->len) {
+			pool_unmap(pool, g_ptr_array_remove_index(free_list,
+					free_list->len - 1));
+		}
+		g_ptr_array_free(free_list, TRUE);
+	}
+}
+
+/*
+ * Request the data of a packet whose index was received. The buffer is
+ * taken from the pool first: if the pool is full, the request is put
+ * off until the iterator needs the packet (force set) or buffers are
+ * released.
+ */
+static
+void request_data(struct lttng_live_ctx *ctx,
+		struct lttng_live_packet *packet, int force)
+{
+	struct lttng_live_buffer_pool *pool = &ctx->pool;
+	struct lttng_viewer_get_packet rq;
+
+	if (!packet->mma) {
+		packet->mma = pool_get(pool,
+				packet->index.packet_size / CHAR_BIT, force);
+		if (!packet->mma) {
+			if (force) {
+				packet->error = -ENOMEM;
+				packet->state = LTTNG_LIVE_PACKET_READY;
+				return;
+			}
+			if (packet->state != LTTNG_LIVE_PACKET_DEFERRED) {
+				packet->state = LTTNG_LIVE_PACKET_DEFERRED;
+				pool->deferred++;
+				pool->nr_deferred++;
+			}
+			return;
+		}
+	}
+	if (packet->state == LTTNG_LIVE_PACKET_DEFERRED)
+		pool->deferred--;
+
+	memset(&rq, 0, sizeof(rq));
+	rq.stream_id = htobe64(packet->stream->id);
+	rq.offset = htobe64(packet->index.offset);
+	rq.len = htobe32(packet->index.packet_size / CHAR_BIT);
+	packet->state = LTTNG_LIVE_PACKET_GET_DATA;
+	queue_request(ctx, LTTNG_VIEWER_GET_PACKET, &rq, sizeof(rq), packet);
+}
+
+/*
+ * Append a packet to the stream queue and request its index.
+ */
+static
+struct lttng_live_packet *new_packet(struct lttng_live_ctx *ctx,
+		struct lttng_live_viewer_stream *stream)
+{
+	struct lttng_live_packet *packet;
+
+	packet = g_new0(struct lttng_live_packet, 1);
+	packet->stream = stream;
+	bt_list_add_tail(&packet->node, &stream->packets);
+	stream->nr_packets++;
+	if (stream->id == -1ULL) {
+		/* Stream hung up: nothing left to request. */
+		packet->index.offset = EOF;
+		packet->state = LTTNG_LIVE_PACKET_READY;
+	} else {
+		request_index(ctx, packet);
+	}
+	return packet;
+}
+
+/*
+ * Whether the index of one more packet may be requested for a stream,
+ * keeping at most depth packets queued. The relay daemon closes a
+ * stream once it sent its last index, so the data of all the previous
+ * packets must be requested first: only the last packet of the queue
+ * may still wait for its index or for a buffer.
+ */
+static
+int can_request_index(struct lttng_live_ctx *ctx,
+		struct lttng_live_viewer_stream *stream, unsigned int depth)
+{
+	struct lttng_live_packet *last;
+
+	if (ctx->inflight_count >= LTTNG_LIVE_MAX_INFLIGHT
+			|| stream->metadata_flag || stream->id == -1ULL
+			|| stream->stalled || stream->nr_packets >= depth)
+		return 0;
+	if (bt_list_empty(&stream->packets))
+		return 1;
+	last = bt_list_entry(stream->packets.prev, struct lttng_live_packet,
+			node);
+	return last->state != LTTNG_LIVE_PACKET_GET_INDEX
+		&& last->state != LTTNG_LIVE_PACKET_DEFERRED;
+}
+
+static
+void free_packet(struct lttng_live_packet *packet)
+{
+	struct lttng_live_buffer_pool *pool =
+		&packet->stream->session->ctx->pool;
+
+	if (packet->state == LTTNG_LIVE_PACKET_DEFERRED)
+		pool->deferred--;
+	pool_put(pool, packet->mma);
+	bt_list_del(&packet->node);
+	packet->stream->nr_packets--;
+	g_free(packet);
+}
+
+/*
+ * Fetch new metadata for the trace of a stream. The metadata reply
+ * comes after those of all outstanding requests, so they are received
+ * first. One of them may ask for the same metadata: it is only fetched
+ * once.
+ */
+static
+int update_metadata(struct lttng_live_ctx *ctx,
+		struct lttng_live_viewer_stream *viewer_stream)
+{
+	struct lttng_live_ctf_trace *trace = viewer_stream->ctf_trace;
+	uint64_t metadata_len;
+	int ret;
+
+	trace->new_metadata = 1;
+	while (!bt_list_empty(&ctx->inflight)) {
+		ret = recv_reply(ctx);
+		if (ret < 0)
+			return ret;
+	}
+	if (!trace->new_metadata)
+		return 0;
+	trace->new_metadata = 0;
+	return get_new_metadata(ctx, viewer_stream, &metadata_len);
+}
+
+static
+int recv_index(struct lttng_live_ctx *ctx, struct lttng_live_packet *packet)
+{
+	struct lttng_live_viewer_stream *viewer_stream = packet->stream;
+	struct packet_index *index = &packet->index;
+	struct lttng_viewer_index rp;
+	ssize_t ret_len;
+	int ret;
+
+	do {
+		ret_len = recv(ctx->control_sock, &rp, sizeof(rp), 0);
+	} while (ret_len < 0 && errno == EINTR);
+	if (ret_len < 0) {
+		fprintf(stderr, "[error] Error receiving index response\n");
+		return ret_len;
+	}
+	assert(ret_len == sizeof(rp));
+
+	/* Prefetched after the stream hung up. */
+	if (viewer_stream->id == -1ULL) {
+		free_packet(packet);
+		return 0;
+	}
+
+	rp.flags = be32toh(rp.flags);
+
+	switch (be32toh(rp.status)) {
+	case LTTNG_VIEWER_INDEX_INACTIVE:
+		printf_verbose("get_next_index: inactive\n");
+		memset(index, 0, sizeof(struct packet_index));
+		index->ts_cycles.timestamp_end = be64toh(rp.timestamp_end);
+		stall_stream(viewer_stream);
+		break;
+	case LTTNG_VIEWER_INDEX_OK:
+		printf_verbose("get_next_index: Ok, need metadata update : %u\n",
+				rp.flags & LTTNG_VIEWER_FLAG_NEW_METADATA);
+		index->offset = be64toh(rp.offset);
+		index->packet_size = be64toh(rp.packet_size);
+		index->content_size = be64toh(rp.content_size);
+		index->ts_cycles.timestamp_begin = be64toh(rp.timestamp_begin);
+		index->ts_cycles.timestamp_end = be64toh(rp.timestamp_end);
+		index->events_discarded = be64toh(rp.events_discarded);
+
+		if (rp.flags & LTTNG_VIEWER_FLAG_NEW_METADATA) {
+			printf_verbose("get_next_index: new metadata needed\n");
+			ret = update_metadata(ctx, viewer_stream);
+			if (ret < 0) {
+				packet->error = ret;
+				break;
+			}
+		}
+		if (index->packet_size != 0) {
+			request_data(ctx, packet, 0);
+			/* Keep the stream pipeline full. */
+			if (can_request_index(ctx, viewer_stream,
+					LTTNG_LIVE_PREFETCH_DEPTH))
+				(void) new_packet(ctx, viewer_stream);
+			return 0;
+		}
+		break;
+	case LTTNG_VIEWER_INDEX_RETRY:
+		/* Requested again when the iterator needs it. */
+		printf_verbose("get_next_index: retry\n");
+		stall_stream(viewer_stream);
+		free_packet(packet);
+		return 0;
+	case LTTNG_VIEWER_INDEX_HUP:
+		printf_verbose("get_next_index: stream hung up\n");
+		viewer_stream->id = -1ULL;
+		viewer_stream->fd = -1;
+		index->offset = EOF;
+		break;
+	case LTTNG_VIEWER_INDEX_ERR:
+		fprintf(stderr, "[error] get_next_index: error\n");
+		packet->error = -1;
+		break;
+	default:
+		fprintf(stderr, "[error] get_next_index: unkwown value\n");
+		packet->error = -1;
+		break;
+	}
+	packet->state = LTTNG_LIVE_PACKET_READY;
+	return 0;
+}
+
+static
+int recv_data(struct lttng_live_ctx *ctx, struct lttng_live_packet *packet)
+{
+	struct lttng_live_viewer_stream *viewer_stream = packet->stream;
+	struct lttng_viewer_trace_packet rp;
+	ssize_t ret_len;
+	uint64_t len;
+	int ret;
+
+	do {
+		ret_len = recv(ctx->control_sock, &rp, sizeof(rp), 0);
+	} while (ret_len < 0 && errno == EINTR);
+	if (ret_len < 0) {
+		fprintf(stderr, "[error] Error receiving data response\n");
+		return ret_len;
+	}
+	if (ret_len != sizeof(rp)) {
+		fprintf(stderr, "[error] get_data_packet: expected %" PRId64
+				", received %" PRId64 "\n", ret_len,
+				sizeof(rp));
+		return -1;
+	}
+
+	rp.flags = be32toh(rp.flags);
+
+	switch (be32toh(rp.status)) {
+	case LTTNG_VIEWER_GET_PACKET_OK:
+		len = be32toh(rp.len);
+		printf_verbose("get_data_packet: Ok, packet size : %" PRIu64
+				"\n", len);
+		break;
+	case LTTNG_VIEWER_GET_PACKET_RETRY:
+		printf_verbose("get_data_packet: retry\n");
+		packet->error = -1;
+		goto end;
+	case LTTNG_VIEWER_GET_PACKET_ERR:
+		if (rp.flags & LTTNG_VIEWER_FLAG_NEW_METADATA) {
+			printf_verbose("get_data_packet: new metadata needed\n");
+			ret = update_metadata(ctx, viewer_stream);
+			if (ret < 0) {
+				packet->error = ret;
+				goto end;
+			}
+			/* Request the packet again, after the metadata. */
+			request_data(ctx, packet, 1);
+			return 0;
+		}
+		fprintf(stderr, "[error] get_data_packet: error\n");
+		packet->error = -1;
+		goto end;
+	case LTTNG_VIEWER_GET_PACKET_EOF:
+		/* Skip to the next index, as a new request would. */
+		free_packet(packet);
+		return 0;
+	default:
+		printf_verbose("get_data_packet: unknown\n");
+		packet->error = -1;
+		goto end;
+	}
+
+	if (len <= 0) {
+		packet->error = -1;
+		goto end;
+	}
+
+	if (len > packet->mma->length) {
+		/* Larger than requested: the data must be received anyway. */
+		pool_put(&ctx->pool, packet->mma);
+		packet->mma = pool_get(&ctx->pool, len, 1);
+		if (!packet->mma)
+			return -1;
+	}
+
+	do {
+		ret_len = recv(ctx->control_sock,
+			mmap_align_addr(packet->mma), len,
+			MSG_WAITALL);
+	} while (ret_len < 0 && errno == EINTR);
+	if (ret_len < 0) {
+		fprintf(stderr, "[error] Error receiving trace packet\n");
+		return ret_len;
+	}
+	assert(ret_len == len);
+
+end:
+	packet->state = LTTNG_LIVE_PACKET_READY;
+	return 0;
+}
+
+/*
+ * Send the queued requests and receive the reply to the oldest
+ * outstanding one.
+ *
+ * Returns 0 on success or a negative value if the connection failed.
+ */
+static
+int recv_reply(struct lttng_live_ctx *ctx)
+{
+	struct lttng_live_packet *packet;
+	int ret;
+
+	ret = flush_requests(ctx);
+	if (ret < 0)
+		return ret;
+	assert(!bt_list_empty(&ctx->inflight));
+	packet = bt_list_entry(ctx->inflight.next, struct lttng_live_packet,
+			inflight_node);
+	bt_list_del(&packet->inflight_node);
+	ctx->inflight_count--;
+
+	switch (packet->state) {
+	case LTTNG_LIVE_PACKET_GET_INDEX:
+		return recv_index(ctx, packet);
+	case LTTNG_LIVE_PACKET_GET_DATA:
+		return recv_data(ctx, packet);
+	default:
+		assert(0);
+		return -1;
+	}
+}
+
+/*
+ * Request the data of the packets put off, as long as the pool has
+ * buffers for them.
+ */
+static
+void request_deferred(struct lttng_live_ctx *ctx)
+{
+	unsigned int j;
+	uint64_t i;
+
+	for (j = 0; j < ctx->sessions->len; j++) {
+		struct lttng_live_session *session =
+			g_ptr_array_index(ctx->sessions, j);
+
+		for (i = 0; i < session->stream_count; i++) {
+			struct lttng_live_viewer_stream *stream =
+				&session->streams[i];
+			struct lttng_live_packet *packet;
+
+			bt_list_for_each_entry(packet, &stream->packets, node) {
+				if (packet->state != LTTNG_LIVE_PACKET_DEFERRED)
+					continue;
+				request_data(ctx, packet, 0);
+				if (packet->state == LTTNG_LIVE_PACKET_DEFERRED)
+					return;
+			}
+		}
+	}
+}
+
+/*
+ * Top up the packet queues of all data streams, one packet per stream
+ * at a time, so no stream starves the others of inflight slots. Streams
+ * for which the relay daemon had nothing new are left alone until the
+ * iterator needs them.
+ */
+static
+int prefetch_packets(struct lttng_live_ctx *ctx)
+{
+	unsigned int depth, j;
+	uint64_t i;
+
+	if (ctx->pool.deferred)
+		request_deferred(ctx);
+	for (depth = 1; depth <= LTTNG_LIVE_PREFETCH_DEPTH; depth++) {
+		for (j = 0; j < ctx->sessions->len; j++) {
+			struct lttng_live_session *session =
+				g_ptr_array_index(ctx->sessions, j);
+
+			for (i = 0; i < session->stream_count; i++) {
+				struct lttng_live_viewer_stream *stream =
+					&session->streams[i];
+
+				if (ctx->inflight_count >= LTTNG_LIVE_MAX_INFLIGHT)
+					goto end;
+				if (!can_request_index(ctx, stream, depth))
+					continue;
+				(void) new_packet(ctx, stream);
+			}
+		}
+	}
+end:
+	return flush_requests(ctx);
+}
+
+/*
+ * Relay connection i among those followed along with ctx.
+ */
+static
+struct lttng_live_ctx *get_relay(struct lttng_live_ctx *ctx, unsigned int i)
+{
+	return ctx->relays ? g_ptr_array_index(ctx->relays, i) : ctx;
+}
+
+/*
+ * Wait for the end of the live timer period of a stalled stream, so a
+ * stream without new data is not polled in a loop. The replies to the
+ * requests of the other streams, on all the relay connections, are
+ * received meanwhile: the viewer sleeps until either a reply or the
+ * timer comes.
+ */
+static
+int wait_stalled_stream(struct lttng_live_ctx *ctx,
+		struct lttng_live_viewer_stream *viewer_stream)
+{
+	unsigned int i, nr_relays = ctx->relays ? ctx->relays->len : 1;
+	struct lttng_live_ctx **polled;
+	struct pollfd *pfds;
+	uint64_t delay, deadline, now;
+	int ret = 0;
+
+	delay = viewer_stream->session->live_timer_interval;
+	if (!delay)
+		delay = LTTNG_LIVE_DEFAULT_RETRY_DELAY;
+	deadline = viewer_stream->stall_time + delay * 1000;
+
+	polled = g_new(struct lttng_live_ctx *, nr_relays);
+	pfds = g_new(struct pollfd, nr_relays);
+	for (i = 0; i < nr_relays; i++) {
+		ret = flush_requests(get_relay(ctx, i));
+		if (ret < 0)
+			goto end;
+	}
+	while ((now = get_time_ns(CLOCK_MONOTONIC)) < deadline) {
+		nfds_t nfds = 0;
+
+		/* The relay daemons only send replies to our requests. */
+		for (i = 0; i < nr_relays; i++) {
+			struct lttng_live_ctx *relay = get_relay(ctx, i);
+
+			if (bt_list_empty(&relay->inflight))
+				continue;
+			polled[nfds] = relay;
+			pfds[nfds].fd = relay->control_sock;
+			pfds[nfds].events = POLLIN;
+			nfds++;
+		}
+		ret = poll(pfds, nfds, (deadline - now + 999999) / 1000000);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			perror("poll");
+			goto end;
+		}
+		for (i = 0; i < nfds; i++) {
+			if (!pfds[i].revents)
+				continue;
+			ret = recv_reply(polled[i]);
+			if (ret < 0)
+				goto end;
+			/* Send the requests chained by the reply. */
+			ret = flush_requests(polled[i]);
+			if (ret < 0)
+				goto end;
+		}
+	}
+	viewer_stream->stalled = 0;
+	ret = 0;
+end:
+	g_free(pfds);
+	g_free(polled);
+	return ret;
+}
+
+/*
+ * Get the next packet of a stream, waiting for the relay daemon if it
+ * was not prefetched yet.
+ *
+ * Returns the packet, removed from the inflight requests but still
+ * queued in the stream, or NULL if the connection failed.
+ */
+static
+struct lttng_live_packet *get_next_packet(struct lttng_live_ctx *ctx,
+		struct lttng_live_viewer_stream *viewer_stream)
+{
+	struct lttng_live_packet *packet;
+	int ret;
+
+	for (;;) {
+		if (bt_list_empty(&viewer_stream->packets)) {
+			if (viewer_stream->stalled) {
+				ret = wait_stalled_stream(ctx, viewer_stream);
+				if (ret < 0)
+					return NULL;
+			}
+			(void) new_packet(ctx, viewer_stream);
+		}
+		packet = bt_list_entry(viewer_stream->packets.next,
+				struct lttng_live_packet, node);
+		if (packet->state == LTTNG_LIVE_PACKET_DEFERRED)
+			request_data(ctx, packet, 1);
+		if (packet->state == LTTNG_LIVE_PACKET_READY)
+			break;
+		ret = recv_reply(ctx);
+		if (ret < 0)
+			return NULL;
+	}
+
+	ret = prefetch_packets(ctx);
+	if (ret < 0)
+		return NULL;
+	return packet;
+}
+
+/*
+ * Receive the replies to all outstanding requests and release the
+ * prefetched packets, leaving the control connection idle.
+ */
+void lttng_live_drain_packets(struct lttng_live_ctx *ctx)
+{
+	unsigned int j;
+	uint64_t i;
+	int ret;
+
+	ret = 0;
+	while (!ret && !bt_list_empty(&ctx->inflight))
+		ret = recv_reply(ctx);
+	if (ret < 0) {
+		/* Connection failed: forget the replies. */
+		BT_INIT_LIST_HEAD(&ctx->inflight);
+		ctx->inflight_count = 0;
+	}
+
+	for (j = 0; j < ctx->sessions->len; j++) {
+		struct lttng_live_session *session =
+			g_ptr_array_index(ctx->sessions, j);
+
+		for (i = 0; i < session->stream_count; i++) {
+			struct lttng_live_viewer_stream *stream =
+				&session->streams[i];
+			struct lttng_live_packet *packet, *tmp;
+
+			if (stream->metadata_flag)
+				continue;
+			bt_list_for_each_entry_safe(packet, tmp,
+					&stream->packets, node)
+				free_packet(packet);
+			/*
+			 * The stream position buffer is unmapped along with
+			 * the trace.
+			 */
+			if (stream->pos_mma) {
+				ctx->pool.used_len -= stream->pos_mma->length;
+				ctx->pool.mapped_len -= stream->pos_mma->length;
+				stream->pos_mma = NULL;
+			}
+		}
+	}
+}
+
+/*
+ * Print, in verbose mode, how far behind the current time each data
+ * stream is shown, how many packets are queued for it, and the packet
+ * buffer usage.
+ */
+void lttng_live_print_lag(struct lttng_live_ctx *ctx)
+{
+	unsigned int j;
+	uint64_t i;
+
+	if (!babeltrace_verbose)
+		return;
+	for (j = 0; j < ctx->sessions->len; j++) {
+		struct lttng_live_session *session =
+			g_ptr_array_index(ctx->sessions, j);
+
+		for (i = 0; i < session->stream_count; i++) {
+			struct lttng_live_viewer_stream *stream =
+				&session->streams[i];
+
+			uint64_t lag_sec, lag_nsec;
+
+			if (stream->metadata_flag || stream->id == -1ULL)
+				continue;
+			lag_sec = stream->lag / NSEC_PER_SEC;
+			lag_nsec = stream->lag % NSEC_PER_SEC;
+			printf_verbose("Session %" PRIu64 " stream %" PRIu64
+				" : lag %" PRIu64 ".%09" PRIu64 " s, "
+				"%u packet(s) queued%s\n",
+				session->id, stream->id, lag_sec, lag_nsec,
+				stream->nr_packets,
+				stream->stalled ? ", waiting for data" : "");
+		}
+	}
+	print_pool_stats(&ctx->pool);
+}
+
+void ctf_live_packet_seek(struct bt_stream_pos *stream_pos, size_t index,
+		int whence)
+{
+	struct ctf_stream_pos *pos;
+	struct ctf_file_stream *file_stream;
+	struct packet_index *prev_index = NULL, *cur_index;
+	struct lttng_live_viewer_stream *viewer_stream;
+	struct lttng_live_session *session;
+	struct lttng_live_packet *packet;
+	uint64_t now;
+	int ret;
+
+	pos = ctf_pos(stream_pos);
+	file_stream = container_of(pos, struct ctf_file_stream, pos);
+	viewer_stream = (struct lttng_live_viewer_stream *) pos->priv;
+	session = viewer_stream->session;
+
+	switch (pos->packet_index->len) {
+	case 0:
+		g_array_set_size(pos->packet_index, 1);
+		cur_index = &g_array_index(pos->packet_index,
+				struct packet_index, 0);
+		break;
 	case 1:
 		g_array_set_size(pos->packet_index, 2);
 		prev_index = &g_array_index(pos->packet_index,
@@ -812,13 +1435,25 @@ retry:
 		abort();
 		break;
 	}
-	printf_verbose("get_next_index for stream %" PRIu64 "\n", viewer_stream->id);
-	ret = get_next_index(session->ctx, viewer_stream, cur_index);
-	if (ret < 0) {
+	printf_verbose("get_next_packet for stream %" PRIu64 "\n", viewer_stream->id);
+	packet = get_next_packet(session->ctx, viewer_stream);
+	if (!packet || packet->error) {
+		if (packet)
+			free_packet(packet);
 		pos->offset = EOF;
-		fprintf(stderr, "[error] get_next_index failed\n");
+		fprintf(stderr, "[error] get_next_packet failed\n");
 		return;
 	}
+	*cur_index = packet->index;
+	if (packet->mma) {
+		/* Hand the packet buffer over to the stream position. */
+		assert(pos->base_mma == viewer_stream->pos_mma);
+		pool_put(&session->ctx->pool, pos->base_mma);
+		pos->base_mma = packet->mma;
+		viewer_stream->pos_mma = packet->mma;
+		packet->mma = NULL;
+	}
+	free_packet(packet);
 
 	pos->packet_size = cur_index->packet_size;
 	pos->content_size = cur_index->content_size;
@@ -853,23 +1488,16 @@ retry:
 				cur_index->ts_real.timestamp_begin;
 	}
 
+	now = get_time_ns(CLOCK_REALTIME);
+	if (now > file_stream->parent.real_timestamp)
+		viewer_stream->lag = now - file_stream->parent.real_timestamp;
+	else
+		viewer_stream->lag = 0;
+
 	if (pos->packet_size == 0 || pos->offset == EOF) {
 		goto end;
 	}
 
-	printf_verbose("get_data_packet for stream %" PRIu64 "\n",
-			viewer_stream->id);
-	ret = get_data_packet(session->ctx, pos, viewer_stream,
-			be64toh(cur_index->offset),
-			cur_index->packet_size / CHAR_BIT);
-	if (ret == -2) {
-		goto retry;
-	} else if (ret < 0) {
-		pos->offset = EOF;
-		fprintf(stderr, "[error] get_data_packet failed\n");
-		return;
-	}
-
 	printf_verbose("Index received : packet_size : %" PRIu64
 			", offset %" PRIu64 ", content_size %" PRIu64
 			", timestamp_end : %" PRIu64 "\n",
@@ -972,9 +1600,120 @@ end:
 	return;
 }
 
-void lttng_live_read(struct lttng_live_ctx *ctx, uint64_t session_id)
+static
+unsigned int nr_active_sessions(struct lttng_live_ctx *ctx)
+{
+	unsigned int i, nr_active = 0;
+
+	for (i = 0; i < ctx->sessions->len; i++) {
+		struct lttng_live_session *session =
+			g_ptr_array_index(ctx->sessions, i);
+
+		if (session->active)
+			nr_active++;
+	}
+	return nr_active;
+}
+
+static
+unsigned int nr_relays_active_sessions(GPtrArray *relays)
 {
-	int ret, active_session = 0;
+	unsigned int i, nr_active = 0;
+
+	for (i = 0; i < relays->len; i++)
+		nr_active += nr_active_sessions(g_ptr_array_index(relays, i));
+	return nr_active;
+}
+
+/*
+ * Attach to the active sessions of a relay daemon, adding their number
+ * of streams to stream_count. Sessions unknown to the relay daemon are
+ * not followed anymore.
+ */
+static
+int attach_relay_sessions(struct lttng_live_ctx *ctx, uint64_t *stream_count)
+{
+	unsigned int i;
+	int ret;
+
+	for (i = 0; i < ctx->sessions->len; i++) {
+		struct lttng_live_session *session =
+			g_ptr_array_index(ctx->sessions, i);
+
+		if (!session->active)
+			continue;
+		ret = lttng_live_attach_session(ctx, session);
+		printf_verbose("Attaching session %" PRIu64
+				" returns %d\n", session->id, ret);
+		if (ret == -LTTNG_VIEWER_ATTACH_UNK) {
+			if (!session->stream_count) {
+				fprintf(stderr, "[error] Unknown "
+					"session ID %" PRIu64 "\n",
+					session->id);
+			}
+			session->active = 0;
+			session->stream_count = 0;
+			continue;
+		} else if (ret < 0) {
+			return ret;
+		}
+		*stream_count += session->stream_count;
+	}
+	return 0;
+}
+
+/*
+ * Attach to all the active sessions of all the relay daemons. Sessions
+ * created but not started yet have no stream: we wait until at least
+ * one session has streams, which allows the viewer to start processing
+ * the traces as soon as a session starts.
+ *
+ * Returns 0 on success, or a negative value on error or when no session
+ * is left.
+ */
+static
+int attach_sessions(GPtrArray *relays)
+{
+	uint64_t stream_count;
+	unsigned int i;
+	int ret;
+
+	/* Get the live timer of the sessions. */
+	for (i = 0; i < relays->len; i++) {
+		struct lttng_live_ctx *ctx = g_ptr_array_index(relays, i);
+
+		if (!nr_active_sessions(ctx))
+			continue;
+		ret = get_session_list(ctx, NULL);
+		if (ret < 0)
+			return ret;
+	}
+
+	for (;;) {
+		stream_count = 0;
+		for (i = 0; i < relays->len; i++) {
+			ret = attach_relay_sessions(g_ptr_array_index(relays, i),
+					&stream_count);
+			if (ret < 0)
+				return ret;
+		}
+		if (!nr_relays_active_sessions(relays))
+			return -1;
+		if (stream_count)
+			return 0;
+		/* No session started yet: ask again later. */
+		usleep(LTTNG_LIVE_DEFAULT_RETRY_DELAY);
+	}
+}
+
+/*
+ * Follow the sessions of all the relay connections, merging their
+ * traces in time order.
+ */
+void lttng_live_read(GPtrArray *relays)
+{
+	unsigned int i, j;
+	int ret;
 	struct bt_context *bt_ctx;
 	struct bt_ctf_iter *iter;
 	const struct bt_ctf_event *event;
@@ -1007,29 +1746,28 @@ void lttng_live_read(struct lttng_live_ctx *ctx, uint64_t session_id)
 		goto end_free;
 
 	/*
-	 * As long as the session is active, we try to reattach to it,
+	 * As long as a session is active, we try to reattach to it,
 	 * even if all the streams get closed.
 	 */
 	do {
 		int flags;
 
-		do {
-			ret = lttng_live_attach_session(ctx, session_id);
-			printf_verbose("Attaching session returns %d\n", ret);
-			if (ret < 0) {
-				if (ret == -LTTNG_VIEWER_ATTACH_UNK) {
-					if (active_session)
-						goto end_free;
-					fprintf(stderr, "[error] Unknown "
-							"session ID\n");
-				}
-				goto end_free;
-			} else {
-				active_session = 1;
-			}
-		} while (ctx->session->stream_count == 0);
+		ret = attach_sessions(relays);
+		if (ret < 0)
+			goto end_free;
+
+		for (i = 0; i < relays->len; i++) {
+			struct lttng_live_ctx *ctx =
+				g_ptr_array_index(relays, i);
 
-		g_hash_table_foreach(ctx->session->ctf_traces, add_traces, bt_ctx);
+			for (j = 0; j < ctx->sessions->len; j++) {
+				struct lttng_live_session *session =
+					g_ptr_array_index(ctx->sessions, j);
+
+				g_hash_table_foreach(session->ctf_traces,
+						add_traces, bt_ctx);
+			}
+		}
 
 		begin_pos.type = BT_SEEK_BEGIN;
 		iter = bt_ctf_iter_create(bt_ctx, &begin_pos, NULL);
@@ -1051,6 +1789,21 @@ void lttng_live_read(struct lttng_live_ctx *ctx, uint64_t session_id)
 							"event failed.\n");
 					goto end_free;
 				}
+			} else {
+				/*
+				 * Show the buffered events while waiting
+				 * for more data.
+				 */
+				ret = ctf_text_flush(sout);
+				if (ret) {
+					fprintf(stderr, "[error] Writing "
+							"event failed.\n");
+					goto end_free;
+				}
+				for (i = 0; i < relays->len; i++) {
+					lttng_live_print_lag(
+						g_ptr_array_index(relays, i));
+				}
 			}
 			ret = bt_iter_next(bt_ctf_get_iter(iter));
 			if (ret < 0) {
@@ -1058,8 +1811,20 @@ void lttng_live_read(struct lttng_live_ctx *ctx, uint64_t session_id)
 			}
 		}
 		bt_ctf_iter_destroy(iter);
-		g_hash_table_foreach_remove(ctx->session->ctf_traces, del_traces, bt_ctx);
-	} while (active_session);
+		for (i = 0; i < relays->len; i++) {
+			struct lttng_live_ctx *ctx =
+				g_ptr_array_index(relays, i);
+
+			lttng_live_drain_packets(ctx);
+			for (j = 0; j < ctx->sessions->len; j++) {
+				struct lttng_live_session *session =
+					g_ptr_array_index(ctx->sessions, j);
+
+				g_hash_table_foreach_remove(session->ctf_traces,
+						del_traces, bt_ctx);
+			}
+		}
+	} while (nr_relays_active_sessions(relays));
 
 end_free:
 	bt_context_put(bt_ctx);
@@ -25,6 +25,9 @@
  */
 
 #include <stdint.h>
+#include <babeltrace/list.h>
+#include <babeltrace/mmap-align.h>
+#include <babeltrace/ctf/types.h>
 
 #define LTTNG_METADATA_PATH_TEMPLATE		"/tmp/lttng-live-XXXXXX"
 #define LTTNG_DEFAULT_NETWORK_VIEWER_PORT	5344
@@ -32,24 +35,86 @@
 #define LTTNG_LIVE_MAJOR			2
 #define LTTNG_LIVE_MINOR			4
 
+/* Delay before asking again for a stream without new data, in us. */
+#define LTTNG_LIVE_DEFAULT_RETRY_DELAY		1000000
+
+/*
+ * Packet buffers are sized by power of two classes, from one page up to
+ * 16 MiB. Larger packets get a buffer of their own.
+ */
+#define LTTNG_LIVE_POOL_MIN_ORDER		12
+#define LTTNG_LIVE_POOL_NR_CLASSES		13
+#define LTTNG_LIVE_DEFAULT_POOL_LEN		(256ULL << 20)
+
+/*
+ * Packet buffers shared by all the streams of a connection. Released
+ * buffers are kept for reuse as long as the mapped total stays within
+ * max_len. Prefetching waits when no buffer fits, only the packets the
+ * iterator waits for may go over the bound.
+ */
+struct lttng_live_buffer_pool {
+	GPtrArray *free[LTTNG_LIVE_POOL_NR_CLASSES];	/* struct mmap_align */
+	uint64_t max_len;
+	uint64_t mapped_len;		/* Free and used buffers */
+	uint64_t used_len;		/* Buffers holding a packet */
+	uint64_t peak_len;		/* Highest mapped_len */
+	uint64_t nr_maps;
+	uint64_t nr_reuses;
+	uint64_t nr_deferred;		/* Packet data requests put off */
+	unsigned int deferred;		/* Packets waiting for a buffer */
+};
+
 struct lttng_live_ctx {
 	int control_sock;
-	struct lttng_live_session *session;
+	GPtrArray *sessions;		/* struct lttng_live_session pointers */
+	GPtrArray *relays;		/* All the connections followed, or NULL */
+	struct bt_list_head inflight;	/* Requests awaiting a reply, in send order */
+	unsigned int inflight_count;
+	GByteArray *send_buf;		/* Requests not sent yet */
+	struct lttng_live_buffer_pool pool;
+};
+
+enum lttng_live_packet_state {
+	LTTNG_LIVE_PACKET_GET_INDEX,	/* GET_NEXT_INDEX sent */
+	LTTNG_LIVE_PACKET_DEFERRED,	/* Index received, no buffer yet */
+	LTTNG_LIVE_PACKET_GET_DATA,	/* GET_PACKET sent */
+	LTTNG_LIVE_PACKET_READY,	/* Index and data received */
+};
+
+/*
+ * Packet requested from the relay daemon, queued in its stream in
+ * request order until the iterator consumes it.
+ */
+struct lttng_live_packet {
+	struct lttng_live_viewer_stream *stream;
+	enum lttng_live_packet_state state;
+	int error;			/* Negative value if the request failed */
+	struct packet_index index;
+	struct mmap_align *mma;		/* Packet data, NULL if none */
+	struct bt_list_head node;	/* Stream packet queue */
+	struct bt_list_head inflight_node;
 };
 
 struct lttng_live_viewer_stream {
 	uint64_t id;
-	uint64_t mmap_size;
 	int fd;
 	int metadata_flag;
 	int first_read;
+	struct bt_list_head packets;	/* Prefetched packets */
+	unsigned int nr_packets;
+	int stalled;			/* No new packet on the relay daemon */
+	uint64_t stall_time;		/* When stalled was set, monotonic ns */
+	struct mmap_align *pos_mma;	/* Pool buffer of the stream position */
+	uint64_t lag;			/* Wall time behind current packet, ns */
 	struct lttng_live_session *session;
 	struct lttng_live_ctf_trace *ctf_trace;
 	char path[PATH_MAX];
 };
 
 struct lttng_live_session {
-	uint64_t live_timer_interval;
+	uint64_t id;
+	int active;			/* Not destroyed on the relay daemon */
+	uint64_t live_timer_interval;	/* In us, 0 if unknown */
 	uint64_t stream_count;
 	struct lttng_live_ctx *ctx;
 	struct lttng_live_viewer_stream *streams;
@@ -62,13 +127,20 @@ struct lttng_live_ctf_trace {
 	GPtrArray *streams;
 	FILE *metadata_fp;
 	int trace_id;
+	int new_metadata;	/* Metadata fetch pending */
 };
 
+void lttng_live_pool_init(struct lttng_live_buffer_pool *pool,
+		uint64_t max_len);
+void lttng_live_pool_fini(struct lttng_live_buffer_pool *pool);
 int lttng_live_connect_viewer(struct lttng_live_ctx *ctx, char *hostname,
 		int port);
 int lttng_live_establish_connection(struct lttng_live_ctx *ctx);
 int lttng_live_list_sessions(struct lttng_live_ctx *ctx, const char *path);
-int lttng_live_attach_session(struct lttng_live_ctx *ctx, uint64_t id);
-void lttng_live_read(struct lttng_live_ctx *ctx, uint64_t session_id);
+int lttng_live_attach_session(struct lttng_live_ctx *ctx,
+		struct lttng_live_session *session);
+void lttng_live_drain_packets(struct lttng_live_ctx *ctx);
+void lttng_live_print_lag(struct lttng_live_ctx *ctx);
+void lttng_live_read(GPtrArray *relays);
 
 #endif /* _LTTNG_LIVE_FUNCTIONS_H */
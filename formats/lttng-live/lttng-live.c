@@ -38,11 +38,35 @@
 #include <stdlib.h>
 #include "lttng-live-functions.h"
 
+/*
+ * Parse a "/ID[,ID]..." list of session IDs. Accept an empty list.
+ */
+static int parse_session_ids(const char *str, GArray *session_ids)
+{
+	uint64_t session_id;
+	int ret, len;
+
+	if (*str++ != '/')
+		return -1;
+	while (*str != '\0') {
+		ret = sscanf(str, "%" SCNu64 "%n", &session_id, &len);
+		if (ret < 1)
+			return -1;
+		g_array_append_val(session_ids, session_id);
+		str += len;
+		if (*str == ',')
+			str++;
+		else if (*str != '\0')
+			return -1;
+	}
+	return 0;
+}
+
 /*
  * hostname parameter needs to hold NAME_MAX chars.
  */
 static int parse_url(const char *path, char *hostname, int *port,
-		uint64_t *session_id)
+		GArray *session_ids)
 {
 	char remain[2][NAME_MAX];
 	int ret = -1, proto, proto_offset = 0;
@@ -77,20 +101,18 @@ static int parse_url(const char *path, char *hostname, int *port,
 		switch (remain[0][0]) {
 		case ':':
 			ret = sscanf(remain[0], ":%d%s", port, remain[1]);
-			/* Optional session ID with port number */
+			/* Optional session IDs with port number */
 			if (ret == 2) {
-				ret = sscanf(remain[1], "/%" PRIu64,
-					session_id);
-				/* Accept 0 or 1 (optional) */
+				ret = parse_session_ids(remain[1],
+					session_ids);
 				if (ret < 0) {
 					goto end;
 				}
 			}
 			break;
 		case '/':
-			/* Optional session ID */
-			ret = sscanf(remain[0], "/%" PRIu64, session_id);
-			/* Accept 0 or 1 (optional) */
+			/* Optional session IDs */
+			ret = parse_session_ids(remain[0], session_ids);
 			if (ret < 0) {
 				goto end;
 			}
@@ -106,69 +128,140 @@ static int parse_url(const char *path, char *hostname, int *port,
 	if (*port < 0)
 		*port = LTTNG_DEFAULT_NETWORK_VIEWER_PORT;
 
-	if (*session_id == -1ULL)
-		printf_verbose("Connecting to hostname : %s, port : %d, "
-				"proto : IPv%d\n",
-				hostname, *port, proto);
-	else
-		printf_verbose("Connecting to hostname : %s, port : %d, "
-				"session id : %" PRIu64 ", proto : IPv%d\n",
-				hostname, *port, *session_id, proto);
+	printf_verbose("Connecting to hostname : %s, port : %d, "
+			"%u session id(s), proto : IPv%d\n",
+			hostname, *port, session_ids->len, proto);
 	ret = 0;
 
 end:
 	return ret;
 }
 
-static int lttng_live_open_trace_read(const char *path)
+static void close_relay(struct lttng_live_ctx *ctx)
+{
+	unsigned int i;
+
+	for (i = 0; i < ctx->sessions->len; i++) {
+		struct lttng_live_session *session =
+			g_ptr_array_index(ctx->sessions, i);
+
+		g_hash_table_destroy(session->ctf_traces);
+		g_free(session->streams);
+		g_free(session);
+	}
+	g_ptr_array_free(ctx->sessions, TRUE);
+	g_byte_array_free(ctx->send_buf, TRUE);
+	lttng_live_pool_fini(&ctx->pool);
+	if (ctx->control_sock >= 0)
+		close(ctx->control_sock);
+	g_free(ctx);
+}
+
+/*
+ * Connect to the relay daemon of url, which is followed along with the
+ * other relays.
+ */
+static struct lttng_live_ctx *open_relay(const char *url, GPtrArray *relays)
 {
 	char hostname[NAME_MAX];
 	int port = -1;
-	uint64_t session_id = -1ULL;
+	GArray *session_ids;
 	int ret = 0;
-	struct lttng_live_ctx ctx;
+	unsigned int i;
+	struct lttng_live_ctx *ctx;
 
-	ctx.session = g_new0(struct lttng_live_session, 1);
+	ctx = g_new0(struct lttng_live_ctx, 1);
+	ctx->control_sock = -1;
+	BT_INIT_LIST_HEAD(&ctx->inflight);
+	ctx->send_buf = g_byte_array_new();
+	lttng_live_pool_init(&ctx->pool, opt_live_buffer_pool_len);
+	ctx->sessions = g_ptr_array_new();
+	ctx->relays = relays;
+	session_ids = g_array_new(FALSE, FALSE, sizeof(uint64_t));
 
-	/* We need a pointer to the context from the packet_seek function. */
-	ctx.session->ctx = &ctx;
+	ret = parse_url(url, hostname, &port, session_ids);
+	if (ret < 0) {
+		goto error;
+	}
 
-	/* HT to store the CTF traces. */
-	ctx.session->ctf_traces = g_hash_table_new(g_direct_hash,
-			g_direct_equal);
+	for (i = 0; i < session_ids->len; i++) {
+		struct lttng_live_session *session;
 
-	ret = parse_url(path, hostname, &port, &session_id);
-	if (ret < 0) {
-		goto end_free;
+		session = g_new0(struct lttng_live_session, 1);
+		session->id = g_array_index(session_ids, uint64_t, i);
+		session->active = 1;
+		/* We need a pointer to the context from the packet_seek function. */
+		session->ctx = ctx;
+		/* HT to store the CTF traces. */
+		session->ctf_traces = g_hash_table_new(g_direct_hash,
+				g_direct_equal);
+		g_ptr_array_add(ctx->sessions, session);
 	}
 
-	ret = lttng_live_connect_viewer(&ctx, hostname, port);
+	ret = lttng_live_connect_viewer(ctx, hostname, port);
 	if (ret < 0) {
 		fprintf(stderr, "[error] Connection failed\n");
-		goto end_free;
+		goto error;
 	}
 	printf_verbose("LTTng-live connected to relayd\n");
 
-	ret = lttng_live_establish_connection(&ctx);
+	ret = lttng_live_establish_connection(ctx);
 	if (ret < 0) {
-		goto end_free;
+		goto error;
 	}
+	g_array_free(session_ids, TRUE);
+	return ctx;
+
+error:
+	g_array_free(session_ids, TRUE);
+	close_relay(ctx);
+	return NULL;
+}
+
+/*
+ * path holds one or more URLs separated by spaces. The sessions of all
+ * the relay daemons are followed at once, their traces merged in time
+ * order. The sessions of the URLs without session ID are listed.
+ */
+static int lttng_live_open_trace_read(const char *path)
+{
+	GPtrArray *relays;
+	gchar **urls;
+	unsigned int i, nr_sessions = 0;
+	int ret = 0;
 
-	if (session_id == -1ULL) {
-		printf_verbose("Listing sessions\n");
-		ret = lttng_live_list_sessions(&ctx, path);
-		if (ret < 0) {
-			fprintf(stderr, "[error] List error\n");
+	relays = g_ptr_array_new();
+	urls = g_strsplit(path, " ", 0);
+	for (i = 0; urls[i]; i++) {
+		struct lttng_live_ctx *ctx;
+
+		if (urls[i][0] == '\0')
+			continue;
+		ctx = open_relay(urls[i], relays);
+		if (!ctx) {
+			ret = -1;
 			goto end_free;
 		}
-	} else {
-		lttng_live_read(&ctx, session_id);
+		g_ptr_array_add(relays, ctx);
+		if (!ctx->sessions->len) {
+			printf_verbose("Listing sessions\n");
+			ret = lttng_live_list_sessions(ctx, urls[i]);
+			if (ret < 0) {
+				fprintf(stderr, "[error] List error\n");
+				goto end_free;
+			}
+		}
+		nr_sessions += ctx->sessions->len;
 	}
 
+	if (nr_sessions)
+		lttng_live_read(relays);
+
 end_free:
-	g_hash_table_destroy(ctx.session->ctf_traces);
-	g_free(ctx.session);
-	g_free(ctx.session->streams);
+	for (i = 0; i < relays->len; i++)
+		close_relay(g_ptr_array_index(relays, i));
+	g_ptr_array_free(relays, TRUE);
+	g_strfreev(urls);
 	return ret;
 }
 
@@ -195,5 +195,11 @@ extern int opt_all_field_names,
 
 extern uint64_t opt_clock_offset;
 extern uint64_t opt_clock_offset_ns;
+extern uint64_t opt_mmap_window_len;
+extern int opt_index_threads;
+extern int opt_write_index_cache;
+extern int opt_pipeline_depth;
+extern int opt_zero_copy_strings;
+extern uint64_t opt_live_buffer_pool_len;
 
 #endif
@@ -30,6 +30,7 @@
 #include <stdint.h>	/* C99 5.2.4.2 Numerical limits */
 #include <limits.h>	/* C99 5.2.4.2 Numerical limits */
 #include <assert.h>
+#include <string.h>
 #include <babeltrace/endian.h>	/* Non-standard BIG_ENDIAN, LITTLE_ENDIAN, BYTE_ORDER */
 
 /* We can't shift a int from 32 bit, >> 32 and << 32 on int is undefined */
@@ -404,4 +405,88 @@ do {									\
 
 #endif
 
+/*
+ * Word-at-a-time reads.
+ *
+ * The read macros above assemble a field one unit at a time, which is
+ * needlessly slow for the short unaligned fields of packed headers. A
+ * field whose bits fit within the 8 bytes starting at the byte holding
+ * its first bit can instead be extracted from a single unaligned 64-bit
+ * load, shifted and masked. bt_bitfield_word_ok() tells whether this
+ * applies, given the number of bytes readable from the base pointer:
+ * all 8 bytes are loaded, even past the end of the field.
+ */
+
+#define bt_bitfield_word_ok(_start, _length, _avail)			\
+	((_length) && (_start) % CHAR_BIT + (_length) <= 64		\
+	 && (_start) / CHAR_BIT + sizeof(uint64_t) <= (_avail))
+
+static inline
+uint64_t _bt_bitfield_load_word_le(const unsigned char *ptr)
+{
+	uint64_t v;
+
+	memcpy(&v, ptr, sizeof(v));
+#if (BYTE_ORDER == BIG_ENDIAN)
+	v = __builtin_bswap64(v);
+#endif
+	return v;
+}
+
+static inline
+uint64_t _bt_bitfield_load_word_be(const unsigned char *ptr)
+{
+	uint64_t v;
+
+	memcpy(&v, ptr, sizeof(v));
+#if (BYTE_ORDER == LITTLE_ENDIAN)
+	v = __builtin_bswap64(v);
+#endif
+	return v;
+}
+
+/*
+ * bt_bitfield_read_word_le - read unsigned integer from a little endian
+ *                            bitfield with a single 64-bit load
+ * bt_bitfield_read_word_be - read unsigned integer from a big endian
+ *                            bitfield with a single 64-bit load
+ * bt_bitfield_sign_extend - sign-extend a value read from a bitfield
+ *
+ * bt_bitfield_word_ok() must hold, which implies a non-zero _length.
+ */
+
+static inline
+uint64_t bt_bitfield_read_word_le(const void *_ptr, uint64_t _start,
+		unsigned int _length)
+{
+	uint64_t v;
+
+	v = _bt_bitfield_load_word_le((const unsigned char *) _ptr
+			+ _start / CHAR_BIT);
+	v >>= _start % CHAR_BIT;
+	if (_length < 64)
+		v &= ~(~(uint64_t) 0 << _length);
+	return v;
+}
+
+static inline
+uint64_t bt_bitfield_read_word_be(const void *_ptr, uint64_t _start,
+		unsigned int _length)
+{
+	uint64_t v;
+
+	v = _bt_bitfield_load_word_be((const unsigned char *) _ptr
+			+ _start / CHAR_BIT);
+	v <<= _start % CHAR_BIT;
+	return v >> (64 - _length);
+}
+
+static inline
+int64_t bt_bitfield_sign_extend(uint64_t _v, unsigned int _length)
+{
+	uint64_t sign = (uint64_t) 1 << (_length - 1);
+
+	return (int64_t) ((_v ^ sign) - sign);
+}
+
 #endif /* _BABELTRACE_BITFIELD_H */
@@ -43,6 +43,26 @@ struct ctf_event_declaration;
 struct ctf_clock;
 struct ctf_callsite;
 
+/*
+ * Event header fields found within one of the event header variant
+ * fields (e.g. the "compact" and "extended" LTTng event headers).
+ */
+struct ctf_event_header_variant_field {
+	struct bt_definition *field;		/* Variant field definition */
+	struct definition_integer *id;
+	struct definition_integer *timestamp;
+};
+
+/*
+ * Events to read from a stream, installed by a filtered iterator.
+ * ctf_read_event() skips the other events without returning them.
+ */
+struct ctf_stream_filter {
+	int skip_stream;		/* Read no event from this stream */
+	uint64_t begin, end;		/* Real timestamp range, in ns, inclusive */
+	GByteArray *event_ids;		/* Non-zero for wanted event IDs, NULL for all */
+};
+
 struct ctf_stream_definition {
 	struct ctf_stream_declaration *stream_class;
 	uint64_t real_timestamp;		/* Current timestamp, in ns */
@@ -55,11 +75,23 @@ struct ctf_stream_definition {
 	struct definition_struct *stream_packet_context;
 	struct definition_struct *stream_event_header;
 	struct definition_struct *stream_event_context;
+	struct ctf_decoder *stream_event_header_decoder;
+	struct ctf_decoder *stream_event_context_decoder;
+	/*
+	 * Event header fields, resolved once when the definitions are
+	 * created. NULL if absent.
+	 */
+	struct definition_integer *event_header_id;
+	struct definition_enum *event_header_enum_id;
+	struct definition_integer *event_header_timestamp;
+	struct definition_variant *event_header_variant;
+	GArray *event_header_variant_fields;	/* Array of struct ctf_event_header_variant_field */
 	GPtrArray *events_by_id;		/* Array of struct ctf_event_definition pointers indexed by id */
 	struct definition_scope *parent_def_scope;	/* for initialization */
 	int stream_definitions_created;
 
 	struct ctf_clock *current_clock;
+	struct ctf_stream_filter *filter;	/* NULL if all events are read */
 
 	/* Event discarded information */
 	uint64_t events_discarded;
@@ -74,6 +106,16 @@ struct ctf_event_definition {
 	struct ctf_stream_definition *stream;
 	struct definition_struct *event_context;
 	struct definition_struct *event_fields;
+	/* Compiled decoders, NULL if the layout is not fixed. */
+	struct ctf_decoder *event_context_decoder;
+	struct ctf_decoder *event_fields_decoder;
+	/*
+	 * Decoders of the stream event context, event context and payload
+	 * which follow the event header, read with a single bounds check.
+	 * nr_body_decoders is 0 if any of those structures is not compiled.
+	 */
+	const struct ctf_decoder *body_decoders[3];
+	unsigned int nr_body_decoders;
 };
 
 #define CTF_CLOCK_SET_FIELD(ctf_clock, field)				\
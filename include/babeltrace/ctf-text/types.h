@@ -30,12 +30,15 @@
 #include <sys/mman.h>
 #include <errno.h>
 #include <stdint.h>
+#include <stdio.h>
+#include <string.h>
 #include <unistd.h>
 #include <glib.h>
 #include <babeltrace/babeltrace-internal.h>
 #include <babeltrace/types.h>
 #include <babeltrace/format.h>
 #include <babeltrace/format-internal.h>
+#include <babeltrace/ctf/types.h>
 
 /*
  * Inherit from both struct bt_stream_pos and struct bt_trace_descriptor.
@@ -51,8 +54,23 @@ struct ctf_text_stream_pos {
 	uint64_t last_real_timestamp;	/* to print delta */
 	uint64_t last_cycles_timestamp;	/* to print delta */
 	GString *string;	/* Current string */
+	/*
+	 * Output buffer. Events are formatted into it, and it is only
+	 * written to fp by ctf_text_flush(), in large chunks.
+	 */
+	char *buf;
+	size_t buf_len;		/* Bytes used in buf */
+	size_t buf_alloc_len;	/* Bytes allocated for buf */
+	int flush_each_event;	/* Flush after each event (terminal) */
+	struct ctf_timestamp_cache ts_cache;	/* Last second printed */
 };
 
+/*
+ * Initial output buffer size, and amount of output buffered before
+ * it is written at the end of an event.
+ */
+#define CTF_TEXT_BUF_LEN	(64 * 1024)
+
 static inline
 struct ctf_text_stream_pos *ctf_text_pos(struct bt_stream_pos *pos)
 {
@@ -79,13 +97,91 @@ int ctf_text_array_write(struct bt_stream_pos *pos, struct bt_definition *defini
 BT_HIDDEN
 int ctf_text_sequence_write(struct bt_stream_pos *pos, struct bt_definition *definition);
 
+/*
+ * Make room for len more bytes in the output buffer, and return where
+ * they should be written. The caller then advances pos->buf_len by the
+ * number of bytes actually written.
+ */
+static inline
+char *ctf_text_reserve(struct ctf_text_stream_pos *pos, size_t len)
+{
+	if (unlikely(pos->buf_len + len > pos->buf_alloc_len)) {
+		size_t alloc_len = pos->buf_alloc_len << 1;
+
+		if (alloc_len < CTF_TEXT_BUF_LEN)
+			alloc_len = CTF_TEXT_BUF_LEN;
+		while (alloc_len < pos->buf_len + len)
+			alloc_len <<= 1;
+		pos->buf = g_realloc(pos->buf, alloc_len);
+		pos->buf_alloc_len = alloc_len;
+	}
+	return pos->buf + pos->buf_len;
+}
+
+static inline
+void ctf_text_write(struct ctf_text_stream_pos *pos, const char *str,
+		size_t len)
+{
+	memcpy(ctf_text_reserve(pos, len), str, len);
+	pos->buf_len += len;
+}
+
+static inline
+void ctf_text_puts(struct ctf_text_stream_pos *pos, const char *str)
+{
+	ctf_text_write(pos, str, strlen(str));
+}
+
+static inline
+void ctf_text_putc(struct ctf_text_stream_pos *pos, char c)
+{
+	*ctf_text_reserve(pos, 1) = c;
+	pos->buf_len++;
+}
+
+/*
+ * Write the output buffer to the output file.
+ * Returns 0 on success, -EIO on write error.
+ */
+static inline
+int ctf_text_flush(struct ctf_text_stream_pos *pos)
+{
+	size_t len = pos->buf_len;
+
+	if (!len)
+		return 0;
+	pos->buf_len = 0;
+	if (fwrite(pos->buf, 1, len, pos->fp) != len || fflush(pos->fp))
+		return -EIO;
+	return 0;
+}
+
+/*
+ * Formatting into the output buffer.
+ */
+BT_HIDDEN
+void ctf_text_put_uint(struct ctf_text_stream_pos *pos, uint64_t v);
+BT_HIDDEN
+void ctf_text_put_int(struct ctf_text_stream_pos *pos, int64_t v);
+BT_HIDDEN
+void ctf_text_put_uint_pad(struct ctf_text_stream_pos *pos, uint64_t v,
+		int width);
+BT_HIDDEN
+void ctf_text_put_hex(struct ctf_text_stream_pos *pos, uint64_t v,
+		int upper);
+BT_HIDDEN
+void ctf_text_put_oct(struct ctf_text_stream_pos *pos, uint64_t v);
+BT_HIDDEN
+void ctf_text_printf(struct ctf_text_stream_pos *pos, const char *fmt, ...)
+	__attribute__((format(printf, 2, 3)));
+
 static inline
 void print_pos_tabs(struct ctf_text_stream_pos *pos)
 {
 	int i;
 
 	for (i = 0; i < pos->depth; i++)
-		fprintf(pos->fp, "\t");
+		ctf_text_putc(pos, '\t');
 }
 
 /*
@@ -93,8 +93,21 @@ int bt_ctf_field_structure_set_field(struct bt_ctf_field *structure,
 BT_HIDDEN
 int bt_ctf_field_validate(struct bt_ctf_field *field);
 
+/*
+ * Clear a field's payload, keeping its sub-fields and buffers allocated so
+ * that it can be set again without allocating.
+ */
+BT_HIDDEN
+void bt_ctf_field_reset(struct bt_ctf_field *field);
+
 BT_HIDDEN
 int bt_ctf_field_serialize(struct bt_ctf_field *field,
 		struct ctf_stream_pos *pos);
 
+/*
+ * Grow the packet mapped at pos to make room for more content.
+ */
+BT_HIDDEN
+int increase_packet_size(struct ctf_stream_pos *pos);
+
 #endif /* BABELTRACE_CTF_WRITER_EVENT_FIELDS_INTERNAL_H */
@@ -34,6 +34,9 @@
 #include <babeltrace/ctf/types.h>
 #include <glib.h>
 
+/* Maximal number of released events an event class keeps for reuse */
+#define EVENT_CACHE_MAX_LEN	16
+
 struct bt_ctf_event_class {
 	struct bt_ctf_ref ref_count;
 	GQuark name;
@@ -45,6 +48,11 @@ struct bt_ctf_event_class {
 	struct bt_ctf_field_type *context;
 	/* Structure type containing the event's fields */
 	struct bt_ctf_field_type *fields;
+	/*
+	 * Released events, with their field trees reset, handed out again
+	 * by bt_ctf_event_create(). They don't hold a reference to the class.
+	 */
+	GPtrArray *event_cache; /* Array of pointers to bt_ctf_event */
 	int frozen;
 };
 
@@ -99,6 +99,21 @@ extern void bt_ctf_event_class_put(struct bt_ctf_event_class *event_class);
 extern struct bt_ctf_event *bt_ctf_event_create(
 		struct bt_ctf_event_class *event_class);
 
+/*
+ * bt_ctf_event_reset: reset an event's payload.
+ *
+ * Clear the value of every field of an event so that it may be set and
+ * appended to a stream again. The event's fields and their buffers are kept
+ * allocated; fields which are also referenced outside of the event are
+ * detached from it rather than cleared. Released events are reset and reused
+ * by bt_ctf_event_create() in the same way.
+ *
+ * @param event Event instance.
+ *
+ * Returns 0 on success, a negative value on error.
+ */
+extern int bt_ctf_event_reset(struct bt_ctf_event *event);
+
 /*
  * bt_ctf_event_set_payload: set an event's field.
  *
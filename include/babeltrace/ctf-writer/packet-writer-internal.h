@@ -0,0 +1,87 @@
+#ifndef BABELTRACE_CTF_WRITER_PACKET_WRITER_INTERNAL_H
+#define BABELTRACE_CTF_WRITER_PACKET_WRITER_INTERNAL_H
+
+/*
+ * BabelTrace - CTF Writer: Asynchronous packet writer internal
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <babeltrace/ctf-writer/ref-internal.h>
+#include <babeltrace/babeltrace-internal.h>
+#include <babeltrace/mmap-align.h>
+#include <babeltrace/list.h>
+#include <sys/types.h>
+#include <pthread.h>
+
+/*
+ * Packet memory handed over to the packet writer thread. A buffer is
+ * owned by the thread from packet_writer_submit() until it has been
+ * written out to its stream file and cleared for reuse.
+ */
+struct packet_buffer {
+	struct bt_list_head node;	/* Packet writer queue */
+	struct mmap_align *mma;		/* Anonymous mapping, NULL if unset */
+	int fd;				/* Stream file */
+	off_t offset;			/* Packet offset in the stream file */
+	size_t len;			/* Packet length, in bytes */
+	size_t content_len;		/* Content length, in bytes */
+	int busy;			/* Queued or being written */
+	int error;			/* Write error, reported on next wait */
+};
+
+/*
+ * A single thread writes the packets of all the asynchronous streams of
+ * a writer. Streams share its ownership since they may outlive the writer.
+ */
+struct packet_writer {
+	struct bt_ctf_ref ref_count;
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t queue_cond;	/* Queue not empty, or quitting */
+	pthread_cond_t done_cond;	/* A buffer has been written */
+	struct bt_list_head queue;	/* Submitted packet_buffer */
+	int quit;
+};
+
+BT_HIDDEN
+struct packet_writer *packet_writer_create(void);
+
+BT_HIDDEN
+void packet_writer_get(struct packet_writer *writer);
+
+BT_HIDDEN
+void packet_writer_put(struct packet_writer *writer);
+
+/*
+ * Queue a buffer for writing; buffer->fd, offset and len must be set.
+ */
+BT_HIDDEN
+void packet_writer_submit(struct packet_writer *writer,
+		struct packet_buffer *buffer);
+
+/*
+ * Wait until a buffer may be reused. Returns the error of its last write,
+ * if any, and clears it.
+ */
+BT_HIDDEN
+int packet_writer_wait(struct packet_writer *writer,
+		struct packet_buffer *buffer);
+
+#endif /* BABELTRACE_CTF_WRITER_PACKET_WRITER_INTERNAL_H */
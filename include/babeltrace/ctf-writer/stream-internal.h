@@ -28,6 +28,7 @@
  */
 
 #include <babeltrace/ctf-writer/ref-internal.h>
+#include <babeltrace/ctf-writer/packet-writer-internal.h>
 #include <babeltrace/ctf-writer/clock.h>
 #include <babeltrace/ctf-writer/event-fields.h>
 #include <babeltrace/ctf-writer/event-types.h>
@@ -37,6 +38,28 @@
 
 typedef void(*flush_func)(struct bt_ctf_stream *, void *);
 
+/* Default packet size, in bits */
+#define DEFAULT_PACKET_SIZE	(getpagesize() * 8 * CHAR_BIT)
+
+/* Placement of an integer field relative to the start of its structure */
+struct header_field_layout {
+	uint64_t offset;	/* in bits */
+	unsigned int len;	/* in bits */
+	int byte_order;		/* LITTLE_ENDIAN or BIG_ENDIAN */
+};
+
+/*
+ * The event header is written straight into the packet mapping on append
+ * rather than through a field instance, so its layout is computed once
+ * when the stream class' byte order is set.
+ */
+struct event_header_layout {
+	unsigned int alignment;	/* in bits */
+	uint64_t len;		/* in bits */
+	struct header_field_layout id;
+	struct header_field_layout timestamp;
+};
+
 struct bt_ctf_stream_class {
 	struct bt_ctf_ref ref_count;
 	GString *name;
@@ -47,7 +70,7 @@ struct bt_ctf_stream_class {
 	uint32_t next_event_id;
 	uint32_t next_stream_id;
 	struct bt_ctf_field_type *event_header_type;
-	struct bt_ctf_field *event_header;
+	struct event_header_layout event_header_layout;
 	struct bt_ctf_field_type *packet_context_type;
 	struct bt_ctf_field *packet_context;
 	struct bt_ctf_field_type *event_context_type;
@@ -65,9 +88,27 @@ struct bt_ctf_stream {
 	uint32_t id;
 	struct bt_ctf_stream_class *stream_class;
 	struct flush_callback flush;
-	/* Array of pointers to bt_ctf_event for the current packet */
-	GPtrArray *events;
 	struct ctf_stream_pos pos;
+	uint64_t packet_size;	/* Initial size of new packets, in bits */
+	off_t next_packet_offset;
+	/*
+	 * In asynchronous mode, packets are built in anonymous memory,
+	 * alternating between two buffers: one is being filled while the
+	 * other is written out by the packet writer thread.
+	 */
+	struct packet_writer *packet_writer;
+	struct packet_buffer buffers[2];
+	unsigned int current_buffer;
+	/*
+	 * Events are serialized in the current packet as they are appended.
+	 * The packet context is rewritten in place when the packet is
+	 * flushed, once its content size and time range are known.
+	 */
+	int packet_open;
+	struct ctf_stream_pos packet_context_pos;
+	uint64_t packet_event_count;
+	uint64_t timestamp_begin;
+	uint64_t timestamp_end;
 	unsigned int flushed_packet_count;
 	uint64_t events_discarded;
 };
@@ -98,4 +139,14 @@ int bt_ctf_stream_set_flush_callback(struct bt_ctf_stream *stream,
 BT_HIDDEN
 int bt_ctf_stream_set_fd(struct bt_ctf_stream *stream, int fd);
 
+/* Size of the packets, in bytes; must be a multiple of the page size */
+BT_HIDDEN
+int bt_ctf_stream_set_packet_size(struct bt_ctf_stream *stream,
+		uint64_t packet_size);
+
+/* Hand the stream's packets to a packet writer thread */
+BT_HIDDEN
+int bt_ctf_stream_set_packet_writer(struct bt_ctf_stream *stream,
+		struct packet_writer *writer);
+
 #endif /* BABELTRACE_CTF_WRITER_STREAM_INTERNAL_H */
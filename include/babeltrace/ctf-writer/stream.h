@@ -120,10 +120,10 @@ extern void bt_ctf_stream_append_discarded_events(struct bt_ctf_stream *stream,
  * bt_ctf_stream_append_event: append an event to the stream.
  *
  * Append "event" to the stream's current packet. The stream's associated clock
- * will be sampled during this call. The event shall not be modified after
- * being appended to a stream. The stream will share the event's ownership by
- * incrementing its reference count. The current packet is not flushed to disk
- * until the next call to bt_ctf_stream_flush.
+ * will be sampled during this call. The event is serialized in the current
+ * packet by this call: the stream does not keep a reference to it and later
+ * modifications to the event have no effect on the stream. The current packet
+ * is not complete until the next call to bt_ctf_stream_flush.
  *
  * @param stream Stream instance.
  * @param event Event instance to append to the stream's current packet.
@@ -137,7 +137,8 @@ extern int bt_ctf_stream_append_event(struct bt_ctf_stream *stream,
  * bt_ctf_stream_flush: flush a stream.
  *
  * The stream's current packet's events will be flushed to disk. Events
- * subsequently appended to the stream will be added to a new packet.
+ * subsequently appended to the stream will be added to a new packet. A packet
+ * left open when the stream is released is flushed at that point.
  *
  * @param stream Stream instance.
  *
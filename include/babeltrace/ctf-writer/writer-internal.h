@@ -28,6 +28,7 @@
  */
 
 #include <babeltrace/ctf-writer/ref-internal.h>
+#include <babeltrace/ctf-writer/packet-writer-internal.h>
 #include <babeltrace/ctf-writer/writer.h>
 #include <babeltrace/ctf-writer/event-types.h>
 #include <babeltrace/ctf-writer/event-fields.h>
@@ -62,6 +63,9 @@ struct bt_ctf_writer {
 	struct bt_ctf_field_type *trace_packet_header_type;
 	struct bt_ctf_field *trace_packet_header;
 	uint32_t next_stream_id;
+	uint64_t packet_size; /* In bytes, 0 for the default size */
+	int async_flush;
+	struct packet_writer *packet_writer; /* Created with the first stream */
 };
 
 struct environment_variable {
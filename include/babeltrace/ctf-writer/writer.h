@@ -30,6 +30,8 @@
  * http://www.efficios.com/ctf
  */
 
+#include <stdint.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -140,6 +142,41 @@ extern void bt_ctf_writer_flush_metadata(struct bt_ctf_writer *writer);
 extern int bt_ctf_writer_set_byte_order(struct bt_ctf_writer *writer,
 		enum bt_ctf_byte_order byte_order);
 
+/*
+ * bt_ctf_writer_set_packet_size: set the size of the trace's packets.
+ *
+ * Set the size of the packets of the streams subsequently created by the
+ * writer. Packets holding more data are grown as needed. Larger packets
+ * reduce the per-packet overhead of writing events. Defaults to 8 pages.
+ *
+ * @param writer Writer instance.
+ * @param packet_size Packet size in bytes, a multiple of the page size.
+ *
+ * Returns 0 on success, a negative value on error.
+ */
+extern int bt_ctf_writer_set_packet_size(struct bt_ctf_writer *writer,
+		uint64_t packet_size);
+
+/*
+ * bt_ctf_writer_set_async_flush: write packets from a background thread.
+ *
+ * When enabled, the packets of the streams subsequently created by the
+ * writer are built in memory and written to the stream files by a
+ * background thread, which bt_ctf_stream_flush only hands complete packets
+ * to. Each stream alternates between two packet buffers: a flush only waits
+ * when the previous packet of the stream is still being written. A write
+ * error is returned by the next bt_ctf_stream_append_event starting a packet
+ * in the same buffer, or reported when the stream is released. Disabled by
+ * default.
+ *
+ * @param writer Writer instance.
+ * @param async_flush Non-zero to enable asynchronous packet writing.
+ *
+ * Returns 0 on success, a negative value on error.
+ */
+extern int bt_ctf_writer_set_async_flush(struct bt_ctf_writer *writer,
+		int async_flush);
+
 /*
  * bt_ctf_writer_get and bt_ctf_writer_put: increment and decrement the
  * writer's reference count.
@@ -29,7 +29,7 @@
 
 #define CTF_INDEX_MAGIC 0xC1F1DCC1
 #define CTF_INDEX_MAJOR 1
-#define CTF_INDEX_MINOR 0
+#define CTF_INDEX_MINOR 1
 
 /*
  * Header at the beginning of each index file.
@@ -43,6 +43,33 @@ struct ctf_packet_index_file_hdr {
 	uint32_t packet_index_len;
 } __attribute__((__packed__));
 
+#define CTF_INDEX_EXT_MAGIC 0xC1F1DCE1
+#define CTF_INDEX_EXT_VERSION 1
+/* First index minor version which may have a header extension. */
+#define CTF_INDEX_EXT_MINOR 1
+
+/*
+ * Header extension following the index file header in the index files
+ * written by babeltrace (index cache). It records the stream file the
+ * index was built from: the index is out of date when the stream size or
+ * modification time differ. Index 1.0 files, such as those written by
+ * the tracer, have no extension. Readers only look for it from index
+ * minor version CTF_INDEX_EXT_MINOR, and check its magic, since other
+ * writers may omit it.
+ * Later versions may grow the extension: readers skip "len" bytes.
+ * All integer fields are stored in big endian.
+ */
+struct ctf_packet_index_file_hdr_ext {
+	uint32_t magic;
+	uint32_t version;
+	/* struct ctf_packet_index_file_hdr_ext length, in bytes */
+	uint32_t len;
+	uint32_t reserved;
+	uint64_t stream_size;		/* stream file size, in bytes */
+	uint64_t stream_mtime_sec;	/* stream file modification time */
+	uint64_t stream_mtime_nsec;
+} __attribute__((__packed__));
+
 /*
  * Packet index generated for each trace packet store in a trace file.
  * All integer fields are stored in big endian.
@@ -77,6 +77,11 @@ struct bt_ctf_iter {
 	 */
 	GPtrArray *dep_gc;
 	uint64_t events_lost;
+	/*
+	 * Streams on which a filter was installed at iterator creation
+	 * (struct ctf_file_stream pointers). NULL if not filtered.
+	 */
+	GPtrArray *filtered_streams;
 };
 
 void ctf_print_discarded(FILE *fp, struct ctf_stream_definition *stream,
@@ -44,6 +44,7 @@ struct bt_declaration;
 struct bt_ctf_event;
 struct bt_ctf_event_decl;
 struct bt_ctf_field_decl;
+struct bt_ctf_field_handle;
 
 /*
  * the top-level scopes in CTF
@@ -141,6 +142,44 @@ const struct bt_definition *bt_ctf_get_field(const struct bt_ctf_event *event,
 		const struct bt_definition *scope,
 		const char *field);
 
+/*
+ * bt_ctf_field_handle_create: resolve a field of a top-level scope
+ *
+ * Lookup "field" within the top-level "scope" of "event" once, and
+ * return a handle which can then be passed to
+ * bt_ctf_get_field_from_handle() to get this field from any event
+ * sharing the same scope layout, without any name lookup or memory
+ * allocation. The layout of the event scopes is the same for all events
+ * of an event class, and the layout of the stream scopes is the same
+ * for all events of a stream class. Return NULL if the field does not
+ * exist or on error.
+ *
+ * The handle must be released with bt_ctf_field_handle_destroy().
+ */
+struct bt_ctf_field_handle *bt_ctf_field_handle_create(
+		const struct bt_ctf_event *event,
+		enum bt_ctf_scope scope,
+		const char *field);
+
+/*
+ * bt_ctf_field_handle_destroy: release a handle returned by
+ * bt_ctf_field_handle_create()
+ */
+void bt_ctf_field_handle_destroy(struct bt_ctf_field_handle *handle);
+
+/*
+ * bt_ctf_get_field_from_handle: returns the definition of the field
+ * designated by a handle
+ *
+ * This is equivalent to bt_ctf_get_field() on the handle's top-level
+ * scope. Return NULL if the event scope does not have the layout the
+ * handle was resolved against, e.g. if the event belongs to another
+ * event class.
+ */
+const struct bt_definition *bt_ctf_get_field_from_handle(
+		const struct bt_ctf_event *event,
+		const struct bt_ctf_field_handle *handle);
+
 /*
  * bt_ctf_get_index: if the field is an array or a sequence, return the element
  * at position index, otherwise return NULL;
@@ -38,7 +38,25 @@ extern "C" {
 #endif
 
 struct bt_ctf_iter;
+struct bt_ctf_iter_filter;
 struct bt_ctf_event;
+struct ctf_stream_definition;
+
+/*
+ * struct bt_ctf_event_batch: arrays filled by bt_ctf_iter_read_events(),
+ * element i describing the i-th event read. Each array is provided by
+ * the caller and must hold at least as many elements as requested; it
+ * may be NULL if the caller does not need it.
+ */
+struct bt_ctf_event_batch {
+	uint64_t *timestamp;	/* As returned by bt_ctf_get_timestamp() */
+	uint64_t *cycles;	/* As returned by bt_ctf_get_cycles() */
+	uint64_t *event_id;	/* Event ID within its stream class */
+	uint64_t *stream_id;	/* Stream class ID */
+	/* Stream read from, valid as long as the iterator exists. */
+	const struct ctf_stream_definition **stream;
+	int *handle_id;		/* Trace handle ID */
+};
 
 /*
  * bt_ctf_iter_create - Allocate a CTF trace collection iterator.
@@ -63,6 +81,72 @@ struct bt_ctf_iter *bt_ctf_iter_create(struct bt_context *ctx,
 		const struct bt_iter_pos *begin_pos,
 		const struct bt_iter_pos *end_pos);
 
+/*
+ * bt_ctf_iter_filter_create - Allocate an iterator filter.
+ *
+ * A filter restricts the events returned by an iterator created with
+ * bt_ctf_iter_create_filtered(). An event is returned if:
+ * - its name is one of the event names added, if any,
+ * - its stream ID is one of the stream IDs added, if any,
+ * - its timestamp (as returned by bt_ctf_get_timestamp()) is within
+ *   the time range, if set.
+ *
+ * The other events are skipped by the trace reader: packets outside of
+ * the time range are not read, and the payload of unwanted events is
+ * not read when its layout is fixed.
+ *
+ * Return a pointer to the newly allocated filter, which accepts all
+ * events.
+ */
+struct bt_ctf_iter_filter *bt_ctf_iter_filter_create(void);
+
+/*
+ * bt_ctf_iter_filter_destroy - Free an iterator filter.
+ *
+ * Iterators created with the filter are not affected.
+ */
+void bt_ctf_iter_filter_destroy(struct bt_ctf_iter_filter *filter);
+
+/*
+ * bt_ctf_iter_filter_add_event_name - Accept events named "name".
+ *
+ * Return 0 on success, a negative value on error.
+ */
+int bt_ctf_iter_filter_add_event_name(struct bt_ctf_iter_filter *filter,
+		const char *name);
+
+/*
+ * bt_ctf_iter_filter_add_stream_id - Accept events of streams with ID
+ * "stream_id".
+ *
+ * Return 0 on success, a negative value on error.
+ */
+int bt_ctf_iter_filter_add_stream_id(struct bt_ctf_iter_filter *filter,
+		uint64_t stream_id);
+
+/*
+ * bt_ctf_iter_filter_set_time_range - Accept events with a timestamp
+ * within [begin, end], in nanoseconds.
+ *
+ * Return 0 on success, a negative value on error.
+ */
+int bt_ctf_iter_filter_set_time_range(struct bt_ctf_iter_filter *filter,
+		uint64_t begin, uint64_t end);
+
+/*
+ * bt_ctf_iter_create_filtered - Allocate a CTF trace collection
+ * iterator only returning the events accepted by a filter.
+ *
+ * Same as bt_ctf_iter_create(), with the events skipped as specified by
+ * filter, which may be NULL to read all events. Seeks only consider the
+ * events accepted by the filter. The filter applies to the streams
+ * opened when the iterator is created.
+ */
+struct bt_ctf_iter *bt_ctf_iter_create_filtered(struct bt_context *ctx,
+		const struct bt_iter_pos *begin_pos,
+		const struct bt_iter_pos *end_pos,
+		const struct bt_ctf_iter_filter *filter);
+
 /*
  * bt_ctf_get_iter - get iterator from ctf iterator.
  */
@@ -94,6 +178,29 @@ struct bt_ctf_event *bt_ctf_iter_read_event(struct bt_ctf_iter *iter);
 struct bt_ctf_event *bt_ctf_iter_read_event_flags(struct bt_ctf_iter *iter,
 		int *flags);
 
+/*
+ * bt_ctf_iter_read_events: Read a batch of events.
+ *
+ * @iter: trace collection iterator (input). Should NOT be NULL.
+ * @batch: arrays receiving the events (output).
+ * @n: maximum number of events to read.
+ *
+ * Read up to n events, starting at the iterator's current event, and
+ * move the iterator past them: this is equivalent to n iterations of
+ * bt_ctf_iter_read_event() followed by bt_iter_next(), but only the
+ * fields of struct bt_ctf_event_batch are kept for each event. After
+ * the call, bt_ctf_iter_read_event() returns the event following the
+ * batch, and bt_ctf_get_lost_events_count() returns the number of
+ * events discarded within the batch.
+ *
+ * Return the number of events read, 0 on end of trace, or a negative
+ * value on error. -EAGAIN is returned if the current packet holds no
+ * event, in which case bt_ctf_iter_read_event_flags() would have set
+ * BT_ITER_FLAG_RETRY: call bt_iter_next() and retry.
+ */
+int bt_ctf_iter_read_events(struct bt_ctf_iter *iter,
+		struct bt_ctf_event_batch *batch, unsigned int n);
+
 /*
  * bt_ctf_get_lost_events_count: returns the number of events discarded
  * immediately prior to the last event read
@@ -41,11 +41,19 @@
 #define CTF_MAGIC	0xC1FC1FC1
 #define TSDL_MAGIC	0x75D11D57
 
+struct ctf_stream_pipeline;
+
 struct ctf_file_stream {
 	struct ctf_stream_definition parent;
 	struct ctf_stream_pos pos;	/* current stream position */
+	struct ctf_stream_pipeline *pipeline;	/* decoding pipeline, NULL if unused */
+	int pipeline_reader;	/* decodes ahead for the pipeline of another stream */
 };
 
+BT_HIDDEN
+void ctf_file_stream_set_filter(struct ctf_file_stream *file_stream,
+		struct ctf_stream_filter *filter);
+
 #define HEADER_END		char end_field
 #define header_sizeof(type)	offsetof(typeof(type), end_field)
 
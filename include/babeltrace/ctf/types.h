@@ -61,6 +61,17 @@ struct packet_index {
 	struct packet_index_time ts_real;	/* realtime timestamp */
 };
 
+/*
+ * Sparse sub-index of event positions within a packet, populated
+ * lazily by time seeks. Entries are sorted by offset (and therefore by
+ * timestamp) within each packet.
+ */
+struct packet_event_index {
+	int64_t offset;		/* offset of the event in the packet, in bits */
+	uint64_t cycles_timestamp;	/* event timestamp, in cycles */
+	uint64_t real_timestamp;	/* event timestamp, in ns */
+};
+
 /*
  * Always update ctf_stream_pos with ctf_move_pos and ctf_init_pos.
  */
@@ -69,12 +80,18 @@ struct ctf_stream_pos {
 	int fd;			/* backing file fd. -1 if unset. */
 	FILE *index_fp;		/* backing index file fp. NULL if unset. */
 	GArray *packet_index;	/* contains struct packet_index */
+	/*
+	 * Contains a GArray of struct packet_event_index (or NULL) for
+	 * each packet. NULL if unset.
+	 */
+	GPtrArray *packet_event_index;
 	int prot;		/* mmap protection */
 	int flags;		/* mmap flags */
 
 	/* Current position */
 	off_t mmap_offset;	/* mmap offset in the file, in bytes */
 	off_t mmap_base_offset;	/* offset of start of packet in mmap, in bytes */
+	off_t mmap_window_offset;	/* read window mmap offset in the file, in bytes */
 	uint64_t packet_size;	/* current packet size, in bits */
 	uint64_t content_size;	/* current content size, in bits */
 	uint64_t *content_size_loc; /* pointer to current content size */
@@ -88,6 +105,12 @@ struct ctf_stream_pos {
 			int whence); /* function called to switch packet */
 
 	int dummy;		/* dummy position, for length calculation */
+	/*
+	 * String definitions referencing the current mapping rather
+	 * than their own copy (zero-copy strings). NULL if strings are
+	 * copied on read.
+	 */
+	GPtrArray *borrowed_strings;
 	struct bt_stream_callbacks *cb;	/* Callbacks registered for iterator. */
 	void *priv;
 };
@@ -111,6 +134,8 @@ int ctf_string_read(struct bt_stream_pos *pos, struct bt_definition *definition)
 BT_HIDDEN
 int ctf_string_write(struct bt_stream_pos *pos, struct bt_definition *definition);
 BT_HIDDEN
+void ctf_pos_detach_strings(struct ctf_stream_pos *pos);
+BT_HIDDEN
 int ctf_enum_read(struct bt_stream_pos *pos, struct bt_definition *definition);
 BT_HIDDEN
 int ctf_enum_write(struct bt_stream_pos *pos, struct bt_definition *definition);
@@ -126,6 +151,24 @@ BT_HIDDEN
 int ctf_sequence_read(struct bt_stream_pos *pos, struct bt_definition *definition);
 BT_HIDDEN
 int ctf_sequence_write(struct bt_stream_pos *pos, struct bt_definition *definition);
+BT_HIDDEN
+void ctf_enum_update_quark_set(struct definition_enum *enum_definition);
+
+struct ctf_decoder;
+
+BT_HIDDEN
+struct ctf_decoder *ctf_decoder_create(struct definition_struct *definition);
+BT_HIDDEN
+void ctf_decoder_destroy(struct ctf_decoder *decoder);
+BT_HIDDEN
+int ctf_decoder_read(struct ctf_stream_pos *pos,
+		const struct ctf_decoder *decoder);
+BT_HIDDEN
+int ctf_decoders_read(struct ctf_stream_pos *pos,
+		const struct ctf_decoder * const *decoders, size_t nr);
+BT_HIDDEN
+int ctf_decoders_skip(struct ctf_stream_pos *pos,
+		const struct ctf_decoder * const *decoders, size_t nr);
 
 void ctf_packet_seek(struct bt_stream_pos *pos, size_t index, int whence);
 
@@ -224,6 +267,39 @@ int ctf_pos_access_ok(struct ctf_stream_pos *pos, uint64_t bit_len)
 	return 1;
 }
 
+/*
+ * Set the value of a float definition, along with its sign, exponent and
+ * mantissa fields, from its len-bit IEEE 754 binary representation.
+ */
+static inline
+void ctf_float_set_bits(struct definition_float *float_definition,
+		uint64_t v, size_t len)
+{
+	unsigned int mant_len = float_definition->declaration->mantissa->len;
+	unsigned int exp_len = float_definition->declaration->exp->len;
+	uint64_t exp;
+
+	float_definition->mantissa->value._unsigned =
+		v & ((1ULL << mant_len) - 1);
+	exp = (v >> mant_len) & ((1ULL << exp_len) - 1);
+	/* Sign-extend the exponent, as read by ctf_integer_read(). */
+	float_definition->exp->value._signed =
+		(int64_t) (exp << (64 - exp_len)) >> (64 - exp_len);
+	float_definition->sign->value._unsigned = v >> (mant_len + exp_len);
+	if (len == sizeof(float) * CHAR_BIT) {
+		uint32_t v32 = (uint32_t) v;
+		float f;
+
+		memcpy(&f, &v32, sizeof(f));
+		float_definition->value = f;
+	} else {
+		double d;
+
+		memcpy(&d, &v, sizeof(d));
+		float_definition->value = d;
+	}
+}
+
 /*
  * Update the stream position to the current event. This moves to
  * the next packet if we are located at the end of the current packet.
@@ -241,7 +317,33 @@ void ctf_pos_get_event(struct ctf_stream_pos *pos)
 	}
 }
 
+/*
+ * Buffer size sufficient to hold any formatted timestamp, including
+ * the terminating '\0'.
+ */
+#define CTF_TIMESTAMP_STR_LEN	64
+
+/*
+ * Formatted wall-clock time of the last second printed by an output,
+ * up to and including the decimal point.
+ */
+struct ctf_timestamp_cache {
+	int valid;
+	uint64_t sec;		/* Cached second, offsets applied */
+	size_t len;
+	char str[CTF_TIMESTAMP_STR_LEN];
+};
+
 void ctf_print_timestamp(FILE *fp, struct ctf_stream_definition *stream,
 			uint64_t timestamp);
+/*
+ * Format a timestamp as ctf_print_timestamp() prints it into buf, of
+ * size CTF_TIMESTAMP_STR_LEN or more. cache, which may be NULL, saves
+ * formatting the date and time of day again for events within the
+ * same second. Returns the length of the formatted string.
+ */
+int ctf_format_timestamp(char *buf, struct ctf_timestamp_cache *cache,
+			struct ctf_stream_definition *stream,
+			uint64_t timestamp);
 
 #endif /* _BABELTRACE_CTF_TYPES_H */
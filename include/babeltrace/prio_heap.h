@@ -4,8 +4,13 @@
 /*
  * prio_heap.h
  *
- * Static-sized priority heap containing pointers. Based on CLRS,
- * chapter 6.
+ * Priority queue containing pointers, implemented as a loser tree
+ * (tournament tree) with the entry keys cached in the tree nodes.
+ *
+ * Entries are ordered by increasing key, as returned by the key()
+ * callback when they are inserted (or replace the maximum). gt() breaks
+ * ties between equal keys. The "maximum" is the entry with the smallest
+ * key.
  *
  * Copyright 2011 - Mathieu Desnoyers <mathieu.desnoyers@efficios.com>
  *
@@ -29,12 +34,30 @@
  */
 
 #include <unistd.h>
+#include <stdint.h>
 #include <babeltrace/babeltrace-internal.h>
 
+struct ptr_heap_node {
+	uint64_t key;
+	size_t leaf;
+};
+
 struct ptr_heap {
-	size_t len, alloc_len;
-	void **ptrs;
+	size_t len;			/* Number of entries */
+	size_t alloc_len;		/* Number of leaves, power of 2 */
+	size_t nr_leaves;		/* Leaves used so far, including holes */
+	void **ptrs;			/* Leaf entries, NULL for holes */
+	uint64_t *keys;			/* Leaf keys */
+	/*
+	 * nodes[0] is the winner, nodes[1 .. alloc_len - 1] hold the
+	 * loser of each match.
+	 */
+	struct ptr_heap_node *nodes;
+	struct ptr_heap_node *winners;	/* Scratch space for rebuilds */
+	uint64_t runner_up_key;		/* Smallest key on the winner path */
+	int dirty;			/* Tree needs a rebuild */
 	int (*gt)(void *a, void *b);
+	uint64_t (*key)(void *p);
 };
 
 #ifdef DEBUG_HEAP
@@ -46,30 +69,46 @@ void check_heap(const struct ptr_heap *heap)
 }
 #endif
 
+extern void bt_heap_rebuild(struct ptr_heap *heap);
+
 /**
  * bt_heap_maximum - return the largest element in the heap
  * @heap: the heap to be operated on
  *
- * Returns the largest element in the heap, without performing any modification
- * to the heap structure. Returns NULL if the heap is empty.
+ * Returns the largest element in the heap (the one with the smallest key),
+ * without removing it. Returns NULL if the heap is empty.
+ *
+ * The heap is not const: when it was modified by bt_heap_insert() or
+ * bt_heap_cherrypick() since the last lookup, the tree is rebuilt first,
+ * in O(n).
  */
-static inline void *bt_heap_maximum(const struct ptr_heap *heap)
+static inline void *bt_heap_maximum(struct ptr_heap *heap)
 {
+	if (unlikely(!heap->len))
+		return NULL;
+	if (unlikely(heap->dirty))
+		bt_heap_rebuild(heap);
 	check_heap(heap);
-	return likely(heap->len) ? heap->ptrs[0] : NULL;
+	return heap->ptrs[heap->nodes[0].leaf];
 }
 
 /**
  * bt_heap_init - initialize the heap
  * @heap: the heap to initialize
  * @alloc_len: number of elements initially allocated
- * @gt: function to compare the elements
+ * @gt: function to compare the elements with equal keys
+ * @key: function returning the key of an element
+ *
+ * The key of an element is read once, when it is inserted (or replaces the
+ * largest element): an element whose key changes must be removed and
+ * inserted again.
  *
  * Returns -ENOMEM if out of memory.
  */
 extern int bt_heap_init(struct ptr_heap *heap,
 		     size_t alloc_len,
-		     int gt(void *a, void *b));
+		     int gt(void *a, void *b),
+		     uint64_t key(void *p));
 
 /**
  * bt_heap_free - free the heap
@@ -82,7 +121,8 @@ extern void bt_heap_free(struct ptr_heap *heap);
  * @heap: the heap to be operated on
  * @p: the element to add
  *
- * Insert an element into the heap.
+ * Insert an element into the heap. The tree is only rebuilt at the next
+ * lookup, so that inserting n elements in a row costs O(n).
  *
  * Returns -ENOMEM if out of memory.
  */
@@ -93,7 +133,8 @@ extern int bt_heap_insert(struct ptr_heap *heap, void *p);
  * @heap: the heap to be operated on
  *
  * Returns the largest element in the heap. It removes this element from the
- * heap. Returns NULL if the heap is empty.
+ * heap, leaving a hole in its leaf, and replays its matches in O(log(n)).
+ * Returns NULL if the heap is empty.
  */
 extern void *bt_heap_remove(struct ptr_heap *heap);
 
@@ -102,9 +143,9 @@ extern void *bt_heap_remove(struct ptr_heap *heap);
  * @heap: the heap to be operated on
  * @p: the element
  *
- * Remove the given element from the heap. Return the element if present, else
- * return NULL. This algorithm has a complexity of O(n), which is higher than
- * O(log(n)) provided by the rest of this API.
+ * Remove the given element from the heap, which may be the largest one.
+ * Return the element if present, else return NULL. Finding the element is
+ * O(n), and the tree is rebuilt at the next lookup.
  */
 extern void *bt_heap_cherrypick(struct ptr_heap *heap, void *p);
 
@@ -114,11 +155,12 @@ extern void *bt_heap_cherrypick(struct ptr_heap *heap, void *p);
  * @p: the pointer to be inserted as topmost element replacement
  *
  * Returns the largest element in the heap. It removes this element from the
- * heap. The heap is rebalanced only once after the insertion. Returns NULL if
- * the heap is empty.
+ * heap. Returns NULL if the heap is empty, in which case p is inserted.
  *
- * This is the equivalent of calling bt_heap_remove() and then bt_heap_insert(), but
- * it only rebalances the heap once. It never allocates memory.
+ * This is the equivalent of calling bt_heap_remove() and then bt_heap_insert(),
+ * but it only replays the matches of the replaced leaf once, and not at all
+ * when the key of p is still smaller than all the keys it beat. It never
+ * allocates memory.
  */
 extern void *bt_heap_replace_max(struct ptr_heap *heap, void *p);
 
@@ -127,6 +169,8 @@ extern void *bt_heap_replace_max(struct ptr_heap *heap, void *p);
  * @dst: the destination heap (must be allocated)
  * @src: the source heap
  *
+ * The copy uses the same gt and key functions as the source.
+ *
  * Returns -ENOMEM if out of memory.
  */
 extern int bt_heap_copy(struct ptr_heap *dst, struct ptr_heap *src);
@@ -38,6 +38,7 @@
 #include <string.h>
 #include <glib.h>
 #include <assert.h>
+#include <pthread.h>
 
 /* Preallocate this many fields for structures */
 #define DEFAULT_NR_STRUCT_FIELDS 8
@@ -202,17 +203,21 @@ struct enum_range_to_quark {
  * hash table mapping values to quark sets. We then lookup the ranges to
  * complete the quark set.
  *
- * TODO: The proper structure to hold the range to quark set mapping would be an
- * interval tree, with O(n) size, O(n*log(n)) build time and O(log(n)) query
- * time. Using a simple O(n) list search for now for implementation speed and
- * given that we can expect to have a _relatively_ small number of enumeration
- * ranges. This might become untrue if we are fed with symbol tables often
- * required to lookup function names from instruction pointer value.
+ * Once all the mappings are inserted, freezing the enumeration builds an
+ * immutable index of the value domain split into intervals of constant
+ * quark set: a sorted interval array searched in O(log(n)), or a direct
+ * table for small domains. Lookups through the index neither scan the
+ * ranges nor allocate. An enumeration which is not frozen is looked up
+ * through the hash table and range list, and its callers own the quark
+ * sets returned.
  */
+struct enum_index;
+
 struct enum_table {
 	GHashTable *value_to_quark_set;		/* (value, GQuark GArray) */
 	struct bt_list_head range_to_quark;	/* (range, GQuark) */
 	GHashTable *quark_to_range_set;		/* (GQuark, range GArray) */
+	struct enum_index *index;		/* NULL until frozen */
 };
 
 struct declaration_enum {
@@ -225,8 +230,12 @@ struct definition_enum {
 	struct bt_definition p;
 	struct definition_integer *integer;
 	struct declaration_enum *declaration;
-	/* Last GQuark values read. Keeping a reference on the GQuark array. */
+	/*
+	 * Last GQuark values read, owned by the frozen declaration, or
+	 * referenced by the definition if value_owned is set.
+	 */
 	GArray *value;
+	int value_owned;
 };
 
 struct declaration_string {
@@ -237,8 +246,11 @@ struct declaration_string {
 struct definition_string {
 	struct bt_definition p;
 	struct declaration_string *declaration;
-	char *value;	/* freed at definition_string teardown */
-	size_t len, alloc_len;
+	char *value;	/* points to buf, or into the mapped packet */
+	size_t len;
+	char *buf;	/* freed at definition_string teardown */
+	size_t alloc_len;
+	int borrowed;	/* listed in a stream position borrowed strings */
 };
 
 struct declaration_field {
@@ -300,6 +312,12 @@ struct declaration_sequence {
 	GArray *length_name;		/* Array of GQuark */
 	struct bt_declaration *elem;
 	struct declaration_scope *scope;
+	/*
+	 * "[i]" element names, interned once for all the definitions of
+	 * the sequence, and grown with the longest sequence seen.
+	 */
+	GArray *elem_names;		/* Array of GQuark */
+	pthread_mutex_t elem_names_lock;	/* Protects elem_names */
 };
 
 struct definition_sequence {
@@ -308,6 +326,13 @@ struct definition_sequence {
 	struct definition_integer *length;
 	GPtrArray *elems;		/* Array of pointers to struct bt_definition */
 	GString *string;		/* String for encoded integer children */
+	/*
+	 * Flat buffer of element values, for sequences of non-encoded
+	 * integers, which are decoded in bulk. Element definitions are
+	 * only created and loaded on demand, by bt_sequence_index() and
+	 * bt_sequence_load_elems(). NULL if unused.
+	 */
+	GArray *values;
 };
 
 int bt_register_declaration(GQuark declaration_name,
@@ -414,6 +439,23 @@ GArray *bt_enum_uint_to_quark_set(const struct declaration_enum *enum_declaratio
 GArray *bt_enum_int_to_quark_set(const struct declaration_enum *enum_declaration,
 			      int64_t v);
 
+/*
+ * Returns the GArray of GQuark cached in the frozen enumeration index, or
+ * NULL if the value is not mapped or the enumeration is not frozen.
+ * Callers do _not_ own the returned GArray. Does not allocate.
+ */
+GArray *bt_enum_uint_lookup_quark_set(const struct declaration_enum *enum_declaration,
+			uint64_t v);
+GArray *bt_enum_int_lookup_quark_set(const struct declaration_enum *enum_declaration,
+			int64_t v);
+
+/*
+ * Build the lookup index of an enumeration, once all its mappings are
+ * inserted. Inserting mappings afterwards drops the index until the next
+ * freeze.
+ */
+void bt_enum_declaration_freeze(struct declaration_enum *enum_declaration);
+
 /*
  * Returns a GArray of struct enum_range or NULL.
  * Callers do _not_ own the returned GArray (and therefore _don't_ need to
@@ -515,6 +557,7 @@ struct declaration_sequence *
 		struct declaration_scope *parent_scope);
 uint64_t bt_sequence_len(struct definition_sequence *sequence);
 struct bt_definition *bt_sequence_index(struct definition_sequence *sequence, uint64_t i);
+int bt_sequence_load_elems(struct definition_sequence *sequence);
 int bt_sequence_rw(struct bt_stream_pos *pos, struct bt_definition *definition);
 
 /*
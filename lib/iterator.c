@@ -76,10 +76,19 @@ static int stream_read_event(struct ctf_file_stream *sin)
 }
 
 /*
- * Return true if a < b, false otherwise.
- * If time stamps are exactly the same, compare by stream path. This
- * ensures we get the same result between runs on the same trace
- * collection on different environments.
+ * The stream heap is ordered by stream timestamp.
+ */
+static uint64_t stream_key(void *p)
+{
+	struct ctf_file_stream *s = p;
+
+	return s->parent.real_timestamp;
+}
+
+/*
+ * Return true if a goes before b, for streams with the same timestamp.
+ * Compare by stream path. This ensures we get the same result between
+ * runs on the same trace collection on different environments.
  * The result will be random for memory-mapped traces since there is no
  * fixed path leading to those (they have empty path string).
  */
@@ -87,13 +96,7 @@ static int stream_compare(void *a, void *b)
 {
 	struct ctf_file_stream *s_a = a, *s_b = b;
 
-	if (s_a->parent.real_timestamp < s_b->parent.real_timestamp) {
-		return 1;
-	} else if (likely(s_a->parent.real_timestamp > s_b->parent.real_timestamp)) {
-		return 0;
-	} else {
-		return strcmp(s_a->parent.path, s_b->parent.path);
-	}
+	return strcmp(s_a->parent.path, s_b->parent.path) < 0;
 }
 
 void bt_iter_free_pos(struct bt_iter_pos *iter_pos)
@@ -112,48 +115,180 @@ void bt_iter_free_pos(struct bt_iter_pos *iter_pos)
 	g_free(iter_pos);
 }
 
+/*
+ * Record a sparse sub-index entry every EVENT_INDEX_STRIDE events read
+ * while seeking within a packet.
+ */
+#define EVENT_INDEX_STRIDE	256
+
+static void free_packet_event_index(gpointer data)
+{
+	if (data)
+		g_array_free(data, TRUE);
+}
+
+/*
+ * find_packet_by_timestamp
+ *
+ * Binary search in the packet index of a stream for the first packet
+ * whose end timestamp is greater or equal to the timestamp passed in
+ * argument. Packets are ordered by time within a stream.
+ *
+ * Return the index of the packet, or the packet index length if no
+ * such packet exists.
+ */
+static size_t find_packet_by_timestamp(GArray *packet_index,
+		uint64_t timestamp)
+{
+	size_t low = 0, high = packet_index->len;
+
+	while (low < high) {
+		size_t mid = low + ((high - low) >> 1);
+		struct packet_index *index;
+
+		index = &g_array_index(packet_index, struct packet_index, mid);
+		if (index->ts_real.timestamp_end < timestamp)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+	return low;
+}
+
+/*
+ * Lookup the packet event sub-index for the current packet. Return NULL
+ * if it has not been populated yet.
+ */
+static GArray *get_packet_event_index(struct ctf_stream_pos *pos,
+		size_t packet)
+{
+	if (!pos->packet_event_index
+			|| packet >= pos->packet_event_index->len)
+		return NULL;
+	return g_ptr_array_index(pos->packet_event_index, packet);
+}
+
+/*
+ * Append the event which has just been read to the sub-index of the
+ * current packet, keeping entries sorted by offset.
+ */
+static void add_packet_event_index(struct ctf_file_stream *cfs)
+{
+	struct ctf_stream_pos *pos = &cfs->pos;
+	struct packet_event_index entry;
+	GArray *event_index;
+
+	if (!pos->packet_event_index) {
+		pos->packet_event_index =
+			g_ptr_array_new_with_free_func(free_packet_event_index);
+	}
+	if (pos->cur_index >= pos->packet_event_index->len)
+		g_ptr_array_set_size(pos->packet_event_index,
+				pos->cur_index + 1);
+	event_index = g_ptr_array_index(pos->packet_event_index,
+			pos->cur_index);
+	if (!event_index) {
+		event_index = g_array_new(FALSE, TRUE,
+				sizeof(struct packet_event_index));
+		g_ptr_array_index(pos->packet_event_index,
+				pos->cur_index) = event_index;
+	}
+	if (event_index->len && g_array_index(event_index,
+			struct packet_event_index,
+			event_index->len - 1).offset >= pos->last_offset)
+		return;
+	entry.offset = pos->last_offset;
+	entry.cycles_timestamp = cfs->parent.cycles_timestamp;
+	entry.real_timestamp = cfs->parent.real_timestamp;
+	g_array_append_val(event_index, entry);
+}
+
+/*
+ * Position the stream on the last sub-index entry of the packet which
+ * timestamp is strictly lower than the timestamp passed in argument, so
+ * that the in-packet scan does not need to start from the beginning of
+ * the packet. The entry is read again as the current event, similarly
+ * to BT_SEEK_RESTORE. Leave the stream at the beginning of the packet
+ * if no such entry exists.
+ */
+static void seek_packet_event_index(struct ctf_file_stream *cfs,
+		size_t packet, uint64_t timestamp)
+{
+	struct ctf_stream_pos *pos = &cfs->pos;
+	struct packet_event_index *entry;
+	GArray *event_index;
+	size_t low = 0, high;
+
+	event_index = get_packet_event_index(pos, packet);
+	if (!event_index)
+		return;
+	high = event_index->len;
+	while (low < high) {
+		size_t mid = low + ((high - low) >> 1);
+
+		entry = &g_array_index(event_index,
+				struct packet_event_index, mid);
+		if (entry->real_timestamp < timestamp)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+	if (!low)
+		return;
+	entry = &g_array_index(event_index, struct packet_event_index,
+			low - 1);
+	/*
+	 * The timestamps need to be restored after packet_seek, because
+	 * this function resets the timestamp to the beginning of the
+	 * packet.
+	 */
+	cfs->parent.real_timestamp = entry->real_timestamp;
+	cfs->parent.cycles_timestamp = entry->cycles_timestamp;
+	pos->offset = entry->offset;
+	pos->last_offset = LAST_OFFSET_POISON;
+}
+
 /*
  * seek_file_stream_by_timestamp
  *
- * Browse a filestream by index, if an index contains the timestamp passed in
- * argument, seek inside the corresponding packet it until we find the event we
- * are looking for (either the exact timestamp or the event just after the
- * timestamp).
+ * Binary search a filestream by index, if an index contains the
+ * timestamp passed in argument, seek inside the corresponding packet it
+ * until we find the event we are looking for (either the exact
+ * timestamp or the event just after the timestamp). The in-packet scan
+ * starts from the closest packet event sub-index entry, and populates
+ * the sub-index as it reads events.
  *
  * Return 0 if the seek succeded, EOF if we didn't find any packet
  * containing the timestamp, or a positive integer for error.
- *
- * TODO: this should be turned into a binary search! It is currently
- * doing a linear search in the packets. This is a O(n) operation on a
- * very frequent code path.
  */
 static int seek_file_stream_by_timestamp(struct ctf_file_stream *cfs,
 		uint64_t timestamp)
 {
 	struct ctf_stream_pos *stream_pos;
-	struct packet_index *index;
-	int i, ret;
+	size_t i, nr_events = 0;
+	int ret;
 
 	stream_pos = &cfs->pos;
-	for (i = 0; i < stream_pos->packet_index->len; i++) {
-		index = &g_array_index(stream_pos->packet_index,
-				struct packet_index, i);
-		if (index->ts_real.timestamp_end < timestamp)
-			continue;
+	i = find_packet_by_timestamp(stream_pos->packet_index, timestamp);
+	if (i >= stream_pos->packet_index->len) {
+		/*
+		 * Cannot find the timestamp within the stream packets,
+		 * return EOF.
+		 */
+		return EOF;
+	}
 
-		stream_pos->packet_seek(&stream_pos->parent, i, SEEK_SET);
-		do {
-			ret = stream_read_event(cfs);
-		} while (cfs->parent.real_timestamp < timestamp && ret == 0);
+	stream_pos->packet_seek(&stream_pos->parent, i, SEEK_SET);
+	if (stream_pos->offset != EOF && stream_pos->cur_index == i)
+		seek_packet_event_index(cfs, i, timestamp);
+	do {
+		ret = stream_read_event(cfs);
+		if (ret == 0 && !(nr_events++ % EVENT_INDEX_STRIDE))
+			add_packet_event_index(cfs);
+	} while (cfs->parent.real_timestamp < timestamp && ret == 0);
 
-		/* Can return either EOF, 0, or error (> 0). */
-		return ret;
-	}
-	/*
-	 * Cannot find the timestamp within the stream packets, return
-	 * EOF.
-	 */
-	return EOF;
+	/* Can return either EOF, 0, or error (> 0). */
+	return ret;
 }
 
 /*
@@ -370,7 +505,8 @@ int bt_iter_set_pos(struct bt_iter *iter, const struct bt_iter_pos *iter_pos)
 			return -EINVAL;
 
 		bt_heap_free(iter->stream_heap);
-		ret = bt_heap_init(iter->stream_heap, 0, stream_compare);
+		ret = bt_heap_init(iter->stream_heap, 0, stream_compare,
+			stream_key);
 		if (ret < 0)
 			goto error_heap_init;
 
@@ -425,7 +561,8 @@ int bt_iter_set_pos(struct bt_iter *iter, const struct bt_iter_pos *iter_pos)
 		tc = iter->ctx->tc;
 
 		bt_heap_free(iter->stream_heap);
-		ret = bt_heap_init(iter->stream_heap, 0, stream_compare);
+		ret = bt_heap_init(iter->stream_heap, 0, stream_compare,
+			stream_key);
 		if (ret < 0)
 			goto error_heap_init;
 
@@ -456,7 +593,8 @@ int bt_iter_set_pos(struct bt_iter *iter, const struct bt_iter_pos *iter_pos)
 	case BT_SEEK_BEGIN:
 		tc = iter->ctx->tc;
 		bt_heap_free(iter->stream_heap);
-		ret = bt_heap_init(iter->stream_heap, 0, stream_compare);
+		ret = bt_heap_init(iter->stream_heap, 0, stream_compare,
+			stream_key);
 		if (ret < 0)
 			goto error_heap_init;
 
@@ -516,7 +654,8 @@ int bt_iter_set_pos(struct bt_iter *iter, const struct bt_iter_pos *iter_pos)
 		/* remove all streams from the heap */
 		bt_heap_free(iter->stream_heap);
 		/* Create a new empty heap */
-		ret = bt_heap_init(iter->stream_heap, 0, stream_compare);
+		ret = bt_heap_init(iter->stream_heap, 0, stream_compare,
+			stream_key);
 		if (ret < 0)
 			goto error;
 		/* Insert the stream that contains the last event */
@@ -535,7 +674,8 @@ int bt_iter_set_pos(struct bt_iter *iter, const struct bt_iter_pos *iter_pos)
 error:
 	bt_heap_free(iter->stream_heap);
 error_heap_init:
-	if (bt_heap_init(iter->stream_heap, 0, stream_compare) < 0) {
+	if (bt_heap_init(iter->stream_heap, 0, stream_compare,
+			stream_key) < 0) {
 		bt_heap_free(iter->stream_heap);
 		g_free(iter->stream_heap);
 		iter->stream_heap = NULL;
@@ -680,7 +820,8 @@ int bt_iter_init(struct bt_iter *iter,
 	bt_context_get(ctx);
 	iter->ctx = ctx;
 
-	ret = bt_heap_init(iter->stream_heap, 0, stream_compare);
+	ret = bt_heap_init(iter->stream_heap, 0, stream_compare,
+			stream_key);
 	if (ret < 0)
 		goto error_heap_init;
 
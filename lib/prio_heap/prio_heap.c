@@ -1,8 +1,18 @@
 /*
  * prio_heap.c
  *
- * Static-sized priority heap containing pointers. Based on CLRS,
- * chapter 6.
+ * Priority queue containing pointers, implemented as a loser tree.
+ *
+ * Leaves hold the entries, and each internal node holds the loser of
+ * the match between the winners of its two subtrees, along with its
+ * key. Replacing the winner only replays the matches on its path to the
+ * root, comparing cached keys without dereferencing the entries.
+ * Moreover, when the new entry key is smaller than every loser on that
+ * path, the winner is updated in place.
+ *
+ * Inserting and cherry-picking entries are rare (stream open, seek,
+ * end of stream): they mark the tree dirty, and it is rebuilt in O(n)
+ * before the next lookup.
  *
  * Copyright 2011 - Mathieu Desnoyers <mathieu.desnoyers@efficios.com>
  *
@@ -37,78 +47,195 @@
 	((type) (a) > (type) (b) ? (type) (a) : (type) (b))
 #endif
 
+/* Key of the empty leaves, which lose against any entry. */
+#define HEAP_EMPTY_KEY	UINT64_MAX
+
+/*
+ * Return whether node a wins against node b.
+ */
+static inline
+int node_beats(const struct ptr_heap *heap, const struct ptr_heap_node *a,
+		const struct ptr_heap_node *b)
+{
+	void *pa, *pb;
+
+	if (likely(a->key != b->key))
+		return a->key < b->key;
+	pa = heap->ptrs[a->leaf];
+	pb = heap->ptrs[b->leaf];
+	if (unlikely(!pa || !pb))
+		return pa != NULL;
+	return heap->gt(pa, pb);
+}
+
 #ifdef DEBUG_HEAP
 void check_heap(const struct ptr_heap *heap)
 {
 	size_t i;
 
-	if (!heap->len)
+	if (!heap->len || heap->dirty)
 		return;
 
-	for (i = 1; i < heap->len; i++)
-		assert(!heap->gt(heap->ptrs[i], heap->ptrs[0]));
+	for (i = 0; i < heap->nr_leaves; i++) {
+		struct ptr_heap_node node;
+
+		if (!heap->ptrs[i] || i == heap->nodes[0].leaf)
+			continue;
+		node.key = heap->keys[i];
+		node.leaf = i;
+		assert(!node_beats(heap, &node, &heap->nodes[0]));
+	}
 }
 #endif
 
 static
-size_t parent(size_t i)
+void heap_update_runner_up(struct ptr_heap *heap)
 {
-	return (i - 1) >> 1;
+	uint64_t key = HEAP_EMPTY_KEY;
+	size_t node;
+
+	for (node = (heap->nodes[0].leaf + heap->alloc_len) >> 1; node > 0;
+			node >>= 1) {
+		if (heap->nodes[node].key < key)
+			key = heap->nodes[node].key;
+	}
+	heap->runner_up_key = key;
 }
 
+/*
+ * Replay the matches from a leaf up to the root. Only valid when the
+ * leaf held the winner, so the nodes on its path hold its opponents.
+ */
 static
-size_t left(size_t i)
+void heap_replay(struct ptr_heap *heap, size_t leaf)
 {
-	return (i << 1) + 1;
+	struct ptr_heap_node winner, tmp;
+	size_t node;
+
+	winner.key = heap->keys[leaf];
+	winner.leaf = leaf;
+	for (node = (leaf + heap->alloc_len) >> 1; node > 0; node >>= 1) {
+		if (node_beats(heap, &heap->nodes[node], &winner)) {
+			tmp = heap->nodes[node];
+			heap->nodes[node] = winner;
+			winner = tmp;
+		}
+	}
+	heap->nodes[0] = winner;
+	heap_update_runner_up(heap);
+	check_heap(heap);
 }
 
-static
-size_t right(size_t i)
+void bt_heap_rebuild(struct ptr_heap *heap)
 {
-	return (i << 1) + 2;
+	struct ptr_heap_node *nodes = heap->nodes, *winners = heap->winners;
+	size_t k = heap->alloc_len, node;
+
+	if (k == 1) {
+		nodes[0].key = heap->keys[0];
+		nodes[0].leaf = 0;
+		goto end;
+	}
+	for (node = k - 1; node > 0; node--) {
+		struct ptr_heap_node l, r;
+		size_t child = node << 1;
+
+		if (child >= k) {
+			l.key = heap->keys[child - k];
+			l.leaf = child - k;
+			r.key = heap->keys[child + 1 - k];
+			r.leaf = child + 1 - k;
+		} else {
+			l = winners[child];
+			r = winners[child + 1];
+		}
+		if (node_beats(heap, &r, &l)) {
+			winners[node] = r;
+			nodes[node] = l;
+		} else {
+			winners[node] = l;
+			nodes[node] = r;
+		}
+	}
+	nodes[0] = winners[1];
+end:
+	heap->dirty = 0;
+	heap_update_runner_up(heap);
+	check_heap(heap);
 }
 
 /*
- * Copy of heap->ptrs pointer is invalid after heap_grow.
+ * Move the entries to the first leaves, removing holes.
  */
+static
+void heap_compact(struct ptr_heap *heap)
+{
+	size_t i, j = 0;
+
+	for (i = 0; i < heap->nr_leaves; i++) {
+		if (!heap->ptrs[i])
+			continue;
+		heap->ptrs[j] = heap->ptrs[i];
+		heap->keys[j] = heap->keys[i];
+		j++;
+	}
+	for (i = j; i < heap->nr_leaves; i++) {
+		heap->ptrs[i] = NULL;
+		heap->keys[i] = HEAP_EMPTY_KEY;
+	}
+	heap->nr_leaves = j;
+	heap->dirty = 1;
+}
+
 static
 int heap_grow(struct ptr_heap *heap, size_t new_len)
 {
+	size_t alloc_len = 1, i;
 	void **new_ptrs;
+	uint64_t *new_keys;
+	struct ptr_heap_node *new_nodes, *new_winners;
 
 	if (likely(heap->alloc_len >= new_len))
 		return 0;
 
-	heap->alloc_len = max_t(size_t, new_len, heap->alloc_len << 1);
-	new_ptrs = calloc(heap->alloc_len, sizeof(void *));
-	if (unlikely(!new_ptrs))
+	while (alloc_len < max_t(size_t, new_len, heap->alloc_len << 1))
+		alloc_len <<= 1;
+	new_ptrs = calloc(alloc_len, sizeof(*new_ptrs));
+	new_keys = malloc(alloc_len * sizeof(*new_keys));
+	new_nodes = calloc(alloc_len, sizeof(*new_nodes));
+	new_winners = calloc(alloc_len, sizeof(*new_winners));
+	if (unlikely(!new_ptrs || !new_keys || !new_nodes || !new_winners)) {
+		free(new_ptrs);
+		free(new_keys);
+		free(new_nodes);
+		free(new_winners);
 		return -ENOMEM;
-	if (likely(heap->ptrs))
-		memcpy(new_ptrs, heap->ptrs, heap->len * sizeof(void *));
+	}
+	for (i = 0; i < alloc_len; i++)
+		new_keys[i] = HEAP_EMPTY_KEY;
+	if (likely(heap->ptrs)) {
+		memcpy(new_ptrs, heap->ptrs, heap->nr_leaves * sizeof(*new_ptrs));
+		memcpy(new_keys, heap->keys, heap->nr_leaves * sizeof(*new_keys));
+	}
 	free(heap->ptrs);
+	free(heap->keys);
+	free(heap->nodes);
+	free(heap->winners);
 	heap->ptrs = new_ptrs;
-	return 0;
-}
-
-static
-int heap_set_len(struct ptr_heap *heap, size_t new_len)
-{
-	int ret;
-
-	ret = heap_grow(heap, new_len);
-	if (unlikely(ret))
-		return ret;
-	heap->len = new_len;
+	heap->keys = new_keys;
+	heap->nodes = new_nodes;
+	heap->winners = new_winners;
+	heap->alloc_len = alloc_len;
+	heap->dirty = 1;
 	return 0;
 }
 
 int bt_heap_init(struct ptr_heap *heap, size_t alloc_len,
-	      int gt(void *a, void *b))
+	      int gt(void *a, void *b), uint64_t key(void *p))
 {
-	heap->ptrs = NULL;
-	heap->len = 0;
-	heap->alloc_len = 0;
+	memset(heap, 0, sizeof(*heap));
 	heap->gt = gt;
+	heap->key = key;
 	/*
 	 * Minimum size allocated is 1 entry to ensure memory allocation
 	 * never fails within bt_heap_replace_max.
@@ -119,107 +246,96 @@ int bt_heap_init(struct ptr_heap *heap, size_t alloc_len,
 void bt_heap_free(struct ptr_heap *heap)
 {
 	free(heap->ptrs);
-}
-
-static void heapify(struct ptr_heap *heap, size_t i)
-{
-	void **ptrs = heap->ptrs;
-	size_t l, r, largest;
-
-	for (;;) {
-		void *tmp;
-
-		l = left(i);
-		r = right(i);
-		if (l < heap->len && heap->gt(ptrs[l], ptrs[i]))
-			largest = l;
-		else
-			largest = i;
-		if (r < heap->len && heap->gt(ptrs[r], ptrs[largest]))
-			largest = r;
-		if (unlikely(largest == i))
-			break;
-		tmp = ptrs[i];
-		ptrs[i] = ptrs[largest];
-		ptrs[largest] = tmp;
-		i = largest;
-	}
-	check_heap(heap);
+	free(heap->keys);
+	free(heap->nodes);
+	free(heap->winners);
 }
 
 void *bt_heap_replace_max(struct ptr_heap *heap, void *p)
 {
+	size_t leaf;
+	uint64_t key;
 	void *res;
 
 	if (unlikely(!heap->len)) {
-		(void) heap_set_len(heap, 1);
+		heap_compact(heap);
 		heap->ptrs[0] = p;
-		check_heap(heap);
+		heap->keys[0] = heap->key(p);
+		heap->nr_leaves = 1;
+		heap->len = 1;
 		return NULL;
 	}
+	if (unlikely(heap->dirty))
+		bt_heap_rebuild(heap);
 
-	/* Replace the current max and heapify */
-	res = heap->ptrs[0];
-	heap->ptrs[0] = p;
-	heapify(heap, 0);
+	leaf = heap->nodes[0].leaf;
+	res = heap->ptrs[leaf];
+	key = heap->key(p);
+	heap->ptrs[leaf] = p;
+	heap->keys[leaf] = key;
+	if (likely(key < heap->runner_up_key)) {
+		/* Still beats every opponent on its path. */
+		heap->nodes[0].key = key;
+		check_heap(heap);
+		return res;
+	}
+	heap_replay(heap, leaf);
 	return res;
 }
 
 int bt_heap_insert(struct ptr_heap *heap, void *p)
 {
-	void **ptrs;
-	size_t pos;
 	int ret;
 
-	ret = heap_set_len(heap, heap->len + 1);
-	if (unlikely(ret))
-		return ret;
-	ptrs = heap->ptrs;
-	pos = heap->len - 1;
-	while (pos > 0 && heap->gt(p, ptrs[parent(pos)])) {
-		/* Move parent down until we find the right spot */
-		ptrs[pos] = ptrs[parent(pos)];
-		pos = parent(pos);
+	if (heap->nr_leaves == heap->alloc_len) {
+		if (heap->len < heap->nr_leaves) {
+			heap_compact(heap);
+		} else {
+			ret = heap_grow(heap, heap->len + 1);
+			if (unlikely(ret))
+				return ret;
+		}
 	}
-	ptrs[pos] = p;
-	check_heap(heap);
+	heap->ptrs[heap->nr_leaves] = p;
+	heap->keys[heap->nr_leaves] = heap->key(p);
+	heap->nr_leaves++;
+	heap->len++;
+	heap->dirty = 1;
 	return 0;
 }
 
 void *bt_heap_remove(struct ptr_heap *heap)
 {
-	switch (heap->len) {
-	case 0:
+	size_t leaf;
+	void *res;
+
+	if (unlikely(!heap->len))
 		return NULL;
-	case 1:
-		(void) heap_set_len(heap, 0);
-		return heap->ptrs[0];
-	}
-	/* Shrink, replace the current max by previous last entry and heapify */
-	heap_set_len(heap, heap->len - 1);
-	/* len changed. previous last entry is at heap->len */
-	return bt_heap_replace_max(heap, heap->ptrs[heap->len]);
+	if (unlikely(heap->dirty))
+		bt_heap_rebuild(heap);
+	/* Leave a hole, which loses all its matches. */
+	leaf = heap->nodes[0].leaf;
+	res = heap->ptrs[leaf];
+	heap->ptrs[leaf] = NULL;
+	heap->keys[leaf] = HEAP_EMPTY_KEY;
+	heap->len--;
+	heap_replay(heap, leaf);
+	return res;
 }
 
 void *bt_heap_cherrypick(struct ptr_heap *heap, void *p)
 {
-	size_t pos, len = heap->len;
+	size_t leaf;
 
-	for (pos = 0; pos < len; pos++)
-		if (unlikely(heap->ptrs[pos] == p))
+	for (leaf = 0; leaf < heap->nr_leaves; leaf++)
+		if (unlikely(heap->ptrs[leaf] == p))
 			goto found;
 	return NULL;
 found:
-	if (unlikely(heap->len == 1)) {
-		(void) heap_set_len(heap, 0);
-		check_heap(heap);
-		return heap->ptrs[0];
-	}
-	/* Replace p with previous last entry and heapify. */
-	heap_set_len(heap, heap->len - 1);
-	/* len changed. previous last entry is at heap->len */
-	heap->ptrs[pos] = heap->ptrs[heap->len];
-	heapify(heap, pos);
+	heap->ptrs[leaf] = NULL;
+	heap->keys[leaf] = HEAP_EMPTY_KEY;
+	heap->len--;
+	heap->dirty = 1;
 	return p;
 }
 
@@ -227,16 +343,17 @@ int bt_heap_copy(struct ptr_heap *dst, struct ptr_heap *src)
 {
 	int ret;
 
-	ret = bt_heap_init(dst, src->alloc_len, src->gt);
+	ret = bt_heap_init(dst, src->alloc_len, src->gt, src->key);
 	if (ret < 0)
 		goto end;
 
-	ret = heap_set_len(dst, src->len);
-	if (ret < 0)
-		goto end;
-
-	memcpy(dst->ptrs, src->ptrs, src->len * sizeof(void *));
-
+	memcpy(dst->ptrs, src->ptrs, src->alloc_len * sizeof(*dst->ptrs));
+	memcpy(dst->keys, src->keys, src->alloc_len * sizeof(*dst->keys));
+	memcpy(dst->nodes, src->nodes, src->alloc_len * sizeof(*dst->nodes));
+	dst->len = src->len;
+	dst->nr_leaves = src->nr_leaves;
+	dst->runner_up_key = src->runner_up_key;
+	dst->dirty = src->dirty;
 end:
 	return ret;
 }
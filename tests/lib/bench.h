@@ -0,0 +1,50 @@
+/*
+ * bench.h
+ *
+ * Lib BabelTrace - Common helpers for the benchmark programs
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; under version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#ifndef _TESTS_BENCH_H
+#define _TESTS_BENCH_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+
+/*
+ * Monotonic time, in nanoseconds, to measure elapsed time.
+ */
+static inline
+uint64_t get_time_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * Print the usage of a benchmark program, args describing its
+ * arguments. Returns the program exit status.
+ */
+static inline
+int bench_usage(const char *progname, const char *args)
+{
+	fprintf(stderr, "Usage: %s %s\n", progname, args);
+	return EXIT_FAILURE;
+}
+
+#endif /* _TESTS_BENCH_H */
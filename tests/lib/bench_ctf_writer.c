@@ -0,0 +1,178 @@
+/*
+ * bench_ctf_writer.c
+ *
+ * CTF Writer - Event write throughput benchmark program
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; under version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#define _GNU_SOURCE
+#include <babeltrace/ctf-writer/writer.h>
+#include <babeltrace/ctf-writer/clock.h>
+#include <babeltrace/ctf-writer/stream.h>
+#include <babeltrace/ctf-writer/event.h>
+#include <babeltrace/ctf-writer/event-types.h>
+#include <babeltrace/ctf-writer/event-fields.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include "bench.h"
+#include "common.h"
+
+#define DEFAULT_NR_EVENTS		1000000
+#define DEFAULT_EVENTS_PER_PACKET	4096
+
+struct bench_result {
+	uint64_t total_ns;
+	uint64_t flush_ns;
+};
+
+/*
+ * Write nr_events two-integer events in packets of events_per_packet
+ * events. The total time includes releasing the writer, which waits for
+ * the packets still being written in async mode.
+ */
+static
+int write_trace(const char *trace_path, uint64_t packet_size, int async_flush,
+		unsigned long nr_events, unsigned long events_per_packet,
+		struct bench_result *result)
+{
+	struct bt_ctf_writer *writer;
+	struct bt_ctf_clock *clock;
+	struct bt_ctf_stream_class *stream_class;
+	struct bt_ctf_event_class *event_class;
+	struct bt_ctf_field_type *uint_32_type, *uint_64_type;
+	struct bt_ctf_stream *stream;
+	uint64_t start_ns, flush_start_ns;
+	unsigned long i;
+	int ret = 0;
+
+	writer = bt_ctf_writer_create(trace_path);
+	if (!writer) {
+		return -1;
+	}
+	clock = bt_ctf_clock_create("bench_clock");
+	stream_class = bt_ctf_stream_class_create("bench_stream");
+	event_class = bt_ctf_event_class_create("bench_event");
+	uint_32_type = bt_ctf_field_type_integer_create(32);
+	uint_64_type = bt_ctf_field_type_integer_create(64);
+	ret |= bt_ctf_writer_set_async_flush(writer, async_flush);
+	if (packet_size) {
+		ret |= bt_ctf_writer_set_packet_size(writer, packet_size);
+	}
+	ret |= bt_ctf_writer_add_clock(writer, clock);
+	ret |= bt_ctf_stream_class_set_clock(stream_class, clock);
+	ret |= bt_ctf_event_class_add_field(event_class, uint_32_type, "id");
+	ret |= bt_ctf_event_class_add_field(event_class, uint_64_type, "value");
+	ret |= bt_ctf_stream_class_add_event_class(stream_class, event_class);
+	if (ret) {
+		fprintf(stderr, "Cannot set up trace \"%s\"\n", trace_path);
+		goto end;
+	}
+	stream = bt_ctf_writer_create_stream(writer, stream_class);
+	if (!stream) {
+		ret = -1;
+		goto end;
+	}
+
+	result->flush_ns = 0;
+	start_ns = get_time_ns();
+	for (i = 0; i < nr_events; i++) {
+		struct bt_ctf_event *event;
+		struct bt_ctf_field *field;
+
+		/* Released events are recycled by their event class. */
+		event = bt_ctf_event_create(event_class);
+		field = bt_ctf_event_get_payload(event, "id");
+		ret |= bt_ctf_field_unsigned_integer_set_value(field, i);
+		bt_ctf_field_put(field);
+		field = bt_ctf_event_get_payload(event, "value");
+		ret |= bt_ctf_field_unsigned_integer_set_value(field, i * 3);
+		bt_ctf_field_put(field);
+		ret |= bt_ctf_clock_set_time(clock, i);
+		ret |= bt_ctf_stream_append_event(stream, event);
+		bt_ctf_event_put(event);
+		if ((i + 1) % events_per_packet == 0) {
+			flush_start_ns = get_time_ns();
+			ret |= bt_ctf_stream_flush(stream);
+			result->flush_ns += get_time_ns() - flush_start_ns;
+		}
+		if (ret) {
+			fprintf(stderr, "Write error at event %lu\n", i);
+			break;
+		}
+	}
+	flush_start_ns = get_time_ns();
+	ret |= bt_ctf_stream_flush(stream);
+	result->flush_ns += get_time_ns() - flush_start_ns;
+	bt_ctf_stream_put(stream);
+	bt_ctf_writer_put(writer);
+	writer = NULL;
+	result->total_ns = get_time_ns() - start_ns;
+end:
+	bt_ctf_field_type_put(uint_32_type);
+	bt_ctf_field_type_put(uint_64_type);
+	bt_ctf_event_class_put(event_class);
+	bt_ctf_stream_class_put(stream_class);
+	bt_ctf_clock_put(clock);
+	bt_ctf_writer_put(writer);
+	return ret;
+}
+
+int main(int argc, char **argv)
+{
+	const char *mode_names[] = { "sync", "async" };
+	unsigned long nr_events = DEFAULT_NR_EVENTS;
+	unsigned long events_per_packet = DEFAULT_EVENTS_PER_PACKET;
+	uint64_t packet_size = 0;
+	int async_flush;
+
+	if (argc > 1)
+		nr_events = strtoul(argv[1], NULL, 0);
+	if (argc > 2)
+		packet_size = strtoull(argv[2], NULL, 0);
+	if (argc > 3)
+		events_per_packet = strtoul(argv[3], NULL, 0);
+	if (!nr_events || !events_per_packet) {
+		return bench_usage(argv[0],
+			"[NR_EVENTS] [PACKET_SIZE] [EVENTS_PER_PACKET]");
+	}
+
+	for (async_flush = 0; async_flush < 2; async_flush++) {
+		char trace_path[] = "/tmp/bench_ctf_writer_XXXXXX";
+		struct bench_result result;
+		int ret;
+
+		if (!mkdtemp(trace_path)) {
+			perror("mkdtemp");
+			return EXIT_FAILURE;
+		}
+		ret = write_trace(trace_path, packet_size, async_flush,
+			nr_events, events_per_packet, &result);
+		remove_trace(trace_path);
+		if (ret) {
+			return EXIT_FAILURE;
+		}
+		printf("%-5s %lu events in %" PRIu64 " ns: %6.1f ns/event, "
+			"%6.1f ns/event in flush\n", mode_names[async_flush],
+			nr_events, result.total_ns,
+			(double) result.total_ns / nr_events,
+			(double) result.flush_ns / nr_events);
+	}
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,138 @@
+/*
+ * bench_merge.c
+ *
+ * Lib BabelTrace - Stream merge benchmark program
+ *
+ * Merges synthetic streams of increasing timestamps through the
+ * iterator priority queue, for 1 to 10000 streams.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; under version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#define _GNU_SOURCE
+#include <babeltrace/prio_heap.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "bench.h"
+
+#define DEFAULT_NR_EVENTS	10000000UL
+#define MAX_NR_STREAMS		10000
+
+struct bench_stream {
+	uint64_t timestamp;
+	uint64_t seed;
+	char path[16];
+};
+
+static
+uint64_t stream_key(void *p)
+{
+	struct bench_stream *s = p;
+
+	return s->timestamp;
+}
+
+static
+int stream_compare(void *a, void *b)
+{
+	struct bench_stream *s_a = a, *s_b = b;
+
+	return strcmp(s_a->path, s_b->path) < 0;
+}
+
+/*
+ * Advance a stream to its next event. Bursty streams make the same
+ * stream win several times in a row, as in real traces.
+ */
+static
+void stream_next(struct bench_stream *s)
+{
+	s->seed = s->seed * 6364136223846793005ULL + 1442695040888963407ULL;
+	if ((s->seed >> 60) < 12)
+		s->timestamp += (s->seed >> 33) & 0xF;
+	else
+		s->timestamp += (s->seed >> 33) & 0xFFFFF;
+}
+
+static
+int bench_merge(unsigned long nr_streams, unsigned long nr_events)
+{
+	struct ptr_heap heap;
+	struct bench_stream *streams, *s;
+	uint64_t start_ns, delta_ns, last = 0;
+	unsigned long i;
+	int ret;
+
+	streams = calloc(nr_streams, sizeof(*streams));
+	if (!streams)
+		return -1;
+	ret = bt_heap_init(&heap, 0, stream_compare, stream_key);
+	if (ret)
+		goto end;
+	for (i = 0; i < nr_streams; i++) {
+		s = &streams[i];
+		s->seed = i + 1;
+		snprintf(s->path, sizeof(s->path), "stream_%lu", i);
+		stream_next(s);
+		ret = bt_heap_insert(&heap, s);
+		if (ret)
+			goto end_heap;
+	}
+
+	start_ns = get_time_ns();
+	for (i = 0; i < nr_events; i++) {
+		s = bt_heap_maximum(&heap);
+		if (s->timestamp < last) {
+			fprintf(stderr, "Out of order event at %" PRIu64 "\n",
+				s->timestamp);
+			ret = -1;
+			goto end_heap;
+		}
+		last = s->timestamp;
+		stream_next(s);
+		(void) bt_heap_replace_max(&heap, s);
+	}
+	delta_ns = get_time_ns() - start_ns;
+
+	printf("%5lu streams: %lu events in %" PRIu64 " ns: "
+		"%.2f ns/event\n",
+		nr_streams, nr_events, delta_ns,
+		(double) delta_ns / nr_events);
+
+end_heap:
+	bt_heap_free(&heap);
+end:
+	free(streams);
+	return ret;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long nr_streams, nr_events = DEFAULT_NR_EVENTS;
+
+	if (argc > 1)
+		nr_events = strtoul(argv[1], NULL, 0);
+	if (!nr_events) {
+		return bench_usage(argv[0], "[NR_EVENTS]");
+	}
+
+	for (nr_streams = 1; nr_streams <= MAX_NR_STREAMS; nr_streams *= 10) {
+		if (bench_merge(nr_streams, nr_events))
+			return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
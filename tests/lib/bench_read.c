@@ -0,0 +1,134 @@
+/*
+ * bench_read.c
+ *
+ * Lib BabelTrace - Event read throughput benchmark program
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; under version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#define _GNU_SOURCE
+#include <babeltrace/context.h>
+#include <babeltrace/iterator.h>
+#include <babeltrace/ctf/iterator.h>
+#include <babeltrace/ctf/events.h>
+#include <babeltrace/babeltrace-internal.h>	/* For symbol side-effects */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+
+#include "bench.h"
+
+#define DEFAULT_NR_LOOPS	10
+#define MAX_BATCH_SIZE		4096
+
+/*
+ * Read all events through bt_ctf_iter_read_events(), summing the
+ * timestamps so the batches are consumed. Return the number of events.
+ */
+static
+uint64_t read_batches(struct bt_ctf_iter *iter, unsigned int batch_size,
+		uint64_t *sum)
+{
+	static uint64_t timestamp[MAX_BATCH_SIZE];
+	struct bt_ctf_event_batch batch = { .timestamp = timestamp };
+	uint64_t nr_events = 0;
+	int i, ret;
+
+	for (;;) {
+		ret = bt_ctf_iter_read_events(iter, &batch, batch_size);
+		if (ret <= 0)
+			break;
+		for (i = 0; i < ret; i++)
+			*sum += timestamp[i];
+		nr_events += ret;
+	}
+	return nr_events;
+}
+
+int main(int argc, char **argv)
+{
+	struct bt_context *ctx;
+	struct bt_ctf_iter *iter;
+	struct bt_ctf_event *event;
+	struct bt_iter_pos begin_pos;
+	uint64_t start_ns, delta_ns, nr_events = 0, sum = 0;
+	unsigned long i, nr_loops = DEFAULT_NR_LOOPS, batch_size = 0;
+	int handle_id;
+
+	/*
+	 * Side-effects ensuring libs are not optimized away by static
+	 * linking.
+	 */
+	babeltrace_debug = 0;	/* libbabeltrace.la */
+	opt_clock_offset = 0;	/* libbabeltrace-ctf.la */
+
+	if (argc < 2) {
+		return bench_usage(argv[0], "TRACE_PATH [NR_LOOPS] [BATCH_SIZE]");
+	}
+	if (argc > 2)
+		nr_loops = strtoul(argv[2], NULL, 0);
+	if (argc > 3)
+		batch_size = strtoul(argv[3], NULL, 0);
+	if (batch_size > MAX_BATCH_SIZE) {
+		fprintf(stderr, "BATCH_SIZE must be at most %d\n",
+			MAX_BATCH_SIZE);
+		return EXIT_FAILURE;
+	}
+
+	ctx = bt_context_create();
+	if (!ctx)
+		return EXIT_FAILURE;
+	handle_id = bt_context_add_trace(ctx, argv[1], "ctf", NULL, NULL, NULL);
+	if (handle_id < 0) {
+		fprintf(stderr, "Cannot open trace \"%s\"\n", argv[1]);
+		goto error;
+	}
+
+	iter = bt_ctf_iter_create(ctx, NULL, NULL);
+	if (!iter)
+		goto error;
+
+	begin_pos.type = BT_SEEK_BEGIN;
+	start_ns = get_time_ns();
+	for (i = 0; i < nr_loops; i++) {
+		if (bt_iter_set_pos(bt_ctf_get_iter(iter), &begin_pos)) {
+			fprintf(stderr, "Seek error\n");
+			break;
+		}
+		if (batch_size) {
+			nr_events += read_batches(iter, batch_size, &sum);
+			continue;
+		}
+		while ((event = bt_ctf_iter_read_event(iter))) {
+			sum += bt_ctf_get_timestamp(event);
+			nr_events++;
+			if (bt_iter_next(bt_ctf_get_iter(iter)) < 0)
+				break;
+		}
+	}
+	delta_ns = get_time_ns() - start_ns;
+
+	printf("%" PRIu64 " events in %" PRIu64 " ns: %" PRIu64 " events/s "
+		"(timestamp sum %" PRIu64 ")\n",
+		nr_events, delta_ns,
+		delta_ns ? (uint64_t) (nr_events * 1e9 / delta_ns) : 0, sum);
+
+	bt_ctf_iter_destroy(iter);
+	bt_context_put(ctx);
+	return EXIT_SUCCESS;
+
+error:
+	bt_context_put(ctx);
+	return EXIT_FAILURE;
+}
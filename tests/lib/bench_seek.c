@@ -0,0 +1,105 @@
+/*
+ * bench_seek.c
+ *
+ * Lib BabelTrace - Time seek benchmark program
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; under version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#define _GNU_SOURCE
+#include <babeltrace/context.h>
+#include <babeltrace/iterator.h>
+#include <babeltrace/trace-handle.h>
+#include <babeltrace/ctf/iterator.h>
+#include <babeltrace/ctf/events.h>
+#include <babeltrace/babeltrace-internal.h>	/* For symbol side-effects */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+
+#include "bench.h"
+
+#define DEFAULT_NR_SEEKS	10000
+
+int main(int argc, char **argv)
+{
+	struct bt_context *ctx;
+	struct bt_ctf_iter *iter;
+	struct bt_iter_pos newpos;
+	uint64_t begin, end, start_ns, delta_ns, seed = 42;
+	unsigned long i, nr_seeks = DEFAULT_NR_SEEKS, nr_events = 0;
+	int handle_id, ret;
+
+	/*
+	 * Side-effects ensuring libs are not optimized away by static
+	 * linking.
+	 */
+	babeltrace_debug = 0;	/* libbabeltrace.la */
+	opt_clock_offset = 0;	/* libbabeltrace-ctf.la */
+
+	if (argc < 2) {
+		return bench_usage(argv[0], "TRACE_PATH [NR_SEEKS]");
+	}
+	if (argc > 2)
+		nr_seeks = strtoul(argv[2], NULL, 0);
+
+	ctx = bt_context_create();
+	if (!ctx)
+		return EXIT_FAILURE;
+	handle_id = bt_context_add_trace(ctx, argv[1], "ctf", NULL, NULL, NULL);
+	if (handle_id < 0) {
+		fprintf(stderr, "Cannot open trace \"%s\"\n", argv[1]);
+		goto error;
+	}
+	begin = bt_trace_handle_get_timestamp_begin(ctx, handle_id,
+			BT_CLOCK_REAL);
+	end = bt_trace_handle_get_timestamp_end(ctx, handle_id,
+			BT_CLOCK_REAL);
+	if (end <= begin) {
+		fprintf(stderr, "Empty trace time range\n");
+		goto error;
+	}
+
+	iter = bt_ctf_iter_create(ctx, NULL, NULL);
+	if (!iter)
+		goto error;
+
+	newpos.type = BT_SEEK_TIME;
+	start_ns = get_time_ns();
+	for (i = 0; i < nr_seeks; i++) {
+		/* Deterministic pseudo-random seek targets. */
+		seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+		newpos.u.seek_time = begin + (seed >> 11) % (end - begin);
+		ret = bt_iter_set_pos(bt_ctf_get_iter(iter), &newpos);
+		if (ret && ret != EOF) {
+			fprintf(stderr, "Seek error %d\n", ret);
+			break;
+		}
+		if (bt_ctf_iter_read_event(iter))
+			nr_events++;
+	}
+	delta_ns = get_time_ns() - start_ns;
+
+	printf("%lu seeks (%lu events found) in %" PRIu64 " ns: "
+		"%" PRIu64 " ns/seek\n",
+		i, nr_events, delta_ns, i ? delta_ns / i : 0);
+
+	bt_ctf_iter_destroy(iter);
+	bt_context_put(ctx);
+	return EXIT_SUCCESS;
+
+error:
+	bt_context_put(ctx);
+	return EXIT_FAILURE;
+}
@@ -0,0 +1,151 @@
+/*
+ * bench_timestamp.c
+ *
+ * Lib BabelTrace - Timestamp formatting benchmark program
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; under version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#define _GNU_SOURCE
+#include <babeltrace/context.h>
+#include <babeltrace/iterator.h>
+#include <babeltrace/ctf/iterator.h>
+#include <babeltrace/ctf/events.h>
+#include <babeltrace/ctf/types.h>
+#include <babeltrace/babeltrace-internal.h>	/* For symbol side-effects */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <glib.h>
+
+#include "bench.h"
+
+struct bench_mode {
+	const char *name;
+	int *opt;
+};
+
+/*
+ * Format all timestamps, returning the elapsed time in ns. The sum of
+ * the formatted lengths is returned through total_len, so the work
+ * cannot be optimized away.
+ */
+static
+uint64_t format_all(GArray *timestamps, struct ctf_timestamp_cache *cache,
+		uint64_t *total_len)
+{
+	char buf[CTF_TIMESTAMP_STR_LEN];
+	uint64_t start_ns, len = 0;
+	guint i;
+
+	start_ns = get_time_ns();
+	for (i = 0; i < timestamps->len; i++)
+		len += ctf_format_timestamp(buf, cache, NULL,
+			g_array_index(timestamps, uint64_t, i));
+	*total_len = len;
+	return get_time_ns() - start_ns;
+}
+
+int main(int argc, char **argv)
+{
+	struct bench_mode modes[] = {
+		{ "cycles", &opt_clock_cycles },
+		{ "seconds", &opt_clock_seconds },
+		{ "time", NULL },
+		{ "date", &opt_clock_date },
+		{ "gmt", &opt_clock_gmt },
+	};
+	struct bt_context *ctx;
+	struct bt_ctf_iter *iter;
+	struct bt_ctf_event *event;
+	GArray *cycles, *timestamps;
+	unsigned int i;
+	int handle_id;
+
+	/*
+	 * Side-effects ensuring libs are not optimized away by static
+	 * linking.
+	 */
+	babeltrace_debug = 0;	/* libbabeltrace.la */
+	opt_clock_offset = 0;	/* libbabeltrace-ctf.la */
+
+	if (argc < 2) {
+		return bench_usage(argv[0], "TRACE_PATH");
+	}
+
+	ctx = bt_context_create();
+	if (!ctx)
+		return EXIT_FAILURE;
+	handle_id = bt_context_add_trace(ctx, argv[1], "ctf", NULL, NULL, NULL);
+	if (handle_id < 0) {
+		fprintf(stderr, "Cannot open trace \"%s\"\n", argv[1]);
+		goto error;
+	}
+	iter = bt_ctf_iter_create(ctx, NULL, NULL);
+	if (!iter)
+		goto error;
+
+	/* Collect the timestamps first: only formatting is measured. */
+	cycles = g_array_new(FALSE, FALSE, sizeof(uint64_t));
+	timestamps = g_array_new(FALSE, FALSE, sizeof(uint64_t));
+	while ((event = bt_ctf_iter_read_event(iter))) {
+		uint64_t v;
+
+		v = bt_ctf_get_cycles(event);
+		g_array_append_val(cycles, v);
+		v = bt_ctf_get_timestamp(event);
+		g_array_append_val(timestamps, v);
+		if (bt_iter_next(bt_ctf_get_iter(iter)) < 0)
+			break;
+	}
+	bt_ctf_iter_destroy(iter);
+	if (!timestamps->len) {
+		fprintf(stderr, "No event in trace\n");
+		goto error_free;
+	}
+
+	printf("%u events\n", timestamps->len);
+	for (i = 0; i < sizeof(modes) / sizeof(modes[0]); i++) {
+		struct ctf_timestamp_cache cache = { 0 };
+		uint64_t uncached_ns, cached_ns, len;
+
+		if (modes[i].opt)
+			*modes[i].opt = 1;
+		if (modes[i].opt == &opt_clock_gmt)
+			opt_clock_date = 1;
+		uncached_ns = format_all(modes[i].opt == &opt_clock_cycles ?
+				cycles : timestamps, NULL, &len);
+		cached_ns = format_all(modes[i].opt == &opt_clock_cycles ?
+				cycles : timestamps, &cache, &len);
+		printf("%-8s %6.1f ns/event uncached, %6.1f ns/event cached "
+			"(%" PRIu64 " bytes)\n", modes[i].name,
+			(double) uncached_ns / timestamps->len,
+			(double) cached_ns / timestamps->len, len);
+		if (modes[i].opt)
+			*modes[i].opt = 0;
+		opt_clock_date = 0;
+	}
+
+	g_array_free(cycles, TRUE);
+	g_array_free(timestamps, TRUE);
+	bt_context_put(ctx);
+	return EXIT_SUCCESS;
+
+error_free:
+	g_array_free(cycles, TRUE);
+	g_array_free(timestamps, TRUE);
+error:
+	bt_context_put(ctx);
+	return EXIT_FAILURE;
+}
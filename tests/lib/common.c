@@ -22,6 +22,15 @@
 
 #include <babeltrace/context.h>
 #include <babeltrace/iterator.h>
+#include <babeltrace/ctf/events.h>
+#include <babeltrace/types.h>
+#include <inttypes.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <glib.h>
+
+#include "common.h"
 
 struct bt_context *create_context_with_path(const char *path)
 {
@@ -40,3 +49,112 @@ struct bt_context *create_context_with_path(const char *path)
 	}
 	return ctx;
 }
+
+static
+void dump_definition(GString *dump, const struct bt_ctf_event *event,
+		const struct bt_definition *def)
+{
+	const struct bt_declaration *decl = bt_ctf_get_decl_from_def(def);
+	struct bt_definition const * const *list;
+	unsigned int count, i;
+
+	g_string_append_printf(dump, " %s=", bt_ctf_field_name(def));
+	switch (bt_ctf_field_type(decl)) {
+	case CTF_TYPE_INTEGER:
+		if (bt_ctf_get_int_signedness(decl))
+			g_string_append_printf(dump, "%" PRId64,
+				bt_ctf_get_int64(def));
+		else
+			g_string_append_printf(dump, "%" PRIu64,
+				bt_ctf_get_uint64(def));
+		break;
+	case CTF_TYPE_FLOAT:
+		g_string_append_printf(dump, "%a", bt_ctf_get_float(def));
+		break;
+	case CTF_TYPE_STRING:
+		g_string_append_printf(dump, "\"%s\"", bt_ctf_get_string(def));
+		break;
+	case CTF_TYPE_ENUM:
+		g_string_append_printf(dump, "%s", bt_ctf_get_enum_str(def));
+		break;
+	case CTF_TYPE_VARIANT:
+		dump_definition(dump, event, bt_ctf_get_variant(def));
+		break;
+	case CTF_TYPE_ARRAY:
+		if (bt_ctf_get_encoding(decl) != CTF_STRING_NONE) {
+			g_string_append_printf(dump, "\"%s\"",
+				bt_ctf_get_char_array(def));
+			break;
+		}
+		goto compound;
+	case CTF_TYPE_SEQUENCE:
+		/* Text sequences have no element definitions. */
+		if (bt_ctf_get_encoding(decl) != CTF_STRING_NONE) {
+			g_string_append_printf(dump, "\"%s\"",
+				container_of(def, struct definition_sequence,
+					p)->string->str);
+			break;
+		}
+		goto compound;
+	case CTF_TYPE_STRUCT:
+	compound:
+		g_string_append(dump, "{");
+		if (!bt_ctf_get_field_list(event, def, &list, &count)) {
+			for (i = 0; i < count; i++)
+				dump_definition(dump, event, list[i]);
+		}
+		g_string_append(dump, " }");
+		break;
+	default:
+		g_string_append(dump, "?");
+		break;
+	}
+}
+
+void dump_event(GString *dump, const struct bt_ctf_event *event)
+{
+	static const enum bt_ctf_scope scopes[] = {
+		BT_STREAM_PACKET_CONTEXT,
+		BT_STREAM_EVENT_HEADER,
+		BT_STREAM_EVENT_CONTEXT,
+		BT_EVENT_CONTEXT,
+		BT_EVENT_FIELDS,
+	};
+	const struct bt_definition *scope;
+	unsigned int i;
+
+	g_string_append_printf(dump, "%" PRIu64 " %" PRIu64 " %s",
+		bt_ctf_get_timestamp(event), bt_ctf_get_cycles(event),
+		bt_ctf_event_name(event));
+	for (i = 0; i < sizeof(scopes) / sizeof(scopes[0]); i++) {
+		scope = bt_ctf_get_top_level_scope(event, scopes[i]);
+		if (scope)
+			dump_definition(dump, event, scope);
+	}
+	g_string_append(dump, "\n");
+}
+
+void remove_trace(const char *path)
+{
+	DIR *dir;
+	struct dirent *entry;
+
+	dir = opendir(path);
+	if (!dir)
+		return;
+	while ((entry = readdir(dir))) {
+		char *subdir_path;
+
+		if (entry->d_type != DT_DIR) {
+			unlinkat(dirfd(dir), entry->d_name, 0);
+			continue;
+		}
+		if (!strcmp(entry->d_name, ".") || !strcmp(entry->d_name, ".."))
+			continue;
+		subdir_path = g_strdup_printf("%s/%s", path, entry->d_name);
+		remove_trace(subdir_path);
+		g_free(subdir_path);
+	}
+	closedir(dir);
+	rmdir(path);
+}
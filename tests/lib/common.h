@@ -21,8 +21,23 @@
 #ifndef _TESTS_COMMON_H
 #define _TESTS_COMMON_H
 
+#include <glib.h>
+
 struct bt_context;
+struct bt_ctf_event;
 
 struct bt_context *create_context_with_path(const char *path);
 
+/*
+ * Append a line describing an event to dump: its timestamps, name and
+ * the values of all its fields.
+ */
+void dump_event(GString *dump, const struct bt_ctf_event *event);
+
+/*
+ * Remove a trace directory written by a test, along with its files and
+ * subdirectories, such as the index cache.
+ */
+void remove_trace(const char *path);
+
 #endif /* _TESTS_COMMON_H */
@@ -24,8 +24,11 @@
 #include <time.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
 
 #include <tap/tap.h>
+#include "bench.h"
 
 unsigned int glob;
 
@@ -45,6 +48,14 @@ void fct(void)
 #define UNSIGNED_TEST_DESC_FMT_STR "Writing and reading back 0x%X, unsigned"
 #define DIAG_FMT_STR "Failed reading value written \"%s\"-wise, with start=%i" \
 	" and length=%i. Read %llX"
+#define WORD_TEST_DESC_FMT_STR "Reading back 0x%llX word-wise"
+#define WORD_DIAG_FMT_STR "Failed reading %s value word-wise, with start=%u" \
+	" and length=%u. Read %llX, expected %llX"
+
+/* Benchmark: LTTng compact event headers, 5-bit id and 27-bit timestamp */
+#define BENCH_NR_HEADERS	(1UL << 20)
+#define BENCH_HEADER_STRIDE	45	/* Bits, misaligns successive headers */
+#define BENCH_DEFAULT_LOOPS	100
 
 unsigned int srcrand;
 
@@ -263,10 +274,79 @@ void run_test_signed(void)
 	pass(SIGNED_TEST_DESC_FMT_STR, src);
 }
 
+/*
+ * Check the word-at-a-time reads against the generic ones, for every
+ * field which bt_bitfield_word_ok() accepts within the test array.
+ */
+void run_test_word(void)
+{
+	unsigned long long src, ref, mask;
+	union {
+		unsigned char c[TEST_LEN];
+		unsigned long l[TEST_LEN/sizeof(unsigned long)];
+	} target;
+	unsigned long long readval;
+	long long sref;
+	unsigned int s, l;
+
+	src = ((unsigned long long) srcrand << 32) | (srcrand ^ 0xA5A5A5A5U);
+
+	for (s = 0; s < CHAR_BIT * TEST_LEN; s++) {
+		for (l = 1; l <= 64; l++) {
+			if (!bt_bitfield_word_ok(s, l, TEST_LEN))
+				continue;
+			mask = l < 64 ? ~(~0ULL << l) : ~0ULL;
+			ref = src & mask;
+
+			init_byte_array(target.c, TEST_LEN, 0xFF);
+			bt_bitfield_write_le(target.l, unsigned long, s, l, src);
+			readval = bt_bitfield_read_word_le(target.c, s, l);
+			if (readval != ref) {
+				fail(WORD_TEST_DESC_FMT_STR, src);
+				diag(WORD_DIAG_FMT_STR, "little endian", s, l,
+					readval, ref);
+				return;
+			}
+			bt_bitfield_read_le(target.c, unsigned long, s, l,
+				&sref);
+			if (bt_bitfield_sign_extend(readval, l) != sref) {
+				fail(WORD_TEST_DESC_FMT_STR, src);
+				diag(WORD_DIAG_FMT_STR, "signed little endian",
+					s, l, (unsigned long long)
+					bt_bitfield_sign_extend(readval, l),
+					(unsigned long long) sref);
+				return;
+			}
+
+			init_byte_array(target.c, TEST_LEN, 0x0);
+			bt_bitfield_write_be(target.l, unsigned long, s, l, src);
+			readval = bt_bitfield_read_word_be(target.c, s, l);
+			if (readval != ref) {
+				fail(WORD_TEST_DESC_FMT_STR, src);
+				diag(WORD_DIAG_FMT_STR, "big endian", s, l,
+					readval, ref);
+				return;
+			}
+			bt_bitfield_read_be(target.c, unsigned long, s, l,
+				&sref);
+			if (bt_bitfield_sign_extend(readval, l) != sref) {
+				fail(WORD_TEST_DESC_FMT_STR, src);
+				diag(WORD_DIAG_FMT_STR, "signed big endian",
+					s, l, (unsigned long long)
+					bt_bitfield_sign_extend(readval, l),
+					(unsigned long long) sref);
+				return;
+			}
+		}
+	}
+
+	pass(WORD_TEST_DESC_FMT_STR, src);
+}
+
 void run_test(void)
 {
 	int i;
-	plan_tests(NR_TESTS * 2 + 6);
+	plan_tests(NR_TESTS * 3 + 8);
 
 	srand(time(NULL));
 
@@ -287,11 +367,109 @@ void run_test(void)
 	srcrand = (int)0x80000000U;
 	run_test_signed();
 
+	srcrand = 0;
+	run_test_word();
+
+	srcrand = ~0U;
+	run_test_word();
+
 	for (i = 0; i < NR_TESTS; i++) {
 		srcrand = rand();
 		run_test_unsigned();
 		run_test_signed();
+		run_test_word();
+	}
+}
+
+/*
+ * Read the id and timestamp of packed compact event headers, as
+ * ctf_integer_read() does, with the generic and the word-at-a-time
+ * reads. The sum of the fields is returned so the reads cannot be
+ * optimized away.
+ */
+static
+uint64_t bench_read(const unsigned char *buf, int byte_order, int word,
+		unsigned long loops, uint64_t *delta_ns)
+{
+	uint64_t start_ns, sum = 0;
+	unsigned long i, j;
+
+	start_ns = get_time_ns();
+	for (j = 0; j < loops; j++) {
+		for (i = 0; i < BENCH_NR_HEADERS; i++) {
+			uint64_t offset = i * BENCH_HEADER_STRIDE;
+			unsigned long long id, timestamp;
+
+			if (word && byte_order == LITTLE_ENDIAN) {
+				id = bt_bitfield_read_word_le(buf, offset, 5);
+				timestamp = bt_bitfield_read_word_le(buf,
+					offset + 5, 27);
+			} else if (word) {
+				id = bt_bitfield_read_word_be(buf, offset, 5);
+				timestamp = bt_bitfield_read_word_be(buf,
+					offset + 5, 27);
+			} else if (byte_order == LITTLE_ENDIAN) {
+				bt_bitfield_read_le(buf, unsigned long,
+					offset, 5, &id);
+				bt_bitfield_read_le(buf, unsigned long,
+					offset + 5, 27, &timestamp);
+			} else {
+				bt_bitfield_read_be(buf, unsigned long,
+					offset, 5, &id);
+				bt_bitfield_read_be(buf, unsigned long,
+					offset + 5, 27, &timestamp);
+			}
+			sum += id + timestamp;
+		}
 	}
+	*delta_ns = get_time_ns() - start_ns;
+	return sum;
+}
+
+static
+int run_bench(unsigned long loops)
+{
+	const int byte_orders[] = { LITTLE_ENDIAN, BIG_ENDIAN };
+	const char *mode_names[] = { "generic", "word" };
+	/* Word reads may load up to 8 bytes past the last header */
+	size_t len = (BENCH_NR_HEADERS * BENCH_HEADER_STRIDE) / CHAR_BIT
+		+ sizeof(uint64_t);
+	unsigned char *buf;
+	unsigned long i;
+	int ret = EXIT_SUCCESS;
+
+	buf = malloc(len);
+	if (!buf)
+		return EXIT_FAILURE;
+	srand(42);
+	for (i = 0; i < len; i++)
+		buf[i] = rand();
+
+	for (i = 0; i < sizeof(byte_orders) / sizeof(byte_orders[0]); i++) {
+		uint64_t sums[2];
+		int word;
+
+		for (word = 0; word < 2; word++) {
+			uint64_t delta_ns;
+
+			sums[word] = bench_read(buf, byte_orders[i], word,
+				loops, &delta_ns);
+			printf("%-6s endian %-7s %6.2f ns/header "
+				"(sum %" PRIu64 ")\n",
+				byte_orders[i] == LITTLE_ENDIAN ?
+					"little" : "big",
+				mode_names[word],
+				(double) delta_ns / (BENCH_NR_HEADERS * loops),
+				sums[word]);
+		}
+		if (sums[0] != sums[1]) {
+			fprintf(stderr, "Word-wise reads differ\n");
+			ret = EXIT_FAILURE;
+			break;
+		}
+	}
+	free(buf);
+	return ret;
 }
 
 static
@@ -340,6 +518,14 @@ int print_encodings(unsigned long src, unsigned int shift, unsigned int len)
 
 int main(int argc, char **argv)
 {
+	if (argc > 1 && !strcmp(argv[1], "--bench")) {
+		/* Read throughput benchmark */
+		unsigned long loops = BENCH_DEFAULT_LOOPS;
+
+		if (argc > 2)
+			loops = strtoul(argv[2], NULL, 0);
+		return run_bench(loops);
+	}
 	if (argc > 1) {
 		/* Print encodings */
 		unsigned long src;
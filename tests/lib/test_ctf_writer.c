@@ -702,6 +702,100 @@ end:
 	bt_ctf_event_class_put(event_class);
 }
 
+int set_recycled_event_payload(struct bt_ctf_event *event, uint64_t value)
+{
+	int ret = 0;
+	uint64_t i;
+	struct bt_ctf_field *integer = bt_ctf_event_get_payload(event,
+		"an_integer");
+	struct bt_ctf_field *string = bt_ctf_event_get_payload(event,
+		"a_string");
+	struct bt_ctf_field *length = bt_ctf_event_get_payload(event,
+		"sequence_length");
+	struct bt_ctf_field *sequence = bt_ctf_event_get_payload(event,
+		"a_sequence");
+
+	ret |= bt_ctf_field_unsigned_integer_set_value(integer, value);
+	ret |= bt_ctf_field_string_set_value(string,
+		value & 1 ? "odd" : "an even value");
+	ret |= bt_ctf_field_unsigned_integer_set_value(length, value);
+	ret |= bt_ctf_field_sequence_set_length(sequence, length);
+	for (i = 0; i < value; i++) {
+		struct bt_ctf_field *element =
+			bt_ctf_field_sequence_get_field(sequence, i);
+
+		ret |= bt_ctf_field_unsigned_integer_set_value(element, i);
+		bt_ctf_field_put(element);
+	}
+
+	bt_ctf_field_put(integer);
+	bt_ctf_field_put(string);
+	bt_ctf_field_put(length);
+	bt_ctf_field_put(sequence);
+	return ret;
+}
+
+void event_reset_test(struct bt_ctf_stream_class *stream_class,
+		struct bt_ctf_stream *stream, struct bt_ctf_clock *clock)
+{
+	struct bt_ctf_event_class *event_class = bt_ctf_event_class_create(
+		"Recycled_Event");
+	struct bt_ctf_field_type *integer_type =
+		bt_ctf_field_type_integer_create(32);
+	struct bt_ctf_field_type *length_type =
+		bt_ctf_field_type_integer_create(8);
+	struct bt_ctf_field_type *string_type =
+		bt_ctf_field_type_string_create();
+	struct bt_ctf_field_type *sequence_type =
+		bt_ctf_field_type_sequence_create(integer_type,
+		"sequence_length");
+	struct bt_ctf_event *event;
+
+	bt_ctf_event_class_add_field(event_class, integer_type, "an_integer");
+	bt_ctf_event_class_add_field(event_class, string_type, "a_string");
+	bt_ctf_event_class_add_field(event_class, length_type,
+		"sequence_length");
+	bt_ctf_event_class_add_field(event_class, sequence_type, "a_sequence");
+	bt_ctf_stream_class_add_event_class(stream_class, event_class);
+
+	event = bt_ctf_event_create(event_class);
+	ok(set_recycled_event_payload(event, 3) == 0,
+		"Set the payload of an event to be reset");
+	bt_ctf_clock_set_time(clock, ++current_time);
+	ok(bt_ctf_stream_append_event(stream, event) == 0,
+		"Append an event to be reset");
+	ok(bt_ctf_event_reset(event) == 0, "Reset an event");
+	ok(bt_ctf_event_reset(NULL), "Reset a NULL event");
+	bt_ctf_clock_set_time(clock, ++current_time);
+	ok(bt_ctf_stream_append_event(stream, event),
+		"Appending a reset event without setting its fields fails");
+	ok(set_recycled_event_payload(event, 2) == 0,
+		"Set the payload of a reset event");
+	ok(bt_ctf_stream_append_event(stream, event) == 0,
+		"Append a reset event");
+	bt_ctf_event_put(event);
+
+	/* A released event is reused by the next bt_ctf_event_create() */
+	event = bt_ctf_event_create(event_class);
+	ok(event, "Create an event after releasing one of the same class");
+	bt_ctf_clock_set_time(clock, ++current_time);
+	ok(bt_ctf_stream_append_event(stream, event),
+		"The fields of a recycled event are unset");
+	ok(set_recycled_event_payload(event, 5) == 0,
+		"Set the payload of a recycled event");
+	ok(bt_ctf_stream_append_event(stream, event) == 0,
+		"Append a recycled event");
+	ok(bt_ctf_stream_flush(stream) == 0,
+		"Flush a stream containing reset and recycled events");
+
+	bt_ctf_event_put(event);
+	bt_ctf_event_class_put(event_class);
+	bt_ctf_field_type_put(integer_type);
+	bt_ctf_field_type_put(length_type);
+	bt_ctf_field_type_put(string_type);
+	bt_ctf_field_type_put(sequence_type);
+}
+
 int main(int argc, char **argv)
 {
 	char trace_path[] = "/tmp/ctfwriter_XXXXXX";
@@ -796,6 +890,16 @@ int main(int argc, char **argv)
 	ok(bt_ctf_writer_add_clock(writer, clock),
 		"Verify a clock can't be added twice to a writer instance");
 
+	/* Packet writing options, left to their defaults */
+	ok(bt_ctf_writer_set_packet_size(NULL, getpagesize()),
+		"bt_ctf_writer_set_packet_size error with NULL writer");
+	ok(bt_ctf_writer_set_packet_size(writer, 0),
+		"bt_ctf_writer_set_packet_size error with a null packet size");
+	ok(bt_ctf_writer_set_packet_size(writer, getpagesize() + 1),
+		"bt_ctf_writer_set_packet_size error with a packet size which is not a multiple of the page size");
+	ok(bt_ctf_writer_set_async_flush(NULL, 1),
+		"bt_ctf_writer_set_async_flush error with NULL writer");
+
 	/* Define a stream class */
 	stream_class = bt_ctf_stream_class_create("test_stream");
 	ok(stream_class, "Create stream class");
@@ -812,6 +916,10 @@ int main(int argc, char **argv)
 	/* Should fail after instanciating a stream (locked)*/
 	ok(bt_ctf_stream_class_set_clock(stream_class, clock),
 		"Changes to a stream class that was already instantiated fail");
+	ok(bt_ctf_writer_set_packet_size(writer, getpagesize()),
+		"Packet size can't be changed once a stream is instantiated");
+	ok(bt_ctf_writer_set_async_flush(writer, 1),
+		"Asynchronous flush can't be enabled once a stream is instantiated");
 
 	append_simple_event(stream_class, stream1, clock);
 
@@ -819,6 +927,8 @@ int main(int argc, char **argv)
 
 	append_complex_event(stream_class, stream1, clock);
 
+	event_reset_test(stream_class, stream1, clock);
+
 	metadata_string = bt_ctf_writer_get_metadata_string(writer);
 	ok(metadata_string, "Get metadata string");
 
@@ -0,0 +1,892 @@
+/*
+ * test_decode_paths.c
+ *
+ * Lib BabelTrace - Field decoding paths test
+ *
+ * Reads traces with the compiled structure decoders, then through
+ * generic_rw() only, then with zero-copy strings, and checks that all
+ * give the same values. A generated trace also checks float bit
+ * patterns, packed signed sequence elements and strings retained across
+ * a packet switch against the values written.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; under version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#define _GNU_SOURCE
+#include <babeltrace/context.h>
+#include <babeltrace/iterator.h>
+#include <babeltrace/ctf/iterator.h>
+#include <babeltrace/ctf/events.h>
+#include <babeltrace/ctf-writer/writer.h>
+#include <babeltrace/ctf-writer/clock.h>
+#include <babeltrace/ctf-writer/stream.h>
+#include <babeltrace/ctf-writer/event.h>
+#include <babeltrace/ctf-writer/event-types.h>
+#include <babeltrace/ctf-writer/event-fields.h>
+#include <babeltrace/ctf-ir/metadata.h>
+#include <babeltrace/context-internal.h>
+#include <babeltrace/babeltrace-internal.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <float.h>
+#include <glib.h>
+
+#include <tap/tap.h>
+#include "common.h"
+
+#define NR_TESTS_PER_TRACE	2
+#define NR_GEN_TESTS		10
+
+#define GEN_NR_PACKETS		3
+#define GEN_SEQ_LEN		32
+
+enum decode_path {
+	DECODE_COMPILED,	/* compiled decoders, copied strings */
+	DECODE_GENERIC,		/* generic_rw() only */
+	DECODE_ZERO_COPY,	/* compiled decoders, zero-copy strings */
+	NR_DECODE_PATHS,
+};
+
+static const char *decode_path_names[] = {
+	[DECODE_COMPILED] = "compiled decoders",
+	[DECODE_GENERIC] = "generic_rw()",
+	[DECODE_ZERO_COPY] = "zero-copy strings",
+};
+
+/*
+ * Compiled decoders hidden from the reader, restored before the trace
+ * is closed so that they are freed along with their stream.
+ */
+struct hidden_decoder {
+	struct ctf_decoder **location;
+	struct ctf_decoder *decoder;
+};
+
+struct hidden_body {
+	unsigned int *location;
+	unsigned int nr;
+};
+
+struct hidden_decoders {
+	GArray *decoders;	/* struct hidden_decoder */
+	GArray *bodies;		/* struct hidden_body */
+};
+
+static
+void hide_decoder(struct hidden_decoders *hidden,
+		struct ctf_decoder **location)
+{
+	struct hidden_decoder entry;
+
+	if (!*location)
+		return;
+	entry.location = location;
+	entry.decoder = *location;
+	g_array_append_val(hidden->decoders, entry);
+	*location = NULL;
+}
+
+static
+void hide_stream_decoders(struct hidden_decoders *hidden,
+		struct ctf_stream_definition *stream)
+{
+	unsigned int i;
+
+	hide_decoder(hidden, &stream->stream_event_header_decoder);
+	hide_decoder(hidden, &stream->stream_event_context_decoder);
+	if (!stream->events_by_id)
+		return;
+	for (i = 0; i < stream->events_by_id->len; i++) {
+		struct ctf_event_definition *event =
+			g_ptr_array_index(stream->events_by_id, i);
+		struct hidden_body body;
+
+		if (!event)
+			continue;
+		hide_decoder(hidden, &event->event_context_decoder);
+		hide_decoder(hidden, &event->event_fields_decoder);
+		body.location = &event->nr_body_decoders;
+		body.nr = event->nr_body_decoders;
+		g_array_append_val(hidden->bodies, body);
+		event->nr_body_decoders = 0;
+	}
+}
+
+/*
+ * Make all the streams of a context read their events through
+ * generic_rw().
+ */
+static
+void hide_decoders(struct hidden_decoders *hidden, struct bt_context *ctx)
+{
+	unsigned int i, j, k;
+
+	hidden->decoders = g_array_new(FALSE, FALSE,
+		sizeof(struct hidden_decoder));
+	hidden->bodies = g_array_new(FALSE, FALSE, sizeof(struct hidden_body));
+	for (i = 0; i < ctx->tc->array->len; i++) {
+		struct ctf_trace *trace = container_of(
+			g_ptr_array_index(ctx->tc->array, i),
+			struct ctf_trace, parent);
+
+		for (j = 0; j < trace->streams->len; j++) {
+			struct ctf_stream_declaration *stream_class =
+				g_ptr_array_index(trace->streams, j);
+
+			if (!stream_class)
+				continue;
+			for (k = 0; k < stream_class->streams->len; k++) {
+				struct ctf_stream_definition *stream =
+					g_ptr_array_index(stream_class->streams, k);
+
+				if (stream)
+					hide_stream_decoders(hidden, stream);
+			}
+		}
+	}
+}
+
+static
+void restore_decoders(struct hidden_decoders *hidden)
+{
+	unsigned int i;
+
+	for (i = 0; i < hidden->decoders->len; i++) {
+		struct hidden_decoder *entry = &g_array_index(hidden->decoders,
+			struct hidden_decoder, i);
+
+		*entry->location = entry->decoder;
+	}
+	for (i = 0; i < hidden->bodies->len; i++) {
+		struct hidden_body *body = &g_array_index(hidden->bodies,
+			struct hidden_body, i);
+
+		*body->location = body->nr;
+	}
+	g_array_free(hidden->decoders, TRUE);
+	g_array_free(hidden->bodies, TRUE);
+}
+
+/*
+ * Open a trace to read it through a decoding path. Returns the number
+ * of compiled decoders hidden by the generic path in nr_hidden.
+ */
+static
+struct bt_context *open_trace(const char *path, enum decode_path decode_path,
+		struct hidden_decoders *hidden, unsigned int *nr_hidden)
+{
+	struct bt_context *ctx;
+
+	opt_zero_copy_strings = decode_path == DECODE_ZERO_COPY;
+	ctx = create_context_with_path(path);
+	opt_zero_copy_strings = 0;
+	*nr_hidden = 0;
+	if (!ctx || decode_path != DECODE_GENERIC)
+		return ctx;
+	hide_decoders(hidden, ctx);
+	*nr_hidden = hidden->decoders->len;
+	return ctx;
+}
+
+static
+void close_trace(struct bt_context *ctx, enum decode_path decode_path,
+		struct hidden_decoders *hidden)
+{
+	if (decode_path == DECODE_GENERIC)
+		restore_decoders(hidden);
+	bt_context_put(ctx);
+}
+
+/*
+ * Dump all the events of a trace read through a decoding path.
+ */
+static
+GString *dump_trace(const char *path, enum decode_path decode_path,
+		unsigned int *nr_hidden)
+{
+	struct hidden_decoders hidden;
+	struct bt_context *ctx;
+	struct bt_ctf_iter *iter;
+	struct bt_ctf_event *event;
+	GString *dump;
+
+	ctx = open_trace(path, decode_path, &hidden, nr_hidden);
+	if (!ctx)
+		return NULL;
+	dump = g_string_new("");
+	iter = bt_ctf_iter_create(ctx, NULL, NULL);
+	if (!iter) {
+		g_string_append(dump, "no iterator\n");
+		goto end;
+	}
+	while ((event = bt_ctf_iter_read_event(iter))) {
+		dump_event(dump, event);
+		if (bt_iter_next(bt_ctf_get_iter(iter)) < 0) {
+			g_string_append(dump, "error\n");
+			break;
+		}
+	}
+	bt_ctf_iter_destroy(iter);
+end:
+	close_trace(ctx, decode_path, &hidden);
+	return dump;
+}
+
+/*
+ * Return the number of the first differing line of two dumps, 0 if
+ * they are the same.
+ */
+static
+unsigned int first_difference(GString *a, GString *b)
+{
+	unsigned int line = 1;
+	gsize i;
+
+	for (i = 0; i < a->len && i < b->len; i++) {
+		if (a->str[i] != b->str[i])
+			return line;
+		if (a->str[i] == '\n')
+			line++;
+	}
+	return a->len == b->len ? 0 : line;
+}
+
+/*
+ * Compare the dumps of a trace read through each decoding path. Returns
+ * the number of decoders compiled for the trace.
+ */
+static
+unsigned int compare_decode_paths(const char *path)
+{
+	GString *dumps[NR_DECODE_PATHS];
+	unsigned int nr_hidden, nr_compiled = 0, line;
+	int i;
+
+	for (i = 0; i < NR_DECODE_PATHS; i++) {
+		dumps[i] = dump_trace(path, i, &nr_hidden);
+		if (i == DECODE_GENERIC)
+			nr_compiled = nr_hidden;
+	}
+	if (!dumps[DECODE_COMPILED]) {
+		diag("Unable to open trace %s", path);
+		skip(NR_TESTS_PER_TRACE, "No trace");
+		goto end;
+	}
+	diag("%s: %u compiled decoders", path, nr_compiled);
+	for (i = DECODE_GENERIC; i < NR_DECODE_PATHS; i++) {
+		line = dumps[i] ? first_difference(dumps[DECODE_COMPILED],
+			dumps[i]) : 1;
+		if (line)
+			diag("First difference at event line %u", line);
+		ok(!line, "%s: same values through %s and %s", path,
+			decode_path_names[DECODE_COMPILED],
+			decode_path_names[i]);
+	}
+end:
+	for (i = 0; i < NR_DECODE_PATHS; i++) {
+		if (dumps[i])
+			g_string_free(dumps[i], TRUE);
+	}
+	return nr_compiled;
+}
+
+/*
+ * Generated trace. Each packet holds one event of each class, in
+ * order: "floats", "seqs", then "str", so that the string is the last
+ * event of its packet.
+ */
+static const uint64_t float_bits[] = {
+	0x0000000000000000ULL,	/* +0 */
+	0x8000000000000000ULL,	/* -0 */
+	0x0000000000000001ULL,	/* smallest double denormal */
+	0x800FFFFFFFFFFFFFULL,	/* largest negative double denormal */
+	0x3690000000000000ULL,	/* float denormal */
+	0x3FF0000000000000ULL,	/* 1 */
+	0xC004000000000000ULL,	/* -2.5 */
+	0x7FEFFFFFFFFFFFFFULL,	/* DBL_MAX */
+	0x47EFFFFFE0000000ULL,	/* FLT_MAX */
+	0x7FF0000000000000ULL,	/* +inf */
+	0xFFF0000000000000ULL,	/* -inf */
+	0x7FF8000000000000ULL,	/* quiet NaN */
+	0xFFF8000000000123ULL,	/* negative quiet NaN with payload */
+	0x7FFC0000DEADBEEFULL,	/* quiet NaN with float payload */
+};
+
+#define NR_FLOAT_BITS	(sizeof(float_bits) / sizeof(float_bits[0]))
+
+/* Float fields of the "floats" event, read back as doubles. */
+static const struct float_field {
+	const char *name;
+	int binary64;
+} float_fields[] = {
+	{ "d64", 1 },		/* aligned, native byte order */
+	{ "f32", 0 },		/* aligned, native byte order */
+	{ "d64_be_packed", 1 },	/* after a 3-bit field, big endian */
+	{ "f32_be_packed", 0 },	/* after a 3-bit field, big endian */
+};
+
+#define NR_FLOAT_FIELDS	(sizeof(float_fields) / sizeof(float_fields[0]))
+
+/* Signed integer sequences of the "seqs" event. */
+static const struct seq_field {
+	const char *name;
+	unsigned int len;
+	unsigned int alignment;
+	int big_endian;
+} seq_fields[] = {
+	{ "s8", 8, 8, 0 },		/* bulk memcpy */
+	{ "s16_be", 16, 16, 1 },	/* bulk memcpy, byte swapped */
+	{ "s5_packed", 5, 1, 0 },	/* bitfield reads */
+	{ "s16_be_packed", 16, 1, 1 },	/* bitfield reads, unaligned */
+};
+
+#define NR_SEQ_FIELDS	(sizeof(seq_fields) / sizeof(seq_fields[0]))
+
+static
+double bits_to_double(uint64_t bits)
+{
+	double value;
+
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+static
+uint64_t double_to_bits(double value)
+{
+	uint64_t bits;
+
+	memcpy(&bits, &value, sizeof(bits));
+	return bits;
+}
+
+/*
+ * Bits of a value written to a float field, once read back as a
+ * double.
+ */
+static
+uint64_t expected_float_bits(uint64_t bits, int binary64)
+{
+	if (binary64)
+		return bits;
+	return double_to_bits((double) (float) bits_to_double(bits));
+}
+
+/*
+ * Element i of sequence field f written in packet p: spans the whole
+ * range of the element size, negative values included.
+ */
+static
+int64_t seq_value(unsigned int f, unsigned int p, unsigned int i)
+{
+	unsigned int len = seq_fields[f].len;
+	int64_t min = -(1LL << (len - 1));
+	uint64_t range = 1ULL << len;
+
+	return min + (int64_t) (((uint64_t) i * 2654435761U + p * 7) % range);
+}
+
+static
+void str_value(char *buf, size_t len, unsigned int p)
+{
+	snprintf(buf, len, "last string of packet %u", p);
+}
+
+static
+struct bt_ctf_field_type *create_float_type(int binary64, int packed)
+{
+	struct bt_ctf_field_type *type;
+
+	type = bt_ctf_field_type_floating_point_create();
+	if (binary64) {
+		bt_ctf_field_type_floating_point_set_exponent_digits(type,
+			sizeof(double) * CHAR_BIT - DBL_MANT_DIG);
+		bt_ctf_field_type_floating_point_set_mantissa_digits(type,
+			DBL_MANT_DIG);
+	}
+	if (packed) {
+		bt_ctf_field_type_set_alignment(type, 1);
+		bt_ctf_field_type_set_byte_order(type,
+			BT_CTF_BYTE_ORDER_BIG_ENDIAN);
+	}
+	return type;
+}
+
+/*
+ * A 3-bit field placing the next one at an odd bit offset. It is byte
+ * aligned and has the byte order of the next field: fields of different
+ * byte orders cannot share a byte.
+ */
+static
+struct bt_ctf_field_type *create_pad_type(int big_endian)
+{
+	struct bt_ctf_field_type *type;
+
+	type = bt_ctf_field_type_integer_create(3);
+	bt_ctf_field_type_set_alignment(type, CHAR_BIT);
+	if (big_endian)
+		bt_ctf_field_type_set_byte_order(type,
+			BT_CTF_BYTE_ORDER_BIG_ENDIAN);
+	return type;
+}
+
+static
+struct bt_ctf_event_class *create_floats_class(void)
+{
+	struct bt_ctf_event_class *event_class;
+	struct bt_ctf_field_type *pad_type;
+	unsigned int i;
+
+	event_class = bt_ctf_event_class_create("floats");
+	pad_type = create_pad_type(1);
+	for (i = 0; i < NR_FLOAT_FIELDS; i++) {
+		struct bt_ctf_field_type *type;
+		int packed = strstr(float_fields[i].name, "packed") != NULL;
+		char pad_name[32];
+
+		if (packed) {
+			snprintf(pad_name, sizeof(pad_name), "pad%u", i);
+			bt_ctf_event_class_add_field(event_class, pad_type,
+				pad_name);
+		}
+		type = create_float_type(float_fields[i].binary64, packed);
+		bt_ctf_event_class_add_field(event_class, type,
+			float_fields[i].name);
+		bt_ctf_field_type_put(type);
+	}
+	bt_ctf_field_type_put(pad_type);
+	return event_class;
+}
+
+static
+struct bt_ctf_event_class *create_seqs_class(void)
+{
+	struct bt_ctf_event_class *event_class;
+	struct bt_ctf_field_type *len_type;
+	unsigned int i;
+
+	event_class = bt_ctf_event_class_create("seqs");
+	len_type = bt_ctf_field_type_integer_create(8);
+	bt_ctf_event_class_add_field(event_class, len_type, "len");
+	for (i = 0; i < NR_SEQ_FIELDS; i++) {
+		struct bt_ctf_field_type *elem_type, *seq_type;
+		char pad_name[32];
+
+		if (seq_fields[i].alignment < CHAR_BIT) {
+			struct bt_ctf_field_type *pad_type;
+
+			pad_type = create_pad_type(seq_fields[i].big_endian);
+			snprintf(pad_name, sizeof(pad_name), "pad%u", i);
+			bt_ctf_event_class_add_field(event_class, pad_type,
+				pad_name);
+			bt_ctf_field_type_put(pad_type);
+		}
+		elem_type = bt_ctf_field_type_integer_create(seq_fields[i].len);
+		bt_ctf_field_type_integer_set_signed(elem_type, 1);
+		bt_ctf_field_type_set_alignment(elem_type,
+			seq_fields[i].alignment);
+		if (seq_fields[i].big_endian)
+			bt_ctf_field_type_set_byte_order(elem_type,
+				BT_CTF_BYTE_ORDER_BIG_ENDIAN);
+		seq_type = bt_ctf_field_type_sequence_create(elem_type, "len");
+		bt_ctf_event_class_add_field(event_class, seq_type,
+			seq_fields[i].name);
+		bt_ctf_field_type_put(seq_type);
+		bt_ctf_field_type_put(elem_type);
+	}
+	bt_ctf_field_type_put(len_type);
+	return event_class;
+}
+
+static
+struct bt_ctf_event_class *create_str_class(void)
+{
+	struct bt_ctf_event_class *event_class;
+	struct bt_ctf_field_type *type;
+
+	event_class = bt_ctf_event_class_create("str");
+	type = bt_ctf_field_type_string_create();
+	bt_ctf_event_class_add_field(event_class, type, "s");
+	bt_ctf_field_type_put(type);
+	return event_class;
+}
+
+static
+int append_floats_event(struct bt_ctf_stream *stream,
+		struct bt_ctf_event_class *event_class, unsigned int nr)
+{
+	struct bt_ctf_event *event;
+	unsigned int i;
+	int ret = 0;
+
+	event = bt_ctf_event_create(event_class);
+	if (!event)
+		return -1;
+	for (i = 0; i < NR_FLOAT_FIELDS; i++) {
+		struct bt_ctf_field *field;
+
+		field = bt_ctf_event_get_payload(event, float_fields[i].name);
+		ret |= bt_ctf_field_floating_point_set_value(field,
+			bits_to_double(float_bits[(nr + i) % NR_FLOAT_BITS]));
+		bt_ctf_field_put(field);
+		if (strstr(float_fields[i].name, "packed")) {
+			char pad_name[32];
+
+			snprintf(pad_name, sizeof(pad_name), "pad%u", i);
+			field = bt_ctf_event_get_payload(event, pad_name);
+			ret |= bt_ctf_field_unsigned_integer_set_value(field,
+				5);
+			bt_ctf_field_put(field);
+		}
+	}
+	if (!ret)
+		ret = bt_ctf_stream_append_event(stream, event);
+	bt_ctf_event_put(event);
+	return ret;
+}
+
+static
+int append_seqs_event(struct bt_ctf_stream *stream,
+		struct bt_ctf_event_class *event_class, unsigned int p)
+{
+	struct bt_ctf_event *event;
+	struct bt_ctf_field *len_field;
+	unsigned int f, i;
+	int ret;
+
+	event = bt_ctf_event_create(event_class);
+	if (!event)
+		return -1;
+	len_field = bt_ctf_event_get_payload(event, "len");
+	ret = bt_ctf_field_unsigned_integer_set_value(len_field, GEN_SEQ_LEN);
+	for (f = 0; f < NR_SEQ_FIELDS; f++) {
+		struct bt_ctf_field *seq;
+
+		if (seq_fields[f].alignment < CHAR_BIT) {
+			struct bt_ctf_field *pad;
+			char pad_name[32];
+
+			snprintf(pad_name, sizeof(pad_name), "pad%u", f);
+			pad = bt_ctf_event_get_payload(event, pad_name);
+			ret |= bt_ctf_field_unsigned_integer_set_value(pad, 5);
+			bt_ctf_field_put(pad);
+		}
+		seq = bt_ctf_event_get_payload(event, seq_fields[f].name);
+		ret |= bt_ctf_field_sequence_set_length(seq, len_field);
+		for (i = 0; i < GEN_SEQ_LEN; i++) {
+			struct bt_ctf_field *elem;
+
+			elem = bt_ctf_field_sequence_get_field(seq, i);
+			ret |= bt_ctf_field_signed_integer_set_value(elem,
+				seq_value(f, p, i));
+			bt_ctf_field_put(elem);
+		}
+		bt_ctf_field_put(seq);
+	}
+	bt_ctf_field_put(len_field);
+	if (!ret)
+		ret = bt_ctf_stream_append_event(stream, event);
+	bt_ctf_event_put(event);
+	return ret;
+}
+
+static
+int append_str_event(struct bt_ctf_stream *stream,
+		struct bt_ctf_event_class *event_class, unsigned int p)
+{
+	struct bt_ctf_event *event;
+	struct bt_ctf_field *field;
+	char value[64];
+	int ret;
+
+	event = bt_ctf_event_create(event_class);
+	if (!event)
+		return -1;
+	str_value(value, sizeof(value), p);
+	field = bt_ctf_event_get_payload(event, "s");
+	ret = bt_ctf_field_string_set_value(field, value);
+	bt_ctf_field_put(field);
+	if (!ret)
+		ret = bt_ctf_stream_append_event(stream, event);
+	bt_ctf_event_put(event);
+	return ret;
+}
+
+static
+int write_trace(const char *trace_path)
+{
+	struct bt_ctf_writer *writer;
+	struct bt_ctf_clock *clock;
+	struct bt_ctf_stream_class *stream_class;
+	struct bt_ctf_event_class *floats_class, *seqs_class, *str_class;
+	struct bt_ctf_stream *stream = NULL;
+	uint64_t time = 1000;
+	unsigned int p;
+	int ret = -1;
+
+	writer = bt_ctf_writer_create(trace_path);
+	if (!writer)
+		return -1;
+	clock = bt_ctf_clock_create("test_clock");
+	stream_class = bt_ctf_stream_class_create("test_stream");
+	floats_class = create_floats_class();
+	seqs_class = create_seqs_class();
+	str_class = create_str_class();
+	if (bt_ctf_writer_add_clock(writer, clock)
+			|| bt_ctf_stream_class_set_clock(stream_class, clock)
+			|| bt_ctf_stream_class_add_event_class(stream_class,
+				floats_class)
+			|| bt_ctf_stream_class_add_event_class(stream_class,
+				seqs_class)
+			|| bt_ctf_stream_class_add_event_class(stream_class,
+				str_class))
+		goto end;
+	stream = bt_ctf_writer_create_stream(writer, stream_class);
+	if (!stream)
+		goto end;
+
+	for (p = 0; p < GEN_NR_PACKETS; p++) {
+		unsigned int nr;
+
+		/* Every float bit pattern in every float field. */
+		for (nr = 0; nr < NR_FLOAT_BITS; nr++) {
+			bt_ctf_clock_set_time(clock, time++);
+			if (append_floats_event(stream, floats_class, nr))
+				goto end;
+		}
+		bt_ctf_clock_set_time(clock, time++);
+		if (append_seqs_event(stream, seqs_class, p))
+			goto end;
+		bt_ctf_clock_set_time(clock, time++);
+		if (append_str_event(stream, str_class, p))
+			goto end;
+		if (bt_ctf_stream_flush(stream))
+			goto end;
+	}
+	bt_ctf_writer_flush_metadata(writer);
+	ret = 0;
+end:
+	bt_ctf_stream_put(stream);
+	bt_ctf_event_class_put(str_class);
+	bt_ctf_event_class_put(seqs_class);
+	bt_ctf_event_class_put(floats_class);
+	bt_ctf_stream_class_put(stream_class);
+	bt_ctf_clock_put(clock);
+	bt_ctf_writer_put(writer);
+	return ret;
+}
+
+struct gen_results {
+	int floats_ok;
+	int seqs_ok[NR_SEQ_FIELDS];
+	int retained_ok;
+	unsigned int nr_floats, nr_retained;
+};
+
+static
+void check_floats_event(struct bt_ctf_event *event, unsigned int nr,
+		struct gen_results *results)
+{
+	const struct bt_definition *scope, *field;
+	unsigned int i;
+
+	scope = bt_ctf_get_top_level_scope(event, BT_EVENT_FIELDS);
+	for (i = 0; i < NR_FLOAT_FIELDS; i++) {
+		uint64_t bits, expected;
+
+		field = bt_ctf_get_field(event, scope, float_fields[i].name);
+		expected = expected_float_bits(
+			float_bits[(nr + i) % NR_FLOAT_BITS],
+			float_fields[i].binary64);
+		bits = field ? double_to_bits(bt_ctf_get_float(field)) : 0;
+		if (!field || bits != expected) {
+			if (results->floats_ok)
+				diag("%s: bits 0x%016" PRIX64 " instead of 0x%016"
+					PRIX64, float_fields[i].name, bits,
+					expected);
+			results->floats_ok = 0;
+		}
+		results->nr_floats++;
+	}
+}
+
+static
+void check_seqs_event(struct bt_ctf_event *event, unsigned int p,
+		struct gen_results *results)
+{
+	const struct bt_definition *scope, *field, *elem;
+	unsigned int f, i;
+
+	scope = bt_ctf_get_top_level_scope(event, BT_EVENT_FIELDS);
+	for (f = 0; f < NR_SEQ_FIELDS; f++) {
+		field = bt_ctf_get_field(event, scope, seq_fields[f].name);
+		if (!field) {
+			results->seqs_ok[f] = 0;
+			continue;
+		}
+		for (i = 0; i < GEN_SEQ_LEN; i++) {
+			elem = bt_ctf_get_index(event, field, i);
+			if (!elem || bt_ctf_get_int64(elem)
+					!= seq_value(f, p, i)) {
+				if (results->seqs_ok[f])
+					diag("%s[%u]: %" PRId64 " instead of %"
+						PRId64, seq_fields[f].name, i,
+						elem ? bt_ctf_get_int64(elem) : 0,
+						seq_value(f, p, i));
+				results->seqs_ok[f] = 0;
+			}
+		}
+	}
+}
+
+/*
+ * Read the generated trace through a decoding path, checking the values
+ * read against the values written. The string of the last event of a
+ * packet is read again once the next packet is mapped.
+ */
+static
+int check_generated_trace(const char *trace_path,
+		enum decode_path decode_path, struct gen_results *results)
+{
+	struct hidden_decoders hidden;
+	struct bt_context *ctx;
+	struct bt_ctf_iter *iter;
+	struct bt_ctf_event *event;
+	const struct bt_definition *retained = NULL;
+	unsigned int nr_hidden, nr_floats = 0, p = 0, f;
+	char expected[64];
+
+	memset(results, 0, sizeof(*results));
+	results->floats_ok = 1;
+	results->retained_ok = 1;
+	for (f = 0; f < NR_SEQ_FIELDS; f++)
+		results->seqs_ok[f] = 1;
+
+	ctx = open_trace(trace_path, decode_path, &hidden, &nr_hidden);
+	if (!ctx)
+		return -1;
+	iter = bt_ctf_iter_create(ctx, NULL, NULL);
+	if (!iter) {
+		close_trace(ctx, decode_path, &hidden);
+		return -1;
+	}
+	while ((event = bt_ctf_iter_read_event(iter))) {
+		const char *name = bt_ctf_event_name(event);
+
+		if (retained) {
+			/* The previous packet is no longer mapped. */
+			str_value(expected, sizeof(expected), p - 1);
+			if (strcmp(bt_ctf_get_string(retained), expected))
+				results->retained_ok = 0;
+			results->nr_retained++;
+			retained = NULL;
+		}
+		if (!strcmp(name, "floats")) {
+			check_floats_event(event, nr_floats++, results);
+		} else if (!strcmp(name, "seqs")) {
+			check_seqs_event(event, p, results);
+		} else if (!strcmp(name, "str")) {
+			retained = bt_ctf_get_field(event,
+				bt_ctf_get_top_level_scope(event,
+					BT_EVENT_FIELDS), "s");
+			str_value(expected, sizeof(expected), p);
+			if (!retained || strcmp(bt_ctf_get_string(retained),
+					expected))
+				results->retained_ok = 0;
+			nr_floats = 0;
+			p++;
+		}
+		if (bt_iter_next(bt_ctf_get_iter(iter)) < 0)
+			break;
+	}
+	bt_ctf_iter_destroy(iter);
+	close_trace(ctx, decode_path, &hidden);
+	return p == GEN_NR_PACKETS ? 0 : -1;
+}
+
+static
+void run_generated_trace_tests(void)
+{
+	char trace_path[] = "/tmp/test_decode_paths_XXXXXX";
+	struct gen_results results;
+	unsigned int f;
+	int all_seqs_ok;
+
+	if (!mkdtemp(trace_path)) {
+		perror("# mkdtemp");
+		skip(NR_GEN_TESTS, "No trace directory");
+		return;
+	}
+	if (write_trace(trace_path)) {
+		diag("Unable to write trace %s", trace_path);
+		skip(NR_GEN_TESTS, "No trace written");
+		goto end;
+	}
+
+	ok(compare_decode_paths(trace_path) > 0,
+		"Generated trace has compiled decoders");
+
+	if (check_generated_trace(trace_path, DECODE_COMPILED, &results)) {
+		skip(NR_GEN_TESTS - NR_TESTS_PER_TRACE - 1,
+			"Unable to read generated trace");
+		goto end;
+	}
+	ok(results.floats_ok, "%u float bit patterns through %s",
+		results.nr_floats, decode_path_names[DECODE_COMPILED]);
+	for (f = 0; f < NR_SEQ_FIELDS; f++)
+		ok(results.seqs_ok[f], "Signed sequence %s, %u-bit elements "
+			"aligned on %u bits", seq_fields[f].name,
+			seq_fields[f].len, seq_fields[f].alignment);
+
+	if (check_generated_trace(trace_path, DECODE_GENERIC, &results)) {
+		skip(1, "Unable to read generated trace");
+	} else {
+		all_seqs_ok = 1;
+		for (f = 0; f < NR_SEQ_FIELDS; f++)
+			all_seqs_ok &= results.seqs_ok[f];
+		ok(results.floats_ok && all_seqs_ok,
+			"Float bit patterns and sequences through %s",
+			decode_path_names[DECODE_GENERIC]);
+	}
+
+	if (check_generated_trace(trace_path, DECODE_ZERO_COPY, &results)) {
+		skip(1, "Unable to read generated trace");
+	} else {
+		ok(results.retained_ok && results.nr_retained
+				== GEN_NR_PACKETS - 1,
+			"%u zero-copy strings keep their value after a "
+			"packet switch", results.nr_retained);
+	}
+end:
+	remove_trace(trace_path);
+}
+
+int main(int argc, char **argv)
+{
+	int i;
+
+	/* Each path is read inline, through each decoding path. */
+	opt_pipeline_depth = 0;
+
+	plan_tests((argc - 1) * NR_TESTS_PER_TRACE + NR_GEN_TESTS);
+
+	for (i = 1; i < argc; i++)
+		compare_decode_paths(argv[i]);
+	run_generated_trace_tests();
+
+	return exit_status();
+}
@@ -0,0 +1,432 @@
+/*
+ * test_decoder.c
+ *
+ * Lib BabelTrace - Compiled decoders test
+ *
+ * Checks that reading consecutive structures with ctf_decoders_read()
+ * is equivalent to successive ctf_decoder_read() calls, and that its
+ * single bounds check rejects out of bounds, truncated and overflowing
+ * bodies before reading any field.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; under version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#define _GNU_SOURCE
+/* The decoder layout is private: test it in place. */
+#include "formats/ctf/types/decoder.c"
+
+#include <babeltrace/mmap-align.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <sys/mman.h>
+
+#include <tap/tap.h>
+
+#define NR_TESTS	13
+#define NR_STRUCTS	3
+#define NR_FIELDS	2
+#define PACKET_LEN	64		/* bytes */
+#define POISON		0xDEADBEEFULL
+
+struct field_desc {
+	const char *name;
+	size_t len;
+	int byte_order;
+	int signedness;
+	size_t alignment;
+};
+
+/*
+ * Structures with mixed alignments, byte orders and signedness: their
+ * padding depends on the start offset of the first one.
+ */
+static const struct field_desc struct_desc[NR_STRUCTS][NR_FIELDS] = {
+	{
+		{ "a", 5, LITTLE_ENDIAN, 0, 1 },
+		{ "b", 27, LITTLE_ENDIAN, 0, 1 },
+	},
+	{
+		{ "c", 64, BIG_ENDIAN, 0, 64 },
+		{ "d", 3, BIG_ENDIAN, 1, 1 },
+	},
+	{
+		{ "e", 16, LITTLE_ENDIAN, 1, 16 },
+		{ "f", 11, LITTLE_ENDIAN, 1, 1 },
+	},
+};
+
+static struct definition_struct *structs[NR_STRUCTS], *ref_structs[NR_STRUCTS];
+static struct ctf_decoder *decoders[NR_STRUCTS], *ref_decoders[NR_STRUCTS];
+static struct ctf_stream_pos pos;
+
+static
+struct definition_struct *create_struct(int nr)
+{
+	struct declaration_struct *declaration;
+	struct bt_definition *definition;
+	int i;
+
+	declaration = bt_struct_declaration_new(NULL, 1);
+	for (i = 0; i < NR_FIELDS; i++) {
+		const struct field_desc *desc = &struct_desc[nr][i];
+		struct declaration_integer *integer_declaration;
+
+		integer_declaration = bt_integer_declaration_new(desc->len,
+			desc->byte_order, desc->signedness, desc->alignment,
+			10, CTF_STRING_NONE, NULL);
+		bt_struct_declaration_add_field(declaration, desc->name,
+			&integer_declaration->p);
+		bt_declaration_unref(&integer_declaration->p);
+	}
+	definition = declaration->p.definition_new(&declaration->p, NULL,
+		g_quark_from_string("payload"), 0, "payload");
+	bt_declaration_unref(&declaration->p);
+	return container_of(definition, struct definition_struct, p);
+}
+
+static
+struct definition_integer *get_field(struct definition_struct *s, int i)
+{
+	return container_of(g_ptr_array_index(s->fields, i),
+		struct definition_integer, p);
+}
+
+static
+void poison_fields(void)
+{
+	int i, j;
+
+	for (i = 0; i < NR_STRUCTS; i++)
+		for (j = 0; j < NR_FIELDS; j++)
+			get_field(structs[i], j)->value._unsigned = POISON;
+}
+
+static
+int fields_poisoned(void)
+{
+	int i, j;
+
+	for (i = 0; i < NR_STRUCTS; i++)
+		for (j = 0; j < NR_FIELDS; j++)
+			if (get_field(structs[i], j)->value._unsigned != POISON)
+				return 0;
+	return 1;
+}
+
+/*
+ * Read the structures with ctf_decoders_read() from start offset, and
+ * check the read is rejected without moving the position or writing
+ * any field.
+ */
+static
+int decoders_read_rejected(const struct ctf_decoder * const *d, size_t nr,
+		uint64_t start)
+{
+	poison_fields();
+	pos.offset = start;
+	if (ctf_decoders_read(&pos, d, nr) != -EFAULT)
+		return 0;
+	if (pos.offset != start || !fields_poisoned())
+		return 0;
+	if (ctf_decoders_skip(&pos, d, nr) != -EFAULT)
+		return 0;
+	return pos.offset == start;
+}
+
+/*
+ * End offset of the structures read from start, as computed by
+ * successive ctf_decoder_read() calls, or 0 if they do not fit.
+ */
+static
+uint64_t ref_end(uint64_t start)
+{
+	struct ctf_stream_pos ref_pos;
+	int i;
+
+	memcpy(&ref_pos, &pos, sizeof(pos));
+	ref_pos.offset = start;
+	for (i = 0; i < NR_STRUCTS; i++) {
+		if (ctf_decoder_read(&ref_pos, ref_decoders[i]))
+			return 0;
+	}
+	return ref_pos.offset;
+}
+
+static
+void test_equivalence(void)
+{
+	uint64_t start;
+	int nr_starts = 0, nr_rejected = 0, equivalent = 1;
+
+	for (start = 0; start < pos.content_size; start++) {
+		uint64_t end;
+		int ret, i, j;
+
+		nr_starts++;
+		end = ref_end(start);
+		if (!end) {
+			nr_rejected++;
+			if (!decoders_read_rejected(
+					(const struct ctf_decoder * const *) decoders,
+					NR_STRUCTS, start)) {
+				diag("Start offset %" PRIu64 " not rejected", start);
+				equivalent = 0;
+			}
+			continue;
+		}
+		pos.offset = start;
+		ret = ctf_decoders_read(&pos,
+			(const struct ctf_decoder * const *) decoders,
+			NR_STRUCTS);
+		if (ret || pos.offset != end) {
+			diag("Start offset %" PRIu64 ": ret %d, end %" PRId64
+				" instead of %" PRIu64, start, ret, pos.offset,
+				end);
+			equivalent = 0;
+			continue;
+		}
+		for (i = 0; i < NR_STRUCTS; i++) {
+			for (j = 0; j < NR_FIELDS; j++) {
+				if (get_field(structs[i], j)->value._unsigned
+					!= get_field(ref_structs[i], j)->value._unsigned) {
+					diag("Start offset %" PRIu64
+						": field %s differs", start,
+						struct_desc[i][j].name);
+					equivalent = 0;
+				}
+			}
+		}
+	}
+	ok(equivalent, "Same values, end offsets and failures as "
+		"ctf_decoder_read() for %d start offsets", nr_starts);
+	ok(nr_rejected > 0 && nr_rejected < nr_starts,
+		"%d start offsets out of bounds", nr_rejected);
+}
+
+static
+void test_bounds(void)
+{
+	uint64_t start = 3, end, content_size = pos.content_size;
+
+	end = ref_end(start);
+	if (!end) {
+		skip(5, "Structures do not fit in the packet");
+		return;
+	}
+
+	/* The packet is mapped past its content: only the content counts. */
+	pos.content_size = end - 1;
+	ok(decoders_read_rejected(
+			(const struct ctf_decoder * const *) decoders,
+			NR_STRUCTS, start),
+		"Body ending one bit past the content size is rejected");
+
+	pos.content_size = end;
+	pos.offset = start;
+	ok(!ctf_decoders_read(&pos,
+			(const struct ctf_decoder * const *) decoders,
+			NR_STRUCTS) && pos.offset == end,
+		"Body ending at the content size is read");
+
+	/* Truncated within the first structure. */
+	pos.content_size = start + 8;
+	ok(decoders_read_rejected(
+			(const struct ctf_decoder * const *) decoders,
+			NR_STRUCTS, start),
+		"Body truncated within its first structure is rejected");
+
+	/* Truncated within the last structure. */
+	pos.content_size = end - 8;
+	ok(decoders_read_rejected(
+			(const struct ctf_decoder * const *) decoders,
+			NR_STRUCTS, start),
+		"Body truncated within its last structure is rejected");
+
+	pos.content_size = content_size;
+	pos.offset = EOF;
+	ok(ctf_decoders_read(&pos,
+			(const struct ctf_decoder * const *) decoders,
+			NR_STRUCTS) == -EFAULT && pos.offset == EOF,
+		"Read at end of stream is rejected");
+}
+
+/*
+ * Empty decoders of arbitrary lengths: the sum of their lengths may
+ * wrap around.
+ */
+static
+struct ctf_decoder *create_empty_decoder(uint64_t alignment, uint64_t len)
+{
+	struct ctf_decoder *decoder;
+
+	decoder = g_malloc0(sizeof(*decoder));
+	decoder->alignment = alignment;
+	decoder->len = len;
+	return decoder;
+}
+
+static
+void test_overflow(void)
+{
+	struct ctf_decoder *large[NR_STRUCTS];
+	int i;
+
+	/* Wraps around to a few bits before the start offset. */
+	large[0] = create_empty_decoder(1, -(uint64_t) 64);
+	large[1] = create_empty_decoder(1, 32);
+	ok(decoders_read_rejected((const struct ctf_decoder * const *) large,
+			2, 64),
+		"Structure length wrapping the end offset around is rejected");
+	ctf_decoder_destroy(large[0]);
+	ctf_decoder_destroy(large[1]);
+
+	/* Wraps around exactly to the start offset. */
+	large[0] = create_empty_decoder(1, 1ULL << 63);
+	large[1] = create_empty_decoder(1, 1ULL << 63);
+	ok(decoders_read_rejected((const struct ctf_decoder * const *) large,
+			2, 0),
+		"Structure lengths summing to 2^64 are rejected");
+	ctf_decoder_destroy(large[0]);
+	ctf_decoder_destroy(large[1]);
+
+	/* Each structure fits in the packet, not all of them. */
+	large[0] = create_empty_decoder(1, 8);
+	large[1] = create_empty_decoder(1, pos.packet_size);
+	large[2] = create_empty_decoder(1, pos.packet_size);
+	ok(decoders_read_rejected((const struct ctf_decoder * const *) large,
+			NR_STRUCTS, 0),
+		"Structures larger than the packet together are rejected");
+
+	pos.offset = 0;
+	ok(!ctf_decoders_read(&pos,
+			(const struct ctf_decoder * const *) &large[1], 1)
+		&& pos.offset == pos.packet_size,
+		"Structure filling the whole packet is read");
+	for (i = 0; i < NR_STRUCTS; i++)
+		ctf_decoder_destroy(large[i]);
+}
+
+/*
+ * A sequence of 8-bit integers, after its 64-bit length field.
+ */
+static
+struct definition_struct *create_sequence_struct(void)
+{
+	struct declaration_struct *declaration;
+	struct declaration_integer *len_declaration, *elem_declaration;
+	struct declaration_sequence *sequence_declaration;
+	struct bt_definition *definition;
+
+	declaration = bt_struct_declaration_new(NULL, 1);
+	len_declaration = bt_integer_declaration_new(64, BYTE_ORDER, 0,
+		CHAR_BIT, 10, CTF_STRING_NONE, NULL);
+	elem_declaration = bt_integer_declaration_new(8, BYTE_ORDER, 1,
+		CHAR_BIT, 10, CTF_STRING_NONE, NULL);
+	sequence_declaration = bt_sequence_declaration_new("len",
+		&elem_declaration->p, declaration->scope);
+	bt_struct_declaration_add_field(declaration, "len",
+		&len_declaration->p);
+	bt_struct_declaration_add_field(declaration, "seq",
+		&sequence_declaration->p);
+	bt_declaration_unref(&sequence_declaration->p);
+	bt_declaration_unref(&elem_declaration->p);
+	bt_declaration_unref(&len_declaration->p);
+	definition = declaration->p.definition_new(&declaration->p, NULL,
+		g_quark_from_string("payload"), 0, "payload");
+	bt_declaration_unref(&declaration->p);
+	return container_of(definition, struct definition_struct, p);
+}
+
+static
+void test_sequence_length(void)
+{
+	struct definition_struct *s;
+	struct definition_integer *len;
+	struct definition_sequence *sequence;
+
+	s = create_sequence_struct();
+	len = get_field(s, 0);
+	sequence = container_of(g_ptr_array_index(s->fields, 1),
+		struct definition_sequence, p);
+
+	/*
+	 * The value buffer is only sized once the packet holds it. Sizing
+	 * it first would truncate this length to PACKET_LEN.
+	 */
+	len->value._unsigned = (1ULL << 32) + PACKET_LEN;
+	pos.offset = 0;
+	ok(ctf_sequence_read(&pos.parent, &sequence->p) == -EFAULT
+			&& sequence->values->len == 0,
+		"Sequence length past the packet is rejected before "
+		"sizing its values");
+
+	len->value._unsigned = PACKET_LEN;
+	pos.offset = 0;
+	ok(!ctf_sequence_read(&pos.parent, &sequence->p)
+			&& sequence->values->len == PACKET_LEN
+			&& pos.offset == PACKET_LEN * CHAR_BIT,
+		"Sequence filling the whole packet is read");
+	bt_definition_unref(&s->p);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned char *buf;
+	int i;
+
+	plan_tests(NR_TESTS);
+
+	memset(&pos, 0, sizeof(pos));
+	pos.fd = -1;
+	pos.base_mma = mmap_align(PACKET_LEN, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (pos.base_mma == MAP_FAILED) {
+		perror("# mmap_align");
+		skip(NR_TESTS, "No packet mapping");
+		return exit_status();
+	}
+	buf = mmap_align_addr(pos.base_mma);
+	for (i = 0; i < PACKET_LEN; i++)
+		buf[i] = i * 37 + 11;
+	pos.prot = PROT_READ;
+	pos.packet_size = pos.content_size = PACKET_LEN * CHAR_BIT;
+
+	for (i = 0; i < NR_STRUCTS; i++) {
+		structs[i] = create_struct(i);
+		ref_structs[i] = create_struct(i);
+		decoders[i] = ctf_decoder_create(structs[i]);
+		ref_decoders[i] = ctf_decoder_create(ref_structs[i]);
+		if (!decoders[i] || !ref_decoders[i]) {
+			diag("Unable to compile structure %d", i);
+			skip(NR_TESTS, "No decoders");
+			return exit_status();
+		}
+	}
+
+	test_equivalence();
+	test_bounds();
+	test_overflow();
+	test_sequence_length();
+
+	for (i = 0; i < NR_STRUCTS; i++) {
+		ctf_decoder_destroy(decoders[i]);
+		ctf_decoder_destroy(ref_decoders[i]);
+		bt_definition_unref(&structs[i]->p);
+		bt_definition_unref(&ref_structs[i]->p);
+	}
+	munmap_align(pos.base_mma);
+
+	return exit_status();
+}
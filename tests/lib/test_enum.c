@@ -0,0 +1,402 @@
+/*
+ * test_enum.c
+ *
+ * Lib BabelTrace - Enumeration lookup test
+ *
+ * Checks that enumeration lookups through the dense table or interval
+ * index of a frozen enumeration return the quark sets of the hash table
+ * and range list lookup, for overlapping and negative ranges, and that
+ * definitions keep the sets read from an enumeration not frozen.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; under version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/* The enumeration index is private: test it in place. */
+#include "types/enum.c"
+
+#include <babeltrace/ctf/types.h>
+#include <babeltrace/endian.h>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include <tap/tap.h>
+
+#define NR_TESTS_PER_ENUM	3
+#define NR_ENUMS		4
+#define NR_TESTS		(NR_ENUMS * NR_TESTS_PER_ENUM + 6)
+
+struct mapping {
+	int64_t start;		/* Unsigned values are cast */
+	int64_t end;
+	const char *label;
+};
+
+/* Overlapping ranges and single values over a small domain. */
+static const struct mapping uint_small[] = {
+	{ 0, 0, "zero" },
+	{ 1, 10, "low" },
+	{ 5, 15, "mid" },
+	{ 5, 5, "five" },
+	{ 8, 8, "eight" },
+	{ 10, 3000, "wide" },
+	{ 15, 15, "fifteen" },
+};
+
+/* Overlapping ranges up to the maximum value. */
+static const struct mapping uint_large[] = {
+	{ 0, 1000, "low" },
+	{ 500, (int64_t) (1ULL << 40), "mid" },
+	{ 700, 700, "seven_hundred" },
+	{ (int64_t) (1ULL << 40), (int64_t) (1ULL << 40), "edge" },
+	{ (int64_t) (UINT64_MAX - 10), (int64_t) UINT64_MAX, "top" },
+	{ (int64_t) UINT64_MAX, (int64_t) UINT64_MAX, "max" },
+};
+
+/* Negative ranges crossing zero over a small domain. */
+static const struct mapping int_small[] = {
+	{ -10, -1, "negative" },
+	{ -5, 5, "around_zero" },
+	{ -1, -1, "minus_one" },
+	{ 0, 0, "zero" },
+	{ 3, 8, "positive" },
+	{ -3, -7, "reversed" },
+};
+
+/* Negative ranges down to the minimum value. */
+static const struct mapping int_large[] = {
+	{ INT64_MIN, -1000, "very_negative" },
+	{ INT64_MIN, INT64_MIN, "min" },
+	{ -2000, 2000, "around_zero" },
+	{ -1000, -1000, "minus_thousand" },
+	{ 1000, INT64_MAX, "very_positive" },
+	{ INT64_MAX, INT64_MAX, "max" },
+};
+
+struct enum_desc {
+	const char *name;
+	int signedness;
+	const struct mapping *mappings;
+	size_t nr_mappings;
+	int dense;
+};
+
+static const struct enum_desc enums[NR_ENUMS] = {
+	{ "unsigned, small domain", 0, uint_small,
+		sizeof(uint_small) / sizeof(uint_small[0]), 1 },
+	{ "unsigned, large domain", 0, uint_large,
+		sizeof(uint_large) / sizeof(uint_large[0]), 0 },
+	{ "signed, small domain", 1, int_small,
+		sizeof(int_small) / sizeof(int_small[0]), 1 },
+	{ "signed, large domain", 1, int_large,
+		sizeof(int_large) / sizeof(int_large[0]), 0 },
+};
+
+static
+struct declaration_enum *create_enum(const struct enum_desc *desc)
+{
+	struct declaration_integer *integer_declaration;
+	struct declaration_enum *enum_declaration;
+	size_t i;
+
+	integer_declaration = bt_integer_declaration_new(64, BYTE_ORDER,
+		desc->signedness, 1, 10, CTF_STRING_NONE, NULL);
+	enum_declaration = bt_enum_declaration_new(integer_declaration);
+	bt_declaration_unref(&integer_declaration->p);
+	for (i = 0; i < desc->nr_mappings; i++) {
+		const struct mapping *m = &desc->mappings[i];
+		GQuark q = g_quark_from_static_string(m->label);
+
+		if (desc->signedness)
+			bt_enum_signed_insert(enum_declaration, m->start,
+				m->end, q);
+		else
+			bt_enum_unsigned_insert(enum_declaration,
+				(uint64_t) m->start, (uint64_t) m->end, q);
+	}
+	return enum_declaration;
+}
+
+/*
+ * Values around each mapping boundary, and the extremes of the domain.
+ * Boundaries at the extremes wrap around to the other end.
+ */
+static
+GArray *create_probes(const struct enum_desc *desc)
+{
+	GArray *probes;
+	uint64_t v;
+	size_t i;
+
+	probes = g_array_new(FALSE, FALSE, sizeof(uint64_t));
+	for (i = 0; i < desc->nr_mappings; i++) {
+		const struct mapping *m = &desc->mappings[i];
+		int d;
+
+		for (d = -1; d <= 1; d++) {
+			v = (uint64_t) m->start + d;
+			g_array_append_val(probes, v);
+			v = (uint64_t) m->end + d;
+			g_array_append_val(probes, v);
+		}
+	}
+	v = 0;
+	g_array_append_val(probes, v);
+	v = INT64_MAX;
+	g_array_append_val(probes, v);
+	v = (uint64_t) INT64_MIN;
+	g_array_append_val(probes, v);
+	v = UINT64_MAX;
+	g_array_append_val(probes, v);
+	return probes;
+}
+
+static
+GArray *to_quark_set(const struct declaration_enum *enum_declaration,
+		uint64_t v)
+{
+	if (enum_declaration->integer_declaration->signedness)
+		return bt_enum_int_to_quark_set(enum_declaration, (int64_t) v);
+	else
+		return bt_enum_uint_to_quark_set(enum_declaration, v);
+}
+
+static
+GArray *lookup_quark_set(const struct declaration_enum *enum_declaration,
+		uint64_t v)
+{
+	if (enum_declaration->integer_declaration->signedness)
+		return bt_enum_int_lookup_quark_set(enum_declaration,
+			(int64_t) v);
+	else
+		return bt_enum_uint_lookup_quark_set(enum_declaration, v);
+}
+
+/*
+ * Reference quark sets, copied from the hash table and range list lookup
+ * of the enumeration before it is frozen. Unmapped values get NULL.
+ */
+static
+GPtrArray *create_ref_sets(const struct declaration_enum *enum_declaration,
+		const GArray *probes)
+{
+	GPtrArray *ref_sets;
+	size_t i;
+
+	ref_sets = g_ptr_array_new();
+	for (i = 0; i < probes->len; i++) {
+		GArray *qs, *copy = NULL;
+
+		qs = to_quark_set(enum_declaration,
+			g_array_index(probes, uint64_t, i));
+		if (qs) {
+			copy = g_array_new(FALSE, FALSE, sizeof(GQuark));
+			g_array_append_vals(copy, qs->data, qs->len);
+			g_array_unref(qs);
+		}
+		g_ptr_array_add(ref_sets, copy);
+	}
+	return ref_sets;
+}
+
+static
+void free_ref_sets(GPtrArray *ref_sets)
+{
+	size_t i;
+
+	for (i = 0; i < ref_sets->len; i++) {
+		if (g_ptr_array_index(ref_sets, i))
+			g_array_unref(g_ptr_array_index(ref_sets, i));
+	}
+	g_ptr_array_free(ref_sets, TRUE);
+}
+
+static
+int quark_set_equal(const GArray *a, const GArray *b)
+{
+	if (!a || !b)
+		return a == b;
+	return a->len == b->len
+		&& !memcmp(a->data, b->data, a->len * sizeof(GQuark));
+}
+
+/*
+ * Check that no lookup of a probe borrows a quark set: the enumeration is
+ * not frozen.
+ */
+static
+int lookups_empty(const struct declaration_enum *enum_declaration,
+		const GArray *probes)
+{
+	size_t i;
+
+	for (i = 0; i < probes->len; i++) {
+		uint64_t v = g_array_index(probes, uint64_t, i);
+
+		if (lookup_quark_set(enum_declaration, v)) {
+			diag("Value %" PRIu64 " (%" PRId64 "): set returned",
+				v, (int64_t) v);
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/*
+ * Check the lookups of each probe against the reference quark sets, in
+ * the same order. Report the first mismatch.
+ */
+static
+int lookups_match(const struct declaration_enum *enum_declaration,
+		const GArray *probes, const GPtrArray *ref_sets)
+{
+	size_t i;
+
+	for (i = 0; i < probes->len; i++) {
+		uint64_t v = g_array_index(probes, uint64_t, i);
+		const GArray *ref = g_ptr_array_index(ref_sets, i);
+		const GArray *qs = lookup_quark_set(enum_declaration, v);
+
+		if (!quark_set_equal(qs, ref)) {
+			diag("Value %" PRIu64 " (%" PRId64 "): %u quarks instead of %u",
+				v, (int64_t) v, qs ? qs->len : 0,
+				ref ? ref->len : 0);
+			return 0;
+		}
+	}
+	return 1;
+}
+
+static
+void check_enum(const struct enum_desc *desc)
+{
+	struct declaration_enum *enum_declaration;
+	const struct enum_index *index;
+	GPtrArray *ref_sets;
+	GArray *probes;
+
+	enum_declaration = create_enum(desc);
+	probes = create_probes(desc);
+	ref_sets = create_ref_sets(enum_declaration, probes);
+
+	ok(lookups_empty(enum_declaration, probes),
+		"%s: lookups before freezing return no set", desc->name);
+
+	bt_enum_declaration_freeze(enum_declaration);
+	index = enum_declaration->table.index;
+	ok(index && !!index->dense == desc->dense,
+		"%s: frozen into %s", desc->name,
+		desc->dense ? "a dense table" : "an interval index");
+	ok(lookups_match(enum_declaration, probes, ref_sets),
+		"%s: lookups through the index match the range lookup",
+		desc->name);
+
+	free_ref_sets(ref_sets);
+	g_array_free(probes, TRUE);
+	bt_declaration_unref(&enum_declaration->p);
+}
+
+static
+void check_unfrozen(void)
+{
+	struct declaration_enum *enum_declaration;
+	GArray *qs;
+
+	enum_declaration = create_enum(&enums[0]);
+
+	/* Callers own the sets of an enumeration not frozen. */
+	qs = bt_enum_uint_to_quark_set(enum_declaration, 12);
+	ok(qs && qs->len == 2
+		&& !bt_enum_uint_lookup_quark_set(enum_declaration, 12),
+		"Unfrozen enumeration does not lend quark sets");
+	if (qs)
+		g_array_unref(qs);
+
+	/* Inserting a mapping drops the index. */
+	bt_enum_declaration_freeze(enum_declaration);
+	bt_enum_unsigned_insert(enum_declaration, 12, 12,
+		g_quark_from_static_string("twelve"));
+	qs = bt_enum_uint_to_quark_set(enum_declaration, 12);
+	ok(!enum_declaration->table.index && qs && qs->len == 3
+		&& g_array_index(qs, GQuark, 0)
+			== g_quark_from_static_string("twelve"),
+		"Lookup after an insertion sees the new mapping");
+	if (qs)
+		g_array_unref(qs);
+
+	bt_enum_declaration_freeze(enum_declaration);
+	qs = bt_enum_uint_lookup_quark_set(enum_declaration, 12);
+	ok(enum_declaration->table.index && qs && qs->len == 3,
+		"Lookup after freezing again uses the new index");
+
+	bt_declaration_unref(&enum_declaration->p);
+}
+
+/*
+ * The quark set of a definition read from an enumeration not frozen must
+ * outlive insertions in that enumeration.
+ */
+static
+void check_definition(void)
+{
+	struct declaration_enum *enum_declaration;
+	struct definition_scope *scope;
+	struct bt_definition *definition;
+	struct definition_enum *enum_definition;
+	GArray *qs;
+
+	enum_declaration = create_enum(&enums[0]);
+	scope = bt_new_definition_scope(NULL, 0, "test");
+	definition = enum_declaration->p.definition_new(&enum_declaration->p,
+		scope, g_quark_from_static_string("e"), 0, NULL);
+	enum_definition = container_of(definition, struct definition_enum, p);
+
+	enum_definition->integer->value._unsigned = 12;
+	ctf_enum_update_quark_set(enum_definition);
+	qs = enum_definition->value;
+	bt_enum_unsigned_insert(enum_declaration, 12, 12,
+		g_quark_from_static_string("twelve"));
+	ok(enum_definition->value_owned && qs->len == 2
+		&& g_array_index(qs, GQuark, 0)
+			!= g_quark_from_static_string("twelve"),
+		"Set read before an insertion is kept by the definition");
+
+	ctf_enum_update_quark_set(enum_definition);
+	ok(enum_definition->value_owned && enum_definition->value->len == 3,
+		"Set read after the insertion sees the new mapping");
+
+	bt_enum_declaration_freeze(enum_declaration);
+	ctf_enum_update_quark_set(enum_definition);
+	ok(!enum_definition->value_owned && enum_definition->value
+			== bt_enum_uint_lookup_quark_set(enum_declaration, 12),
+		"Set read once frozen is borrowed from the index");
+
+	bt_definition_unref(definition);
+	bt_free_definition_scope(scope);
+	bt_declaration_unref(&enum_declaration->p);
+}
+
+int main(int argc, char **argv)
+{
+	int i;
+
+	plan_tests(NR_TESTS);
+
+	for (i = 0; i < NR_ENUMS; i++)
+		check_enum(&enums[i]);
+	check_unfrozen();
+	check_definition();
+
+	return exit_status();
+}
@@ -0,0 +1,458 @@
+/*
+ * test_field_handle.c
+ *
+ * Lib BabelTrace - Field handle test
+ *
+ * Writes a trace of two event classes, then checks that fields fetched
+ * through handles match bt_ctf_get_field(): underscore prefixed names,
+ * variant selection, event scope handles used on another event class
+ * and stream scope handles shared by all event classes.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; under version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#define _GNU_SOURCE
+#include <babeltrace/context.h>
+#include <babeltrace/iterator.h>
+#include <babeltrace/ctf/iterator.h>
+#include <babeltrace/ctf/events.h>
+#include <babeltrace/ctf-writer/writer.h>
+#include <babeltrace/ctf-writer/clock.h>
+#include <babeltrace/ctf-writer/stream.h>
+#include <babeltrace/ctf-writer/event.h>
+#include <babeltrace/ctf-writer/event-types.h>
+#include <babeltrace/ctf-writer/event-fields.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <tap/tap.h>
+#include "common.h"
+
+#define NR_TESTS		8
+#define NR_EVENT_PAIRS		8
+
+#define SELECT_SMALL		0
+#define SELECT_LARGE		1
+
+static
+uint64_t first_value(int nr)
+{
+	return 1000 + nr;
+}
+
+static
+uint64_t second_value(int nr)
+{
+	return 2000 + nr;
+}
+
+static
+uint64_t small_choice(int nr)
+{
+	return nr * 3;
+}
+
+static
+int64_t large_choice(int nr)
+{
+	return -100000 * (int64_t) nr;
+}
+
+/*
+ * Write NR_EVENT_PAIRS pairs of events, alternating the two event
+ * classes:
+ * - "first": "_value", then a variant "choice" tagged by "selector",
+ *   selecting an unsigned 8-bit or a signed 32-bit integer;
+ * - "second": "value".
+ */
+static
+int write_trace(const char *trace_path)
+{
+	struct bt_ctf_writer *writer;
+	struct bt_ctf_clock *clock;
+	struct bt_ctf_stream_class *stream_class;
+	struct bt_ctf_event_class *first_class, *second_class;
+	struct bt_ctf_field_type *uint_32_type, *uint_8_type, *int_32_type,
+		*selector_type, *choice_type;
+	struct bt_ctf_stream *stream = NULL;
+	uint64_t time = 1000;
+	int nr, ret = -1;
+
+	writer = bt_ctf_writer_create(trace_path);
+	if (!writer)
+		return -1;
+	clock = bt_ctf_clock_create("test_clock");
+	stream_class = bt_ctf_stream_class_create("test_stream");
+	first_class = bt_ctf_event_class_create("first");
+	second_class = bt_ctf_event_class_create("second");
+	uint_32_type = bt_ctf_field_type_integer_create(32);
+	uint_8_type = bt_ctf_field_type_integer_create(8);
+	int_32_type = bt_ctf_field_type_integer_create(32);
+	selector_type = bt_ctf_field_type_enumeration_create(uint_8_type);
+	if (!clock || !stream_class || !first_class || !second_class
+			|| !uint_32_type || !uint_8_type || !int_32_type
+			|| !selector_type)
+		goto end_types;
+	bt_ctf_field_type_integer_set_signed(int_32_type, 1);
+	bt_ctf_field_type_enumeration_add_mapping(selector_type, "SMALL",
+		SELECT_SMALL, SELECT_SMALL);
+	bt_ctf_field_type_enumeration_add_mapping(selector_type, "LARGE",
+		SELECT_LARGE, SELECT_LARGE);
+	choice_type = bt_ctf_field_type_variant_create(selector_type,
+		"selector");
+	if (!choice_type)
+		goto end_types;
+	if (bt_ctf_field_type_variant_add_field(choice_type, uint_8_type,
+				"SMALL")
+			|| bt_ctf_field_type_variant_add_field(choice_type,
+				int_32_type, "LARGE")
+			|| bt_ctf_event_class_add_field(first_class, uint_32_type,
+				"_value")
+			|| bt_ctf_event_class_add_field(first_class,
+				selector_type, "selector")
+			|| bt_ctf_event_class_add_field(first_class, choice_type,
+				"choice")
+			|| bt_ctf_event_class_add_field(second_class,
+				uint_32_type, "value")
+			|| bt_ctf_writer_add_clock(writer, clock)
+			|| bt_ctf_stream_class_set_clock(stream_class, clock)
+			|| bt_ctf_stream_class_add_event_class(stream_class,
+				first_class)
+			|| bt_ctf_stream_class_add_event_class(stream_class,
+				second_class))
+		goto end;
+	stream = bt_ctf_writer_create_stream(writer, stream_class);
+	if (!stream)
+		goto end;
+
+	for (nr = 0; nr < NR_EVENT_PAIRS; nr++) {
+		struct bt_ctf_event *event;
+		struct bt_ctf_field *field, *selector, *container, *choice,
+			*selected;
+		int select = nr & 1 ? SELECT_LARGE : SELECT_SMALL;
+
+		event = bt_ctf_event_create(first_class);
+		field = bt_ctf_event_get_payload(event, "_value");
+		bt_ctf_field_unsigned_integer_set_value(field, first_value(nr));
+		bt_ctf_field_put(field);
+		selector = bt_ctf_event_get_payload(event, "selector");
+		container = bt_ctf_field_enumeration_get_container(selector);
+		bt_ctf_field_unsigned_integer_set_value(container, select);
+		choice = bt_ctf_event_get_payload(event, "choice");
+		selected = bt_ctf_field_variant_get_field(choice, selector);
+		if (select == SELECT_LARGE)
+			bt_ctf_field_signed_integer_set_value(selected,
+				large_choice(nr));
+		else
+			bt_ctf_field_unsigned_integer_set_value(selected,
+				small_choice(nr));
+		bt_ctf_field_put(selected);
+		bt_ctf_field_put(choice);
+		bt_ctf_field_put(container);
+		bt_ctf_field_put(selector);
+		bt_ctf_clock_set_time(clock, time++);
+		ret = bt_ctf_stream_append_event(stream, event);
+		bt_ctf_event_put(event);
+		if (ret)
+			goto end;
+
+		event = bt_ctf_event_create(second_class);
+		field = bt_ctf_event_get_payload(event, "value");
+		bt_ctf_field_unsigned_integer_set_value(field, second_value(nr));
+		bt_ctf_field_put(field);
+		bt_ctf_clock_set_time(clock, time++);
+		ret = bt_ctf_stream_append_event(stream, event);
+		bt_ctf_event_put(event);
+		if (ret)
+			goto end;
+	}
+	ret = bt_ctf_stream_flush(stream);
+	if (ret)
+		goto end;
+	bt_ctf_writer_flush_metadata(writer);
+
+end:
+	bt_ctf_stream_put(stream);
+	bt_ctf_field_type_put(choice_type);
+end_types:
+	bt_ctf_field_type_put(selector_type);
+	bt_ctf_field_type_put(int_32_type);
+	bt_ctf_field_type_put(uint_8_type);
+	bt_ctf_field_type_put(uint_32_type);
+	bt_ctf_event_class_put(second_class);
+	bt_ctf_event_class_put(first_class);
+	bt_ctf_stream_class_put(stream_class);
+	bt_ctf_clock_put(clock);
+	bt_ctf_writer_put(writer);
+	return ret;
+}
+
+enum handle_id {
+	HANDLE_FIRST_VALUE,		/* "value" resolved as "_value" */
+	HANDLE_FIRST_VALUE_UNDERSCORE,	/* "_value" */
+	HANDLE_FIRST_CHOICE,
+	HANDLE_SECOND_VALUE,
+	HANDLE_HEADER_TIMESTAMP,	/* Resolved on a "second" event */
+	HANDLE_PACKET_TIMESTAMP_BEGIN,	/* Resolved on a "first" event */
+	NR_HANDLES,
+};
+
+struct handle_results {
+	int nr_checked;
+	int underscore_ok;
+	int variant_ok;
+	int other_class_null;
+	int stream_scope_ok;
+	int values_ok;
+};
+
+/*
+ * Fetch the field of handle from event and check it is the same
+ * definition bt_ctf_get_field() returns for name.
+ */
+static
+const struct bt_definition *field_from_handle(const struct bt_ctf_event *event,
+		const struct bt_ctf_field_handle *handle, enum bt_ctf_scope scope,
+		const char *name, int *ok_flag)
+{
+	const struct bt_definition *def, *ref;
+
+	def = bt_ctf_get_field_from_handle(event, handle);
+	ref = bt_ctf_get_field(event, bt_ctf_get_top_level_scope(event, scope),
+		name);
+	if (!def || def != ref) {
+		diag("Event %s, field %s: %p instead of %p",
+			bt_ctf_event_name(event), name, def, ref);
+		*ok_flag = 0;
+	}
+	return def;
+}
+
+static
+void check_first_event(const struct bt_ctf_event *event, int nr,
+		struct bt_ctf_field_handle **handles,
+		struct handle_results *results)
+{
+	const struct bt_definition *def;
+	const struct bt_declaration *decl;
+
+	def = field_from_handle(event, handles[HANDLE_FIRST_VALUE],
+		BT_EVENT_FIELDS, "value", &results->underscore_ok);
+	if (def != bt_ctf_get_field_from_handle(event,
+			handles[HANDLE_FIRST_VALUE_UNDERSCORE]))
+		results->underscore_ok = 0;
+	if (def && bt_ctf_get_uint64(def) != first_value(nr))
+		results->values_ok = 0;
+
+	def = field_from_handle(event, handles[HANDLE_FIRST_CHOICE],
+		BT_EVENT_FIELDS, "choice", &results->variant_ok);
+	if (def) {
+		decl = bt_ctf_get_decl_from_def(def);
+		if (bt_ctf_field_type(decl) != CTF_TYPE_INTEGER) {
+			results->variant_ok = 0;
+		} else if (nr & 1) {
+			if (!bt_ctf_get_int_signedness(decl)
+					|| bt_ctf_get_int64(def) != large_choice(nr))
+				results->variant_ok = 0;
+		} else {
+			if (bt_ctf_get_int_signedness(decl)
+					|| bt_ctf_get_uint64(def) != small_choice(nr))
+				results->variant_ok = 0;
+		}
+	}
+
+	if (bt_ctf_get_field_from_handle(event, handles[HANDLE_SECOND_VALUE]))
+		results->other_class_null = 0;
+}
+
+static
+void check_second_event(const struct bt_ctf_event *event, int nr,
+		struct bt_ctf_field_handle **handles,
+		struct handle_results *results)
+{
+	const struct bt_definition *def;
+
+	def = field_from_handle(event, handles[HANDLE_SECOND_VALUE],
+		BT_EVENT_FIELDS, "value", &results->values_ok);
+	if (def && bt_ctf_get_uint64(def) != second_value(nr))
+		results->values_ok = 0;
+
+	/* Same field name and position, in another event class. */
+	if (bt_ctf_get_field_from_handle(event, handles[HANDLE_FIRST_VALUE])
+			|| bt_ctf_get_field_from_handle(event,
+				handles[HANDLE_FIRST_VALUE_UNDERSCORE])
+			|| bt_ctf_get_field_from_handle(event,
+				handles[HANDLE_FIRST_CHOICE]))
+		results->other_class_null = 0;
+}
+
+/*
+ * Resolve the handles on the first events of each class, then fetch the
+ * fields of all events through them.
+ */
+static
+int check_handles(const char *trace_path, struct handle_results *results)
+{
+	struct bt_ctf_field_handle *handles[NR_HANDLES] = { NULL };
+	struct bt_context *ctx;
+	struct bt_ctf_iter *iter;
+	struct bt_ctf_event *event;
+	int nr_first = 0, nr_second = 0, i, ret = -1;
+
+	memset(results, 0, sizeof(*results));
+	results->underscore_ok = results->variant_ok = 1;
+	results->other_class_null = results->stream_scope_ok = 1;
+	results->values_ok = 1;
+
+	ctx = create_context_with_path(trace_path);
+	if (!ctx)
+		return -1;
+	iter = bt_ctf_iter_create(ctx, NULL, NULL);
+	if (!iter)
+		goto end_iter;
+
+	while ((event = bt_ctf_iter_read_event(iter))) {
+		const char *name = bt_ctf_event_name(event);
+		int first = name && !strcmp(name, "first");
+		int nr = first ? nr_first++ : nr_second++;
+
+		if (first && !handles[HANDLE_FIRST_VALUE]) {
+			handles[HANDLE_FIRST_VALUE] = bt_ctf_field_handle_create(
+				event, BT_EVENT_FIELDS, "value");
+			handles[HANDLE_FIRST_VALUE_UNDERSCORE] =
+				bt_ctf_field_handle_create(event,
+					BT_EVENT_FIELDS, "_value");
+			handles[HANDLE_FIRST_CHOICE] = bt_ctf_field_handle_create(
+				event, BT_EVENT_FIELDS, "choice");
+			handles[HANDLE_PACKET_TIMESTAMP_BEGIN] =
+				bt_ctf_field_handle_create(event,
+					BT_STREAM_PACKET_CONTEXT,
+					"timestamp_begin");
+		} else if (!first && !handles[HANDLE_SECOND_VALUE]) {
+			handles[HANDLE_SECOND_VALUE] = bt_ctf_field_handle_create(
+				event, BT_EVENT_FIELDS, "value");
+			handles[HANDLE_HEADER_TIMESTAMP] =
+				bt_ctf_field_handle_create(event,
+					BT_STREAM_EVENT_HEADER, "timestamp");
+		}
+		for (i = 0; i < NR_HANDLES; i++) {
+			if (!handles[i])
+				break;
+		}
+		/* All handles are resolved once the first pair is read. */
+		if (i == NR_HANDLES) {
+			if (first)
+				check_first_event(event, nr, handles, results);
+			else
+				check_second_event(event, nr, handles, results);
+			results->nr_checked++;
+			field_from_handle(event,
+				handles[HANDLE_HEADER_TIMESTAMP],
+				BT_STREAM_EVENT_HEADER, "timestamp",
+				&results->stream_scope_ok);
+			field_from_handle(event,
+				handles[HANDLE_PACKET_TIMESTAMP_BEGIN],
+				BT_STREAM_PACKET_CONTEXT, "timestamp_begin",
+				&results->stream_scope_ok);
+		} else if (nr_second) {
+			/* No event is checked. */
+			diag("Unable to resolve field handle %d", i);
+			break;
+		}
+		if (bt_iter_next(bt_ctf_get_iter(iter)) < 0)
+			goto end;
+	}
+	ret = 0;
+end:
+	for (i = 0; i < NR_HANDLES; i++)
+		bt_ctf_field_handle_destroy(handles[i]);
+	bt_ctf_iter_destroy(iter);
+end_iter:
+	bt_context_put(ctx);
+	return ret;
+}
+
+static
+void check_invalid_handles(const char *trace_path)
+{
+	struct bt_ctf_field_handle *handle;
+	struct bt_context *ctx;
+	struct bt_ctf_iter *iter;
+	struct bt_ctf_event *event;
+
+	ctx = create_context_with_path(trace_path);
+	iter = ctx ? bt_ctf_iter_create(ctx, NULL, NULL) : NULL;
+	event = iter ? bt_ctf_iter_read_event(iter) : NULL;
+	if (!event) {
+		skip(2, "Unable to read generated trace");
+		goto end;
+	}
+	handle = bt_ctf_field_handle_create(event, BT_EVENT_FIELDS,
+		"no_such_field");
+	ok(!handle && !bt_ctf_field_handle_create(event, BT_EVENT_FIELDS,
+			NULL)
+		&& !bt_ctf_field_handle_create(NULL, BT_EVENT_FIELDS, "value"),
+		"No handle for a missing field");
+	bt_ctf_field_handle_destroy(handle);
+	ok(!bt_ctf_get_field_from_handle(event, NULL),
+		"No field from a NULL handle");
+end:
+	if (iter)
+		bt_ctf_iter_destroy(iter);
+	if (ctx)
+		bt_context_put(ctx);
+}
+
+int main(int argc, char **argv)
+{
+	char trace_path[] = "/tmp/test_field_handle_XXXXXX";
+	struct handle_results results;
+
+	plan_tests(NR_TESTS);
+
+	if (!mkdtemp(trace_path)) {
+		perror("# mkdtemp");
+		skip(NR_TESTS, "No trace directory");
+		return exit_status();
+	}
+	if (write_trace(trace_path)) {
+		diag("Unable to write trace %s", trace_path);
+		skip(NR_TESTS, "No trace written");
+		goto end;
+	}
+
+	if (check_handles(trace_path, &results)) {
+		skip(NR_TESTS - 2, "Unable to read generated trace");
+	} else {
+		ok(results.nr_checked == 2 * NR_EVENT_PAIRS - 1,
+			"Fields of %d events fetched through handles",
+			results.nr_checked);
+		ok(results.values_ok, "Handles fetch the values written");
+		ok(results.underscore_ok,
+			"Handle falls back on the underscore prefixed field");
+		ok(results.variant_ok,
+			"Handle on a variant fetches the selected field");
+		ok(results.other_class_null,
+			"Event field handles return NULL for another event class");
+		ok(results.stream_scope_ok,
+			"Stream scope handles fetch the fields of all event classes");
+	}
+	check_invalid_handles(trace_path);
+end:
+	remove_trace(trace_path);
+
+	return exit_status();
+}
@@ -0,0 +1,401 @@
+/*
+ * test_index_cache.c
+ *
+ * Lib BabelTrace - Packet index cache test
+ *
+ * Writes the packet index cache of a trace, then alters the stream file
+ * and checks whether the cached index is used or rebuilt.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; under version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#define _GNU_SOURCE
+#include <babeltrace/context.h>
+#include <babeltrace/iterator.h>
+#include <babeltrace/ctf/iterator.h>
+#include <babeltrace/ctf/events.h>
+#include <babeltrace/ctf/ctf-index.h>
+#include <babeltrace/ctf-writer/writer.h>
+#include <babeltrace/ctf-writer/clock.h>
+#include <babeltrace/ctf-writer/stream.h>
+#include <babeltrace/ctf-writer/event.h>
+#include <babeltrace/ctf-writer/event-types.h>
+#include <babeltrace/ctf-writer/event-fields.h>
+#include <babeltrace/babeltrace-internal.h>
+#include <babeltrace/endian.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <limits.h>
+#include <sys/stat.h>
+
+#include <tap/tap.h>
+#include "common.h"
+
+#define NR_TESTS		9
+#define NR_PACKETS		4
+#define EVENTS_PER_PACKET	5
+
+#define STREAM_NAME		"test_stream_0"
+
+static char trace_path[] = "/tmp/test_index_cache_XXXXXX";
+static char stream_path[PATH_MAX], index_dir[PATH_MAX], index_path[PATH_MAX];
+
+/*
+ * Write a trace of NR_PACKETS packets of EVENTS_PER_PACKET events.
+ */
+static
+int write_trace(void)
+{
+	struct bt_ctf_writer *writer;
+	struct bt_ctf_clock *clock;
+	struct bt_ctf_stream_class *stream_class;
+	struct bt_ctf_event_class *event_class;
+	struct bt_ctf_field_type *uint_type;
+	struct bt_ctf_stream *stream = NULL;
+	uint64_t time = 1000;
+	int packet, nr, ret = -1;
+
+	writer = bt_ctf_writer_create(trace_path);
+	if (!writer)
+		return -1;
+	clock = bt_ctf_clock_create("test_clock");
+	stream_class = bt_ctf_stream_class_create("test_stream");
+	event_class = bt_ctf_event_class_create("test_event");
+	uint_type = bt_ctf_field_type_integer_create(32);
+	if (!clock || !stream_class || !event_class || !uint_type)
+		goto end;
+	if (bt_ctf_writer_add_clock(writer, clock)
+			|| bt_ctf_stream_class_set_clock(stream_class, clock)
+			|| bt_ctf_event_class_add_field(event_class, uint_type,
+				"value")
+			|| bt_ctf_stream_class_add_event_class(stream_class,
+				event_class))
+		goto end;
+	stream = bt_ctf_writer_create_stream(writer, stream_class);
+	if (!stream)
+		goto end;
+
+	for (packet = 0; packet < NR_PACKETS; packet++) {
+		for (nr = 0; nr < EVENTS_PER_PACKET; nr++) {
+			struct bt_ctf_event *event;
+			struct bt_ctf_field *field;
+
+			event = bt_ctf_event_create(event_class);
+			field = bt_ctf_field_create(uint_type);
+			bt_ctf_field_unsigned_integer_set_value(field, nr);
+			bt_ctf_event_set_payload(event, "value", field);
+			bt_ctf_clock_set_time(clock, time);
+			time += 100;
+			ret = bt_ctf_stream_append_event(stream, event);
+			bt_ctf_field_put(field);
+			bt_ctf_event_put(event);
+			if (ret)
+				goto end;
+		}
+		ret = bt_ctf_stream_flush(stream);
+		if (ret)
+			goto end;
+	}
+	bt_ctf_writer_flush_metadata(writer);
+	ret = 0;
+
+end:
+	bt_ctf_stream_put(stream);
+	bt_ctf_field_type_put(uint_type);
+	bt_ctf_event_class_put(event_class);
+	bt_ctf_stream_class_put(stream_class);
+	bt_ctf_clock_put(clock);
+	bt_ctf_writer_put(writer);
+	return ret;
+}
+
+/*
+ * Return the number of events read from the trace, or -1 if it cannot
+ * be opened.
+ */
+static
+int count_events(void)
+{
+	struct bt_context *ctx;
+	struct bt_ctf_iter *iter;
+	int nr_events = 0;
+
+	ctx = create_context_with_path(trace_path);
+	if (!ctx)
+		return -1;
+	iter = bt_ctf_iter_create(ctx, NULL, NULL);
+	if (!iter) {
+		bt_context_put(ctx);
+		return -1;
+	}
+	while (bt_ctf_iter_read_event(iter)) {
+		nr_events++;
+		if (bt_iter_next(bt_ctf_get_iter(iter)) < 0)
+			break;
+	}
+	bt_ctf_iter_destroy(iter);
+	bt_context_put(ctx);
+	return nr_events;
+}
+
+/*
+ * Read the header, the header extension and the last packet index entry
+ * of the index cache.
+ */
+static
+int read_index(struct ctf_packet_index_file_hdr *hdr,
+		struct ctf_packet_index_file_hdr_ext *ext,
+		struct ctf_packet_index *last)
+{
+	struct stat st;
+	FILE *fp;
+	int ret = -1;
+
+	fp = fopen(index_path, "r");
+	if (!fp)
+		return -1;
+	if (fstat(fileno(fp), &st)
+			|| fread(hdr, sizeof(*hdr), 1, fp) != 1
+			|| fread(ext, sizeof(*ext), 1, fp) != 1
+			|| be32toh(ext->magic) != CTF_INDEX_EXT_MAGIC
+			|| fseek(fp, st.st_size - sizeof(*last), SEEK_SET)
+			|| fread(last, sizeof(*last), 1, fp) != 1)
+		goto end;
+	ret = 0;
+end:
+	fclose(fp);
+	return ret;
+}
+
+/*
+ * Return the minor version of the index cache, or -1.
+ */
+static
+int read_index_minor(void)
+{
+	struct ctf_packet_index_file_hdr hdr;
+	FILE *fp;
+	int ret = -1;
+
+	fp = fopen(index_path, "r");
+	if (!fp)
+		return -1;
+	if (fread(&hdr, sizeof(hdr), 1, fp) == 1)
+		ret = be32toh(hdr.index_minor);
+	fclose(fp);
+	return ret;
+}
+
+/*
+ * Rewrite the index cache as an index 1.0 file, without header
+ * extension, as the tracer writes it.
+ */
+static
+int downgrade_index(void)
+{
+	struct ctf_packet_index_file_hdr *hdr;
+	struct stat st;
+	size_t skip_len;
+	char *buf;
+	FILE *fp;
+	int ret = -1;
+
+	if (stat(index_path, &st))
+		return -1;
+	buf = malloc(st.st_size);
+	if (!buf)
+		return -1;
+	fp = fopen(index_path, "r");
+	if (!fp)
+		goto end;
+	if (fread(buf, st.st_size, 1, fp) != 1) {
+		fclose(fp);
+		goto end;
+	}
+	fclose(fp);
+	hdr = (struct ctf_packet_index_file_hdr *) buf;
+	hdr->index_minor = htobe32(0);
+	skip_len = sizeof(*hdr) + sizeof(struct ctf_packet_index_file_hdr_ext);
+	fp = fopen(index_path, "w");
+	if (!fp)
+		goto end;
+	if (fwrite(buf, sizeof(*hdr), 1, fp) == 1
+			&& fwrite(buf + skip_len, st.st_size - skip_len, 1,
+				fp) == 1)
+		ret = 0;
+	if (fclose(fp))
+		ret = -1;
+end:
+	free(buf);
+	return ret;
+}
+
+/*
+ * Return the number of files in the index directory other than the
+ * index cache.
+ */
+static
+int count_other_index_files(void)
+{
+	DIR *dir;
+	struct dirent *entry;
+	int nr = 0;
+
+	dir = opendir(index_dir);
+	if (!dir)
+		return -1;
+	while ((entry = readdir(dir))) {
+		if (entry->d_name[0] != '.'
+				&& strcmp(entry->d_name, STREAM_NAME ".idx"))
+			nr++;
+	}
+	closedir(dir);
+	return nr;
+}
+
+/*
+ * Set the modification time of the stream file.
+ */
+static
+int set_stream_mtime(uint64_t sec, uint64_t nsec)
+{
+	struct timespec times[2];
+
+	times[0].tv_sec = 0;
+	times[0].tv_nsec = UTIME_OMIT;
+	times[1].tv_sec = sec;
+	times[1].tv_nsec = nsec;
+	return utimensat(AT_FDCWD, stream_path, times, 0);
+}
+
+static
+void run_index_cache_tests(void)
+{
+	struct ctf_packet_index_file_hdr hdr;
+	struct ctf_packet_index_file_hdr_ext ext;
+	struct ctf_packet_index last;
+	struct stat st;
+	uint64_t mtime_sec, mtime_nsec;
+	int nr_events;
+
+	/* Build the index from the stream data and save it. */
+	opt_write_index_cache = 1;
+	nr_events = count_events();
+	ok(nr_events == NR_PACKETS * EVENTS_PER_PACKET,
+		"Read %d events while writing the index cache", nr_events);
+	opt_write_index_cache = 0;
+
+	if (read_index(&hdr, &ext, &last) || stat(stream_path, &st)) {
+		diag("Unable to read index cache %s", index_path);
+		skip(NR_TESTS - 1, "No index cache");
+		return;
+	}
+	mtime_sec = be64toh(ext.stream_mtime_sec);
+	mtime_nsec = be64toh(ext.stream_mtime_nsec);
+	ok(be32toh(hdr.index_minor) >= CTF_INDEX_EXT_MINOR
+			&& be32toh(ext.version) == CTF_INDEX_EXT_VERSION
+			&& be32toh(ext.len) >= sizeof(ext)
+			&& be64toh(ext.stream_size) == (uint64_t) st.st_size
+			&& mtime_sec == (uint64_t) st.st_mtim.tv_sec
+			&& mtime_nsec == (uint64_t) st.st_mtim.tv_nsec,
+		"Index header extension records the stream size and mtime");
+	ok(count_other_index_files() == 0,
+		"No temporary index file is left");
+
+	/*
+	 * Drop the last packet from the index: while the index is used,
+	 * its events are not read.
+	 */
+	if (stat(index_path, &st)
+			|| truncate(index_path, st.st_size - sizeof(last))) {
+		skip(NR_TESTS - 2, "Unable to truncate index cache");
+		return;
+	}
+	nr_events = count_events();
+	ok(nr_events == (NR_PACKETS - 1) * EVENTS_PER_PACKET,
+		"Up to date index cache is used");
+
+	set_stream_mtime(mtime_sec + 1, mtime_nsec);
+	nr_events = count_events();
+	ok(nr_events == NR_PACKETS * EVENTS_PER_PACKET,
+		"Index is rebuilt when the stream mtime changes");
+
+	/* An older mtime is a change as well. */
+	set_stream_mtime(mtime_sec - 1, mtime_nsec);
+	nr_events = count_events();
+	ok(nr_events == NR_PACKETS * EVENTS_PER_PACKET,
+		"Index is rebuilt when the stream mtime goes back");
+
+	set_stream_mtime(mtime_sec, mtime_nsec);
+	nr_events = count_events();
+	ok(nr_events == (NR_PACKETS - 1) * EVENTS_PER_PACKET,
+		"Index cache is used again when the stream mtime matches");
+
+	/*
+	 * Drop the last packet from the stream, keeping its mtime: the
+	 * index is rebuilt from the remaining packets.
+	 */
+	if (truncate(stream_path, be64toh(last.offset))) {
+		skip(1, "Unable to truncate stream");
+		return;
+	}
+	set_stream_mtime(mtime_sec, mtime_nsec);
+	nr_events = count_events();
+	ok(nr_events == (NR_PACKETS - 1) * EVENTS_PER_PACKET,
+		"Index is rebuilt when the stream size changes");
+
+	/*
+	 * An up to date index 1.0 file is used as is: with the index cache
+	 * enabled, it is not rewritten.
+	 */
+	opt_write_index_cache = 1;
+	count_events();
+	if (downgrade_index()) {
+		opt_write_index_cache = 0;
+		skip(1, "Unable to rewrite index cache");
+		return;
+	}
+	nr_events = count_events();
+	opt_write_index_cache = 0;
+	ok(nr_events == (NR_PACKETS - 1) * EVENTS_PER_PACKET
+			&& read_index_minor() == 0,
+		"Index 1.0 file without header extension is used");
+}
+
+int main(int argc, char **argv)
+{
+	plan_tests(NR_TESTS);
+
+	if (!mkdtemp(trace_path)) {
+		perror("# mkdtemp");
+		skip(NR_TESTS, "No trace directory");
+		return exit_status();
+	}
+	snprintf(stream_path, PATH_MAX, "%s/" STREAM_NAME, trace_path);
+	snprintf(index_dir, PATH_MAX, "%s/index", trace_path);
+	snprintf(index_path, PATH_MAX, "%s/" STREAM_NAME ".idx", index_dir);
+
+	if (write_trace()) {
+		diag("Unable to write trace %s", trace_path);
+		skip(NR_TESTS, "No trace written");
+	} else {
+		run_index_cache_tests();
+	}
+	remove_trace(trace_path);
+
+	return exit_status();
+}
@@ -0,0 +1,424 @@
+/*
+ * test_lttng_live.c
+ *
+ * Lib BabelTrace - lttng-live request pipeline test program
+ *
+ * Runs the lttng-live packet request pipeline against a stand-in relay
+ * daemon answering on a socketpair. The relay daemon replies to each
+ * command in order, as the real one does, and checks that no packet
+ * is requested from a stream after its hang-up.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; under version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#define _GNU_SOURCE
+/* The pipeline internals are static: test them in place. */
+#include "formats/lttng-live/lttng-live-functions.c"
+
+#include <pthread.h>
+
+#include <tap/tap.h>
+
+#define NR_STREAMS		3
+#define NR_PACKETS		5	/* Per stream, before the hang-up */
+#define PACKET_LEN		4096
+#define NR_POOL_CONFIGS		3
+#define NR_TESTS_PER_CONFIG	9
+#define NR_RELAYS_TESTS		4
+#define NR_TESTS		(NR_POOL_CONFIGS * NR_TESTS_PER_CONFIG \
+					+ NR_RELAYS_TESTS)
+
+/*
+ * Stand-in relay daemon script:
+ * - stream 0 has a packet twice as large as the others;
+ * - stream 1 answers RETRY to its first index request, and asks for
+ *   new metadata with its third packet;
+ * - stream 2 answers EOF to the data request of its second packet;
+ * - all the streams hang up after NR_PACKETS packets.
+ */
+struct relay {
+	int fd;
+	int next_packet[NR_STREAMS];
+	int retried;
+	int metadata_pending;
+	unsigned int nr_packet_after_hup;
+	unsigned int nr_metadata;
+};
+
+static
+int relay_read(struct relay *relay, void *buf, size_t len)
+{
+	size_t offset = 0;
+	ssize_t ret;
+
+	while (offset < len) {
+		ret = read(relay->fd, (char *) buf + offset, len - offset);
+		if (ret <= 0)
+			return -1;
+		offset += ret;
+	}
+	return 0;
+}
+
+static
+void relay_write(struct relay *relay, const void *buf, size_t len)
+{
+	size_t offset = 0;
+	ssize_t ret;
+
+	while (offset < len) {
+		ret = write(relay->fd, (const char *) buf + offset,
+				len - offset);
+		if (ret <= 0)
+			return;
+		offset += ret;
+	}
+}
+
+static
+void relay_get_next_index(struct relay *relay)
+{
+	struct lttng_viewer_get_next_index rq;
+	struct lttng_viewer_index rp;
+	uint64_t stream_id;
+	int nr;
+
+	if (relay_read(relay, &rq, sizeof(rq)))
+		return;
+	stream_id = be64toh(rq.stream_id);
+	memset(&rp, 0, sizeof(rp));
+	if (stream_id == 1 && !relay->retried) {
+		relay->retried = 1;
+		rp.status = htobe32(LTTNG_VIEWER_INDEX_RETRY);
+	} else if (relay->next_packet[stream_id] >= NR_PACKETS) {
+		rp.status = htobe32(relay->next_packet[stream_id] == NR_PACKETS ?
+				LTTNG_VIEWER_INDEX_HUP : LTTNG_VIEWER_INDEX_ERR);
+		relay->next_packet[stream_id]++;
+	} else {
+		nr = relay->next_packet[stream_id]++;
+		rp.status = htobe32(LTTNG_VIEWER_INDEX_OK);
+		rp.offset = htobe64(nr * PACKET_LEN);
+		rp.packet_size = htobe64((stream_id == 0 && nr == 3 ?
+				2 * PACKET_LEN : PACKET_LEN) * CHAR_BIT);
+		rp.content_size = rp.packet_size;
+		rp.timestamp_begin = htobe64(nr);
+		if (stream_id == 1 && nr == 2) {
+			rp.flags = htobe32(LTTNG_VIEWER_FLAG_NEW_METADATA);
+			relay->metadata_pending = 1;
+		}
+	}
+	relay_write(relay, &rp, sizeof(rp));
+}
+
+static
+void relay_get_packet(struct relay *relay)
+{
+	static char zero[2 * PACKET_LEN];
+	struct lttng_viewer_get_packet rq;
+	struct lttng_viewer_trace_packet rp;
+	uint64_t stream_id, offset, header[2];
+	uint32_t len;
+
+	if (relay_read(relay, &rq, sizeof(rq)))
+		return;
+	stream_id = be64toh(rq.stream_id);
+	offset = be64toh(rq.offset);
+	len = be32toh(rq.len);
+	memset(&rp, 0, sizeof(rp));
+	if (relay->metadata_pending && stream_id == 1) {
+		/* The client requests the packet again after the metadata. */
+		rp.status = htobe32(LTTNG_VIEWER_GET_PACKET_ERR);
+		rp.flags = htobe32(LTTNG_VIEWER_FLAG_NEW_METADATA);
+		relay_write(relay, &rp, sizeof(rp));
+		return;
+	}
+	if (relay->next_packet[stream_id] > NR_PACKETS) {
+		relay->nr_packet_after_hup++;
+		rp.status = htobe32(LTTNG_VIEWER_GET_PACKET_ERR);
+		relay_write(relay, &rp, sizeof(rp));
+		return;
+	}
+	if (stream_id == 2 && offset == PACKET_LEN) {
+		rp.status = htobe32(LTTNG_VIEWER_GET_PACKET_EOF);
+		relay_write(relay, &rp, sizeof(rp));
+		return;
+	}
+	rp.status = htobe32(LTTNG_VIEWER_GET_PACKET_OK);
+	rp.len = htobe32(len);
+	relay_write(relay, &rp, sizeof(rp));
+	/* Tag the packet data with its stream and offset. */
+	header[0] = stream_id;
+	header[1] = offset;
+	relay_write(relay, header, sizeof(header));
+	relay_write(relay, zero, len - sizeof(header));
+}
+
+static
+void relay_get_metadata(struct relay *relay)
+{
+	struct lttng_viewer_get_metadata rq;
+	struct lttng_viewer_metadata_packet rp;
+
+	if (relay_read(relay, &rq, sizeof(rq)))
+		return;
+	memset(&rp, 0, sizeof(rp));
+	if (relay->metadata_pending) {
+		relay->metadata_pending = 0;
+		relay->nr_metadata++;
+		rp.status = htobe32(LTTNG_VIEWER_METADATA_OK);
+		rp.len = htobe64(4);
+		relay_write(relay, &rp, sizeof(rp));
+		relay_write(relay, "meta", 4);
+	} else {
+		rp.status = htobe32(LTTNG_VIEWER_NO_NEW_METADATA);
+		relay_write(relay, &rp, sizeof(rp));
+	}
+}
+
+static
+void *relay_thread(void *arg)
+{
+	struct relay *relay = arg;
+	struct lttng_viewer_cmd cmd;
+
+	while (!relay_read(relay, &cmd, sizeof(cmd))) {
+		switch (be32toh(cmd.cmd)) {
+		case LTTNG_VIEWER_GET_NEXT_INDEX:
+			relay_get_next_index(relay);
+			break;
+		case LTTNG_VIEWER_GET_PACKET:
+			relay_get_packet(relay);
+			break;
+		case LTTNG_VIEWER_GET_METADATA:
+			relay_get_metadata(relay);
+			break;
+		default:
+			diag("Unexpected relay command %u", be32toh(cmd.cmd));
+			return NULL;
+		}
+	}
+	return NULL;
+}
+
+/*
+ * Viewer side of a relay connection: one session holding the data
+ * streams of the script and a metadata stream.
+ */
+struct viewer {
+	struct lttng_live_viewer_stream streams[NR_STREAMS + 1];
+	struct lttng_live_session session;
+	struct lttng_live_ctf_trace trace;
+	struct lttng_live_ctx ctx;
+	struct relay relay;
+	pthread_t thread;
+	int sv[2];
+};
+
+static
+int viewer_init(struct viewer *viewer, uint64_t pool_len,
+		uint64_t live_timer_interval)
+{
+	int i;
+
+	memset(viewer, 0, sizeof(*viewer));
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, viewer->sv))
+		return -1;
+	viewer->relay.fd = viewer->sv[1];
+	pthread_create(&viewer->thread, NULL, relay_thread, &viewer->relay);
+
+	viewer->ctx.control_sock = viewer->sv[0];
+	BT_INIT_LIST_HEAD(&viewer->ctx.inflight);
+	viewer->ctx.send_buf = g_byte_array_new();
+	viewer->ctx.sessions = g_ptr_array_new();
+	lttng_live_pool_init(&viewer->ctx.pool, pool_len);
+
+	viewer->session.ctx = &viewer->ctx;
+	viewer->session.active = 1;
+	viewer->session.live_timer_interval = live_timer_interval;
+	viewer->session.streams = viewer->streams;
+	viewer->session.stream_count = NR_STREAMS + 1;
+	g_ptr_array_add(viewer->ctx.sessions, &viewer->session);
+
+	viewer->trace.metadata_stream = &viewer->streams[NR_STREAMS];
+	for (i = 0; i <= NR_STREAMS; i++) {
+		viewer->streams[i].id = i;
+		viewer->streams[i].session = &viewer->session;
+		viewer->streams[i].ctf_trace = &viewer->trace;
+		BT_INIT_LIST_HEAD(&viewer->streams[i].packets);
+	}
+	viewer->streams[NR_STREAMS].metadata_flag = 1;
+	viewer->streams[NR_STREAMS].fd = open("/dev/null", O_WRONLY);
+	return 0;
+}
+
+static
+void viewer_fini(struct viewer *viewer)
+{
+	lttng_live_pool_fini(&viewer->ctx.pool);
+	close(viewer->streams[NR_STREAMS].fd);
+	close(viewer->sv[0]);
+	pthread_join(viewer->thread, NULL);
+	close(viewer->sv[1]);
+	g_ptr_array_free(viewer->ctx.sessions, TRUE);
+	g_byte_array_free(viewer->ctx.send_buf, TRUE);
+}
+
+/*
+ * Read all the packets of the streams in turn, as the iterator does,
+ * with a packet buffer pool bounded to pool_len bytes (0 for the
+ * default).
+ */
+static
+void run_relay_test(uint64_t pool_len)
+{
+	struct viewer viewer;
+	struct lttng_live_ctx *ctx = &viewer.ctx;
+	int i, round, nr_mismatches = 0, nr_errors = 0;
+	int nr_read[NR_STREAMS] = { 0 }, done[NR_STREAMS] = { 0 };
+
+	if (viewer_init(&viewer, pool_len, 1000)) {
+		skip(NR_TESTS_PER_CONFIG, "socketpair failed");
+		return;
+	}
+
+	for (round = 0; round <= NR_PACKETS; round++) {
+		for (i = 0; i < NR_STREAMS; i++) {
+			struct lttng_live_packet *packet;
+			uint64_t *data;
+
+			if (done[i])
+				continue;
+			packet = get_next_packet(ctx, &viewer.streams[i]);
+			if (!packet || packet->error) {
+				nr_errors++;
+				done[i] = 1;
+				continue;
+			}
+			if (packet->index.offset == EOF) {
+				done[i] = 1;
+			} else {
+				data = mmap_align_addr(packet->mma);
+				if (data[0] != i
+						|| data[1] != packet->index.offset
+						|| packet->mma->length <
+						packet->index.packet_size / CHAR_BIT)
+					nr_mismatches++;
+				nr_read[i]++;
+			}
+			free_packet(packet);
+		}
+	}
+
+	ok(nr_errors == 0, "Pool of %" PRIu64 " bytes: no failed request",
+		pool_len);
+	ok(nr_mismatches == 0, "Pool of %" PRIu64 " bytes: packets match "
+		"their stream and offset", pool_len);
+	ok(nr_read[0] == NR_PACKETS && nr_read[1] == NR_PACKETS,
+		"Pool of %" PRIu64 " bytes: all packets read up to the hang-up",
+		pool_len);
+	ok(nr_read[2] == NR_PACKETS - 1,
+		"Pool of %" PRIu64 " bytes: packet at EOF skipped", pool_len);
+	ok(viewer.relay.nr_packet_after_hup == 0,
+		"Pool of %" PRIu64 " bytes: no packet requested after hang-up",
+		pool_len);
+	ok(viewer.relay.nr_metadata == 1 && !viewer.relay.metadata_pending,
+		"Pool of %" PRIu64 " bytes: new metadata fetched once",
+		pool_len);
+
+	lttng_live_drain_packets(ctx);
+	ok(ctx->inflight_count == 0 && bt_list_empty(&ctx->inflight),
+		"Pool of %" PRIu64 " bytes: no request left after drain",
+		pool_len);
+	ok(ctx->pool.used_len == 0 && ctx->pool.deferred == 0,
+		"Pool of %" PRIu64 " bytes: all packet buffers released",
+		pool_len);
+	ok(!pool_len || ctx->pool.peak_len <= pool_len
+			|| ctx->pool.nr_deferred > 0,
+		"Pool of %" PRIu64 " bytes: prefetching waits for buffers",
+		pool_len);
+
+	viewer_fini(&viewer);
+}
+
+/*
+ * Follow two relay daemons. While the viewer waits on a stream of the
+ * first one, for which the relay daemon had no data, the replies of the
+ * second one are received.
+ */
+static
+void run_relays_test(void)
+{
+	struct viewer viewers[2];
+	struct lttng_live_packet *packet;
+	GPtrArray *relays;
+	uint64_t start;
+	int i;
+
+	/* A live timer long enough for the other relay to reply. */
+	if (viewer_init(&viewers[0], 0, 200000)) {
+		skip(NR_RELAYS_TESTS, "socketpair failed");
+		return;
+	}
+	if (viewer_init(&viewers[1], 0, 200000)) {
+		viewer_fini(&viewers[0]);
+		skip(NR_RELAYS_TESTS, "socketpair failed");
+		return;
+	}
+	relays = g_ptr_array_new();
+	for (i = 0; i < 2; i++) {
+		g_ptr_array_add(relays, &viewers[i].ctx);
+		viewers[i].ctx.relays = relays;
+	}
+
+	/* Request the first packet of the second relay. */
+	(void) new_packet(&viewers[1].ctx, &viewers[1].streams[0]);
+	ok(flush_requests(&viewers[1].ctx) == 0,
+		"Second relay: index requested");
+
+	/* Stream 1 of the first relay stalls on its first index. */
+	start = get_time_ns(CLOCK_MONOTONIC);
+	packet = get_next_packet(&viewers[0].ctx, &viewers[0].streams[1]);
+	ok(packet && !packet->error && packet->index.offset == 0,
+		"First relay: packet read after the stall");
+	ok(get_time_ns(CLOCK_MONOTONIC) - start >= 200000 * 1000ULL,
+		"First relay: stalled stream waited for the live timer");
+	if (packet)
+		free_packet(packet);
+
+	packet = bt_list_entry(viewers[1].streams[0].packets.next,
+			struct lttng_live_packet, node);
+	ok(packet->state == LTTNG_LIVE_PACKET_READY,
+		"Second relay: packet received during the wait");
+
+	for (i = 0; i < 2; i++) {
+		lttng_live_drain_packets(&viewers[i].ctx);
+		viewer_fini(&viewers[i]);
+	}
+	g_ptr_array_free(relays, TRUE);
+}
+
+int main(int argc, char **argv)
+{
+	/* Default, room for a few packets, a single packet. */
+	uint64_t pool_lens[NR_POOL_CONFIGS] = { 0, 4 * PACKET_LEN, PACKET_LEN };
+	int i;
+
+	plan_tests(NR_TESTS);
+
+	for (i = 0; i < NR_POOL_CONFIGS; i++)
+		run_relay_test(pool_lens[i]);
+	run_relays_test();
+
+	return exit_status();
+}
@@ -0,0 +1,459 @@
+/*
+ * test_pipeline.c
+ *
+ * Lib BabelTrace - Decoding pipeline test
+ *
+ * Reads traces inline and through the decoding pipeline, and checks that
+ * both give the same events, after the same seeks, with the same
+ * warnings at the same place.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; under version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#define _GNU_SOURCE
+#include <babeltrace/context.h>
+#include <babeltrace/iterator.h>
+#include <babeltrace/ctf/iterator.h>
+#include <babeltrace/ctf/events.h>
+#include <babeltrace/ctf-writer/writer.h>
+#include <babeltrace/ctf-writer/clock.h>
+#include <babeltrace/ctf-writer/stream.h>
+#include <babeltrace/ctf-writer/event.h>
+#include <babeltrace/ctf-writer/event-types.h>
+#include <babeltrace/ctf-writer/event-fields.h>
+#include <babeltrace/babeltrace-internal.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <glib.h>
+
+#include <tap/tap.h>
+#include "common.h"
+
+#define NR_SEEKS		8
+#define NR_EVENTS_AFTER_SEEK	10
+#define NR_TESTS_PER_DEPTH	3
+#define NR_TESTS_PER_TRACE	(NR_DEPTHS * NR_TESTS_PER_DEPTH + 1)
+
+#define GEN_NR_PACKETS		4
+#define GEN_EVENTS_PER_PACKET	6
+
+static const int depths[] = { 2, 3, 16 };
+
+#define NR_DEPTHS	(sizeof(depths) / sizeof(depths[0]))
+
+/*
+ * Standard error is redirected to a temporary file while reading, so
+ * that the warnings printed by the library can be placed among the
+ * events.
+ */
+static int err_fd = -1, saved_err_fd = -1;
+static off_t err_consumed;
+
+/*
+ * Most decoding threads seen while reading a trace: threads of the
+ * process while reading, less those left once the trace is closed.
+ */
+static int max_decoding_threads;
+
+static
+int capture_stderr(void)
+{
+	char path[] = "/tmp/test_pipeline_err_XXXXXX";
+
+	err_fd = mkstemp(path);
+	if (err_fd < 0)
+		return -1;
+	unlink(path);
+	err_consumed = 0;
+	fflush(stderr);
+	saved_err_fd = dup(STDERR_FILENO);
+	if (saved_err_fd < 0 || dup2(err_fd, STDERR_FILENO) < 0) {
+		close(err_fd);
+		return -1;
+	}
+	return 0;
+}
+
+static
+void collect_stderr(GString *dump)
+{
+	struct stat st;
+	char buf[4096];
+	ssize_t len;
+
+	fflush(stderr);
+	if (fstat(err_fd, &st))
+		return;
+	while (err_consumed < st.st_size) {
+		len = pread(err_fd, buf, sizeof(buf), err_consumed);
+		if (len <= 0)
+			break;
+		g_string_append(dump, "stderr: ");
+		g_string_append_len(dump, buf, len);
+		err_consumed += len;
+	}
+}
+
+static
+void release_stderr(void)
+{
+	fflush(stderr);
+	dup2(saved_err_fd, STDERR_FILENO);
+	close(saved_err_fd);
+	close(err_fd);
+}
+
+/*
+ * Dump up to max_events events (all of them if negative) from the
+ * current position of the iterator, along with the warnings printed
+ * while reading them.
+ */
+static
+void dump_events(GString *dump, struct bt_ctf_iter *iter, int max_events)
+{
+	struct bt_ctf_event *event;
+	int nr_events = 0;
+
+	while (max_events < 0 || nr_events < max_events) {
+		event = bt_ctf_iter_read_event(iter);
+		collect_stderr(dump);
+		if (!event) {
+			g_string_append(dump, "end\n");
+			return;
+		}
+		dump_event(dump, event);
+		nr_events++;
+		if (bt_iter_next(bt_ctf_get_iter(iter)) < 0) {
+			g_string_append(dump, "error\n");
+			return;
+		}
+	}
+}
+
+struct trace_dumps {
+	GString *read;		/* all the events */
+	GString *seek_time;	/* events following time seeks */
+	GString *seek_last;	/* last event, then going back to the start */
+};
+
+/*
+ * Return the number of threads of the process, or -1.
+ */
+static
+int count_threads(void)
+{
+	DIR *dir;
+	struct dirent *entry;
+	int nr = 0;
+
+	dir = opendir("/proc/self/task");
+	if (!dir)
+		return -1;
+	while ((entry = readdir(dir))) {
+		if (entry->d_name[0] != '.')
+			nr++;
+	}
+	closedir(dir);
+	return nr;
+}
+
+/*
+ * Read the trace at path with the given pipeline depth (0 for inline
+ * decoding). Time seeks spread over [begin, end].
+ */
+static
+int dump_trace(const char *path, int depth, uint64_t begin, uint64_t end,
+		struct trace_dumps *dumps)
+{
+	struct bt_context *ctx;
+	struct bt_ctf_iter *iter;
+	struct bt_iter_pos *pos;
+	struct bt_iter_pos last_pos;
+	uint64_t ts;
+	int nr_threads = 0, i, ret = -1;
+
+	opt_pipeline_depth = depth;
+	if (capture_stderr())
+		return -1;
+
+	dumps->read = g_string_new("");
+	dumps->seek_time = g_string_new("");
+	dumps->seek_last = g_string_new("");
+
+	ctx = create_context_with_path(path);
+	if (!ctx)
+		goto end_context;
+	iter = bt_ctf_iter_create(ctx, NULL, NULL);
+	if (!iter)
+		goto end_iter;
+
+	/* The first event of each stream has been read. */
+	nr_threads = count_threads();
+	dump_events(dumps->read, iter, -1);
+
+	for (i = 0; i <= NR_SEEKS + 1; i++) {
+		/* The last seek is past the end of the trace. */
+		ts = begin + (end - begin) / NR_SEEKS * i;
+		g_string_append_printf(dumps->seek_time, "seek %" PRIu64 "\n",
+			ts);
+		pos = bt_iter_create_time_pos(bt_ctf_get_iter(iter), ts);
+		if (bt_iter_set_pos(bt_ctf_get_iter(iter), pos)) {
+			g_string_append(dumps->seek_time, "seek error\n");
+		} else {
+			dump_events(dumps->seek_time, iter,
+				NR_EVENTS_AFTER_SEEK);
+		}
+		bt_iter_free_pos(pos);
+	}
+
+	last_pos.type = BT_SEEK_LAST;
+	if (bt_iter_set_pos(bt_ctf_get_iter(iter), &last_pos)) {
+		g_string_append(dumps->seek_last, "seek error\n");
+	} else {
+		dump_events(dumps->seek_last, iter, NR_EVENTS_AFTER_SEEK);
+	}
+	last_pos.type = BT_SEEK_BEGIN;
+	if (bt_iter_set_pos(bt_ctf_get_iter(iter), &last_pos)) {
+		g_string_append(dumps->seek_last, "seek error\n");
+	} else {
+		dump_events(dumps->seek_last, iter, NR_EVENTS_AFTER_SEEK);
+	}
+	ret = 0;
+
+	bt_ctf_iter_destroy(iter);
+end_iter:
+	bt_context_put(ctx);
+	nr_threads -= count_threads();
+	if (nr_threads > max_decoding_threads)
+		max_decoding_threads = nr_threads;
+end_context:
+	release_stderr();
+	return ret;
+}
+
+static
+void free_dumps(struct trace_dumps *dumps)
+{
+	g_string_free(dumps->read, TRUE);
+	g_string_free(dumps->seek_time, TRUE);
+	g_string_free(dumps->seek_last, TRUE);
+}
+
+/*
+ * Get the timestamps of the first and last events of a trace read
+ * inline.
+ */
+static
+int get_trace_bounds(const char *path, uint64_t *begin, uint64_t *end)
+{
+	struct bt_context *ctx;
+	struct bt_ctf_iter *iter;
+	struct bt_ctf_event *event;
+	int ret = -1;
+
+	opt_pipeline_depth = 0;
+	if (capture_stderr())
+		return -1;
+	ctx = create_context_with_path(path);
+	if (!ctx)
+		goto end_context;
+	iter = bt_ctf_iter_create(ctx, NULL, NULL);
+	if (!iter)
+		goto end;
+	event = bt_ctf_iter_read_event(iter);
+	if (!event)
+		goto end_iter;
+	*begin = *end = bt_ctf_get_timestamp(event);
+	while (bt_iter_next(bt_ctf_get_iter(iter)) == 0) {
+		event = bt_ctf_iter_read_event(iter);
+		if (!event)
+			break;
+		*end = bt_ctf_get_timestamp(event);
+	}
+	ret = 0;
+end_iter:
+	bt_ctf_iter_destroy(iter);
+end:
+	bt_context_put(ctx);
+end_context:
+	release_stderr();
+	return ret;
+}
+
+static
+void run_trace_tests(const char *path)
+{
+	struct trace_dumps inline_dumps, pipeline_dumps;
+	uint64_t begin, end;
+	long nr_cpus;
+	unsigned int i;
+
+	if (get_trace_bounds(path, &begin, &end)
+			|| dump_trace(path, 0, begin, end, &inline_dumps)) {
+		diag("Unable to read trace %s", path);
+		skip(NR_TESTS_PER_TRACE, "Trace cannot be read");
+		return;
+	}
+	max_decoding_threads = 0;
+	for (i = 0; i < NR_DEPTHS; i++) {
+		if (dump_trace(path, depths[i], begin, end, &pipeline_dumps)) {
+			fail("Read %s with pipeline depth %d", path, depths[i]);
+			skip(NR_TESTS_PER_DEPTH - 1, "Trace cannot be read");
+			continue;
+		}
+		ok(!strcmp(inline_dumps.read->str, pipeline_dumps.read->str),
+			"Read %s with pipeline depth %d", path, depths[i]);
+		ok(!strcmp(inline_dumps.seek_time->str,
+				pipeline_dumps.seek_time->str),
+			"Time seeks in %s with pipeline depth %d", path,
+			depths[i]);
+		ok(!strcmp(inline_dumps.seek_last->str,
+				pipeline_dumps.seek_last->str),
+			"Last event seek in %s with pipeline depth %d", path,
+			depths[i]);
+		free_dumps(&pipeline_dumps);
+	}
+	free_dumps(&inline_dumps);
+
+	/* At most one decoding worker per CPU. */
+	nr_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	ok(max_decoding_threads <= (nr_cpus > 0 ? nr_cpus : 1),
+		"Read %s with %d decoding threads for %ld CPUs", path,
+		max_decoding_threads, nr_cpus);
+}
+
+/*
+ * Write a trace whose stream has discarded events, in the middle and at
+ * the end of the stream: the end of stream warning must come after the
+ * last event of the stream, whichever way it is decoded.
+ */
+static
+int write_discarded_trace(const char *path)
+{
+	struct bt_ctf_writer *writer;
+	struct bt_ctf_clock *clock;
+	struct bt_ctf_stream_class *stream_class;
+	struct bt_ctf_event_class *event_class;
+	struct bt_ctf_field_type *uint_type;
+	struct bt_ctf_stream *stream = NULL;
+	uint64_t time = 1000;
+	int packet, nr, ret = -1;
+
+	writer = bt_ctf_writer_create(path);
+	if (!writer)
+		return -1;
+	clock = bt_ctf_clock_create("test_clock");
+	stream_class = bt_ctf_stream_class_create("test_stream");
+	event_class = bt_ctf_event_class_create("test_event");
+	uint_type = bt_ctf_field_type_integer_create(32);
+	if (!clock || !stream_class || !event_class || !uint_type)
+		goto end;
+	if (bt_ctf_writer_add_clock(writer, clock)
+			|| bt_ctf_stream_class_set_clock(stream_class, clock)
+			|| bt_ctf_event_class_add_field(event_class, uint_type,
+				"value")
+			|| bt_ctf_stream_class_add_event_class(stream_class,
+				event_class))
+		goto end;
+	stream = bt_ctf_writer_create_stream(writer, stream_class);
+	if (!stream)
+		goto end;
+
+	for (packet = 0; packet < GEN_NR_PACKETS; packet++) {
+		for (nr = 0; nr < GEN_EVENTS_PER_PACKET; nr++) {
+			struct bt_ctf_event *event;
+			struct bt_ctf_field *field;
+
+			event = bt_ctf_event_create(event_class);
+			field = bt_ctf_field_create(uint_type);
+			bt_ctf_field_unsigned_integer_set_value(field,
+				packet * GEN_EVENTS_PER_PACKET + nr);
+			bt_ctf_event_set_payload(event, "value", field);
+			bt_ctf_clock_set_time(clock, time);
+			time += 100;
+			ret = bt_ctf_stream_append_event(stream, event);
+			bt_ctf_field_put(field);
+			bt_ctf_event_put(event);
+			if (ret)
+				goto end;
+		}
+		/* Events are lost in the first and last packets. */
+		if (packet == 0 || packet == GEN_NR_PACKETS - 1)
+			bt_ctf_stream_append_discarded_events(stream,
+				packet + 1);
+		ret = bt_ctf_stream_flush(stream);
+		if (ret)
+			goto end;
+	}
+	bt_ctf_writer_flush_metadata(writer);
+	ret = 0;
+
+end:
+	bt_ctf_stream_put(stream);
+	bt_ctf_field_type_put(uint_type);
+	bt_ctf_event_class_put(event_class);
+	bt_ctf_stream_class_put(stream_class);
+	bt_ctf_clock_put(clock);
+	bt_ctf_writer_put(writer);
+	return ret;
+}
+
+/*
+ * The count reported at the end of the stream is taken from the last
+ * packet left and the one before it: 5 - 1 discarded events.
+ */
+static
+void check_discarded_events(const char *path)
+{
+	struct trace_dumps dumps;
+	uint64_t begin, end;
+
+	if (get_trace_bounds(path, &begin, &end)
+			|| dump_trace(path, 0, begin, end, &dumps)) {
+		fail("Discarded events reported when reading %s", path);
+		return;
+	}
+	ok(strstr(dumps.read->str, "discarded 4 events at end of stream")
+			!= NULL,
+		"Discarded events reported when reading %s", path);
+	free_dumps(&dumps);
+}
+
+int main(int argc, char **argv)
+{
+	char trace_path[] = "/tmp/test_pipeline_XXXXXX";
+	int i;
+
+	plan_tests(argc * NR_TESTS_PER_TRACE + 1);
+
+	if (!mkdtemp(trace_path) || write_discarded_trace(trace_path)) {
+		diag("Unable to write trace %s", trace_path);
+		skip(NR_TESTS_PER_TRACE + 1, "No trace written");
+	} else {
+		check_discarded_events(trace_path);
+		run_trace_tests(trace_path);
+	}
+	remove_trace(trace_path);
+
+	for (i = 1; i < argc; i++)
+		run_trace_tests(argv[i]);
+
+	return exit_status();
+}
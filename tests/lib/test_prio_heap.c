@@ -0,0 +1,267 @@
+/*
+ * test_prio_heap.c
+ *
+ * Lib BabelTrace - Priority heap test
+ *
+ * Runs random sequences of heap operations, checking each result
+ * against a reference: a plain array scanned for its smallest entry.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; under version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#define _GNU_SOURCE
+#include <babeltrace/prio_heap.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include <tap/tap.h>
+
+#define NR_TESTS	12
+#define NR_ENTRIES	300
+#define NR_OPS		20000
+
+struct entry {
+	uint64_t key;
+	unsigned int id;	/* breaks ties between equal keys */
+	int queued;
+};
+
+static struct entry entries[NR_ENTRIES];
+static uint64_t seed = 1;
+
+static
+unsigned int rand_below(unsigned int n)
+{
+	seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+	return (seed >> 33) % n;
+}
+
+static
+uint64_t entry_key(void *p)
+{
+	return ((struct entry *) p)->key;
+}
+
+static
+int entry_gt(void *a, void *b)
+{
+	return ((struct entry *) a)->id < ((struct entry *) b)->id;
+}
+
+/*
+ * Return the entry the heap should give: the smallest key, the smallest
+ * id among equal keys.
+ */
+static
+struct entry *ref_maximum(void)
+{
+	struct entry *max = NULL;
+	unsigned int i;
+
+	for (i = 0; i < NR_ENTRIES; i++) {
+		struct entry *e = &entries[i];
+
+		if (!e->queued)
+			continue;
+		if (!max || e->key < max->key
+				|| (e->key == max->key && e->id < max->id))
+			max = e;
+	}
+	return max;
+}
+
+static
+size_t ref_len(void)
+{
+	size_t len = 0;
+	unsigned int i;
+
+	for (i = 0; i < NR_ENTRIES; i++)
+		len += entries[i].queued;
+	return len;
+}
+
+/*
+ * Remove all the entries of a heap, checking they come out in the
+ * reference order. The reference is left untouched.
+ */
+static
+int drain_matches(struct ptr_heap *heap)
+{
+	int queued[NR_ENTRIES];
+	struct entry *e;
+	unsigned int i;
+	int ret = 1;
+
+	for (i = 0; i < NR_ENTRIES; i++)
+		queued[i] = entries[i].queued;
+	while ((e = bt_heap_remove(heap))) {
+		if (e != ref_maximum())
+			ret = 0;
+		e->queued = 0;
+	}
+	if (ref_len())
+		ret = 0;
+	for (i = 0; i < NR_ENTRIES; i++)
+		entries[i].queued = queued[i];
+	return ret;
+}
+
+static
+void test_empty(void)
+{
+	struct ptr_heap heap;
+	struct entry *e = &entries[0];
+
+	bt_heap_init(&heap, 0, entry_gt, entry_key);
+	ok(!bt_heap_maximum(&heap) && !bt_heap_remove(&heap),
+		"Empty heap has no maximum");
+	ok(!bt_heap_replace_max(&heap, e) && bt_heap_maximum(&heap) == e
+			&& heap.len == 1,
+		"bt_heap_replace_max on an empty heap inserts the element");
+	bt_heap_free(&heap);
+}
+
+static
+void test_random_ops(void)
+{
+	struct ptr_heap heap, copy;
+	unsigned int i, op;
+	int nr_inserts = 0, nr_removes = 0, nr_cherrypick_max = 0,
+		nr_cherrypick_other = 0, nr_replace_small = 0,
+		nr_replace_large = 0, nr_copies = 0;
+	int ok_insert = 1, ok_remove = 1, ok_cherrypick_max = 1,
+		ok_cherrypick_other = 1, ok_cherrypick_absent = 1,
+		ok_replace = 1, ok_copy = 1, ok_len = 1;
+
+	for (i = 0; i < NR_ENTRIES; i++) {
+		entries[i].id = i;
+		entries[i].queued = 0;
+	}
+	bt_heap_init(&heap, 0, entry_gt, entry_key);
+
+	for (i = 0; i < NR_OPS; i++) {
+		struct entry *e, *max, *res;
+
+		op = rand_below(16);
+		e = &entries[rand_below(NR_ENTRIES)];
+		max = ref_maximum();
+		if (op < 6) {
+			/* Insert a few entries in a row: dirty rebuild. */
+			unsigned int n = 1 + rand_below(4);
+
+			while (n--) {
+				e = &entries[rand_below(NR_ENTRIES)];
+				if (e->queued)
+					continue;
+				/* Few distinct keys, to get ties. */
+				e->key = rand_below(32);
+				if (bt_heap_insert(&heap, e))
+					ok_insert = 0;
+				e->queued = 1;
+				nr_inserts++;
+			}
+			if (bt_heap_maximum(&heap) != ref_maximum())
+				ok_insert = 0;
+		} else if (op < 9) {
+			res = bt_heap_remove(&heap);
+			if (res != max)
+				ok_remove = 0;
+			if (res)
+				res->queued = 0;
+			nr_removes++;
+		} else if (op < 10 && max) {
+			/* Cherrypick the winner. */
+			if (bt_heap_cherrypick(&heap, max) != max)
+				ok_cherrypick_max = 0;
+			max->queued = 0;
+			if (bt_heap_maximum(&heap) != ref_maximum())
+				ok_cherrypick_max = 0;
+			nr_cherrypick_max++;
+		} else if (op < 12) {
+			/* Cherrypick any entry, queued or not. */
+			res = bt_heap_cherrypick(&heap, e);
+			if (!e->queued) {
+				if (res)
+					ok_cherrypick_absent = 0;
+			} else {
+				if (res != e)
+					ok_cherrypick_other = 0;
+				e->queued = 0;
+				nr_cherrypick_other++;
+			}
+			if (bt_heap_maximum(&heap) != ref_maximum())
+				ok_cherrypick_other = 0;
+		} else if (op < 15 && max) {
+			/*
+			 * Replace the winner by itself with a larger key:
+			 * it either still wins (fast path) or its matches
+			 * are replayed.
+			 */
+			if (rand_below(2)) {
+				max->key++;
+				nr_replace_small++;
+			} else {
+				max->key += rand_below(32);
+				nr_replace_large++;
+			}
+			if (bt_heap_replace_max(&heap, max) != max)
+				ok_replace = 0;
+			if (bt_heap_maximum(&heap) != ref_maximum())
+				ok_replace = 0;
+		} else if (op == 15) {
+			if (bt_heap_copy(&copy, &heap)) {
+				ok_copy = 0;
+			} else {
+				if (!drain_matches(&copy))
+					ok_copy = 0;
+				bt_heap_free(&copy);
+			}
+			nr_copies++;
+		}
+		if (ok_len && heap.len != ref_len()) {
+			diag("Heap length %zu after operation %u, expected %zu",
+				heap.len, i, ref_len());
+			ok_len = 0;
+		}
+	}
+
+	ok(ok_insert, "Maximum after %d inserts, rebuilding the tree",
+		nr_inserts);
+	ok(ok_remove, "%d removes in order, leaving holes", nr_removes);
+	ok(ok_cherrypick_max, "%d cherrypicks of the maximum",
+		nr_cherrypick_max);
+	ok(ok_cherrypick_other, "%d cherrypicks of other entries",
+		nr_cherrypick_other);
+	ok(ok_cherrypick_absent, "Cherrypick of an absent entry returns NULL");
+	ok(ok_replace, "%d + %d replace_max, with small and large key increases",
+		nr_replace_small, nr_replace_large);
+	ok(ok_copy, "%d copies drain in order", nr_copies);
+	ok(ok_len, "Heap length follows the operations");
+	ok(drain_matches(&heap), "Heap drains in order");
+	ok(heap.len == 0 && !bt_heap_maximum(&heap), "Drained heap is empty");
+	bt_heap_free(&heap);
+}
+
+int main(int argc, char **argv)
+{
+	plan_tests(NR_TESTS);
+
+	test_empty();
+	test_random_ops();
+
+	return exit_status();
+}
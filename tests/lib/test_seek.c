@@ -28,12 +28,15 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <errno.h>
+#include <inttypes.h>
 #include <limits.h>
+#include <string.h>
+#include <glib.h>
 
 #include <tap/tap.h>
 #include "common.h"
 
-#define NR_TESTS	29
+#define NR_TESTS	48
 
 void run_seek_begin(char *path, uint64_t expected_begin)
 {
@@ -291,6 +294,392 @@ void run_seek_cycles(char *path,
 	bt_context_put(ctx);
 }
 
+void run_read_events(char *path,
+		uint64_t expected_begin,
+		uint64_t expected_last)
+{
+	struct bt_context *ctx;
+	struct bt_ctf_iter *iter;
+	struct bt_ctf_event_batch batch;
+	uint64_t timestamp[16], prev_timestamp;
+	int ret, i, ordered = 1;
+	unsigned int nr_read_events_tests;
+
+	nr_read_events_tests = 5;
+
+	/* Open the trace */
+	ctx = create_context_with_path(path);
+	if (!ctx) {
+		skip(nr_read_events_tests, "Cannot create valid context");
+		return;
+	}
+
+	/* Create iterator with null begin and end */
+	iter = bt_ctf_iter_create(ctx, NULL, NULL);
+	if (!iter) {
+		skip(nr_read_events_tests, "Cannot create valid iterator");
+		return;
+	}
+
+	memset(&batch, 0, sizeof(batch));
+	batch.timestamp = timestamp;
+	ret = bt_ctf_iter_read_events(iter, &batch, 1);
+
+	ok(ret == 1, "Read first event batch retval %d", ret);
+	ok1(timestamp[0] == expected_begin);
+
+	/* Read the rest of the trace */
+	prev_timestamp = timestamp[0];
+	for (;;) {
+		ret = bt_ctf_iter_read_events(iter, &batch, 16);
+		if (ret == -EAGAIN) {
+			if (bt_iter_next(bt_ctf_get_iter(iter)) < 0)
+				break;
+			continue;
+		}
+		if (ret <= 0)
+			break;
+		for (i = 0; i < ret; i++) {
+			if (timestamp[i] < prev_timestamp)
+				ordered = 0;
+			prev_timestamp = timestamp[i];
+		}
+	}
+
+	ok(ret == 0, "Read events until end of trace retval %d", ret);
+	ok(ordered, "Batch timestamps are ordered");
+	ok1(prev_timestamp == expected_last);
+
+	bt_ctf_iter_destroy(iter);
+	bt_context_put(ctx);
+}
+
+struct event_ref {
+	uint64_t timestamp;
+	GQuark name;
+};
+
+/*
+ * Read all the events of an iterator, from its current position.
+ */
+static
+GArray *read_event_refs(struct bt_ctf_iter *iter)
+{
+	GArray *refs = g_array_new(FALSE, FALSE, sizeof(struct event_ref));
+	struct bt_ctf_event *event;
+	struct event_ref ref;
+
+	while ((event = bt_ctf_iter_read_event(iter))) {
+		ref.timestamp = bt_ctf_get_timestamp(event);
+		ref.name = g_quark_from_string(bt_ctf_event_name(event));
+		g_array_append_val(refs, ref);
+		if (bt_iter_next(bt_ctf_get_iter(iter)) < 0)
+			break;
+	}
+	return refs;
+}
+
+static
+struct bt_ctf_iter *create_filtered_iter(struct bt_context *ctx,
+		const char *name, uint64_t begin, uint64_t end)
+{
+	struct bt_ctf_iter_filter *filter;
+	struct bt_ctf_iter *iter;
+
+	filter = bt_ctf_iter_filter_create();
+	if (!filter)
+		return NULL;
+	if (name)
+		bt_ctf_iter_filter_add_event_name(filter, name);
+	bt_ctf_iter_filter_set_time_range(filter, begin, end);
+	iter = bt_ctf_iter_create_filtered(ctx, NULL, NULL, filter);
+	bt_ctf_iter_filter_destroy(filter);
+	return iter;
+}
+
+/*
+ * Check the filtered iterators against the events of an unfiltered
+ * read: the events of one name, the events of a time range which
+ * excludes whole packets at both ends, and seeks among the events of
+ * one name.
+ */
+void run_filter_events(char *path)
+{
+	struct bt_context *ctx;
+	struct bt_ctf_iter *iter;
+	struct bt_ctf_event *event;
+	struct bt_iter_pos newpos;
+	GArray *all = NULL, *refs;
+	struct event_ref *ref, *expected;
+	uint64_t range_begin, range_end, seek_time;
+	unsigned int i, nr_expected, nr_filter_tests;
+	const char *name;
+	GQuark name_q;
+	int ret, ok_refs;
+
+	nr_filter_tests = 11;
+
+	/* Open the trace */
+	ctx = create_context_with_path(path);
+	if (!ctx) {
+		skip(nr_filter_tests, "Cannot create valid context");
+		return;
+	}
+
+	iter = bt_ctf_iter_create(ctx, NULL, NULL);
+	if (!iter) {
+		skip(nr_filter_tests, "Cannot create valid iterator");
+		goto end;
+	}
+	all = read_event_refs(iter);
+	bt_ctf_iter_destroy(iter);
+	if (all->len < 4) {
+		skip(nr_filter_tests, "Not enough events in trace");
+		goto end;
+	}
+
+	/* Event name filter */
+	name_q = g_array_index(all, struct event_ref, all->len / 2).name;
+	name = g_quark_to_string(name_q);
+	iter = create_filtered_iter(ctx, name, 0, UINT64_MAX);
+	if (!iter) {
+		skip(nr_filter_tests, "Cannot create filtered iterator");
+		goto end;
+	}
+	refs = read_event_refs(iter);
+	nr_expected = 0;
+	ok_refs = 1;
+	for (i = 0; i < all->len; i++) {
+		expected = &g_array_index(all, struct event_ref, i);
+		if (expected->name != name_q)
+			continue;
+		if (nr_expected >= refs->len)
+			ok_refs = 0;
+		else if (g_array_index(refs, struct event_ref,
+				nr_expected).timestamp != expected->timestamp)
+			ok_refs = 0;
+		nr_expected++;
+	}
+	ok(refs->len == nr_expected,
+		"Name filter on \"%s\" returns %u events", name, refs->len);
+	ok(ok_refs, "Name filter returns the events of that name");
+	g_array_free(refs, TRUE);
+
+	/* Seeks on the filtered iterator */
+	seek_time = g_array_index(all, struct event_ref, all->len / 2 - 1).timestamp;
+	expected = NULL;
+	for (i = 0; i < all->len; i++) {
+		ref = &g_array_index(all, struct event_ref, i);
+		if (ref->name == name_q && ref->timestamp >= seek_time) {
+			expected = ref;
+			break;
+		}
+	}
+	newpos.type = BT_SEEK_TIME;
+	newpos.u.seek_time = seek_time;
+	ret = bt_iter_set_pos(bt_ctf_get_iter(iter), &newpos);
+	ok(ret == 0, "Seek time on filtered iterator retval %d", ret);
+	event = bt_ctf_iter_read_event(iter);
+	ok(event && expected
+		&& bt_ctf_get_timestamp(event) == expected->timestamp
+		&& !strcmp(bt_ctf_event_name(event), name),
+		"Seek time on filtered iterator lands on the next event of that name");
+
+	newpos.type = BT_SEEK_BEGIN;
+	ret = bt_iter_set_pos(bt_ctf_get_iter(iter), &newpos);
+	event = bt_ctf_iter_read_event(iter);
+	expected = NULL;
+	for (i = 0; i < all->len; i++) {
+		ref = &g_array_index(all, struct event_ref, i);
+		if (ref->name == name_q) {
+			expected = ref;
+			break;
+		}
+	}
+	ok(ret == 0 && event && expected
+		&& bt_ctf_get_timestamp(event) == expected->timestamp,
+		"Seek begin on filtered iterator lands on the first event of that name");
+	bt_ctf_iter_destroy(iter);
+
+	/*
+	 * Time range filter, from the middle of the first quarter of
+	 * the trace to the middle of the last one.
+	 */
+	range_begin = g_array_index(all, struct event_ref, all->len / 4).timestamp;
+	range_end = g_array_index(all, struct event_ref,
+			all->len - 1 - all->len / 4).timestamp;
+	iter = create_filtered_iter(ctx, NULL, range_begin, range_end);
+	if (!iter) {
+		skip(6, "Cannot create filtered iterator");
+		goto end;
+	}
+	refs = read_event_refs(iter);
+	nr_expected = 0;
+	for (i = 0; i < all->len; i++) {
+		ref = &g_array_index(all, struct event_ref, i);
+		if (ref->timestamp >= range_begin && ref->timestamp <= range_end)
+			nr_expected++;
+	}
+	ok(refs->len == nr_expected,
+		"Time range filter returns %u events, expected %u",
+		refs->len, nr_expected);
+	ok(refs->len
+		&& g_array_index(refs, struct event_ref, 0).timestamp == range_begin,
+		"Time range filter starts at its begin bound");
+	ok(refs->len
+		&& g_array_index(refs, struct event_ref,
+			refs->len - 1).timestamp == range_end,
+		"Time range filter stops at its end bound");
+	g_array_free(refs, TRUE);
+
+	/* The end bound is the end of the trace: later reads give EOF. */
+	ret = bt_iter_next(bt_ctf_get_iter(iter));
+	event = bt_ctf_iter_read_event(iter);
+	ok(ret == 0 && !event, "Read past the end bound returns no event");
+
+	/* A time seek before the begin bound lands on the begin bound. */
+	newpos.type = BT_SEEK_TIME;
+	newpos.u.seek_time = 0;
+	ret = bt_iter_set_pos(bt_ctf_get_iter(iter), &newpos);
+	event = bt_ctf_iter_read_event(iter);
+	ok(ret == 0 && event && bt_ctf_get_timestamp(event) == range_begin,
+		"Seek time before the range lands on its begin bound");
+
+	/* Last event seek stops at the end bound. */
+	newpos.type = BT_SEEK_LAST;
+	ret = bt_iter_set_pos(bt_ctf_get_iter(iter), &newpos);
+	event = bt_ctf_iter_read_event(iter);
+	ok(ret == 0 && event && bt_ctf_get_timestamp(event) == range_end,
+		"Seek last on time range lands on its end bound");
+	bt_ctf_iter_destroy(iter);
+
+end:
+	if (all)
+		g_array_free(all, TRUE);
+	bt_context_put(ctx);
+}
+
+/*
+ * Return the timestamp of the first event at or after a time, or
+ * UINT64_MAX if there is none. The events are ordered by time.
+ */
+static
+uint64_t ref_seek_time(GArray *refs, uint64_t time)
+{
+	unsigned int low = 0, high = refs->len;
+
+	while (low < high) {
+		unsigned int mid = low + (high - low) / 2;
+
+		if (g_array_index(refs, struct event_ref, mid).timestamp < time)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+	if (low == refs->len)
+		return UINT64_MAX;
+	return g_array_index(refs, struct event_ref, low).timestamp;
+}
+
+/*
+ * Seek to the time of one event out of SEEK_MID_PACKET_STEP, or just
+ * after it, and check the first event read against an unfiltered
+ * read. Packets of several hundred events hold targets past the first
+ * sub-index entries of their packet, reached from an earlier entry.
+ * Return the number of mismatches.
+ */
+#define SEEK_MID_PACKET_STEP	37
+
+static
+unsigned int seek_mid_packet_targets(struct bt_ctf_iter *iter,
+		GArray *refs, unsigned int order)
+{
+	struct bt_iter_pos newpos;
+	struct bt_ctf_event *event;
+	unsigned int i, nr_targets, nr_mismatches = 0;
+	uint64_t seed = 42;
+
+	nr_targets = refs->len / SEEK_MID_PACKET_STEP;
+	newpos.type = BT_SEEK_TIME;
+	for (i = 0; i < nr_targets; i++) {
+		unsigned int target, nr;
+		uint64_t expected;
+		int ret;
+
+		switch (order) {
+		case 0:		/* Forward */
+			target = i;
+			break;
+		case 1:		/* Backward */
+			target = nr_targets - 1 - i;
+			break;
+		default:	/* Pseudo-random */
+			seed = seed * 6364136223846793005ULL
+				+ 1442695040888963407ULL;
+			target = (seed >> 33) % nr_targets;
+			break;
+		}
+		nr = target * SEEK_MID_PACKET_STEP;
+		newpos.u.seek_time = g_array_index(refs, struct event_ref,
+			nr).timestamp + (target & 1);
+		expected = ref_seek_time(refs, newpos.u.seek_time);
+		ret = bt_iter_set_pos(bt_ctf_get_iter(iter), &newpos);
+		event = bt_ctf_iter_read_event(iter);
+		if (expected == UINT64_MAX) {
+			if (ret != EOF && event)
+				nr_mismatches++;
+			continue;
+		}
+		if (ret || !event || bt_ctf_get_timestamp(event) != expected) {
+			if (!nr_mismatches++)
+				diag("Seek time %" PRIu64 ": retval %d, event at %"
+					PRIu64 " instead of %" PRIu64,
+					newpos.u.seek_time, ret,
+					event ? bt_ctf_get_timestamp(event) : 0,
+					expected);
+		}
+	}
+	return nr_mismatches;
+}
+
+/*
+ * Check time seeks landing anywhere within packets, forward, backward
+ * (using the sub-index entries recorded by later seeks) and at random.
+ */
+void run_seek_mid_packet(char *path)
+{
+	struct bt_context *ctx;
+	struct bt_ctf_iter *iter;
+	GArray *refs;
+	unsigned int nr_seek_mid_packet_tests;
+
+	nr_seek_mid_packet_tests = 3;
+
+	ctx = create_context_with_path(path);
+	if (!ctx) {
+		skip(nr_seek_mid_packet_tests, "Cannot create valid context");
+		return;
+	}
+	iter = bt_ctf_iter_create(ctx, NULL, NULL);
+	if (!iter) {
+		skip(nr_seek_mid_packet_tests, "Cannot create valid iterator");
+		bt_context_put(ctx);
+		return;
+	}
+	refs = read_event_refs(iter);
+
+	ok(!seek_mid_packet_targets(iter, refs, 0),
+		"Forward time seeks within packets");
+	ok(!seek_mid_packet_targets(iter, refs, 1),
+		"Backward time seeks within packets");
+	ok(!seek_mid_packet_targets(iter, refs, 2),
+		"Random time seeks within packets");
+
+	g_array_free(refs, TRUE);
+	bt_ctf_iter_destroy(iter);
+	bt_context_put(ctx);
+}
+
 int main(int argc, char **argv)
 {
 	char *path;
@@ -328,6 +717,9 @@ int main(int argc, char **argv)
 	run_seek_time_at_last(path, expected_last);
 	run_seek_last(path, expected_last);
 	run_seek_cycles(path, expected_begin, expected_last);
+	run_read_events(path, expected_begin, expected_last);
+	run_filter_events(path);
+	run_seek_mid_packet(path);
 
 	return exit_status();
 }
@@ -112,5 +112,101 @@ class TestBabeltracePythonModule(unittest.TestCase):
 		f.close()
 
 
+class TestFieldHandle(unittest.TestCase):
+
+	def open_trace(self, path):
+		tc = TraceCollection()
+		self.assertIsNotNone(tc.add_trace(path, "ctf"), "Error adding trace")
+		return tc
+
+	def test_other_event_class(self):
+		tc = self.open_trace("ctf-traces/succeed/lttng-modules-2.0-pre5")
+		handle = None
+		nr_other = 0
+		for event in tc.events:
+			if handle is None and event.name == "sched_switch":
+				handle = event.field_handle("prev_tid")
+				self.assertIsNotNone(handle, "Error creating field handle")
+			if handle is None:
+				continue
+			value = event.field_with_handle(handle)
+			if event.name == "sched_switch":
+				self.assertEqual(value,
+					event.field_with_scope("prev_tid",
+						CTFScope.EVENT_FIELDS))
+			else:
+				self.assertIsNone(value,
+					"Handle used on {}".format(event.name))
+				nr_other += 1
+		self.assertGreater(nr_other, 0, "No event of another class")
+
+	def test_underscore_prefix(self):
+		tc = self.open_trace("ctf-traces/succeed/wk-heartbeat-u")
+		handles = None
+		for event in tc.events:
+			if handles is None:
+				handles = [
+					("msg", CTFScope.EVENT_FIELDS),
+					("vtid", CTFScope.STREAM_EVENT_CONTEXT),
+					("_vpid", CTFScope.STREAM_EVENT_CONTEXT),
+				]
+				handles = [(name, scope,
+					event.field_handle(name, scope))
+					for name, scope in handles]
+			for name, scope, handle in handles:
+				self.assertIsNotNone(handle,
+					"Error creating field handle for " + name)
+				self.assertEqual(handle.scope, scope)
+				value = event.field_with_handle(handle)
+				self.assertIsNotNone(value)
+				self.assertEqual(value,
+					event.field_with_scope(name, scope))
+		self.assertIsNotNone(handles, "No event read")
+
+	def test_variant(self):
+		tc = self.open_trace("ctf-traces/succeed/lttng-modules-2.0-pre5")
+		handle = None
+		for event in tc.events:
+			if handle is None:
+				handle = event.field_handle("v",
+					CTFScope.STREAM_EVENT_HEADER)
+				self.assertIsNotNone(handle,
+					"Error creating field handle")
+			value = event.field_with_handle(handle)
+			# The selected structure, not the variant.
+			self.assertIsInstance(value, dict)
+			self.assertIn("timestamp", value)
+			self.assertEqual(value,
+				event.field_with_scope("v",
+					CTFScope.STREAM_EVENT_HEADER))
+
+	def test_stream_scope(self):
+		tc = self.open_trace("ctf-traces/succeed/lttng-modules-2.0-pre5")
+		handle = None
+		names = set()
+		for event in tc.events:
+			if handle is None:
+				handle = event.field_handle("cpu_id",
+					CTFScope.STREAM_PACKET_CONTEXT)
+				self.assertIsNotNone(handle,
+					"Error creating field handle")
+			names.add(event.name)
+			value = event.field_with_handle(handle)
+			self.assertIsNotNone(value,
+				"No cpu_id for {}".format(event.name))
+			self.assertEqual(value,
+				event.field_with_scope("cpu_id",
+					CTFScope.STREAM_PACKET_CONTEXT))
+		self.assertGreater(len(names), 1, "Single event class read")
+
+	def test_missing_field(self):
+		tc = self.open_trace("ctf-traces/succeed/lttng-modules-2.0-pre5")
+		for event in tc.events:
+			self.assertIsNone(event.field_handle("no_such_field"))
+			self.assertRaises(ValueError, event.field_handle,
+				"cpu_id", -1)
+			break
+
+
 if __name__ == "__main__":
 	unittest.main()
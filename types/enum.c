@@ -30,6 +30,8 @@
 #include <babeltrace/format.h>
 #include <babeltrace/types.h>
 #include <stdint.h>
+#include <stdlib.h>
+#include <assert.h>
 #include <glib.h>
 
 #if (__LONG_MAX__ == 2147483647L)
@@ -120,6 +122,271 @@ void enum_val_free(void *ptr)
 }
 #endif /* WORD_SIZE != 32 */
 
+/* Largest value domain mapped through a dense table. */
+#define ENUM_DENSE_MAX_LEN	4096
+
+/*
+ * Elementary interval of the enumeration value domain, over which the
+ * quark set is constant. Bounds are inclusive, expressed as index keys.
+ */
+struct enum_interval {
+	uint64_t start;
+	uint64_t end;
+	GArray *quark_set;
+};
+
+/*
+ * Immutable lookup index, built when the enumeration is frozen. Values
+ * are mapped to unsigned keys preserving their order, so signed and
+ * unsigned enumerations share the same index.
+ */
+struct enum_index {
+	struct enum_interval *intervals;	/* Sorted, non-overlapping */
+	size_t nr_intervals;
+	/* Quark sets indexed by key - dense_base, NULL if unused. */
+	GArray **dense;
+	uint64_t dense_base;
+	uint64_t dense_len;
+};
+
+static inline
+uint64_t enum_uint_key(uint64_t v)
+{
+	return v;
+}
+
+static inline
+uint64_t enum_int_key(int64_t v)
+{
+	return (uint64_t) v ^ (1ULL << 63);
+}
+
+static
+uint64_t enum_range_key(const struct declaration_enum *enum_declaration,
+		const struct enum_range *range, int end)
+{
+	if (enum_declaration->integer_declaration->signedness)
+		return enum_int_key(end ? range->end._signed : range->start._signed);
+	else
+		return enum_uint_key(end ? range->end._unsigned : range->start._unsigned);
+}
+
+static
+uint64_t enum_hash_key(const struct declaration_enum *enum_declaration,
+		gconstpointer key)
+{
+	uint64_t v;
+
+#if (WORD_SIZE == 32)
+	v = *(const uint64_t *) key;
+#else
+	v = (uint64_t) (unsigned long) key;
+#endif
+	if (enum_declaration->integer_declaration->signedness)
+		return enum_int_key((int64_t) v);
+	else
+		return enum_uint_key(v);
+}
+
+static
+GArray *enum_index_lookup(const struct enum_index *index, uint64_t key)
+{
+	size_t lo = 0, hi = index->nr_intervals;
+
+	if (index->dense) {
+		if (key - index->dense_base < index->dense_len)
+			return index->dense[key - index->dense_base];
+		return NULL;
+	}
+	while (lo < hi) {
+		size_t mid = lo + ((hi - lo) >> 1);
+		const struct enum_interval *interval = &index->intervals[mid];
+
+		if (key < interval->start)
+			hi = mid;
+		else if (key > interval->end)
+			lo = mid + 1;
+		else
+			return interval->quark_set;
+	}
+	return NULL;
+}
+
+static
+int uint64_compare(const void *a, const void *b)
+{
+	uint64_t ua = *(const uint64_t *) a, ub = *(const uint64_t *) b;
+
+	return ua < ub ? -1 : (ua > ub);
+}
+
+/*
+ * Return the index of the elementary interval starting at key, which
+ * must be a boundary.
+ */
+static
+size_t enum_boundary_index(const uint64_t *bounds, size_t nr_bounds,
+		uint64_t key)
+{
+	const uint64_t *b;
+
+	b = bsearch(&key, bounds, nr_bounds, sizeof(*bounds), uint64_compare);
+	assert(b);
+	return b - bounds;
+}
+
+static
+void enum_index_free(struct enum_index *index)
+{
+	size_t i;
+
+	if (!index)
+		return;
+	for (i = 0; i < index->nr_intervals; i++)
+		g_array_unref(index->intervals[i].quark_set);
+	g_free(index->intervals);
+	g_free(index->dense);
+	g_free(index);
+}
+
+/*
+ * Build the interval index. The domain is split at each mapping
+ * boundary into elementary intervals. Each interval gets the quark set
+ * bt_enum_*_to_quark_set() would return for its values: single value
+ * quarks first, then range quarks in list order.
+ */
+static
+struct enum_index *enum_index_build(const struct declaration_enum *enum_declaration)
+{
+	const struct enum_table *table = &enum_declaration->table;
+	struct enum_range_to_quark *iter;
+	struct enum_index *index;
+	GArray **sets;
+	uint64_t *bounds;
+	size_t nr_bounds = 0, nr_alloc, i, j;
+	GHashTableIter hiter;
+	gpointer key, value;
+
+	nr_alloc = 2 * g_hash_table_size(table->value_to_quark_set);
+	bt_list_for_each_entry(iter, &table->range_to_quark, node)
+		nr_alloc += 2;
+	bounds = g_new(uint64_t, nr_alloc + 1);
+
+	/* Interval start boundaries. A boundary past the maximum is dropped. */
+	g_hash_table_iter_init(&hiter, table->value_to_quark_set);
+	while (g_hash_table_iter_next(&hiter, &key, &value)) {
+		uint64_t k = enum_hash_key(enum_declaration, key);
+
+		bounds[nr_bounds++] = k;
+		if (k != UINT64_MAX)
+			bounds[nr_bounds++] = k + 1;
+	}
+	bt_list_for_each_entry(iter, &table->range_to_quark, node) {
+		uint64_t start = enum_range_key(enum_declaration, &iter->range, 0);
+		uint64_t end = enum_range_key(enum_declaration, &iter->range, 1);
+
+		bounds[nr_bounds++] = start;
+		if (end != UINT64_MAX)
+			bounds[nr_bounds++] = end + 1;
+	}
+	qsort(bounds, nr_bounds, sizeof(*bounds), uint64_compare);
+	for (i = 0, j = 0; i < nr_bounds; i++) {
+		if (j && bounds[j - 1] == bounds[i])
+			continue;
+		bounds[j++] = bounds[i];
+	}
+	nr_bounds = j;
+
+	/* Quark set of each elementary interval. */
+	sets = g_new0(GArray *, nr_bounds);
+	g_hash_table_iter_init(&hiter, table->value_to_quark_set);
+	while (g_hash_table_iter_next(&hiter, &key, &value)) {
+		GArray *qs = value;
+
+		i = enum_boundary_index(bounds, nr_bounds,
+				enum_hash_key(enum_declaration, key));
+		sets[i] = g_array_sized_new(FALSE, TRUE, sizeof(GQuark),
+				qs->len + 1);
+		g_array_append_vals(sets[i], qs->data, qs->len);
+	}
+	bt_list_for_each_entry(iter, &table->range_to_quark, node) {
+		uint64_t end = enum_range_key(enum_declaration, &iter->range, 1);
+
+		for (i = enum_boundary_index(bounds, nr_bounds,
+				enum_range_key(enum_declaration, &iter->range, 0));
+				i < nr_bounds && bounds[i] <= end; i++) {
+			if (!sets[i])
+				sets[i] = g_array_sized_new(FALSE, TRUE,
+						sizeof(GQuark), 1);
+			g_array_append_val(sets[i], iter->quark);
+		}
+	}
+
+	index = g_new0(struct enum_index, 1);
+	index->intervals = g_new(struct enum_interval, nr_bounds);
+	for (i = 0; i < nr_bounds; i++) {
+		struct enum_interval *interval;
+
+		if (!sets[i])
+			continue;	/* Unmapped gap */
+		interval = &index->intervals[index->nr_intervals++];
+		interval->start = bounds[i];
+		interval->end = (i + 1 < nr_bounds) ? bounds[i + 1] - 1 : UINT64_MAX;
+		interval->quark_set = sets[i];
+	}
+
+	/* Small domains are looked up through a direct table. */
+	if (index->nr_intervals) {
+		struct enum_interval *first = &index->intervals[0];
+		struct enum_interval *last =
+			&index->intervals[index->nr_intervals - 1];
+
+		if (last->end - first->start < ENUM_DENSE_MAX_LEN) {
+			index->dense_base = first->start;
+			index->dense_len = last->end - first->start + 1;
+			index->dense = g_new0(GArray *, index->dense_len);
+			for (i = 0; i < index->nr_intervals; i++) {
+				struct enum_interval *interval =
+					&index->intervals[i];
+				uint64_t k, len;
+
+				len = interval->end - interval->start + 1;
+				for (k = 0; k < len; k++)
+					index->dense[interval->start
+						- index->dense_base + k] =
+						interval->quark_set;
+			}
+		}
+	}
+	g_free(sets);
+	g_free(bounds);
+	return index;
+}
+
+void bt_enum_declaration_freeze(struct declaration_enum *enum_declaration)
+{
+	enum_index_free(enum_declaration->table.index);
+	enum_declaration->table.index = enum_index_build(enum_declaration);
+}
+
+GArray *bt_enum_uint_lookup_quark_set(const struct declaration_enum *enum_declaration,
+			uint64_t v)
+{
+	if (!enum_declaration->table.index)
+		return NULL;
+	return enum_index_lookup(enum_declaration->table.index,
+			enum_uint_key(v));
+}
+
+GArray *bt_enum_int_lookup_quark_set(const struct declaration_enum *enum_declaration,
+			int64_t v)
+{
+	if (!enum_declaration->table.index)
+		return NULL;
+	return enum_index_lookup(enum_declaration->table.index,
+			enum_int_key(v));
+}
+
 /*
  * Returns a GArray or NULL.
  * Caller must release the GArray with g_array_unref().
@@ -130,6 +397,13 @@ GArray *bt_enum_uint_to_quark_set(const struct declaration_enum *enum_declaratio
 	struct enum_range_to_quark *iter;
 	GArray *qs, *ranges = NULL;
 
+	if (enum_declaration->table.index) {
+		qs = bt_enum_uint_lookup_quark_set(enum_declaration, v);
+		if (qs)
+			g_array_ref(qs);
+		return qs;
+	}
+
 	/* Single values lookup */
 	qs = g_hash_table_lookup(enum_declaration->table.value_to_quark_set,
 				 get_uint_v(&v));
@@ -177,6 +451,13 @@ GArray *bt_enum_int_to_quark_set(const struct declaration_enum *enum_declaration
 	struct enum_range_to_quark *iter;
 	GArray *qs, *ranges = NULL;
 
+	if (enum_declaration->table.index) {
+		qs = bt_enum_int_lookup_quark_set(enum_declaration, v);
+		if (qs)
+			g_array_ref(qs);
+		return qs;
+	}
+
 	/* Single values lookup */
 	qs = g_hash_table_lookup(enum_declaration->table.value_to_quark_set,
 				 get_int_v(&v));
@@ -305,6 +586,10 @@ void bt_enum_signed_insert(struct declaration_enum *enum_declaration,
 	GArray *array;
 	struct enum_range *range;
 
+	/* The index is rebuilt by the next freeze. */
+	enum_index_free(enum_declaration->table.index);
+	enum_declaration->table.index = NULL;
+
 	if (start == end) {
 		bt_enum_signed_insert_value_to_quark_set(enum_declaration, start, q);
 	} else {
@@ -339,6 +624,9 @@ void bt_enum_unsigned_insert(struct declaration_enum *enum_declaration,
 	GArray *array;
 	struct enum_range *range;
 
+	/* The index is rebuilt by the next freeze. */
+	enum_index_free(enum_declaration->table.index);
+	enum_declaration->table.index = NULL;
 
 	if (start == end) {
 		bt_enum_unsigned_insert_value_to_quark_set(enum_declaration, start, q);
@@ -386,6 +674,7 @@ void _enum_declaration_free(struct bt_declaration *declaration)
 		g_free(iter);
 	}
 	g_hash_table_destroy(enum_declaration->table.quark_to_range_set);
+	enum_index_free(enum_declaration->table.index);
 	bt_declaration_unref(&enum_declaration->integer_declaration->p);
 	g_free(enum_declaration);
 }
@@ -405,6 +694,7 @@ struct declaration_enum *
 	enum_declaration->table.quark_to_range_set = g_hash_table_new_full(g_direct_hash,
 							g_direct_equal,
 							NULL, enum_range_set_free);
+	enum_declaration->table.index = NULL;
 	bt_declaration_ref(&integer_declaration->p);
 	enum_declaration->integer_declaration = integer_declaration;
 	enum_declaration->p.id = CTF_TYPE_ENUM;
@@ -443,6 +733,7 @@ struct bt_definition *
 	_enum->p.path = bt_new_definition_path(parent_scope, field_name, root_name);
 	_enum->p.scope = bt_new_definition_scope(parent_scope, field_name, root_name);
 	_enum->value = NULL;
+	_enum->value_owned = 0;
 	ret = bt_register_field_definition(field_name, &_enum->p,
 					parent_scope);
 	assert(!ret);
@@ -464,7 +755,7 @@ void _enum_definition_free(struct bt_definition *definition)
 	bt_definition_unref(&_enum->integer->p);
 	bt_free_definition_scope(_enum->p.scope);
 	bt_declaration_unref(_enum->p.declaration);
-	if (_enum->value)
+	if (_enum->value_owned)
 		g_array_unref(_enum->value);
 	g_free(_enum);
 }
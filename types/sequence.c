@@ -30,6 +30,8 @@
 #include <babeltrace/format.h>
 #include <babeltrace/types.h>
 #include <inttypes.h>
+#include <stdio.h>
+#include <errno.h>
 
 static
 struct bt_definition *_sequence_definition_new(struct bt_declaration *declaration,
@@ -39,16 +41,17 @@ struct bt_definition *_sequence_definition_new(struct bt_declaration *declaratio
 static
 void _sequence_definition_free(struct bt_definition *definition);
 
-int bt_sequence_rw(struct bt_stream_pos *pos, struct bt_definition *definition)
+/*
+ * Create the element definitions of a sequence up to index len - 1.
+ */
+static
+void sequence_grow_elems(struct definition_sequence *sequence_definition,
+		uint64_t len)
 {
-	struct definition_sequence *sequence_definition =
-		container_of(definition, struct definition_sequence, p);
-	const struct declaration_sequence *sequence_declaration =
+	struct declaration_sequence *sequence_declaration =
 		sequence_definition->declaration;
-	uint64_t len, oldlen, i;
-	int ret;
+	uint64_t oldlen, i;
 
-	len = sequence_definition->length->value._unsigned;
 	/*
 	 * Yes, large sequences could be _painfully slow_ to parse due
 	 * to memory allocation for each event read. At least, never
@@ -58,24 +61,114 @@ int bt_sequence_rw(struct bt_stream_pos *pos, struct bt_definition *definition)
 	 * value for that.
 	 */
 	oldlen = sequence_definition->elems->len;
-	if (oldlen < len)
-		g_ptr_array_set_size(sequence_definition->elems, len);
+	if (oldlen >= len)
+		return;
+	g_ptr_array_set_size(sequence_definition->elems, len);
+
+	/*
+	 * Definitions of the same declaration may be grown by several
+	 * pipeline workers at once.
+	 */
+	pthread_mutex_lock(&sequence_declaration->elem_names_lock);
+	for (i = sequence_declaration->elem_names->len; i < len; i++) {
+		char name[sizeof("[]") + 20];
+		GQuark quark;
 
+		snprintf(name, sizeof(name), "[%" PRIu64 "]", i);
+		quark = g_quark_from_string(name);
+		g_array_append_val(sequence_declaration->elem_names, quark);
+	}
 	for (i = oldlen; i < len; i++) {
 		struct bt_definition **field;
-		GString *str;
 		GQuark name;
 
-		str = g_string_new("");
-		g_string_printf(str, "[%" PRIu64 "]", i);
-		name = g_quark_from_string(str->str);
-		(void) g_string_free(str, TRUE);
-
+		name = g_array_index(sequence_declaration->elem_names,
+				GQuark, i);
 		field = (struct bt_definition **) &g_ptr_array_index(sequence_definition->elems, i);
 		*field = sequence_declaration->elem->definition_new(sequence_declaration->elem,
 					  sequence_definition->p.scope,
 					  name, i, NULL);
 	}
+	pthread_mutex_unlock(&sequence_declaration->elem_names_lock);
+}
+
+/*
+ * Load the value of element i from the flat value buffer into its
+ * definition.
+ */
+static
+void sequence_load_elem(struct definition_sequence *sequence_definition,
+		uint64_t i, struct bt_definition *field)
+{
+	struct definition_integer *integer_definition =
+		container_of(field, struct definition_integer, p);
+	const char *data = sequence_definition->values->data;
+
+	if (integer_definition->declaration->signedness) {
+		switch (g_array_get_element_size(sequence_definition->values)) {
+		case 1:
+			integer_definition->value._signed = ((const int8_t *) data)[i];
+			break;
+		case 2:
+			integer_definition->value._signed = ((const int16_t *) data)[i];
+			break;
+		case 4:
+			integer_definition->value._signed = ((const int32_t *) data)[i];
+			break;
+		default:
+			integer_definition->value._signed = ((const int64_t *) data)[i];
+			break;
+		}
+	} else {
+		switch (g_array_get_element_size(sequence_definition->values)) {
+		case 1:
+			integer_definition->value._unsigned = ((const uint8_t *) data)[i];
+			break;
+		case 2:
+			integer_definition->value._unsigned = ((const uint16_t *) data)[i];
+			break;
+		case 4:
+			integer_definition->value._unsigned = ((const uint32_t *) data)[i];
+			break;
+		default:
+			integer_definition->value._unsigned = ((const uint64_t *) data)[i];
+			break;
+		}
+	}
+}
+
+int bt_sequence_load_elems(struct definition_sequence *sequence_definition)
+{
+	uint64_t len, i;
+
+	if (!sequence_definition->values)
+		return 0;
+	len = sequence_definition->length->value._unsigned;
+	if (len > sequence_definition->values->len)
+		return -EINVAL;
+	sequence_grow_elems(sequence_definition, len);
+	for (i = 0; i < len; i++)
+		sequence_load_elem(sequence_definition, i,
+			g_ptr_array_index(sequence_definition->elems, i));
+	return 0;
+}
+
+int bt_sequence_rw(struct bt_stream_pos *pos, struct bt_definition *definition)
+{
+	struct definition_sequence *sequence_definition =
+		container_of(definition, struct definition_sequence, p);
+	uint64_t len, i;
+	int ret;
+
+	len = sequence_definition->length->value._unsigned;
+	if (sequence_definition->values) {
+		/* Elements decoded in bulk: output their values. */
+		ret = bt_sequence_load_elems(sequence_definition);
+		if (ret)
+			return ret;
+	} else {
+		sequence_grow_elems(sequence_definition, len);
+	}
 	for (i = 0; i < len; i++) {
 		struct bt_definition **field;
 
@@ -95,6 +188,8 @@ void _sequence_declaration_free(struct bt_declaration *declaration)
 
 	bt_free_declaration_scope(sequence_declaration->scope);
 	g_array_free(sequence_declaration->length_name, TRUE);
+	g_array_free(sequence_declaration->elem_names, TRUE);
+	pthread_mutex_destroy(&sequence_declaration->elem_names_lock);
 	bt_declaration_unref(sequence_declaration->elem);
 	g_free(sequence_declaration);
 }
@@ -116,6 +211,8 @@ struct declaration_sequence *
 	bt_declaration_ref(elem_declaration);
 	sequence_declaration->elem = elem_declaration;
 	sequence_declaration->scope = bt_new_declaration_scope(parent_scope);
+	sequence_declaration->elem_names = g_array_new(FALSE, FALSE, sizeof(GQuark));
+	pthread_mutex_init(&sequence_declaration->elem_names_lock, NULL);
 	declaration->id = CTF_TYPE_SEQUENCE;
 	declaration->alignment = elem_declaration->alignment;
 	declaration->declaration_free = _sequence_declaration_free;
@@ -170,6 +267,7 @@ struct bt_definition *_sequence_definition_new(struct bt_declaration *declaratio
 
 	sequence->string = NULL;
 	sequence->elems = NULL;
+	sequence->values = NULL;
 
 	if (sequence_declaration->elem->id == CTF_TYPE_INTEGER) {
 		struct declaration_integer *integer_declaration =
@@ -184,6 +282,19 @@ struct bt_definition *_sequence_definition_new(struct bt_declaration *declaratio
 			    && integer_declaration->p.alignment == CHAR_BIT) {
 				return &sequence->p;
 			}
+		} else {
+			guint size;
+
+			/* Smallest native integer holding an element. */
+			if (integer_declaration->len <= 8)
+				size = 1;
+			else if (integer_declaration->len <= 16)
+				size = 2;
+			else if (integer_declaration->len <= 32)
+				size = 4;
+			else
+				size = 8;
+			sequence->values = g_array_new(FALSE, FALSE, size);
 		}
 	}
 
@@ -216,6 +327,8 @@ void _sequence_definition_free(struct bt_definition *definition)
 		}
 		(void) g_ptr_array_free(sequence->elems, TRUE);
 	}
+	if (sequence->values)
+		(void) g_array_free(sequence->values, TRUE);
 	bt_definition_unref(len_definition);
 	bt_free_definition_scope(sequence->p.scope);
 	bt_declaration_unref(sequence->p.declaration);
@@ -229,10 +342,20 @@ uint64_t bt_sequence_len(struct definition_sequence *sequence)
 
 struct bt_definition *bt_sequence_index(struct definition_sequence *sequence, uint64_t i)
 {
+	struct bt_definition *field;
+
 	if (!sequence->elems)
 		return NULL;
 	if (i >= sequence->length->value._unsigned)
 		return NULL;
+	if (sequence->values) {
+		if (i >= sequence->values->len)
+			return NULL;
+		sequence_grow_elems(sequence, i + 1);
+		field = g_ptr_array_index(sequence->elems, i);
+		sequence_load_elem(sequence, i, field);
+		return field;
+	}
 	assert(i < sequence->elems->len);
 	return g_ptr_array_index(sequence->elems, i);
 }
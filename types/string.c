@@ -91,7 +91,9 @@ struct bt_definition *
 	string->p.scope = NULL;
 	string->value = NULL;
 	string->len = 0;
+	string->buf = NULL;
 	string->alloc_len = 0;
+	string->borrowed = 0;
 	ret = bt_register_field_definition(field_name, &string->p,
 					parent_scope);
 	assert(!ret);
@@ -105,7 +107,7 @@ void _string_definition_free(struct bt_definition *definition)
 		container_of(definition, struct definition_string, p);
 
 	bt_declaration_unref(string->p.declaration);
-	g_free(string->value);
+	g_free(string->buf);
 	g_free(string);
 }
 
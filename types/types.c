@@ -279,16 +279,21 @@ int bt_register_field_definition(GQuark field_name, struct bt_definition *defini
 	return 0;
 }
 
+/*
+ * Declarations are shared by the definitions of all streams, which can
+ * be created concurrently (see ctf_open_file_streams_read()), hence the
+ * atomic reference count.
+ */
 void bt_declaration_ref(struct bt_declaration *declaration)
 {
-	declaration->ref++;
+	g_atomic_int_inc(&declaration->ref);
 }
 
 void bt_declaration_unref(struct bt_declaration *declaration)
 {
 	if (!declaration)
 		return;
-	if (!--declaration->ref)
+	if (g_atomic_int_dec_and_test(&declaration->ref))
 		declaration->declaration_free(declaration);
 }
 